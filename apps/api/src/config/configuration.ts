@@ -31,6 +31,16 @@ export default () => ({
     password: process.env.MQTT_PASSWORD || '',
   },
 
+  ota: {
+    // Firmware images for ota_mqtt, one {sha256}.bin per image
+    imageDir: process.env.OTA_IMAGE_DIR || './firmware-images',
+  },
+
+  crash: {
+    // Core dumps from crash reports, as {deviceId}/{reportId}.core
+    dumpDir: process.env.CRASH_DUMP_DIR || './crash-dumps',
+  },
+
   cors: {
     origin: process.env.CORS_ORIGIN || 'http://localhost:3000',
   },
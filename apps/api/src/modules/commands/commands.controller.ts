@@ -15,7 +15,7 @@ import { RolesGuard } from '../../common/guards/roles.guard';
 import { Roles } from '../../common/decorators/roles.decorator';
 import { CurrentTenant } from '../../common/decorators/current-tenant.decorator';
 import { ZodValidationPipe } from '../../common/pipes/zod-validation.pipe';
-import { createCommandSchema } from '@thingbase/shared';
+import { createCommandSchema, createBroadcastCommandSchema } from '@thingbase/shared';
 
 @ApiTags('Commands')
 @ApiBearerAuth('access-token')
@@ -80,6 +80,25 @@ export class CommandsController {
     };
   }
 
+  @Post('broadcast')
+  @Roles('admin')
+  @ApiOperation({
+    summary: 'Broadcast command',
+    description: 'Send a command to every device of the tenant, or of one group (admin only)',
+  })
+  @ApiResponse({ status: 201, description: 'Command published' })
+  async sendBroadcast(
+    @CurrentTenant() tenantId: string,
+    @Body(new ZodValidationPipe(createBroadcastCommandSchema))
+    dto: { type: string; payload: Record<string, unknown>; group?: string },
+  ) {
+    const result = await this.commands.sendBroadcast(tenantId, dto);
+    return {
+      success: true,
+      data: result,
+    };
+  }
+
   @Post(':id/retry')
   @Roles('admin')
   @ApiOperation({ summary: 'Retry command', description: 'Retry a failed or timed-out command (admin only)' })
@@ -18,6 +18,12 @@ interface CreateCommandDto {
   payload: Record<string, unknown>;
 }
 
+interface CreateBroadcastCommandDto {
+  type: string;
+  payload: Record<string, unknown>;
+  group?: string;
+}
+
 interface FindAllParams {
   deviceId?: string;
   page?: number;
@@ -160,13 +166,81 @@ export class CommandsService {
     }
   }
 
+  /**
+   * Send one command to every device of the tenant, or of one group
+   * Not stored per device: each device ACKs with the returned correlationId
+   * on its own ack topic, which reaches the device updates channel
+   */
+  async sendBroadcast(tenantId: string, dto: CreateBroadcastCommandDto) {
+    const correlationId = uuidv4();
+    const timestamp = new Date().toISOString();
+
+    await this.mqtt.publishBroadcast(
+      tenantId,
+      {
+        correlationId,
+        action: dto.type,
+        params: dto.payload,
+        timestamp,
+      },
+      dto.group,
+    );
+
+    this.logger.log(
+      `Broadcast ${dto.type} to ${dto.group ? `group ${dto.group}` : 'all devices'} of tenant ${tenantId}`,
+    );
+    return { correlationId, type: dto.type, group: dto.group ?? null, sentAt: timestamp };
+  }
+
+  /**
+   * Handle "accepted" / "progress" from a long-running command
+   * Marks it running and restarts the timeout, so a job that keeps
+   * reporting is not timed out while it works
+   */
+  async handleCommandProgress(correlationId: string, progress?: number) {
+    const key = REDIS_KEYS.COMMAND_CORRELATION(correlationId);
+    const correlationData = await this.redis.get(key);
+
+    if (!correlationData) {
+      this.logger.warn(`Command correlation not found: ${correlationId}`);
+      return;
+    }
+
+    const correlation = JSON.parse(correlationData);
+    const wasRunning = correlation.lastActivity !== undefined;
+    correlation.lastActivity = Date.now();
+    await this.redis.set(
+      key,
+      JSON.stringify(correlation),
+      this.COMMAND_TIMEOUT_MS / 1000,
+    );
+
+    if (!wasRunning) {
+      await this.prisma.command.update({
+        where: { id: correlation.commandId },
+        data: { status: COMMAND_STATUS.RUNNING },
+      });
+    }
+
+    await this.redis.publish(
+      REDIS_KEYS.COMMAND_UPDATES_CHANNEL(correlation.tenantId),
+      JSON.stringify({
+        type: 'command:update',
+        commandId: correlation.commandId,
+        status: COMMAND_STATUS.RUNNING,
+        progress,
+      }),
+    );
+  }
+
   /**
    * Handle command acknowledgement from device
    */
   async handleCommandAck(
     correlationId: string,
-    status: 'acked' | 'failed',
+    status: 'acked' | 'failed' | 'cancelled',
     errorMessage?: string,
+    result?: Record<string, unknown>,
   ) {
     // Look up command from correlation ID
     const correlationData = await this.redis.get(
@@ -201,6 +275,7 @@ export class CommandsService {
         commandId: command.id,
         status: command.status,
         errorMessage: command.errorMessage,
+        result,
         completedAt: command.completedAt,
       }),
     );
@@ -211,7 +286,11 @@ export class CommandsService {
   /**
    * Schedule a timeout check for a command
    */
-  private scheduleTimeoutCheck(commandId: string, correlationId: string) {
+  private scheduleTimeoutCheck(
+    commandId: string,
+    correlationId: string,
+    delayMs: number = this.COMMAND_TIMEOUT_MS,
+  ) {
     setTimeout(async () => {
       // Check if correlation still exists (means not acked)
       const exists = await this.redis.get(
@@ -219,7 +298,18 @@ export class CommandsService {
       );
 
       if (exists) {
-        const { tenantId } = JSON.parse(exists);
+        const { tenantId, lastActivity } = JSON.parse(exists);
+
+        // A long-running command reported since: wait a full timeout from then
+        const idleMs = lastActivity ? Date.now() - lastActivity : Infinity;
+        if (idleMs < this.COMMAND_TIMEOUT_MS) {
+          this.scheduleTimeoutCheck(
+            commandId,
+            correlationId,
+            this.COMMAND_TIMEOUT_MS - idleMs,
+          );
+          return;
+        }
 
         // Mark as timeout
         await this.prisma.command.update({
@@ -246,7 +336,7 @@ export class CommandsService {
 
         this.logger.warn(`Command ${commandId} timed out`);
       }
-    }, this.COMMAND_TIMEOUT_MS);
+    }, delayMs);
   }
 
   /**
@@ -0,0 +1,258 @@
+import { Injectable, OnModuleInit, Logger, Inject, forwardRef } from '@nestjs/common';
+import { ConfigService } from '@nestjs/config';
+import { promises as fs } from 'fs';
+import * as path from 'path';
+import { MqttService, MqttMessage } from './mqtt.service';
+import { PrismaService } from '../../prisma/prisma.service';
+import { RedisService } from '../../redis/redis.service';
+import { CommandsService } from '../commands/commands.service';
+import { REDIS_KEYS, CRASH_REPORT_LIMITS, mqttCrashReportSchema, MqttCrashReport } from '@thingbase/shared';
+
+type CrashReportBegin = Extract<MqttCrashReport, { type: 'begin' }>;
+
+// Chunk header: report id, then chunk index (4 bytes each, big-endian)
+const CHUNK_HEADER_LEN = 8;
+
+// A report the device stops sending is dropped after a week
+const REPORT_TTL_S = 7 * 24 * 3600;
+
+// CRC-32 (IEEE), as the firmware computes it over the dump
+function crc32(data: Buffer): number {
+  let crc = 0xffffffff;
+  for (const byte of data) {
+    crc ^= byte;
+    for (let bit = 0; bit < 8; bit++) {
+      crc = (crc >>> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+  }
+  return (crc ^ 0xffffffff) >>> 0;
+}
+
+/**
+ * Crash report ingest
+ *
+ * After a crash the next boot sends a begin message on .../crash, the core
+ * dump in chunks on .../crash/data and an end message. Chunks are collected
+ * in Redis; once all are in and the CRC matches, the dump is written to
+ * {crash.dumpDir}/{deviceId}/{reportId}.core and the device is told to
+ * erase it. Missing chunks are asked for again with crash_report.
+ */
+@Injectable()
+export class CrashReportsService implements OnModuleInit {
+  private readonly logger = new Logger(CrashReportsService.name);
+
+  constructor(
+    private readonly mqtt: MqttService,
+    private readonly prisma: PrismaService,
+    private readonly redis: RedisService,
+    @Inject(forwardRef(() => CommandsService))
+    private readonly commands: CommandsService,
+    private readonly config: ConfigService,
+  ) { }
+
+  onModuleInit() {
+    this.mqtt.registerHandler('crash', this.handleReport.bind(this));
+    this.mqtt.registerHandler('crash/data', this.handleChunk.bind(this));
+  }
+
+  /**
+   * Handle begin and end messages
+   */
+  private async handleReport(message: MqttMessage) {
+    const { tenantId, deviceId, payload } = message;
+
+    if (!tenantId || !deviceId) {
+      this.logger.warn('Invalid crash report: missing tenantId or deviceId');
+      return;
+    }
+
+    try {
+      const parseResult = mqttCrashReportSchema.safeParse(JSON.parse(payload.toString()));
+      if (!parseResult.success) {
+        this.logger.warn(`Invalid crash report payload from ${deviceId}: ${JSON.stringify(parseResult.error.format())}`);
+        return;
+      }
+
+      // Verify device belongs to tenant (security: prevents cross-tenant data injection)
+      const device = await this.prisma.device.findFirst({
+        where: { id: deviceId, tenantId },
+        select: { id: true },
+      });
+
+      if (!device) {
+        this.logger.warn(`Device ${deviceId} not found in tenant ${tenantId} - possible topic spoofing`);
+        return;
+      }
+
+      const report = parseResult.data;
+      if (report.type === 'begin') {
+        await this.handleBegin(tenantId, deviceId, report);
+      } else {
+        await this.handleEnd(tenantId, deviceId, report.id.toLowerCase());
+      }
+    } catch (error) {
+      this.logger.error(`Failed to process crash report from ${deviceId}`, error);
+    }
+  }
+
+  private async handleBegin(tenantId: string, deviceId: string, report: CrashReportBegin) {
+    const reportId = report.id.toLowerCase();
+
+    // Chunk loops and resend lists are sized from these
+    if (report.chunks !== Math.ceil(report.dumpSize / report.chunkSize)) {
+      this.logger.warn(
+        `Crash report ${reportId} from ${deviceId}: ${report.chunks} chunks do not hold ${report.dumpSize} bytes of ${report.chunkSize}`,
+      );
+      return;
+    }
+
+    // Sent again after every boot until erased; chunks already in are kept
+    await this.redis.set(
+      REDIS_KEYS.CRASH_REPORT(deviceId, reportId),
+      JSON.stringify(report),
+      REPORT_TTL_S,
+    );
+
+    const lastCrash = {
+      id: reportId,
+      reason: report.reason,
+      crashedBoot: report.crashedBoot,
+      uptimeMs: report.uptimeMs,
+      fw: report.fw,
+      dumpSize: report.dumpSize,
+      receivedAt: new Date().toISOString(),
+    };
+
+    const currentState = await this.redis.get(REDIS_KEYS.DEVICE_STATE(deviceId));
+    const state = currentState ? JSON.parse(currentState) : {};
+    await this.redis.set(
+      REDIS_KEYS.DEVICE_STATE(deviceId),
+      JSON.stringify({ ...state, lastCrash }),
+    );
+
+    await this.redis.publish(
+      REDIS_KEYS.DEVICE_UPDATES_CHANNEL(tenantId),
+      JSON.stringify({
+        type: 'device:crash',
+        deviceId,
+        crash: lastCrash,
+        timestamp: lastCrash.receivedAt,
+      }),
+    );
+
+    this.logger.warn(
+      `Device ${deviceId} crashed (${report.reason}, report ${reportId}, ${report.dumpSize} byte core dump)`,
+    );
+  }
+
+  /**
+   * Handle one core dump chunk: report id, chunk index, then the data
+   */
+  private async handleChunk(message: MqttMessage) {
+    const { deviceId, payload } = message;
+
+    if (!deviceId || payload.length <= CHUNK_HEADER_LEN) {
+      this.logger.warn(`Invalid crash data message from ${deviceId}`);
+      return;
+    }
+
+    try {
+      const reportId = payload.readUInt32BE(0).toString(16).padStart(8, '0');
+      const index = payload.readUInt32BE(4);
+      const data = payload.subarray(CHUNK_HEADER_LEN);
+
+      // Only for a report whose begin message came through
+      const stored = await this.redis.get(REDIS_KEYS.CRASH_REPORT(deviceId, reportId));
+      if (!stored) {
+        this.logger.debug(`Crash data from ${deviceId} for unknown report ${reportId}`);
+        return;
+      }
+
+      const report: CrashReportBegin = JSON.parse(stored);
+      const expected = Math.min(report.chunkSize, report.dumpSize - index * report.chunkSize);
+      if (index >= report.chunks || data.length !== expected) {
+        this.logger.warn(`Crash data from ${deviceId}: chunk ${index} of report ${reportId} has ${data.length} bytes`);
+        return;
+      }
+
+      const chunksKey = REDIS_KEYS.CRASH_CHUNKS(deviceId, reportId);
+      await this.redis.hset(chunksKey, String(index), data.toString('base64'));
+      await this.redis.getClient().expire(chunksKey, REPORT_TTL_S);
+    } catch (error) {
+      this.logger.error(`Failed to process crash data from ${deviceId}`, error);
+    }
+  }
+
+  /**
+   * The device has sent every chunk once: store the dump and confirm it,
+   * or ask for what is missing
+   */
+  private async handleEnd(tenantId: string, deviceId: string, reportId: string) {
+    const reportKey = REDIS_KEYS.CRASH_REPORT(deviceId, reportId);
+    const chunksKey = REDIS_KEYS.CRASH_CHUNKS(deviceId, reportId);
+    const stored = await this.redis.get(reportKey);
+    if (!stored) {
+      this.logger.debug(`Crash report end from ${deviceId} for unknown report ${reportId}`);
+      return;
+    }
+
+    // Without a dump the device does not wait for a confirmation
+    const report: CrashReportBegin = JSON.parse(stored);
+    if (report.dumpSize === 0) {
+      await this.redis.del(reportKey);
+      return;
+    }
+
+    const chunks = await this.redis.hgetall(chunksKey);
+    const missing: number[] = [];
+    for (let i = 0; i < report.chunks; i++) {
+      if (chunks[String(i)] === undefined) {
+        missing.push(i);
+      }
+    }
+
+    if (missing.length > 0) {
+      this.logger.log(`Crash report ${reportId} from ${deviceId}: asking for ${missing.length} missing chunk(s)`);
+      await this.commands.sendCommand(tenantId, {
+        deviceId,
+        type: 'crash_report',
+        payload: { id: reportId, chunks: missing.slice(0, CRASH_REPORT_LIMITS.MAX_CHUNKS) },
+      });
+      return;
+    }
+
+    const dump = Buffer.concat(
+      Array.from({ length: report.chunks }, (_, i) => Buffer.from(chunks[String(i)], 'base64')),
+    );
+    if (dump.length !== report.dumpSize || crc32(dump) !== parseInt(report.crc32, 16)) {
+      // Start over: every chunk is asked for again
+      this.logger.warn(`Crash report ${reportId} from ${deviceId} failed its CRC check`);
+      await this.redis.del(chunksKey);
+      await this.commands.sendCommand(tenantId, {
+        deviceId,
+        type: 'crash_report',
+        payload: {
+          id: reportId,
+          chunks: Array.from({ length: Math.min(report.chunks, CRASH_REPORT_LIMITS.MAX_CHUNKS) }, (_, i) => i),
+        },
+      });
+      return;
+    }
+
+    const dumpDir = path.join(this.config.get<string>('crash.dumpDir')!, deviceId);
+    await fs.mkdir(dumpDir, { recursive: true });
+    await fs.writeFile(path.join(dumpDir, `${reportId}.core`), dump);
+
+    await this.redis.del(chunksKey);
+    await this.redis.del(reportKey);
+
+    // Stored: the device may erase its copy and stop reporting it
+    await this.commands.sendCommand(tenantId, {
+      deviceId,
+      type: 'crash_report',
+      payload: { id: reportId, erase: true },
+    });
+
+    this.logger.log(`Stored ${dump.length} byte core dump ${reportId} from ${deviceId}`);
+  }
+}
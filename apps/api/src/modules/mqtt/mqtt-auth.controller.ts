@@ -105,8 +105,9 @@ export class MqttAuthController {
      * Check ACL permissions for topic access
      * Called by EMQX on every publish/subscribe
      * 
-     * Topic pattern: iot/{tenantId}/devices/{deviceId}/{type}
-     * Devices can only access their own topics
+     * Topic pattern: iot/{tenantId}/devices/{deviceId}/{type}[/{subtype}]
+     * Devices can only access their own topics, plus their tenant's
+     * broadcast and group command topics
      */
     @Public()
     @Post('acl')
@@ -132,19 +133,49 @@ export class MqttAuthController {
             parts[2] === 'devices' &&
             parts[3] === username) {
 
-            const messageType = parts[4];
+            // Everything after the deviceId, e.g. "telemetry" or "ota/request"
+            const messageType = parts.slice(4).join('/');
 
-            // Write permissions: telemetry, ack, status
-            if (acc === 2 && ['telemetry', 'ack', 'status'].includes(messageType)) {
+            // Write permissions: telemetry, ack, status, time, rollup,
+            // ota/request, crash, crash/data
+            const writable = ['telemetry', 'ack', 'status', 'time', 'rollup', 'ota/request', 'crash', 'crash/data'];
+            if (acc === 2 && writable.includes(messageType)) {
                 return { result: 'allow' };
             }
 
-            // Read permissions: command
-            if (acc === 1 && messageType === 'command') {
+            // Read permissions: command, ota/data
+            if (acc === 1 && ['command', 'ota/data'].includes(messageType)) {
                 return { result: 'allow' };
             }
         }
 
+        // Fleet command topics, read-only and only within the device's tenant:
+        //   iot/{tenantId}/broadcast/command
+        //   iot/{tenantId}/groups/{group}/command
+        const isBroadcast = parts.length === 4 &&
+            parts[0] === 'iot' &&
+            parts[2] === 'broadcast' &&
+            parts[3] === 'command';
+        const isGroup = parts.length === 5 &&
+            parts[0] === 'iot' &&
+            parts[2] === 'groups' &&
+            /^[A-Za-z0-9_-]{1,32}$/.test(parts[3]) &&
+            parts[4] === 'command';
+
+        if (acc === 1 && (isBroadcast || isGroup)) {
+            try {
+                const device = await this.prisma.device.findFirst({
+                    where: { id: username, tenantId: parts[1] },
+                    select: { id: true },
+                });
+                if (device) {
+                    return { result: 'allow' };
+                }
+            } catch (error) {
+                this.logger.error(`MQTT ACL error: ${error.message}`);
+            }
+        }
+
         this.logger.warn(`ACL denied: ${username} tried to ${action} on ${topic}`);
         return { result: 'deny' };
     }
@@ -1,11 +1,14 @@
 import { Injectable, OnModuleInit, Logger, Inject, forwardRef } from '@nestjs/common';
+import { ConfigService } from '@nestjs/config';
+import { promises as fs } from 'fs';
+import * as path from 'path';
 import { MqttService, MqttMessage } from './mqtt.service';
 import { PrismaService } from '../../prisma/prisma.service';
 import { RedisService } from '../../redis/redis.service';
 import { CommandsService } from '../commands/commands.service';
 import { AlertEvaluatorService } from '../alerts/alert-evaluator.service';
 import { REDIS_KEYS } from '@thingbase/shared';
-import { mqttAckPayloadSchema, mqttTelemetryPayloadSchema, mqttStatusPayloadSchema } from '@thingbase/shared';
+import { mqttAckPayloadSchema, mqttTelemetryPayloadSchema, mqttStatusPayloadSchema, mqttTimeSyncRequestSchema, mqttOtaRequestSchema, mqttRollupPayloadSchema } from '@thingbase/shared';
 
 @Injectable()
 export class MqttHandlers implements OnModuleInit {
@@ -19,6 +22,7 @@ export class MqttHandlers implements OnModuleInit {
     private readonly commands: CommandsService,
     @Inject(forwardRef(() => AlertEvaluatorService))
     private readonly alertEvaluator: AlertEvaluatorService,
+    private readonly config: ConfigService,
   ) { }
 
   onModuleInit() {
@@ -26,6 +30,102 @@ export class MqttHandlers implements OnModuleInit {
     this.mqtt.registerHandler('telemetry', this.handleTelemetry.bind(this));
     this.mqtt.registerHandler('ack', this.handleAck.bind(this));
     this.mqtt.registerHandler('status', this.handleStatus.bind(this));
+    this.mqtt.registerHandler('time', this.handleTimeSync.bind(this));
+    this.mqtt.registerHandler('rollup', this.handleRollup.bind(this));
+    this.mqtt.registerHandler('ota/request', this.handleOtaRequest.bind(this));
+  }
+
+  /**
+   * Serve firmware chunks to a device running an ota_mqtt command
+   * The image is {ota.imageDir}/{sha256}.bin, sha256 from the command's
+   * params; each chunk goes out as its index (4 bytes, big-endian) then data
+   */
+  private async handleOtaRequest(message: MqttMessage) {
+    const { tenantId, deviceId, payload } = message;
+
+    if (!tenantId || !deviceId) {
+      this.logger.warn('Invalid OTA request: missing tenantId or deviceId');
+      return;
+    }
+
+    try {
+      const parseResult = mqttOtaRequestSchema.safeParse(JSON.parse(payload.toString()));
+      if (!parseResult.success) {
+        this.logger.warn(`Invalid OTA request payload from ${deviceId}`);
+        return;
+      }
+
+      const request = parseResult.data;
+
+      // Only for an update sent to this device (security: the correlationId
+      // alone must not unlock another tenant's image)
+      const command = await this.prisma.command.findFirst({
+        where: { correlationId: request.id, tenantId, deviceId, type: 'ota_mqtt' },
+        select: { payload: true },
+      });
+      const sha256 = (command?.payload as { sha256?: unknown } | undefined)?.sha256;
+
+      // Also keeps the file name inside the image directory
+      if (typeof sha256 !== 'string' || !/^[0-9a-fA-F]{64}$/.test(sha256)) {
+        this.logger.warn(`OTA request from ${deviceId} for unknown update ${request.id}`);
+        return;
+      }
+
+      const imageDir = this.config.get<string>('ota.imageDir')!;
+      const file = await fs.open(path.join(imageDir, `${sha256.toLowerCase()}.bin`), 'r');
+      try {
+        for (const index of request.chunks) {
+          const chunk = Buffer.alloc(4 + request.chunkSize);
+          chunk.writeUInt32BE(index, 0);
+          const { bytesRead } = await file.read(
+            chunk,
+            4,
+            request.chunkSize,
+            index * request.chunkSize,
+          );
+          if (bytesRead === 0) {
+            this.logger.warn(`OTA request from ${deviceId} for chunk ${index}, past the end of the image`);
+            continue;
+          }
+          await this.mqtt.publishOtaChunk(tenantId, deviceId, chunk.subarray(0, 4 + bytesRead));
+        }
+      } finally {
+        await file.close();
+      }
+
+      this.logger.debug(`Sent ${request.chunks.length} OTA chunk(s) to ${deviceId}`);
+    } catch (error) {
+      this.logger.error(`Failed to serve OTA request from ${deviceId}`, error);
+    }
+  }
+
+  /**
+   * Handle time sync requests from devices
+   * Replies NTP-style on the command topic: t0 echoed, t1 = receive, t2 = send
+   */
+  private async handleTimeSync(message: MqttMessage) {
+    const t1 = Date.now();
+    const { tenantId, deviceId, payload } = message;
+
+    if (!tenantId || !deviceId) {
+      this.logger.warn('Invalid time sync message: missing tenantId or deviceId');
+      return;
+    }
+
+    try {
+      const parseResult = mqttTimeSyncRequestSchema.safeParse(JSON.parse(payload.toString()));
+      if (!parseResult.success) {
+        this.logger.warn(`Invalid time sync payload from ${deviceId}`);
+        return;
+      }
+
+      await this.mqtt.publishCommand(tenantId, deviceId, {
+        action: 'time_sync',
+        params: { t0: parseResult.data.t0, t1, t2: Date.now() },
+      });
+    } catch (error) {
+      this.logger.error(`Failed to answer time sync from ${deviceId}`, error);
+    }
   }
 
   /**
@@ -62,14 +162,37 @@ export class MqttHandlers implements OnModuleInit {
         return;
       }
 
-      // Store telemetry in database
-      await this.prisma.telemetry.create({
-        data: {
-          tenantId,
-          deviceId,
-          data: data as any, // Cast for Prisma JSON type compatibility
-        },
-      });
+      // Stored at the time the sample was taken; receive time when the
+      // device clock was not synced yet
+      const sampledAt = data.timestamp ? new Date(data.timestamp) : new Date();
+
+      // Store telemetry in database. A numbered sample that is already
+      // stored (resent over an overlap, or redelivered) is skipped.
+      if (data.boot && data.seq) {
+        await this.prisma.telemetry.upsert({
+          where: {
+            deviceId_boot_seq: { deviceId, boot: data.boot, seq: data.seq },
+          },
+          create: {
+            tenantId,
+            deviceId,
+            timestamp: sampledAt,
+            boot: data.boot,
+            seq: data.seq,
+            data: data as any, // Cast for Prisma JSON type compatibility
+          },
+          update: {},
+        });
+      } else {
+        await this.prisma.telemetry.create({
+          data: {
+            tenantId,
+            deviceId,
+            timestamp: sampledAt,
+            data: data as any, // Cast for Prisma JSON type compatibility
+          },
+        });
+      }
 
       // Update device last seen
       await this.prisma.device.update({
@@ -80,6 +203,21 @@ export class MqttHandlers implements OnModuleInit {
         },
       });
 
+      // Backfill is history only: it must not overwrite the live state,
+      // reach the dashboard as current or raise alerts now
+      if (data.resent) {
+        this.logger.debug(`Stored resent telemetry ${data.boot}/${data.seq} from device ${deviceId}`);
+        return;
+      }
+
+      if (data.boot && data.seq) {
+        try {
+          await this.requestTelemetryGap(tenantId, deviceId, data.boot, data.seq);
+        } catch (error) {
+          this.logger.error(`Failed to request telemetry gap from ${deviceId}`, error);
+        }
+      }
+
       // Flatten telemetry data for easier access in UI widgets
       const telemetryData = data.data && typeof data.data === 'object' ? data.data : {};
 
@@ -131,10 +269,96 @@ export class MqttHandlers implements OnModuleInit {
     }
   }
 
+  /**
+   * Ask the device for samples missing between the newest one seen and this
+   * one; it keeps them (telemetry retention), so a gap is loss, not silence.
+   * A new boot starts counting again: the old boot's gap cannot be filled.
+   */
+  private async requestTelemetryGap(tenantId: string, deviceId: string, boot: string, seq: number) {
+    const key = REDIS_KEYS.TELEMETRY_SEQ(deviceId);
+    const stored = await this.redis.get(key);
+    const last: { boot: string; seq: number } | null = stored ? JSON.parse(stored) : null;
+    const sameBoot = last !== null && last.boot === boot;
+
+    // Out of order: counted already
+    if (sameBoot && seq <= last!.seq) {
+      return;
+    }
+
+    await this.redis.set(key, JSON.stringify({ boot, seq }));
+
+    if (sameBoot && seq > last!.seq + 1) {
+      this.logger.log(`Telemetry gap from ${deviceId}: seq ${last!.seq + 1}-${seq - 1} of boot ${boot}`);
+      await this.commands.sendCommand(tenantId, {
+        deviceId,
+        type: 'resend_telemetry',
+        payload: { boot, from: last!.seq + 1, to: seq - 1 },
+      });
+    }
+  }
+
+  /**
+   * Handle rollup messages: one closed bucket of a device's readings
+   */
+  private async handleRollup(message: MqttMessage) {
+    const { tenantId, deviceId, payload } = message;
+
+    if (!tenantId || !deviceId) {
+      this.logger.warn('Invalid rollup message: missing tenantId or deviceId');
+      return;
+    }
+
+    try {
+      const parseResult = mqttRollupPayloadSchema.safeParse(JSON.parse(payload.toString()));
+      if (!parseResult.success) {
+        this.logger.warn(`Invalid rollup payload from ${deviceId}: ${JSON.stringify(parseResult.error.format())}`);
+        return;
+      }
+
+      const { periodS, start, ...data } = parseResult.data;
+
+      // Verify device belongs to tenant (security: prevents cross-tenant data injection)
+      const device = await this.prisma.device.findFirst({
+        where: { id: deviceId, tenantId },
+        select: { id: true },
+      });
+
+      if (!device) {
+        this.logger.warn(`Device ${deviceId} not found in tenant ${tenantId} - possible topic spoofing`);
+        return;
+      }
+
+      // Upsert: rollups go out at QoS 0, without a PUBACK. A bucket stays in
+      // the device's RTC memory until its publish succeeds locally, so one
+      // that reached us anyway (publish reported failed, or a reset before
+      // the device moved on) is sent again after the reconnect or reboot
+      await this.prisma.rollup.upsert({
+        where: {
+          deviceId_periodS_start: { deviceId, periodS, start: new Date(start) },
+        },
+        create: {
+          tenantId,
+          deviceId,
+          periodS,
+          start: new Date(start),
+          data: data as any, // Cast for Prisma JSON type compatibility
+        },
+        update: {
+          data: data as any,
+        },
+      });
+
+      this.logger.debug(`Stored ${periodS} s rollup from device ${deviceId}`);
+    } catch (error) {
+      this.logger.error(`Failed to process rollup from ${deviceId}`, error);
+    }
+  }
+
   /**
    * Handle acknowledgment messages from devices
    */
   private async handleAck(message: MqttMessage) {
+    const receivedAt = new Date().toISOString();
     const { tenantId, deviceId, payload } = message;
 
     if (!tenantId || !deviceId) {
@@ -153,12 +377,26 @@ export class MqttHandlers implements OnModuleInit {
 
       const ackData = parseResult.data;
 
-      // Update command status
-      await this.commands.handleCommandAck(
-        ackData.correlationId,
-        ackData.status === 'success' ? 'acked' : 'failed',
-        ackData.error,
-      );
+      // Update command status; accepted/progress keep a long-running
+      // command open, the other statuses finish it
+      if (ackData.status === 'accepted' || ackData.status === 'progress') {
+        await this.commands.handleCommandProgress(
+          ackData.correlationId,
+          ackData.progress,
+        );
+      } else {
+        const finalStatus = {
+          success: 'acked',
+          error: 'failed',
+          cancelled: 'cancelled',
+        } as const;
+        await this.commands.handleCommandAck(
+          ackData.correlationId,
+          finalStatus[ackData.status],
+          ackData.error,
+          ackData.result,
+        );
+      }
 
       // Update device state if provided
       if (ackData.state) {
@@ -186,9 +424,12 @@ export class MqttHandlers implements OnModuleInit {
           deviceId,
           correlationId: ackData.correlationId,
           status: ackData.status,
+          progress: ackData.progress,
           error: ackData.error,
+          result: ackData.result,
           state: ackData.state,
-          timestamp: new Date().toISOString(),
+          // Device time when synced, otherwise when the ack arrived
+          timestamp: ackData.timestamp ?? receivedAt,
         }),
       );
 
@@ -246,9 +487,22 @@ export class MqttHandlers implements OnModuleInit {
       const currentState = await this.redis.get(REDIS_KEYS.DEVICE_STATE(deviceId));
       const state = currentState ? JSON.parse(currentState) : {};
 
+      // Keep the capabilities from the birth message for profile selection
+      const capabilities = data.caps !== undefined
+        ? {
+          fw: data.fw,
+          build: data.build,
+          schema: data.schema,
+          caps: data.caps,
+          profile: data.profile,
+          limits: data.limits,
+        }
+        : state.capabilities;
+
       const newState = {
         ...state,
         online,
+        capabilities,
         lastSeen: new Date().toISOString(),
       };
 
@@ -1,6 +1,7 @@
 import { Module, forwardRef } from '@nestjs/common';
 import { MqttService } from './mqtt.service';
 import { MqttHandlers } from './mqtt.handlers';
+import { CrashReportsService } from './crash-reports.service';
 import { MqttAuthController } from './mqtt-auth.controller';
 import { CommandsModule } from '../commands/commands.module';
 import { AlertsModule } from '../alerts/alerts.module';
@@ -10,7 +11,7 @@ import { AlertsModule } from '../alerts/alerts.module';
     forwardRef(() => CommandsModule),
     forwardRef(() => AlertsModule),
   ],
-  providers: [MqttService, MqttHandlers],
+  providers: [MqttService, MqttHandlers, CrashReportsService],
   controllers: [MqttAuthController],
   exports: [MqttService],
 })
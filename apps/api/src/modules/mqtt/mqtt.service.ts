@@ -76,6 +76,11 @@ export class MqttService implements OnModuleInit, OnModuleDestroy {
       MQTT_TOPICS.ALL_TELEMETRY,
       MQTT_TOPICS.ALL_ACK,
       MQTT_TOPICS.ALL_STATUS,
+      MQTT_TOPICS.ALL_TIME,
+      MQTT_TOPICS.ALL_ROLLUP,
+      MQTT_TOPICS.ALL_OTA_REQUEST,
+      MQTT_TOPICS.ALL_CRASH,
+      MQTT_TOPICS.ALL_CRASH_DATA,
     ];
 
     this.client.subscribe(topics, { qos: 1 }, (err) => {
@@ -95,7 +100,8 @@ export class MqttService implements OnModuleInit, OnModuleDestroy {
     const topicParts = topic.split('/');
     const tenantId = topicParts[1];
     const deviceId = topicParts[3];
-    const messageType = topicParts[4]; // telemetry, ack, status
+    // telemetry, ack, status, time, rollup, ota/request, crash, crash/data
+    const messageType = topicParts.slice(4).join('/');
 
     const message: MqttMessage = {
       topic,
@@ -129,11 +135,47 @@ export class MqttService implements OnModuleInit, OnModuleDestroy {
    * Publish a command to a device
    */
   async publishCommand(tenantId: string, deviceId: string, payload: object): Promise<void> {
+    return this.publish(MQTT_TOPICS.COMMAND(tenantId, deviceId), payload);
+  }
+
+  /**
+   * Publish a command to every device of a tenant, or of one group
+   * (devices join groups with the set_groups command)
+   */
+  async publishBroadcast(tenantId: string, payload: object, group?: string): Promise<void> {
+    const topic = group
+      ? MQTT_TOPICS.GROUP_COMMAND(tenantId, group)
+      : MQTT_TOPICS.BROADCAST_COMMAND(tenantId);
+    return this.publish(topic, payload);
+  }
+
+  /**
+   * Publish one firmware chunk to a device running ota_mqtt
+   * QoS 0: the device asks again for a chunk that does not arrive
+   */
+  async publishOtaChunk(tenantId: string, deviceId: string, chunk: Buffer): Promise<void> {
+    if (!this.client) {
+      throw new Error('MQTT client not connected');
+    }
+
+    const topic = MQTT_TOPICS.OTA_DATA(tenantId, deviceId);
+    return new Promise((resolve, reject) => {
+      this.client!.publish(topic, chunk, { qos: 0 }, (err) => {
+        if (err) {
+          this.logger.error(`Failed to publish to ${topic}`, err);
+          reject(err);
+        } else {
+          resolve();
+        }
+      });
+    });
+  }
+
+  private async publish(topic: string, payload: object): Promise<void> {
     if (!this.client) {
       throw new Error('MQTT client not connected');
     }
 
-    const topic = MQTT_TOPICS.COMMAND(tenantId, deviceId);
     const message = JSON.stringify(payload);
 
     return new Promise((resolve, reject) => {
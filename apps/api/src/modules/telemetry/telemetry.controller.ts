@@ -76,6 +76,37 @@ export class TelemetryController {
     };
   }
 
+  @Get(':deviceId/rollups')
+  @ApiOperation({ summary: 'Get rollups', description: 'Get the buckets a device aggregated itself, with mean, min, max and standard deviation per field' })
+  @ApiParam({ name: 'deviceId', type: String })
+  @ApiQuery({ name: 'periodS', required: false, type: Number, description: 'Bucket length in seconds (default 3600)' })
+  @ApiQuery({ name: 'startTime', required: false, type: String, description: 'ISO timestamp' })
+  @ApiQuery({ name: 'endTime', required: false, type: String, description: 'ISO timestamp' })
+  @ApiQuery({ name: 'limit', required: false, type: Number })
+  @ApiResponse({ status: 200, description: 'Rollup buckets' })
+  async getRollups(
+    @CurrentTenant() tenantId: string,
+    @Param('deviceId', ParseUUIDPipe) deviceId: string,
+    @Query('periodS') periodS?: string,
+    @Query('startTime') startTime?: string,
+    @Query('endTime') endTime?: string,
+    @Query('limit') limit?: string,
+  ) {
+    const data = await this.telemetryService.getRollups(tenantId, deviceId, {
+      periodS: periodS ? parseInt(periodS, 10) : undefined,
+      startTime,
+      endTime,
+      limit: limit ? parseInt(limit, 10) : undefined,
+    });
+
+    return {
+      success: true,
+      data: {
+        items: data,
+      },
+    };
+  }
+
   @Get(':deviceId/latest')
   @ApiOperation({ summary: 'Get latest telemetry', description: 'Get most recent telemetry reading' })
   @ApiParam({ name: 'deviceId', type: String })
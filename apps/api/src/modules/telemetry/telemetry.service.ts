@@ -3,6 +3,13 @@ import { Cron, CronExpression } from '@nestjs/schedule';
 import { PrismaService } from '../../prisma/prisma.service';
 import { DeviceTypeSchema, DeviceField } from '@thingbase/shared';
 
+interface RollupQueryParams {
+  periodS?: number;
+  startTime?: string;
+  endTime?: string;
+  limit?: number;
+}
+
 interface TelemetryQueryParams {
   startTime?: string;
   endTime?: string;
@@ -35,6 +42,21 @@ export interface AggregatedDataPoint {
   fields: Record<string, { avg: number; min: number; max: number }>;
 }
 
+export interface RollupDataPoint {
+  start: Date;
+  periodS: number;
+  fields: Record<string, { count: number; avg: number; min: number; max: number; stddev: number }>;
+}
+
+// Accumulator as the device sends it, in 1/scale units
+interface RollupAccumulator {
+  count: number;
+  min: number;
+  max: number;
+  sum: number;
+  sumSq: number;
+}
+
 @Injectable()
 export class TelemetryService {
   private readonly logger = new Logger(TelemetryService.name);
@@ -83,6 +105,62 @@ export class TelemetryService {
     }));
   }
 
+  /**
+   * Get device-side rollups for a device with time range
+   * Defaults to the hourly buckets of the last 30 days
+   */
+  async getRollups(
+    tenantId: string,
+    deviceId: string,
+    params: RollupQueryParams = {},
+  ): Promise<RollupDataPoint[]> {
+    const device = await this.prisma.device.findFirst({
+      where: { id: deviceId, tenantId },
+    });
+
+    if (!device) {
+      throw new NotFoundException('Device not found');
+    }
+
+    const endTime = params.endTime ? new Date(params.endTime) : new Date();
+    const startTime = params.startTime
+      ? new Date(params.startTime)
+      : new Date(endTime.getTime() - 30 * 24 * 60 * 60 * 1000);
+
+    const limit = Math.min(params.limit || 1000, 5000);
+
+    const rollups = await this.prisma.rollup.findMany({
+      where: {
+        deviceId,
+        tenantId,
+        periodS: params.periodS || 3600,
+        start: {
+          gte: startTime,
+          lte: endTime,
+        },
+      },
+      orderBy: { start: 'desc' },
+      take: limit,
+    });
+
+    return rollups.map((r: { start: Date; periodS: number; data: unknown }) => {
+      const { scale, ...accumulators } = r.data as { scale: number } & Record<string, RollupAccumulator>;
+      const fields: RollupDataPoint['fields'] = {};
+      for (const [field, a] of Object.entries(accumulators)) {
+        const mean = a.sum / a.count;
+        const variance = Math.max(0, a.sumSq / a.count - mean * mean);
+        fields[field] = {
+          count: a.count,
+          avg: mean / scale,
+          min: a.min / scale,
+          max: a.max / scale,
+          stddev: Math.sqrt(variance) / scale,
+        };
+      }
+      return { start: r.start, periodS: r.periodS, fields };
+    });
+  }
+
   /**
    * Get latest telemetry reading for a device
    */
@@ -458,6 +536,14 @@ export class TelemetryService {
           },
         });
 
+        // Rollups follow the same retention
+        await this.prisma.rollup.deleteMany({
+          where: {
+            tenantId: tenant.id,
+            start: { lt: cutoffDate },
+          },
+        });
+
         if (result.count > 0) {
           this.logger.log(
             `Deleted ${result.count} telemetry records for tenant ${tenant.id} (older than ${retentionDays} days)`
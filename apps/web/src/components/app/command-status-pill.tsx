@@ -1,16 +1,18 @@
 'use client';
 
 import { Badge } from '@/components/ui/badge';
-import { Clock, Check, AlertCircle, Send, Timer, RotateCcw } from 'lucide-react';
+import { Clock, Check, AlertCircle, Send, Timer, RotateCcw, Loader2, Ban } from 'lucide-react';
 import { cn } from '@/lib/utils';
 
-type CommandStatus = 'pending' | 'sent' | 'acked' | 'failed' | 'timeout';
+type CommandStatus = 'pending' | 'sent' | 'running' | 'acked' | 'failed' | 'cancelled' | 'timeout';
 
 const statusConfig: Record<CommandStatus, { variant: 'warning' | 'default' | 'success' | 'destructive'; label: string; icon: typeof Clock }> = {
   pending: { variant: 'warning', label: 'Pending', icon: Clock },
   sent: { variant: 'default', label: 'Sent', icon: Send },
+  running: { variant: 'default', label: 'Running', icon: Loader2 },
   acked: { variant: 'success', label: 'Acknowledged', icon: Check },
   failed: { variant: 'destructive', label: 'Failed', icon: AlertCircle },
+  cancelled: { variant: 'warning', label: 'Cancelled', icon: Ban },
   timeout: { variant: 'destructive', label: 'Timeout', icon: Timer },
 };
 
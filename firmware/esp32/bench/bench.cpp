@@ -0,0 +1,285 @@
+#include "bench.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// CLOCKS
+// ============================================================================
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#define BENCH_TARGET "esp32"
+#define BENCH_CYCLE_COUNTER "ccount"
+typedef uint32_t BenchCycles; // wraps after ~17 s at 240 MHz
+
+static inline BenchCycles readCycles() { return ESP.getCycleCount(); }
+static inline uint64_t readNanos() {
+  return (uint64_t)esp_timer_get_time() * 1000;
+}
+static uint32_t cpuMhz() { return ESP.getCpuFreqMHz(); }
+#else
+#include <chrono>
+
+#define BENCH_TARGET "host"
+typedef uint64_t BenchCycles;
+
+static inline uint64_t readNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLE_COUNTER "tsc"
+static inline BenchCycles readCycles() { return __rdtsc(); }
+#else
+#define BENCH_CYCLE_COUNTER "ns"
+static inline BenchCycles readCycles() { return readNanos(); }
+#endif
+static uint32_t cpuMhz() { return 0; }
+#endif
+
+// ============================================================================
+// ALLOCATION COUNTING
+// ============================================================================
+// Target: the bench env links with -Wl,--wrap=malloc,--wrap=calloc,
+// --wrap=realloc so every heap allocation passes through here.
+// Host (glibc): malloc & co. are interposed and forwarded to glibc.
+
+static volatile uint32_t allocCount = 0;
+static volatile uint64_t allocBytes = 0;
+
+static inline void countAlloc(size_t size) {
+  allocCount = allocCount + 1;
+  allocBytes = allocBytes + size;
+}
+
+#ifdef ARDUINO_ARCH_ESP32
+#define BENCH_ALLOC_COUNTER "wrap"
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  countAlloc(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  countAlloc(n * size);
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  countAlloc(size);
+  return __real_realloc(ptr, size);
+}
+}
+#elif defined(__GLIBC__)
+#define BENCH_ALLOC_COUNTER "glibc"
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) noexcept {
+  countAlloc(size);
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) noexcept {
+  countAlloc(n * size);
+  return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) noexcept {
+  countAlloc(size);
+  return __libc_realloc(ptr, size);
+}
+}
+#else
+#define BENCH_ALLOC_COUNTER "none"
+#endif
+
+void benchAllocSnapshot(uint32_t *count, uint64_t *bytes) {
+  *count = allocCount;
+  *bytes = allocBytes;
+}
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static BenchCycles cycleStart = 0;
+
+void BenchState::startTiming() {
+  if (running_) {
+    return;
+  }
+  running_ = true;
+  benchAllocSnapshot(&start_.allocs, &start_.allocBytes);
+  start_.nanos = readNanos();
+  cycleStart = readCycles();
+}
+
+void BenchState::stopTiming() {
+  if (!running_) {
+    return;
+  }
+  BenchCycles cycleEnd = readCycles();
+  uint64_t nanos = readNanos();
+  uint32_t allocs;
+  uint64_t bytes;
+  benchAllocSnapshot(&allocs, &bytes);
+  running_ = false;
+
+  total_.cycles += (BenchCycles)(cycleEnd - cycleStart);
+  total_.nanos += nanos - start_.nanos;
+  total_.allocs += allocs - start_.allocs;
+  total_.allocBytes += bytes - start_.allocBytes;
+}
+
+// ============================================================================
+// REGISTRY
+// ============================================================================
+
+static BenchCase *firstCase = nullptr;
+static BenchCase *lastCase = nullptr;
+static BenchQuietHook quietHook = nullptr;
+
+BenchCase *benchRegister(BenchCase *benchCase) {
+  benchCase->next = nullptr;
+  if (lastCase) {
+    lastCase->next = benchCase;
+  } else {
+    firstCase = benchCase;
+  }
+  lastCase = benchCase;
+  return benchCase;
+}
+
+void benchSetQuietHook(BenchQuietHook hook) { quietHook = hook; }
+
+void benchList(BenchSink sink) {
+  for (BenchCase *c = firstCase; c; c = c->next) {
+    sink(c->name);
+    sink("\n");
+  }
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static const char *matchesFilter(const char *name, const char *filter) {
+  return !filter || !*filter ? name : strstr(name, filter);
+}
+
+// Grows the iteration count like Google Benchmark until a run is long enough
+static bool runCase(const BenchCase *c, uint32_t minTimeMs,
+                    uint32_t *iterationsOut, BenchCounters *countersOut,
+                    const char **errorOut) {
+  uint64_t minNanos = (uint64_t)minTimeMs * 1000000ULL;
+  uint32_t iterations = 1;
+  for (;;) {
+    if (quietHook) {
+      quietHook(true);
+    }
+    BenchState state(iterations);
+    c->fn(state);
+    if (quietHook) {
+      quietHook(false);
+    }
+    if (state.error()) {
+      *errorOut = state.error();
+      return false;
+    }
+    const BenchCounters &counters = state.counters();
+    if (counters.nanos >= minNanos || iterations >= c->maxIterations) {
+      *iterationsOut = iterations;
+      *countersOut = counters;
+      return true;
+    }
+    double multiplier =
+        counters.nanos > 0 ? 1.4 * (double)minNanos / counters.nanos : 10.0;
+    if (multiplier > 10.0) {
+      multiplier = 10.0;
+    }
+    double next = iterations * multiplier;
+    if (next < iterations + 1.0) {
+      next = iterations + 1.0;
+    }
+    if (next > c->maxIterations) {
+      next = c->maxIterations;
+    }
+    iterations = (uint32_t)next;
+  }
+}
+
+int benchRunAll(const char *filter, uint32_t minTimeMs, BenchSink sink) {
+  char line[256];
+
+  sink("{\n  \"context\": {\n");
+  snprintf(line, sizeof(line),
+           "    \"executable\": \"thingbase-firmware\",\n"
+           "    \"target\": \"" BENCH_TARGET "\",\n"
+           "    \"firmware\": \"%s\",\n"
+           "    \"build\": %d,\n",
+           FIRMWARE_VERSION, (int)FIRMWARE_BUILD);
+  sink(line);
+  snprintf(line, sizeof(line),
+           "    \"mhz_per_cpu\": %u,\n"
+           "    \"cycle_counter\": \"" BENCH_CYCLE_COUNTER "\",\n"
+           "    \"alloc_counter\": \"" BENCH_ALLOC_COUNTER "\",\n"
+           "    \"min_time_ms\": %u\n",
+           (unsigned)cpuMhz(), (unsigned)minTimeMs);
+  sink(line);
+  sink("  },\n  \"benchmarks\": [");
+
+  int count = 0;
+  for (BenchCase *c = firstCase; c; c = c->next) {
+    if (!matchesFilter(c->name, filter)) {
+      continue;
+    }
+    uint32_t iterations = 0;
+    BenchCounters counters = {};
+    const char *error = nullptr;
+    bool ok = runCase(c, minTimeMs, &iterations, &counters, &error);
+
+    sink(count == 0 ? "\n" : ",\n");
+    if (!ok) {
+      snprintf(line, sizeof(line),
+               "    {\"name\": \"%s\", \"run_name\": \"%s\", "
+               "\"run_type\": \"iteration\", \"error_occurred\": true, "
+               "\"error_message\": \"%s\"}",
+               c->name, c->name, error);
+      sink(line);
+      count++;
+      continue;
+    }
+
+    double ns = (double)counters.nanos / iterations;
+    snprintf(line, sizeof(line),
+             "    {\"name\": \"%s\", \"run_name\": \"%s\", "
+             "\"run_type\": \"iteration\", \"iterations\": %u, ",
+             c->name, c->name, (unsigned)iterations);
+    sink(line);
+    snprintf(line, sizeof(line),
+             "\"real_time\": %.1f, \"cpu_time\": %.1f, \"time_unit\": \"ns\", "
+             "\"cycles_per_op\": %.1f, \"allocs_per_op\": %.2f, "
+             "\"bytes_allocated_per_op\": %.1f}",
+             ns, ns, (double)counters.cycles / iterations,
+             (double)counters.allocs / iterations,
+             (double)counters.allocBytes / iterations);
+    sink(line);
+    count++;
+  }
+
+  sink(count == 0 ? "]\n}\n" : "\n  ]\n}\n");
+  return count;
+}
@@ -0,0 +1,137 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// ============================================================================
+// MICROBENCHMARKS (Google Benchmark style, host and on target)
+// ============================================================================
+// A benchmark is a function that loops over its state:
+//
+//   static void BM_TopicBuild(BenchState &state) {
+//     char topic[128];
+//     for ([[maybe_unused]] auto _ : state) {
+//       topicBuild(topic, sizeof(topic), "tenant", "device", "telemetry");
+//       benchDoNotOptimize(topic);
+//     }
+//   }
+//   BENCHMARK(BM_TopicBuild);
+//
+// The runner grows the iteration count until a run lasts the minimum time
+// and reports time, cycles and heap allocations per iteration as JSON.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef BENCH_MIN_TIME_MS
+#define BENCH_MIN_TIME_MS 500
+#endif
+#define BENCH_MAX_ITERATIONS 1000000000UL
+
+class BenchState;
+typedef void (*BenchFunction)(BenchState &state);
+
+// Output goes through a sink so the same runner prints to stdout or Serial
+typedef void (*BenchSink)(const char *text);
+
+struct BenchCounters {
+  uint64_t cycles;
+  uint64_t nanos;
+  uint32_t allocs;
+  uint64_t allocBytes;
+};
+
+struct BenchValue {};
+
+class BenchState {
+public:
+  struct Iterator {
+    BenchState *state;
+    uint32_t remaining;
+    BenchValue operator*() const { return BenchValue(); }
+    Iterator &operator++() {
+      remaining--;
+      return *this;
+    }
+    bool operator!=(const Iterator &) {
+      if (remaining > 0) {
+        return true;
+      }
+      state->stopTiming();
+      return false;
+    }
+  };
+
+  explicit BenchState(uint32_t iterations) : iterations_(iterations) {}
+
+  Iterator begin() {
+    startTiming();
+    return Iterator{this, iterations_};
+  }
+  Iterator end() { return Iterator{this, 0}; }
+
+  uint32_t iterations() const { return iterations_; }
+
+  // Exclude per-iteration setup from the measurement
+  void pauseTiming() { stopTiming(); }
+  void resumeTiming() { startTiming(); }
+
+  // Report the benchmark as skipped instead of measuring it
+  void skipWithError(const char *message) { error_ = message; }
+  const char *error() const { return error_; }
+
+  const BenchCounters &counters() const { return total_; }
+
+private:
+  void startTiming();
+  void stopTiming();
+
+  uint32_t iterations_;
+  bool running_ = false;
+  BenchCounters start_ = {};
+  BenchCounters total_ = {};
+  const char *error_ = nullptr;
+};
+
+struct BenchCase {
+  const char *name;
+  BenchFunction fn;
+  uint32_t maxIterations; // flash writes and other slow fixtures cap this
+  BenchCase *next;
+};
+
+// Registration (static constructors, see BENCHMARK below)
+BenchCase *benchRegister(BenchCase *benchCase);
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK_MAX_ITERATIONS(fn, max)                                      \
+  static BenchCase BENCH_CONCAT(benchCase_, fn) = {#fn, fn, max, nullptr};     \
+  static BenchCase *BENCH_CONCAT(benchRegistered_, fn)                         \
+      __attribute__((unused)) =                                                \
+          benchRegister(&BENCH_CONCAT(benchCase_, fn))
+#define BENCHMARK(fn) BENCHMARK_MAX_ITERATIONS(fn, BENCH_MAX_ITERATIONS)
+
+// Keep the compiler from discarding a result or hoisting work out of a loop
+template <typename T> inline void benchDoNotOptimize(T const &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+inline void benchClobberMemory() { asm volatile("" : : : "memory"); }
+
+// Called with true before and false after each measured run, so the target
+// runner can silence Serial while firmware code logs
+typedef void (*BenchQuietHook)(bool quiet);
+void benchSetQuietHook(BenchQuietHook hook);
+
+// Runs every benchmark whose name contains filter (nullptr = all) and writes
+// one JSON document to sink. Returns the number of benchmarks run.
+int benchRunAll(const char *filter, uint32_t minTimeMs, BenchSink sink);
+
+// Lists registered benchmark names, one per line
+void benchList(BenchSink sink);
+
+// Heap allocations since boot (malloc/calloc/realloc), see bench.cpp
+void benchAllocSnapshot(uint32_t *count, uint64_t *bytes);
+
+// Serial console runner for the target, never returns (bench_serial.cpp)
+void benchSerialMain();
+
+#endif
@@ -0,0 +1,256 @@
+#include "bench.h"
+#include "claim.h"
+#include "derived_metrics.h"
+#include "event_bus.h"
+#include "fixed_point.h"
+#include "sensor_pipeline.h"
+#include "storage.h"
+#include "telemetry.h"
+#include "thresholds.h"
+#include "topics.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+
+// Firmware hot paths. Cases that need NVS call storageInit() themselves;
+// storage cases skip on an unprovisioned device rather than writing fake
+// credentials over nothing.
+
+// Defined in main.cpp
+void mqttCallback(char *topic, byte *payload, unsigned int length);
+void serviceCommands();
+
+// ============================================================================
+// TELEMETRY
+// ============================================================================
+
+static TelemetryReading sampleReading() {
+  TelemetryReading reading = {};
+  reading.temperatureCenti = 2340;
+  reading.humidityCenti = 5120;
+  derivedCompute(reading.temperatureCenti, reading.humidityCenti,
+                 reading.derived);
+  reading.uptimeS = 86400;
+  reading.rssi = -61;
+  reading.led = true;
+  reading.sensorConnected = true;
+  reading.sampleMs = millis();
+  return reading;
+}
+
+static void BM_TelemetrySerializeFull(BenchState &state) {
+  TelemetryReading reading = sampleReading();
+  char buffer[512];
+  for ([[maybe_unused]] auto _ : state) {
+    size_t length = telemetrySerialize(reading, TELEMETRY_FIELDS_ALL, false,
+                                       buffer, sizeof(buffer));
+    benchDoNotOptimize(length);
+  }
+}
+BENCHMARK(BM_TelemetrySerializeFull);
+
+static void BM_TelemetrySerializeDelta(BenchState &state) {
+  TelemetryReading reading = sampleReading();
+  char buffer[512];
+  for ([[maybe_unused]] auto _ : state) {
+    size_t length = telemetrySerialize(reading, TELEMETRY_FIELD_UPTIME, false,
+                                       buffer, sizeof(buffer));
+    benchDoNotOptimize(length);
+  }
+}
+BENCHMARK(BM_TelemetrySerializeDelta);
+
+// Sensor values as text: the fixed-point formatter against the printf the
+// log lines used before readings were held in hundredths
+static void BM_SensorFormatFixed(BenchState &state) {
+  int32_t value = 2340;
+  char text[FIXED_TEXT_MAX];
+  for ([[maybe_unused]] auto _ : state) {
+    benchDoNotOptimize(value);
+    size_t length = fixedFormat(value, 1, text);
+    benchDoNotOptimize(length);
+  }
+}
+BENCHMARK(BM_SensorFormatFixed);
+
+static void BM_SensorFormatJson(BenchState &state) {
+  int32_t value = 2345;
+  char text[FIXED_TEXT_MAX];
+  for ([[maybe_unused]] auto _ : state) {
+    benchDoNotOptimize(value);
+    size_t length = fixedFormatJson(value, text);
+    benchDoNotOptimize(length);
+  }
+}
+BENCHMARK(BM_SensorFormatJson);
+
+static void BM_SensorFormatPrintf(BenchState &state) {
+  float value = 23.4f;
+  char text[16];
+  for ([[maybe_unused]] auto _ : state) {
+    benchDoNotOptimize(value);
+    int length = snprintf(text, sizeof(text), "%.1f", value);
+    benchDoNotOptimize(length);
+  }
+}
+BENCHMARK(BM_SensorFormatPrintf);
+
+// ============================================================================
+// COMMANDS & THRESHOLDS
+// ============================================================================
+
+static void BM_CommandParseDispatch(BenchState &state) {
+  static const char payload[] =
+      "{\"action\":\"set_state\",\"correlationId\":\"bench-0001\","
+      "\"params\":{\"led\":true}}";
+  char topic[] = "iot/bench/devices/bench/command";
+  byte buffer[sizeof(payload)];
+
+  for ([[maybe_unused]] auto _ : state) {
+    // PubSubClient hands the callback its own receive buffer
+    memcpy(buffer, payload, sizeof(payload) - 1);
+    mqttCallback(topic, buffer, sizeof(payload) - 1);
+    serviceCommands();
+    eventBusService();
+  }
+}
+BENCHMARK(BM_CommandParseDispatch);
+
+static void BM_ThresholdEvaluate(BenchState &state) {
+  int16_t temperature = 2000;
+  int16_t humidity = 5000;
+  for ([[maybe_unused]] auto _ : state) {
+    benchDoNotOptimize(temperature);
+    benchDoNotOptimize(humidity);
+    uint8_t exceeded = thresholdsEvaluate(temperature, humidity);
+    benchDoNotOptimize(exceeded);
+  }
+}
+BENCHMARK(BM_ThresholdEvaluate);
+
+// The stages between acquire and publish on one full batch
+static void BM_PipelineFilterToRules(BenchState &state) {
+  PipelineBatch batch;
+  for ([[maybe_unused]] auto _ : state) {
+    state.pauseTiming();
+    for (uint8_t i = 0; i < PIPELINE_BATCH_SIZE; i++) {
+      batch.samples[i] = {(int16_t)(2340 + i), 5120, i * 2000u, {}, 0, true};
+    }
+    batch.count = PIPELINE_BATCH_SIZE;
+    state.resumeTiming();
+    pipelineFilter(batch, 0);
+    pipelineDerive(batch, 0);
+    pipelineAggregate(batch, 0);
+    pipelineRules(batch, 0);
+    benchDoNotOptimize(batch.samples[0].exceeded);
+  }
+}
+BENCHMARK(BM_PipelineFilterToRules);
+
+// Dew point, absolute humidity and heat index for one reading
+static void BM_DerivedMetrics(BenchState &state) {
+  int16_t temperature = 3200;
+  int16_t humidity = 7000;
+  DerivedMetrics derived;
+  for ([[maybe_unused]] auto _ : state) {
+    benchDoNotOptimize(temperature);
+    benchDoNotOptimize(humidity);
+    derivedCompute(temperature, humidity, derived);
+    benchDoNotOptimize(derived);
+  }
+}
+BENCHMARK(BM_DerivedMetrics);
+
+// ============================================================================
+// EVENT BUS
+// ============================================================================
+
+static uint32_t benchEventsSeen = 0;
+
+static void benchCountEvent(const Event &event) {
+  benchEventsSeen += event.type == EVENT_SAMPLE ? 1 : 0;
+}
+
+// One sample through a queue slot to three subscribers
+static void BM_EventBusSample(BenchState &state) {
+  static const EventSubscriber subscribers[] = {
+      {EVENT_SAMPLE, benchCountEvent},
+      {EVENT_ALERT, benchCountEvent},
+      {EVENT_SAMPLE, benchCountEvent},
+      {EVENT_CONNECTIVITY, benchCountEvent},
+      {EVENT_SAMPLE, benchCountEvent},
+  };
+  eventBusBegin(subscribers, sizeof(subscribers) / sizeof(subscribers[0]));
+  SampleEvent sample = {2340, 5120, 0, true, false};
+  for ([[maybe_unused]] auto _ : state) {
+    eventPublishSample(sample, 0);
+    eventBusService();
+  }
+  benchDoNotOptimize(benchEventsSeen);
+  eventBusBegin(nullptr, 0);
+}
+BENCHMARK(BM_EventBusSample);
+
+// ============================================================================
+// STORAGE
+// ============================================================================
+
+static void BM_StorageLoadMqtt(BenchState &state) {
+  storageInit();
+  for ([[maybe_unused]] auto _ : state) {
+    MqttCredentials creds = storageLoadMqtt();
+    benchDoNotOptimize(creds.isValid);
+  }
+}
+BENCHMARK(BM_StorageLoadMqtt);
+
+// Writes back the stored values; capped so a run cannot wear the flash
+static void BM_StorageSaveMqtt(BenchState &state) {
+  storageInit();
+  MqttCredentials creds = storageLoadMqtt();
+  if (!creds.isValid) {
+    state.skipWithError("device not provisioned");
+    return;
+  }
+  for ([[maybe_unused]] auto _ : state) {
+    storageSaveMqtt(creds.broker, creds.clientId, creds.username,
+                    creds.password, creds.topicTelemetry, creds.topicCommands,
+                    creds.topicAck, creds.topicStatus, creds.tenantId,
+                    creds.deviceId);
+  }
+}
+BENCHMARK_MAX_ITERATIONS(BM_StorageSaveMqtt, 32);
+
+// ============================================================================
+// TOPICS & CLAIM
+// ============================================================================
+
+static void BM_TopicBuild(BenchState &state) {
+  char topic[128];
+  for ([[maybe_unused]] auto _ : state) {
+    bool ok = topicBuild(topic, sizeof(topic), "5f0c9a1e-tenant",
+                         "a81d44c2-device", "telemetry");
+    benchDoNotOptimize(ok);
+    benchDoNotOptimize(topic);
+  }
+}
+BENCHMARK(BM_TopicBuild);
+
+static void BM_ClaimResponseParse(BenchState &state) {
+  static const char response[] =
+      "{\"success\":true,\"data\":{\"deviceId\":\"a81d44c2-device\","
+      "\"tenantId\":\"5f0c9a1e-tenant\",\"mqtt\":{"
+      "\"broker\":\"mqtts://broker.example.com:8883\","
+      "\"clientId\":\"a81d44c2-device\",\"username\":\"a81d44c2-device\","
+      "\"password\":\"0123456789abcdef0123456789abcdef\",\"topics\":{"
+      "\"telemetry\":\"iot/5f0c9a1e-tenant/devices/a81d44c2-device/telemetry\","
+      "\"commands\":\"iot/5f0c9a1e-tenant/devices/a81d44c2-device/command\","
+      "\"ack\":\"iot/5f0c9a1e-tenant/devices/a81d44c2-device/ack\","
+      "\"status\":\"iot/5f0c9a1e-tenant/devices/a81d44c2-device/status\"}}}}";
+  for ([[maybe_unused]] auto _ : state) {
+    ClaimResult result;
+    bool ok = claimParseResponse(response, sizeof(response) - 1, result);
+    benchDoNotOptimize(ok);
+  }
+}
+BENCHMARK(BM_ClaimResponseParse);
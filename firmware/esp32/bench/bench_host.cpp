@@ -0,0 +1,55 @@
+// Host runner: runs the benchmarks against the shim and prints Google
+// Benchmark compatible JSON to stdout.
+//
+//   .pio/build/native-bench/program [--filter NAME] [--min-time-ms N] [--list]
+
+#include "bench.h"
+#include "host_device.h"
+#include "host_env.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void printSink(const char *text) { fputs(text, stdout); }
+
+static void usage() {
+  fprintf(stderr,
+          "usage: bench [--filter NAME] [--min-time-ms N] [--list] [--echo]\n");
+}
+
+int main(int argc, char **argv) {
+  const char *filter = nullptr;
+  uint32_t minTimeMs = BENCH_MIN_TIME_MS;
+  bool list = false;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--filter") == 0 && hasValue) {
+      filter = argv[++i];
+    } else if (strcmp(argv[i], "--min-time-ms") == 0 && hasValue) {
+      minTimeMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--list") == 0) {
+      list = true;
+    } else if (strcmp(argv[i], "--echo") == 0) {
+      hostSetSerialEcho(true);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  if (list) {
+    benchList(printSink);
+    return 0;
+  }
+
+  hostClockReset();
+  hostProvisionDevice("mqtt://localhost:1883");
+
+  int count = benchRunAll(filter, minTimeMs, printSink);
+  if (count == 0) {
+    fprintf(stderr, "No benchmark matches '%s'\n", filter ? filter : "");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+// Target runner (env:esp32dev-bench): setup() hands over to benchSerialMain()
+// before any WiFi or MQTT work, so the radio stays off while measuring.
+//
+// At boot every benchmark runs once; afterwards the serial console accepts
+//   run [filter]   run benchmarks whose name contains filter
+//   list           list benchmark names
+// Each JSON report is framed by @bench-begin / @bench-end lines so a host
+// script can cut it out of the monitor log.
+
+#include "bench.h"
+#include <Arduino.h>
+
+#define BENCH_SERIAL_BAUD 115200
+#define BENCH_LINE_MAX 64
+
+static void serialSink(const char *text) { Serial.print(text); }
+
+// Firmware code logs to Serial; detaching the UART turns those prints into
+// cheap no-ops so they neither garble the report nor get measured
+static void serialQuiet(bool quiet) {
+  if (quiet) {
+    Serial.flush();
+    Serial.end();
+  } else {
+    Serial.begin(BENCH_SERIAL_BAUD);
+  }
+}
+
+static void runAndReport(const char *filter) {
+  Serial.println("@bench-begin");
+  int count = benchRunAll(filter, BENCH_MIN_TIME_MS, serialSink);
+  Serial.println("@bench-end");
+  if (count == 0) {
+    Serial.printf("[Bench] No benchmark matches '%s'\n", filter ? filter : "");
+  }
+}
+
+static void handleLine(char *line) {
+  if (strncmp(line, "run", 3) == 0 && (line[3] == '\0' || line[3] == ' ')) {
+    const char *filter = line[3] ? line + 4 : nullptr;
+    runAndReport(filter);
+  } else if (strcmp(line, "list") == 0) {
+    benchList(serialSink);
+  } else if (line[0] != '\0') {
+    Serial.println("[Bench] Commands: run [filter], list");
+  }
+}
+
+void benchSerialMain() {
+  Serial.printf("[Bench] Free heap: %u bytes, CPU: %u MHz\n",
+                ESP.getFreeHeap(), ESP.getCpuFreqMHz());
+  benchSetQuietHook(serialQuiet);
+  runAndReport(nullptr);
+
+  char line[BENCH_LINE_MAX];
+  size_t length = 0;
+  for (;;) {
+    while (Serial.available()) {
+      char c = (char)Serial.read();
+      if (c == '\r') {
+        continue;
+      }
+      if (c == '\n') {
+        line[length] = '\0';
+        handleLine(line);
+        length = 0;
+      } else if (length < sizeof(line) - 1) {
+        line[length++] = c;
+      }
+    }
+    delay(10);
+  }
+}
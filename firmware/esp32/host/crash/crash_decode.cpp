@@ -0,0 +1,539 @@
+/**
+ * Crash report decoder
+ *
+ * Reassembles the crash reports devices send after a panic, watchdog or
+ * brownout reset (include/crash_report.h) from a capture of their crash
+ * topics, checks the dump against the CRC32 in the begin message, writes
+ * it out as <id>.core and decodes what the ESP-IDF panic handler put in it:
+ * reset reason, uptime, exception cause and address, every task with its
+ * registers and a backtrace walked through the dumped stacks. The capture
+ * is mosquitto_sub output, one message per line as topic and hex payload:
+ *
+ *   mosquitto_sub -h <broker> -v -F '%t %x' \
+ *       -t 'iot/+/devices/+/crash' -t 'iot/+/devices/+/crash/data' > cap.txt
+ *   crash_decode [--out DIR] cap.txt...
+ *
+ * The JSON report goes to stdout. A report with lost chunks lists them
+ * together with the crash_report command that asks the device for them
+ * again. Addresses are left for addr2line with the matching firmware.elf:
+ *
+ *   xtensa-esp32-elf-addr2line -pfiaC -e firmware.elf 0x400d1234 ...
+ *
+ * The exit code is 1 if any report is incomplete or fails its CRC.
+ */
+
+#include "factory_image.h"
+#include <map>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define CRASH_HEADER_LEN 8     // report id + chunk index (crash_report.h)
+#define DUMP_HEADER_LEN 20     // core_dump_header_t
+#define MAX_BACKTRACE 32       // frames per task
+
+// ESP-IDF core dump, ELF flavour (esp_core_dump_types.h, core_dump_elf.c)
+#define DUMP_VERSION_ELF 1     // major version byte
+#define DUMP_CHECKSUM_SHA256 1 // minor version for SHA-256 instead of CRC32
+#define NOTE_PRSTATUS 1        // "CORE" note per task
+#define NOTE_DUMP_INFO 8266    // "ESP_CORE_DUMP_INFO": version, app SHA
+#define NOTE_EXTRA_INFO 677    // "EXTRA_INFO": crashed TCB, exception regs
+#define NOTE_PANIC_DETAILS 1346 // "ESP_PANIC_DETAILS": panic message
+#define PRSTATUS_PID 24        // task handle (TCB address) in the note
+#define PRSTATUS_LEN 72        // elf_prstatus before the registers
+#define REG_PC 0               // xtensa_gregset_t, in words
+#define REG_AR0 64             // pc..windowbase (8) + reserved (56)
+#define TCB_NAME_OFFSET 52     // pcTaskName in the FreeRTOS TCB (no MPU)
+#define TCB_NAME_LEN 16
+
+// ============================================================================
+// CAPTURE
+// ============================================================================
+
+struct Report {
+  std::string id;
+  std::string topic;
+  std::string begin; // JSON as sent
+  bool ended = false;
+  uint32_t dumpSize = 0;
+  uint32_t chunkSize = 0;
+  uint32_t chunks = 0;
+  uint32_t crc = 0;
+  std::map<uint32_t, std::vector<uint8_t>> data;
+};
+
+static std::map<std::string, Report> reports;
+static std::vector<std::string> order;
+
+static bool fromHex(const std::string &hex, std::vector<uint8_t> &out) {
+  if (hex.size() % 2 != 0) {
+    return false;
+  }
+  out.clear();
+  for (size_t i = 0; i < hex.size(); i += 2) {
+    char byte[3] = {hex[i], hex[i + 1], 0};
+    char *end = nullptr;
+    out.push_back((uint8_t)strtoul(byte, &end, 16));
+    if (*end) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Value of a key in the flat JSON the firmware sends; empty if absent
+static std::string jsonField(const std::string &json, const char *key) {
+  std::string quoted = std::string("\"") + key + "\":";
+  size_t at = json.find(quoted);
+  if (at == std::string::npos) {
+    return "";
+  }
+  at += quoted.size();
+  if (json[at] == '"') {
+    size_t end = json.find('"', at + 1);
+    return json.substr(at + 1, end - at - 1);
+  }
+  size_t end = json.find_first_of(",}", at);
+  return json.substr(at, end - at);
+}
+
+static Report &reportFor(const std::string &id) {
+  if (!reports.count(id)) {
+    order.push_back(id);
+    reports[id].id = id;
+  }
+  return reports[id];
+}
+
+static void readMessage(const std::string &topic,
+                        const std::vector<uint8_t> &payload) {
+  bool data = topic.size() > 5 &&
+              topic.compare(topic.size() - 5, 5, "/data") == 0;
+  if (data) {
+    if (payload.size() < CRASH_HEADER_LEN) {
+      return;
+    }
+    char id[9];
+    snprintf(id, sizeof(id), "%02x%02x%02x%02x", payload[0], payload[1],
+             payload[2], payload[3]);
+    uint32_t index = (uint32_t)payload[4] << 24 | (uint32_t)payload[5] << 16 |
+                     (uint32_t)payload[6] << 8 | payload[7];
+    reportFor(id).data[index].assign(payload.begin() + CRASH_HEADER_LEN,
+                                     payload.end());
+    return;
+  }
+
+  std::string json(payload.begin(), payload.end());
+  Report &report = reportFor(jsonField(json, "id"));
+  std::string type = jsonField(json, "type");
+  if (type == "begin") {
+    report.begin = json;
+    report.topic = topic;
+    report.dumpSize = strtoul(jsonField(json, "dumpSize").c_str(), 0, 10);
+    report.chunkSize = strtoul(jsonField(json, "chunkSize").c_str(), 0, 10);
+    report.chunks = strtoul(jsonField(json, "chunks").c_str(), 0, 10);
+    report.crc = strtoul(jsonField(json, "crc32").c_str(), 0, 16);
+  } else if (type == "end") {
+    report.ended = true;
+  }
+}
+
+static bool readCapture(const char *path) {
+  FILE *file = fopen(path, "r");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  char *line = nullptr;
+  size_t capacity = 0;
+  ssize_t length;
+  std::vector<uint8_t> payload;
+  while ((length = getline(&line, &capacity, file)) > 0) {
+    std::string text(line, length);
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+      text.pop_back();
+    }
+    size_t space = text.find(' ');
+    if (space == std::string::npos ||
+        !fromHex(text.substr(space + 1), payload)) {
+      continue;
+    }
+    readMessage(text.substr(0, space), payload);
+  }
+  free(line);
+  fclose(file);
+  return true;
+}
+
+// ============================================================================
+// CORE DUMP
+// ============================================================================
+
+struct Segment {
+  uint32_t vaddr;
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct Task {
+  uint32_t tcb;
+  uint32_t regs[REG_AR0 + 16];
+};
+
+struct Dump {
+  const uint8_t *elf;
+  size_t elfLen;
+  std::vector<Segment> memory;
+  std::vector<Task> tasks;
+  std::string appSha;
+  std::string panic;
+  uint32_t crashedTcb = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> excRegs; // index, value
+};
+
+static uint32_t le32(const uint8_t *p) {
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint16_t le16(const uint8_t *p) { return p[0] | p[1] << 8; }
+
+static bool readMemory(const Dump &dump, uint32_t address, void *out,
+                       size_t length) {
+  for (const Segment &segment : dump.memory) {
+    if (address >= segment.vaddr &&
+        address + length <= segment.vaddr + segment.size) {
+      memcpy(out, dump.elf + segment.offset + (address - segment.vaddr),
+             length);
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool readWord(const Dump &dump, uint32_t address, uint32_t &value) {
+  uint8_t bytes[4];
+  if (!readMemory(dump, address, bytes, 4)) {
+    return false;
+  }
+  value = le32(bytes);
+  return true;
+}
+
+static void readNotes(Dump &dump, const uint8_t *p, size_t length) {
+  size_t at = 0;
+  while (at + 12 <= length) {
+    uint32_t nameLen = le32(p + at);
+    uint32_t descLen = le32(p + at + 4);
+    uint32_t type = le32(p + at + 8);
+    size_t nameAt = at + 12;
+    size_t descAt = nameAt + ((nameLen + 3) & ~3u);
+    size_t next = descAt + ((descLen + 3) & ~3u);
+    if (next > length) {
+      return;
+    }
+    const uint8_t *desc = p + descAt;
+    if (type == NOTE_PRSTATUS &&
+        descLen >= PRSTATUS_LEN + sizeof(Task::regs)) {
+      Task task;
+      task.tcb = le32(desc + PRSTATUS_PID);
+      for (size_t i = 0; i < sizeof(task.regs) / 4; i++) {
+        task.regs[i] = le32(desc + PRSTATUS_LEN + 4 * i);
+      }
+      dump.tasks.push_back(task);
+    } else if (type == NOTE_DUMP_INFO && descLen > 4) {
+      dump.appSha.assign((const char *)desc + 4,
+                         strnlen((const char *)desc + 4, descLen - 4));
+    } else if (type == NOTE_EXTRA_INFO && descLen >= 4) {
+      dump.crashedTcb = le32(desc);
+      for (size_t i = 4; i + 8 <= descLen; i += 8) {
+        if (le32(desc + i) != 0) {
+          dump.excRegs.push_back({le32(desc + i), le32(desc + i + 4)});
+        }
+      }
+    } else if (type == NOTE_PANIC_DETAILS) {
+      dump.panic.assign((const char *)desc,
+                        strnlen((const char *)desc, descLen));
+    }
+    at = next;
+  }
+}
+
+// Program headers: PT_LOAD is memory (stacks, TCBs), PT_NOTE the rest
+static const char *readElf(Dump &dump) {
+  const uint8_t *e = dump.elf;
+  if (dump.elfLen < 52 || memcmp(e, "\x7f" "ELF", 4) != 0 || e[4] != 1 ||
+      e[5] != 1) {
+    return "not a 32-bit little-endian ELF";
+  }
+  uint32_t phoff = le32(e + 28);
+  uint16_t phentsize = le16(e + 42);
+  uint16_t phnum = le16(e + 44);
+  if (phentsize < 32 || phoff + (size_t)phentsize * phnum > dump.elfLen) {
+    return "bad program headers";
+  }
+  for (uint16_t i = 0; i < phnum; i++) {
+    const uint8_t *ph = e + phoff + (size_t)i * phentsize;
+    uint32_t type = le32(ph);
+    uint32_t offset = le32(ph + 4);
+    uint32_t vaddr = le32(ph + 8);
+    uint32_t size = le32(ph + 16);
+    if ((size_t)offset + size > dump.elfLen) {
+      return "segment past the end of the dump";
+    }
+    if (type == 1) {
+      dump.memory.push_back({vaddr, offset, size});
+    } else if (type == 4) {
+      readNotes(dump, e + offset, size);
+    }
+  }
+  return nullptr;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static const char *excCauseName(uint32_t cause) {
+  static const char *const names[] = {
+      "IllegalInstruction",    "Syscall",
+      "InstructionFetchError", "LoadStoreError",
+      "Level1Interrupt",       "Alloca",
+      "IntegerDivideByZero",   "PCValue",
+      "Privileged",            "LoadStoreAlignment",
+      nullptr,                 nullptr,
+      "InstrPIFDataError",     "LoadStorePIFDataError",
+      "InstrPIFAddrError",     "LoadStorePIFAddrError",
+      "InstTLBMiss",           "InstTLBMultiHit",
+      "InstFetchPrivilege",    nullptr,
+      "InstFetchProhibited",   nullptr,
+      nullptr,                 nullptr,
+      "LoadStoreTLBMiss",      "LoadStoreTLBMultihit",
+      "LoadStorePrivilege",    nullptr,
+      "LoadProhibited",        "StoreProhibited",
+  };
+  if (cause < sizeof(names) / sizeof(names[0]) && names[cause]) {
+    return names[cause];
+  }
+  return cause >= 32 && cause < 40 ? "CoprocessorDisabled" : "Unknown";
+}
+
+// Xtensa special register numbers as the panic handler records them
+static const char *excRegName(uint32_t index) {
+  static char name[16];
+  if (index == 232) {
+    return "EXCCAUSE";
+  }
+  if (index == 238) {
+    return "EXCVADDR";
+  }
+  if (index >= 177 && index <= 183) {
+    snprintf(name, sizeof(name), "EPC%u", (unsigned)(index - 176));
+  } else if (index >= 194 && index <= 199) {
+    snprintf(name, sizeof(name), "EPS%u", (unsigned)(index - 192));
+  } else {
+    snprintf(name, sizeof(name), "SR%u", (unsigned)index);
+  }
+  return name;
+}
+
+// Windowed call return addresses keep the window increment in the top bits
+static uint32_t stackPc(uint32_t pc) {
+  if (pc & 0x80000000) {
+    pc = (pc & 0x3fffffff) | 0x40000000;
+  }
+  return pc - 3;
+}
+
+static std::string taskName(const Dump &dump, uint32_t tcb) {
+  char name[TCB_NAME_LEN + 1] = {0};
+  if (!readMemory(dump, tcb + TCB_NAME_OFFSET, name, TCB_NAME_LEN)) {
+    return "";
+  }
+  for (char *c = name; *c; c++) {
+    if (*c < 0x20 || *c > 0x7e) {
+      return "";
+    }
+  }
+  return name;
+}
+
+// As esp_backtrace_get_next_frame: the caller's a0 and sp sit in the base
+// save area just below each frame's sp
+static void printBacktrace(const Dump &dump, const Task &task) {
+  uint32_t pc = task.regs[REG_PC];
+  uint32_t sp = task.regs[REG_AR0 + 1];
+  uint32_t nextPc = task.regs[REG_AR0];
+  printf("\"backtrace\": [\"0x%08x:0x%08x\"", stackPc(pc), sp);
+  for (int frame = 1; frame < MAX_BACKTRACE && nextPc != 0; frame++) {
+    uint32_t callerPc, callerSp;
+    if (!readWord(dump, sp - 16, callerPc) ||
+        !readWord(dump, sp - 12, callerSp)) {
+      break;
+    }
+    pc = nextPc;
+    nextPc = callerPc;
+    sp = callerSp;
+    printf(", \"0x%08x:0x%08x\"", stackPc(pc), sp);
+  }
+  printf("]");
+}
+
+static void printDump(const std::vector<uint8_t> &raw) {
+  printf("\"dump\": {");
+  if (raw.size() < DUMP_HEADER_LEN + 4) {
+    printf("\"error\": \"too short\"}");
+    return;
+  }
+  uint32_t dataLen = le32(&raw[0]);
+  uint32_t version = le32(&raw[4]);
+  printf("\"version\": \"0x%08x\"", version);
+  if (((version >> 8) & 0xFF) != DUMP_VERSION_ELF) {
+    printf(", \"error\": \"binary format, not decoded\"}");
+    return;
+  }
+  bool sha = (version & 0xFF) == DUMP_CHECKSUM_SHA256;
+  size_t checksumLen = sha ? 32 : 4;
+  if (dataLen > raw.size() || dataLen < DUMP_HEADER_LEN + checksumLen) {
+    printf(", \"error\": \"length %u does not fit\"}", (unsigned)dataLen);
+    return;
+  }
+  if (sha) {
+    printf(", \"checksum\": \"sha256, not checked\"");
+  } else {
+    uint32_t crc = factoryCrc32(raw.data(), dataLen - 4);
+    printf(", \"checksumOk\": %s",
+           crc == le32(&raw[dataLen - 4]) ? "true" : "false");
+  }
+
+  Dump dump;
+  dump.elf = raw.data() + DUMP_HEADER_LEN;
+  dump.elfLen = dataLen - DUMP_HEADER_LEN - checksumLen;
+  const char *error = readElf(dump);
+  if (error) {
+    printf(", \"error\": \"%s\"}", error);
+    return;
+  }
+  printf(", \"appElfSha256\": \"%s\"", dump.appSha.c_str());
+  if (!dump.panic.empty()) {
+    printf(", \"panic\": \"%s\"", dump.panic.c_str());
+  }
+  printf(", \"crashedTask\": \"0x%08x\", \"exception\": {",
+         dump.crashedTcb);
+  for (size_t i = 0; i < dump.excRegs.size(); i++) {
+    printf("%s\"%s\": \"0x%08x\"", i ? ", " : "",
+           excRegName(dump.excRegs[i].first), dump.excRegs[i].second);
+    if (dump.excRegs[i].first == 232) {
+      printf(", \"cause\": \"%s\"", excCauseName(dump.excRegs[i].second));
+    }
+  }
+  printf("}, \"tasks\": [");
+  for (size_t i = 0; i < dump.tasks.size(); i++) {
+    const Task &task = dump.tasks[i];
+    printf("%s\n      {\"tcb\": \"0x%08x\", \"name\": \"%s\", "
+           "\"crashed\": %s, \"pc\": \"0x%08x\", \"sp\": \"0x%08x\", ",
+           i ? "," : "", task.tcb, taskName(dump, task.tcb).c_str(),
+           task.tcb == dump.crashedTcb ? "true" : "false",
+           task.regs[REG_PC], task.regs[REG_AR0 + 1]);
+    printBacktrace(dump, task);
+    printf("}");
+  }
+  printf("]}");
+}
+
+// Complete and CRC-clean
+static bool printReport(const Report &report, const char *outDir) {
+  printf("    {\"id\": \"%s\", \"topic\": \"%s\"", report.id.c_str(),
+         report.topic.c_str());
+  if (report.begin.empty()) {
+    printf(", \"error\": \"no begin message\"}");
+    return false;
+  }
+  static const char *const fields[] = {"reason", "crashedBoot", "fw"};
+  for (const char *field : fields) {
+    std::string value = jsonField(report.begin, field);
+    if (!value.empty()) {
+      printf(", \"%s\": \"%s\"", field, value.c_str());
+    }
+  }
+  std::string uptime = jsonField(report.begin, "uptimeMs");
+  if (!uptime.empty()) {
+    printf(", \"uptimeMs\": %s", uptime.c_str());
+  }
+  printf(", \"dumpSize\": %u, \"chunks\": %u, \"ended\": %s",
+         (unsigned)report.dumpSize, (unsigned)report.chunks,
+         report.ended ? "true" : "false");
+
+  std::vector<uint32_t> missing;
+  std::vector<uint8_t> raw;
+  for (uint32_t i = 0; i < report.chunks; i++) {
+    auto chunk = report.data.find(i);
+    if (chunk == report.data.end()) {
+      missing.push_back(i);
+    } else {
+      raw.insert(raw.end(), chunk->second.begin(), chunk->second.end());
+    }
+  }
+  if (!missing.empty()) {
+    std::string list;
+    for (uint32_t index : missing) {
+      list += (list.empty() ? "" : ",") + std::to_string(index);
+    }
+    printf(", \"missing\": [%s], \"resend\": {\"action\": \"crash_report\", "
+           "\"params\": {\"id\": \"%s\", \"chunks\": [%s]}}}",
+           list.c_str(), report.id.c_str(), list.c_str());
+    return false;
+  }
+  bool crcOk = raw.size() == report.dumpSize &&
+               factoryCrc32(raw.data(), raw.size()) == report.crc;
+  printf(", \"crcOk\": %s", crcOk ? "true" : "false");
+  if (report.dumpSize > 0) {
+    std::string path = std::string(outDir) + "/" + report.id + ".core";
+    FILE *file = fopen(path.c_str(), "wb");
+    if (file) {
+      fwrite(raw.data(), 1, raw.size(), file);
+      fclose(file);
+      printf(", \"file\": \"%s\"", path.c_str());
+    }
+    printf(",\n     ");
+    printDump(raw);
+  }
+  printf("}");
+  return crcOk;
+}
+
+int main(int argc, char **argv) {
+  const char *outDir = ".";
+  std::vector<const char *> captures;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "usage: %s [--out DIR] capture.txt...\n", argv[0]);
+      return 2;
+    } else {
+      captures.push_back(argv[i]);
+    }
+  }
+  if (captures.empty()) {
+    fprintf(stderr, "usage: %s [--out DIR] capture.txt...\n", argv[0]);
+    return 2;
+  }
+  for (const char *path : captures) {
+    if (!readCapture(path)) {
+      return 2;
+    }
+  }
+
+  bool ok = true;
+  printf("{\n  \"reports\": [");
+  for (size_t i = 0; i < order.size(); i++) {
+    printf("%s\n", i ? "," : "");
+    ok = printReport(reports[order[i]], outDir) && ok;
+  }
+  printf("\n  ]\n}\n");
+  return ok ? 0 : 1;
+}
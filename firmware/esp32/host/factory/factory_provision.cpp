@@ -0,0 +1,456 @@
+/**
+ * Factory line station
+ *
+ * Writes prebuilt NVS partition images into units over their serial ports,
+ * one thread per port, using the protocol in include/factory.h. Images are
+ * handed out from a shared queue: each goes to exactly one unit, a failed
+ * one goes back to the queue for another try. A unit is recognised by its
+ * chip id, so the same unit rebooting after a good write is not provisioned
+ * twice. A port's thread ends once every image is written or out of
+ * retries, or when no unit has said @factory-ready for --wait-s
+ * seconds. At the end a JSON report goes to stdout; the exit code is 1
+ * unless every image was written.
+ *
+ *   factory_provision [--baud N] [--reset] [--wait-s N] [--retries N]
+ *                     --images <image.bin...> --ports <tty...>
+ *
+ * --reset pulses RTS once per port at start (EN on the usual auto-reset
+ * circuit) so units that are already running reboot into their window.
+ */
+
+#include "factory_image.h"
+#include <chrono>
+#include <deque>
+#include <errno.h>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#define BOOT_BAUD 115200          // Console speed while the unit boots
+#define REPLY_TIMEOUT_MS 1000     // @factory-begin to @factory-baud
+#define RESULT_TIMEOUT_MS 10000   // Last image byte to @factory-ok
+#define SWITCH_SETTLE_MS 20       // Unit restarting its UART at the new speed
+#define IDLE_POLL_MS 250          // How often an idle port checks for the end
+
+typedef std::chrono::steady_clock Clock;
+
+static long long elapsedMs(Clock::time_point since) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() -
+                                                               since)
+      .count();
+}
+
+// ============================================================================
+// SERIAL PORTS
+// ============================================================================
+
+static speed_t speedConstant(unsigned baud) {
+  switch (baud) {
+  case 115200:
+    return B115200;
+  case 230400:
+    return B230400;
+#ifdef B460800
+  case 460800:
+    return B460800;
+#endif
+#ifdef B921600
+  case 921600:
+    return B921600;
+#endif
+#ifdef B1500000
+  case 1500000:
+    return B1500000;
+#endif
+#ifdef B2000000
+  case 2000000:
+    return B2000000;
+#endif
+  default:
+    return 0;
+  }
+}
+
+struct Port {
+  std::string path;
+  int fd;
+  std::string pending; // received, not yet split into lines
+};
+
+static bool setSpeed(Port &port, unsigned baud) {
+  termios tio;
+  if (tcgetattr(port.fd, &tio) != 0) {
+    return false;
+  }
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CRTSCTS | HUPCL);
+  tio.c_cc[VMIN] = 0;
+  tio.c_cc[VTIME] = 0;
+  speed_t speed = speedConstant(baud);
+  return speed && cfsetispeed(&tio, speed) == 0 &&
+         cfsetospeed(&tio, speed) == 0 &&
+         tcsetattr(port.fd, TCSANOW, &tio) == 0;
+}
+
+static bool openPort(Port &port) {
+  port.fd = open(port.path.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  return port.fd >= 0 && setSpeed(port, BOOT_BAUD);
+}
+
+// DTR released keeps GPIO0 high; RTS asserted holds EN low
+static void pulseReset(Port &port) {
+  int dtr = TIOCM_DTR, rts = TIOCM_RTS;
+  ioctl(port.fd, TIOCMBIC, &dtr);
+  ioctl(port.fd, TIOCMBIS, &rts);
+  usleep(100000);
+  ioctl(port.fd, TIOCMBIC, &rts);
+}
+
+static bool writeAll(Port &port, const void *data, size_t length) {
+  const uint8_t *cursor = (const uint8_t *)data;
+  while (length > 0) {
+    ssize_t n = write(port.fd, cursor, length);
+    if (n > 0) {
+      cursor += n;
+      length -= n;
+    } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+      return false;
+    } else {
+      pollfd pfd = {port.fd, POLLOUT, 0};
+      poll(&pfd, 1, 100);
+    }
+  }
+  return tcdrain(port.fd) == 0;
+}
+
+// Next line starting with "@factory-"; the boot log around it is skipped
+static bool readProtocolLine(Port &port, long long timeoutMs,
+                             std::string &line) {
+  Clock::time_point start = Clock::now();
+  for (;;) {
+    size_t newline;
+    while ((newline = port.pending.find('\n')) != std::string::npos) {
+      line = port.pending.substr(0, newline);
+      port.pending.erase(0, newline + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      size_t at = line.find("@factory-");
+      if (at != std::string::npos) {
+        line.erase(0, at);
+        return true;
+      }
+    }
+    long long left = timeoutMs - elapsedMs(start);
+    if (left <= 0) {
+      return false;
+    }
+    pollfd pfd = {port.fd, POLLIN, 0};
+    if (poll(&pfd, 1, (int)left) > 0) {
+      char buf[256];
+      ssize_t n = read(port.fd, buf, sizeof(buf));
+      if (n > 0) {
+        port.pending.append(buf, n);
+      } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+        return false;
+      }
+    }
+  }
+}
+
+// ============================================================================
+// IMAGES AND RESULTS
+// ============================================================================
+
+struct Image {
+  std::string path;
+  std::vector<uint8_t> data;
+  uint32_t crc;
+  int attempts;
+  bool done;
+};
+
+struct Unit {
+  std::string chipId;
+  std::string port;
+  size_t image;
+  bool ok;
+  std::string error;
+  long long ms;
+};
+
+static std::mutex lock;
+static std::vector<Image> images;
+static std::deque<size_t> queue;
+static std::set<std::string> provisioned; // chip ids
+static std::vector<Unit> units;
+static size_t inFlight = 0;
+static int maxAttempts = 3;
+
+// Nothing left to hand out and nothing that could still come back
+static bool finished() {
+  std::lock_guard<std::mutex> guard(lock);
+  return queue.empty() && inFlight == 0;
+}
+
+static bool takeImage(size_t &index) {
+  std::lock_guard<std::mutex> guard(lock);
+  if (queue.empty()) {
+    return false;
+  }
+  index = queue.front();
+  queue.pop_front();
+  images[index].attempts++;
+  inFlight++;
+  return true;
+}
+
+static void record(const Unit &unit) {
+  std::lock_guard<std::mutex> guard(lock);
+  units.push_back(unit);
+  inFlight--;
+  Image &image = images[unit.image];
+  if (unit.ok) {
+    image.done = true;
+    provisioned.insert(unit.chipId);
+  } else if (image.attempts < maxAttempts) {
+    queue.push_back(unit.image);
+  }
+  fprintf(stderr, "[%s] %s <- %s: %s (%lld ms)\n", unit.port.c_str(),
+          unit.chipId.c_str(), image.path.c_str(),
+          unit.ok ? "ok" : unit.error.c_str(), unit.ms);
+}
+
+static bool alreadyProvisioned(const std::string &chipId) {
+  std::lock_guard<std::mutex> guard(lock);
+  return provisioned.count(chipId) > 0;
+}
+
+// ============================================================================
+// STATION
+// ============================================================================
+
+// One session; an empty string on success, otherwise what went wrong
+static std::string provision(Port &port, const Image &image, unsigned baud) {
+  char begin[96];
+  snprintf(begin, sizeof(begin), "@factory-begin %zu %08x %u\n",
+           image.data.size(), image.crc, baud);
+  std::string line;
+  if (!writeAll(port, begin, strlen(begin)) ||
+      !readProtocolLine(port, REPLY_TIMEOUT_MS, line)) {
+    return "no reply to begin";
+  }
+  if (line.rfind("@factory-baud ", 0) != 0) {
+    return line;
+  }
+
+  if (!setSpeed(port, baud)) {
+    return "cannot switch port speed";
+  }
+  usleep(SWITCH_SETTLE_MS * 1000);
+  tcflush(port.fd, TCIOFLUSH);
+  port.pending.clear();
+
+  std::string error;
+  if (!writeAll(port, image.data.data(), image.data.size())) {
+    error = "write failed";
+  } else if (!readProtocolLine(port, RESULT_TIMEOUT_MS, line)) {
+    error = "no result";
+  } else if (line.rfind("@factory-ok ", 0) != 0) {
+    error = line;
+  } else if (strtoul(line.c_str() + 12, nullptr, 16) != image.crc) {
+    error = "crc mismatch in reply";
+  }
+
+  // The unit restarts at the boot speed either way
+  setSpeed(port, BOOT_BAUD);
+  port.pending.clear();
+  return error;
+}
+
+static void station(std::string path, unsigned baud, bool reset,
+                    long long waitMs) {
+  Port port = {path, -1, ""};
+  if (!openPort(port)) {
+    fprintf(stderr, "[%s] cannot open: %s\n", path.c_str(), strerror(errno));
+    if (port.fd >= 0) {
+      close(port.fd);
+    }
+    return;
+  }
+  if (reset) {
+    pulseReset(port);
+  }
+
+  std::string line;
+  long long idleMs = 0;
+  while (!finished() && idleMs < waitMs) {
+    if (!readProtocolLine(port, IDLE_POLL_MS, line)) {
+      idleMs += IDLE_POLL_MS;
+      continue;
+    }
+    idleMs = 0;
+    char chipId[24];
+    unsigned long nvsBytes = 0;
+    if (sscanf(line.c_str(), "@factory-ready %23s %lu", chipId, &nvsBytes) !=
+            2 ||
+        alreadyProvisioned(chipId)) {
+      continue;
+    }
+
+    size_t index;
+    if (!takeImage(index)) {
+      continue; // another port's failure may still come back
+    }
+    Unit unit = {chipId, path, index, false, "", 0};
+    Clock::time_point start = Clock::now();
+    const Image &image = images[index];
+    if (image.data.size() > nvsBytes) {
+      unit.error = "image larger than the unit's NVS partition";
+    } else {
+      unit.error = provision(port, image, baud);
+    }
+    unit.ok = unit.error.empty();
+    unit.ms = elapsedMs(start);
+    record(unit);
+  }
+  close(port.fd);
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static bool loadImage(const char *path, Image &image) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "factory_provision: cannot read %s\n", path);
+    return false;
+  }
+  image.path = path;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), file)) > 0) {
+    image.data.insert(image.data.end(), buf, buf + n);
+  }
+  fclose(file);
+
+  // The partition size is checked per unit
+  const char *reason =
+      factoryImageCheck(image.data.data(), image.data.size(), (size_t)-1);
+  if (reason) {
+    fprintf(stderr, "factory_provision: %s: %s\n", path, reason);
+    return false;
+  }
+  image.crc = factoryCrc32(image.data.data(), image.data.size());
+  image.attempts = 0;
+  image.done = false;
+  return true;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: factory_provision [--baud N] [--reset] [--wait-s N] "
+          "[--retries N]\n"
+          "                         --images <image.bin...> --ports "
+          "<tty...>\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned baud = 921600;
+  bool reset = false;
+  long long waitMs = 120000;
+  std::vector<std::string> imagePaths, ports;
+  std::vector<std::string> *list = nullptr;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--baud" && i + 1 < argc) {
+      baud = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--reset") {
+      reset = true;
+    } else if (arg == "--wait-s" && i + 1 < argc) {
+      waitMs = strtoll(argv[++i], nullptr, 10) * 1000;
+    } else if (arg == "--retries" && i + 1 < argc) {
+      maxAttempts = 1 + atoi(argv[++i]);
+    } else if (arg == "--images") {
+      list = &imagePaths;
+    } else if (arg == "--ports") {
+      list = &ports;
+    } else if (list && arg.rfind("--", 0) != 0) {
+      list->push_back(arg);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (imagePaths.empty() || ports.empty() || !speedConstant(baud) ||
+      maxAttempts < 1) {
+    usage();
+    return 2;
+  }
+
+  images.resize(imagePaths.size());
+  for (size_t i = 0; i < imagePaths.size(); i++) {
+    if (!loadImage(imagePaths[i].c_str(), images[i])) {
+      return 2;
+    }
+    queue.push_back(i);
+  }
+
+  Clock::time_point start = Clock::now();
+  std::vector<std::thread> threads;
+  for (const std::string &port : ports) {
+    threads.emplace_back(station, port, baud, reset, waitMs);
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  double elapsedS = elapsedMs(start) / 1000.0;
+
+  size_t written = 0;
+  long long unitMsTotal = 0;
+  for (const Unit &unit : units) {
+    if (unit.ok) {
+      written++;
+      unitMsTotal += unit.ms;
+    }
+  }
+  printf("{\n  \"context\": {\"baud\": %u, \"ports\": %zu, \"images\": %zu},\n",
+         baud, ports.size(), images.size());
+  printf("  \"provisioned\": %zu, \"attempts\": %zu, \"elapsedS\": %.1f, "
+         "\"unitsPerMinute\": %.1f, \"meanUnitMs\": %.0f,\n",
+         written, units.size(), elapsedS,
+         elapsedS > 0 ? written * 60.0 / elapsedS : 0,
+         written ? (double)unitMsTotal / written : 0);
+  printf("  \"units\": [");
+  for (size_t i = 0; i < units.size(); i++) {
+    const Unit &unit = units[i];
+    printf("%s\n    {\"chipId\": \"%s\", \"port\": \"%s\", \"image\": \"%s\", "
+           "\"ok\": %s, \"ms\": %lld%s%s%s}",
+           i ? "," : "", unit.chipId.c_str(), unit.port.c_str(),
+           images[unit.image].path.c_str(), unit.ok ? "true" : "false",
+           unit.ms, unit.ok ? "" : ", \"error\": \"",
+           unit.ok ? "" : unit.error.c_str(), unit.ok ? "" : "\"");
+  }
+  printf("\n  ],\n  \"notWritten\": [");
+  bool first = true;
+  for (const Image &image : images) {
+    if (!image.done) {
+      printf("%s\"%s\"", first ? "" : ", ", image.path.c_str());
+      first = false;
+    }
+  }
+  printf("]\n}\n");
+  return written == images.size() ? 0 : 1;
+}
@@ -0,0 +1,244 @@
+/**
+ * MQTT framing runner
+ *
+ * Counts what one PUBLISH costs on a TLS connection to the simulated broker
+ * (sim_network.h), where every Client::write() is sealed as its own TLS
+ * record: writes, records, TCP segments and bytes on the wire. Each message
+ * shape is sent three ways:
+ *
+ *   publish  PubSubClient::publish(), limited to the library buffer
+ *   stream   beginPublish() + print() + endPublish(), for larger payloads
+ *   framed   mqttPublishFramed(), the firmware's path (mqtt_publish.h)
+ *
+ * Then the production setup()/loop() runs over mqtts:// and every packet
+ * it writes is checked to have gone out as exactly one record. The exit
+ * code is 1 if the framed path ever needs more than one.
+ *
+ *   framing [--echo] [--minutes N]
+ */
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "WiFiClientSecure.h"
+#include "config.h"
+#include "derived_metrics.h"
+#include "host_device.h"
+#include "mqtt_publish.h"
+#include "sim_network.h"
+#include "telemetry.h"
+#include <PubSubClient.h>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+#define RUNNER_TOPIC "iot/" HOST_TENANT_ID "/devices/" HOST_DEVICE_ID "/"
+
+// ============================================================================
+// MESSAGE SHAPES
+// ============================================================================
+
+struct Shape {
+  const char *name;
+  std::string topic;
+  std::string payload;
+  bool retained;
+};
+
+// Sizes as the firmware produces them; "large" stands in for payloads
+// beyond PubSubClient's buffer
+static std::vector<Shape> buildShapes() {
+  std::vector<Shape> shapes;
+
+  shapes.push_back({"ack", RUNNER_TOPIC "ack",
+                    "{\"correlationId\":\"3f2a9c1e-5b7d-4e21-9a0c-"
+                    "6d1f2e3b4a5c\",\"status\":\"success\",\"state\":{\"led\":"
+                    "true},\"timestamp\":\"2026-01-01T00:00:00.000Z\"}",
+                    false});
+
+  TelemetryReading reading = {};
+  reading.temperatureCenti = 2150;
+  reading.humidityCenti = 4500;
+  derivedCompute(reading.temperatureCenti, reading.humidityCenti,
+                 reading.derived);
+  reading.uptimeS = 86400;
+  reading.rssi = -61;
+  reading.sensorConnected = true;
+  reading.seq = 1234;
+  char buffer[MQTT_BUFFER_SIZE];
+  telemetrySerialize(reading, TELEMETRY_FIELDS_ALL, false, buffer,
+                     sizeof(buffer));
+  shapes.push_back({"telemetry", RUNNER_TOPIC "telemetry", buffer, false});
+
+  shapes.push_back(
+      {"status", RUNNER_TOPIC "status",
+       "{\"status\":\"online\",\"timestamp\":\"2026-01-01T00:00:00.000Z\","
+       "\"fw\":\"" FIRMWARE_VERSION "\",\"build\":0,\"schema\":2,\"boot\":"
+       "\"e124b63a\",\"caps\":16383,\"profile\":0,\"limits\":{\"mqttBuffer\":"
+       "512},\"bist\":{\"state\":\"pass\",\"ms\":2010},\"cmdQueue\":"
+       "{\"executed\":12,\"dropped\":0,\"overruns\":0,"
+       "\"depthMax\":1,\"waitMaxMs\":3},\"events\":{\"published\":5120,"
+       "\"dropped\":0,\"depthMax\":3},\"groups\":[\"north\",\"dock-2\"],"
+       "\"timeSync\":{\"uncertaintyMs\":4,\"driftPpm\":12.5,\"samples\":8}}",
+       true});
+
+  std::string large = "{\"data\":\"";
+  large.append(MQTT_FRAME_SIZE - 200, 'x');
+  large += "\"}";
+  shapes.push_back({"large", RUNNER_TOPIC "telemetry", large, false});
+  return shapes;
+}
+
+// ============================================================================
+// MEASUREMENT
+// ============================================================================
+
+enum Path { PATH_PUBLISH, PATH_STREAM, PATH_FRAMED };
+static const char *const pathNames[] = {"publish", "stream", "framed"};
+
+struct Cost {
+  bool ok;
+  uint32_t writes;
+  uint32_t records;
+  uint32_t segments;
+  uint64_t wireBytes;
+};
+
+static bool send(Path path, PubSubClient &client,
+                 const Shape &shape) {
+  const uint8_t *payload = (const uint8_t *)shape.payload.data();
+  size_t length = shape.payload.size();
+  switch (path) {
+  case PATH_PUBLISH:
+    return client.publish(shape.topic.c_str(), payload, length,
+                          shape.retained);
+  case PATH_STREAM:
+    return client.beginPublish(shape.topic.c_str(), length, shape.retained) &&
+           client.write(payload, length) == length && client.endPublish();
+  case PATH_FRAMED:
+    return mqttPublishFramed(client, shape.topic.c_str(), payload, length,
+                             shape.retained);
+  }
+  return false;
+}
+
+static Cost measure(Path path, PubSubClient &client,
+                    const Shape &shape) {
+  SimNetStats before = simNetGetStats();
+  size_t published = simNetPublishes().size();
+  Cost cost = {};
+  cost.ok = send(path, client, shape);
+
+  // Let the broker take the packet off the link and check it arrived whole
+  client.loop();
+  hostClockAdvance(10);
+  client.loop();
+  const std::vector<SimPublish> &log = simNetPublishes();
+  cost.ok = cost.ok && log.size() == published + 1 &&
+            log.back().topic == shape.topic &&
+            log.back().payload == shape.payload &&
+            log.back().retained == shape.retained;
+
+  SimNetStats after = simNetGetStats();
+  cost.writes = after.writeCalls - before.writeCalls;
+  cost.records = after.tlsRecords - before.tlsRecords;
+  cost.segments = after.segmentsFromDevice - before.segmentsFromDevice;
+  cost.wireBytes = after.wireBytesFromDevice - before.wireBytesFromDevice;
+  return cost;
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static void usage() {
+  fprintf(stderr, "usage: framing [--echo] [--minutes N]\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned long minutes = 10;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--echo") {
+      hostSetSerialEcho(true);
+    } else if (arg == "--minutes" && i + 1 < argc) {
+      minutes = strtoul(argv[++i], nullptr, 10);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  bool failed = false;
+  hostClockReset();
+  simNetReset();
+  hostSetWifiStatus(WL_CONNECTED);
+
+  // Per message: the same packet through each path
+  std::vector<Shape> shapes = buildShapes();
+  printf("{\n  \"messages\": [\n");
+  {
+    WiFiClientSecure transport;
+    PubSubClient client(transport);
+    client.setBufferSize(MQTT_BUFFER_SIZE);
+    client.setServer("broker.sim", 8883);
+    if (!client.connect("framing-runner", "user", "pass")) {
+      fprintf(stderr, "framing: broker did not accept CONNECT\n");
+      return 2;
+    }
+
+    for (size_t s = 0; s < shapes.size(); s++) {
+      const Shape &shape = shapes[s];
+      printf("    {\"name\": \"%s\", \"payloadBytes\": %zu, \"paths\": {",
+             shape.name, shape.payload.size());
+      for (int p = PATH_PUBLISH; p <= PATH_FRAMED; p++) {
+        Cost cost = measure((Path)p, client, shape);
+        printf("%s\n      \"%s\": {\"ok\": %s, \"writes\": %u, "
+               "\"tlsRecords\": %u, \"segments\": %u, \"wireBytes\": %llu}",
+               p == PATH_PUBLISH ? "" : ",", pathNames[p],
+               cost.ok ? "true" : "false", cost.writes, cost.records,
+               cost.segments, (unsigned long long)cost.wireBytes);
+        if (p == PATH_FRAMED && (!cost.ok || cost.records != 1)) {
+          failed = true;
+        }
+      }
+      printf("}}%s\n", s + 1 < shapes.size() ? "," : "");
+    }
+    client.disconnect();
+  }
+  printf("  ],\n");
+
+  // The firmware itself: every packet it writes should be one record
+  hostClockReset();
+  simNetReset();
+  hostProvisionDevice("mqtts://broker.sim:8883");
+  hostSetWifiStatus(WL_CONNECTED);
+  setup();
+  while (millis() < minutes * 60000UL) {
+    unsigned long v0 = millis();
+    loop();
+    if (millis() == v0) {
+      hostClockAdvance(1);
+    }
+  }
+
+  SimNetStats stats = simNetGetStats();
+  double recordsPerPacket =
+      stats.packetsWritten ? (double)stats.tlsRecords / stats.packetsWritten
+                           : 0;
+  printf("  \"firmware\": {\"minutes\": %lu, \"packets\": %u, "
+         "\"publishes\": %u, \"writes\": %u, \"tlsRecords\": %u, "
+         "\"segments\": %u, \"recordsPerPacket\": %.2f, "
+         "\"bytes\": %llu, \"wireBytes\": %llu}\n",
+         minutes, stats.packetsWritten, stats.publishesWritten,
+         stats.writeCalls, stats.tlsRecords, stats.segmentsFromDevice,
+         recordsPerPacket, (unsigned long long)stats.bytesFromDevice,
+         (unsigned long long)stats.wireBytesFromDevice);
+  printf("}\n");
+
+  if (stats.packetsWritten == 0 || stats.tlsRecords != stats.packetsWritten) {
+    failed = true;
+  }
+  return failed ? 1 : 0;
+}
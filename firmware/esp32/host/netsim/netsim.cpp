@@ -0,0 +1,470 @@
+/**
+ * Network fault-injection runner
+ *
+ * Runs the production setup()/loop() in virtual time against the simulated
+ * network (sim_network.h) while a scenario script impairs WiFi, the TCP link
+ * and the broker. Reports recovery time per outage, message loss and
+ * duplicates as JSON; `expect` lines in the script make it a regression gate
+ * (exit code 1).
+ *
+ *   netsim <scenario.txt> [--echo] [--seed N]
+ */
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "config.h"
+#include "host_device.h"
+#include "sim_network.h"
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+// ============================================================================
+// SCENARIO
+// ============================================================================
+
+struct ScenarioStep {
+  unsigned long atMs;
+  std::vector<std::string> args; // verb first
+  int line;
+};
+
+struct Expectation {
+  std::string metric;
+  std::string op;
+  double value;
+};
+
+struct Scenario {
+  unsigned long durationMs = 120000;
+  unsigned long commandEveryMs = 0;
+  unsigned long assocMs = 2000;
+  uint32_t seed = 1;
+  std::vector<ScenarioStep> steps;
+  std::vector<Expectation> expectations;
+};
+
+static std::vector<std::string> splitWords(const char *line) {
+  std::vector<std::string> words;
+  std::string word;
+  for (const char *p = line;; p++) {
+    if (*p == '\0' || *p == '#' || isspace((unsigned char)*p)) {
+      if (!word.empty()) {
+        words.push_back(word);
+        word.clear();
+      }
+      if (*p == '\0' || *p == '#') {
+        return words;
+      }
+    } else {
+      word += *p;
+    }
+  }
+}
+
+static bool isNumber(const std::string &s) {
+  return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+}
+
+static bool loadScenario(const char *path, Scenario &scenario) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    fprintf(stderr, "netsim: cannot read %s\n", path);
+    return false;
+  }
+  char line[256];
+  int lineNo = 0;
+  bool ok = true;
+  while (fgets(line, sizeof(line), f)) {
+    lineNo++;
+    std::vector<std::string> w = splitWords(line);
+    if (w.empty()) {
+      continue;
+    }
+    if (isNumber(w[0]) && w.size() >= 2) {
+      ScenarioStep step;
+      step.atMs = strtoul(w[0].c_str(), nullptr, 10);
+      step.args.assign(w.begin() + 1, w.end());
+      step.line = lineNo;
+      scenario.steps.push_back(step);
+    } else if (w[0] == "duration" && w.size() == 2) {
+      scenario.durationMs = strtoul(w[1].c_str(), nullptr, 10);
+    } else if (w[0] == "commands" && w.size() == 2) {
+      scenario.commandEveryMs = strtoul(w[1].c_str(), nullptr, 10);
+    } else if (w[0] == "assoc" && w.size() == 2) {
+      scenario.assocMs = strtoul(w[1].c_str(), nullptr, 10);
+    } else if (w[0] == "seed" && w.size() == 2) {
+      scenario.seed = strtoul(w[1].c_str(), nullptr, 10);
+    } else if (w[0] == "expect" && w.size() == 4) {
+      scenario.expectations.push_back({w[1], w[2], strtod(w[3].c_str(), 0)});
+    } else {
+      fprintf(stderr, "netsim: %s:%d: cannot parse\n", path, lineNo);
+      ok = false;
+    }
+  }
+  fclose(f);
+  std::stable_sort(scenario.steps.begin(), scenario.steps.end(),
+                   [](const ScenarioStep &a, const ScenarioStep &b) {
+                     return a.atMs < b.atMs;
+                   });
+  return ok;
+}
+
+// ============================================================================
+// WORLD (applied on every clock advance, including inside delay())
+// ============================================================================
+
+struct Outage {
+  unsigned long downAt;
+  unsigned long upAt; // 0 while still down
+  unsigned long healthyAt;
+};
+
+static Scenario scenario;
+static size_t nextStep = 0;
+static bool scriptError = false;
+
+static bool apUp = true;
+static unsigned long associateAt = 0; // 0 = not associating
+static unsigned long healthyAt = 0;   // network last became usable
+
+static unsigned long nextCommandAt = 0;
+static uint32_t commandsInjected = 0;
+static std::set<std::string> commandsOutstanding;
+
+static bool sessionWasUp = false;
+static std::vector<Outage> outages;
+static std::vector<unsigned long> halfOpenAt;
+
+static bool networkImpaired() {
+  SimNetFaults f = simNetGetFaults();
+  return !apUp || associateAt != 0 || f.dnsFail || f.brokerDown ||
+         f.blackhole || f.connackRc != 0;
+}
+
+static void applyStep(const ScenarioStep &step, unsigned long nowMs) {
+  const std::vector<std::string> &a = step.args;
+  const std::string &verb = a[0];
+  SimNetFaults f = simNetGetFaults();
+  bool wasImpaired = networkImpaired();
+  auto arg = [&](size_t i) {
+    return i < a.size() ? strtoul(a[i].c_str(), nullptr, 10) : 0;
+  };
+
+  if (verb == "wifi" && a.size() == 2) {
+    apUp = a[1] == "up";
+    if (apUp) {
+      associateAt = nowMs + scenario.assocMs;
+    } else {
+      associateAt = 0;
+      hostSetWifiStatus(WL_CONNECTION_LOST);
+    }
+  } else if (verb == "latency" && a.size() >= 2) {
+    f.latencyMs = arg(1);
+    f.jitterMs = arg(2);
+  } else if (verb == "bandwidth" && a.size() == 2) {
+    f.bandwidthBps = arg(1);
+  } else if (verb == "loss" && a.size() == 2) {
+    f.lossPercent = (uint8_t)std::min<unsigned long>(arg(1), 100);
+  } else if (verb == "dns" && a.size() == 2) {
+    f.dnsFail = a[1] == "fail";
+  } else if (verb == "broker" && a.size() == 2) {
+    f.brokerDown = a[1] == "down";
+    f.blackhole = a[1] == "blackhole";
+  } else if (verb == "reject" && a.size() == 2) {
+    f.connackRc = (uint8_t)arg(1);
+  } else if (verb == "half-open") {
+    simNetHalfOpen();
+    halfOpenAt.push_back(nowMs);
+  } else if (verb == "reset") {
+    simNetDropConnection();
+  } else if (verb == "heal") {
+    f = SimNetFaults();
+    if (!apUp) {
+      apUp = true;
+      associateAt = nowMs + scenario.assocMs;
+    }
+  } else {
+    fprintf(stderr, "netsim: line %d: unknown step '%s'\n", step.line,
+            verb.c_str());
+    scriptError = true;
+  }
+  simNetSetFaults(f);
+
+  // Instant disruptions leave a usable network behind them
+  if (verb == "half-open" || verb == "reset" ||
+      (wasImpaired && !networkImpaired())) {
+    healthyAt = nowMs;
+  }
+}
+
+static void injectCommand() {
+  char id[16];
+  snprintf(id, sizeof(id), "ns-%u", (unsigned)++commandsInjected);
+  char payload[128];
+  int len = snprintf(payload, sizeof(payload),
+                     "{\"correlationId\":\"%s\",\"action\":\"set_state\","
+                     "\"params\":{\"led\":false}}",
+                     id);
+  char topic[128];
+  snprintf(topic, sizeof(topic), "iot/%s/devices/%s/command", HOST_TENANT_ID,
+           HOST_DEVICE_ID);
+  commandsOutstanding.insert(id);
+  simNetInject(topic, (const uint8_t *)payload, len);
+}
+
+static void tickWorld(unsigned long nowMs) {
+  while (nextStep < scenario.steps.size() &&
+         scenario.steps[nextStep].atMs <= nowMs) {
+    applyStep(scenario.steps[nextStep++], nowMs);
+  }
+
+  // Association completes on its own once the AP is back
+  if (associateAt != 0 && nowMs >= associateAt) {
+    associateAt = 0;
+    hostSetWifiStatus(WL_CONNECTED);
+    if (!networkImpaired()) {
+      healthyAt = nowMs;
+    }
+  }
+
+  // A distinct reading per sensor interval makes duplicates detectable
+  unsigned long sample = nowMs / SENSOR_READ_INTERVAL_MS;
+  hostSetSensor(20.0f + (sample % 100) * 0.1f,
+                40.0f + (sample / 100 % 200) * 0.1f);
+
+  if (scenario.commandEveryMs > 0 && nowMs >= nextCommandAt) {
+    nextCommandAt = nowMs + scenario.commandEveryMs;
+    injectCommand();
+  }
+
+  bool up = simNetSessionUp() && hostGetWifiStatus() == WL_CONNECTED;
+  if (sessionWasUp && !up) {
+    outages.push_back({nowMs, 0, 0});
+  } else if (!sessionWasUp && up && !outages.empty()) {
+    outages.back().upAt = nowMs;
+    outages.back().healthyAt = healthyAt;
+  }
+  sessionWasUp = up;
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static std::string jsonField(const std::string &json, const char *key) {
+  std::string needle = std::string("\"") + key + "\":\"";
+  size_t start = json.find(needle);
+  if (start == std::string::npos) {
+    return "";
+  }
+  start += needle.size();
+  size_t end = json.find('"', start);
+  return end == std::string::npos ? "" : json.substr(start, end - start);
+}
+
+static long jsonNumber(const std::string &json, const char *key) {
+  std::string needle = std::string("\"") + key + "\":";
+  size_t start = json.find(needle);
+  return start == std::string::npos
+             ? -1
+             : strtol(json.c_str() + start + needle.size(), nullptr, 10);
+}
+
+static bool compare(double actual, const std::string &op, double expected) {
+  if (op == "<=") {
+    return actual <= expected;
+  }
+  if (op == ">=") {
+    return actual >= expected;
+  }
+  if (op == "==") {
+    return actual == expected;
+  }
+  if (op == "<") {
+    return actual < expected;
+  }
+  if (op == ">") {
+    return actual > expected;
+  }
+  return false;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: netsim <scenario.txt> [--echo] [--seed N]\n");
+    return 2;
+  }
+  if (!loadScenario(argv[1], scenario)) {
+    return 2;
+  }
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--echo") {
+      hostSetSerialEcho(true);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      scenario.seed = strtoul(argv[++i], nullptr, 10);
+    } else {
+      fprintf(stderr, "usage: netsim <scenario.txt> [--echo] [--seed N]\n");
+      return 2;
+    }
+  }
+
+  hostClockReset();
+  simNetReset();
+  simNetSeed(scenario.seed);
+  hostProvisionDevice("mqtt://broker.sim:1883");
+  hostSetWifiStatus(WL_CONNECTED);
+  nextCommandAt = scenario.commandEveryMs;
+  hostSetClockHook(tickWorld);
+  tickWorld(0);
+
+  unsigned long maxLoopMs = 0;
+  bool restarted = false;
+  try {
+    setup();
+    while (millis() < scenario.durationMs && !scriptError) {
+      unsigned long v0 = millis();
+      loop();
+      maxLoopMs = std::max(maxLoopMs, millis() - v0);
+      if (millis() == v0) {
+        hostClockAdvance(1);
+      }
+    }
+  } catch (const HostRestart &) {
+    restarted = true;
+  }
+  if (scriptError) {
+    return 2;
+  }
+
+  // Delivery accounting
+  const std::vector<SimPublish> &pubs = simNetPublishes();
+  SimNetStats net = simNetGetStats();
+  long telemetryDelivered = 0;
+  long telemetryDuplicates = 0;
+  long ackDuplicates = 0;
+  std::set<std::string> telemetrySeen;
+  std::set<long> seqSeen;
+  std::set<std::string> acked;
+  for (const SimPublish &pub : pubs) {
+    std::string type = simNetTopicType(pub.topic);
+    if (type == "telemetry") {
+      telemetryDelivered++;
+      if (!telemetrySeen.insert(pub.payload).second) {
+        telemetryDuplicates++;
+      }
+      seqSeen.insert(jsonNumber(pub.payload, "seq"));
+    } else if (type == "ack") {
+      std::string id = jsonField(pub.payload, "correlationId");
+      if (!acked.insert(id).second) {
+        ackDuplicates++;
+      }
+      commandsOutstanding.erase(id);
+    }
+  }
+  long telemetryExpected = (long)(scenario.durationMs / TELEMETRY_INTERVAL_MS);
+  long telemetryMissing = std::max(0L, telemetryExpected - telemetryDelivered);
+  long lostInFlight = (long)net.publishesWritten - (long)pubs.size();
+  // Samples the platform would have to ask for with resend_telemetry
+  long seqGaps = seqSeen.empty() ? 0 : *seqSeen.rbegin() - (long)seqSeen.size();
+
+  // Recovery: from the moment the network was usable again to a new session
+  unsigned long recoveryMax = 0;
+  long unrecovered = 0;
+  for (Outage &o : outages) {
+    if (o.upAt == 0) {
+      unrecovered++;
+      continue;
+    }
+    unsigned long from = std::max(o.downAt, o.healthyAt);
+    recoveryMax = std::max(recoveryMax, o.upAt - from);
+  }
+
+  // Half-open detection: until the device closed the dead socket
+  std::vector<unsigned long> detectMs;
+  for (unsigned long at : halfOpenAt) {
+    for (const SimNetEvent &e : simNetEvents()) {
+      if (e.type == SIM_SOCKET_CLOSED && e.timeMs >= at) {
+        detectMs.push_back(e.timeMs - at);
+        break;
+      }
+    }
+  }
+
+  std::map<std::string, double> metrics;
+  metrics["recovery-max-ms"] = recoveryMax;
+  metrics["unrecovered"] = unrecovered;
+  metrics["outages"] = outages.size();
+  metrics["telemetry-missing"] = telemetryMissing;
+  metrics["telemetry-seq-gaps"] = seqGaps;
+  metrics["lost-in-flight"] = lostInFlight;
+  metrics["commands-lost"] = commandsOutstanding.size();
+  metrics["duplicates"] = telemetryDuplicates + ackDuplicates;
+  metrics["mqtt-connects"] = net.mqttConnects;
+  metrics["loop-max-ms"] = maxLoopMs;
+  metrics["half-open-detect-max-ms"] =
+      detectMs.empty() ? 0
+                       : *std::max_element(detectMs.begin(), detectMs.end());
+
+  printf("{\n");
+  printf("  \"scenario\": \"%s\",\n", argv[1]);
+  printf("  \"seed\": %u,\n", (unsigned)scenario.seed);
+  printf("  \"virtualMs\": %lu,\n", millis());
+  printf("  \"restarted\": %s,\n", restarted ? "true" : "false");
+  printf("  \"outages\": [");
+  for (size_t i = 0; i < outages.size(); i++) {
+    const Outage &o = outages[i];
+    printf("%s\n    {\"downAt\": %lu, ", i ? "," : "", o.downAt);
+    if (o.upAt == 0) {
+      printf("\"upAt\": null, \"recoveryMs\": null}");
+    } else {
+      printf("\"upAt\": %lu, \"recoveryMs\": %lu}", o.upAt,
+             o.upAt - std::max(o.downAt, o.healthyAt));
+    }
+  }
+  printf("%s],\n", outages.empty() ? "" : "\n  ");
+  printf("  \"halfOpenDetectMs\": [");
+  for (size_t i = 0; i < detectMs.size(); i++) {
+    printf("%s%lu", i ? ", " : "", detectMs[i]);
+  }
+  printf("],\n");
+  printf("  \"telemetry\": {\"expected\": %ld, \"delivered\": %ld, "
+         "\"missing\": %ld, \"duplicates\": %ld, \"seqGaps\": %ld},\n",
+         telemetryExpected, telemetryDelivered, telemetryMissing,
+         telemetryDuplicates, seqGaps);
+  printf("  \"commands\": {\"injected\": %u, \"acked\": %zu, \"lost\": %zu, "
+         "\"duplicateAcks\": %ld},\n",
+         (unsigned)commandsInjected, acked.size(), commandsOutstanding.size(),
+         ackDuplicates);
+  printf("  \"publishes\": {\"written\": %u, \"delivered\": %zu, "
+         "\"lostInFlight\": %ld},\n",
+         net.publishesWritten, pubs.size(), lostInFlight);
+  printf("  \"net\": {\"tcpConnects\": %u, \"connectFailures\": %u, "
+         "\"mqttConnects\": %u, \"mqttRejects\": %u, \"retransmits\": %u, "
+         "\"bytesLost\": %llu},\n",
+         net.connects, net.connectFailures, net.mqttConnects, net.mqttRejects,
+         net.retransmits, (unsigned long long)net.bytesLost);
+  printf("  \"wifiBegins\": %u,\n", hostWifiBeginCount());
+  printf("  \"loopMaxMs\": %lu,\n", maxLoopMs);
+
+  printf("  \"checks\": [");
+  bool allOk = true;
+  for (size_t i = 0; i < scenario.expectations.size(); i++) {
+    const Expectation &e = scenario.expectations[i];
+    auto it = metrics.find(e.metric);
+    bool ok = it != metrics.end() && compare(it->second, e.op, e.value);
+    printf("%s\n    {\"check\": \"%s %s %g\", \"actual\": %g, \"ok\": %s}",
+           i ? "," : "", e.metric.c_str(), e.op.c_str(), e.value,
+           it != metrics.end() ? it->second : -1.0, ok ? "true" : "false");
+    allOk = allOk && ok;
+  }
+  printf("%s]\n}\n", scenario.expectations.empty() ? "" : "\n  ");
+
+  return allOk ? 0 : 1;
+}
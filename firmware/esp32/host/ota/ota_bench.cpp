@@ -0,0 +1,361 @@
+/**
+ * MQTT OTA throughput runner
+ *
+ * Runs the production setup()/loop() against the simulated broker
+ * (sim_network.h) with a link of the given latency and bandwidth, starts an
+ * ota_mqtt update (ota_mqtt.h) and plays the update server: every chunk the
+ * device asks for on .../ota/request is published on .../ota/data, except
+ * for the --drop share, which is dropped as a QoS 0 broker might. One run
+ * per window size. Each run reports the virtual time from "accepted" to
+ * "success", throughput, requests, re-requests and the device's round trip
+ * estimate, and checks that the image in the OTA partition is the one sent
+ * and that the device restarted into it. The exit code is 1 if any run
+ * failed.
+ *
+ *   ota_bench [--windows 1,2,4,8,16] [--size-kb N] [--chunk N]
+ *             [--latency-ms N] [--bandwidth-bps N] [--loss N] [--drop N]
+ *             [--seed N] [--echo]
+ */
+
+#include "Arduino.h"
+#include "Update.h"
+#include "WiFi.h"
+#include "config.h"
+#include "host_device.h"
+#include "mbedtls/sha256.h"
+#include "ota_mqtt.h"
+#include "sim_network.h"
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+#define RUNNER_TOPIC "iot/" HOST_TENANT_ID "/devices/" HOST_DEVICE_ID "/"
+#define RUN_TIMEOUT_MS (30UL * 60 * 1000)
+
+// ============================================================================
+// UPDATE SERVER
+// ============================================================================
+
+struct Server {
+  std::vector<uint8_t> image;
+  uint32_t chunkSize;
+  uint8_t dropPercent;
+  std::string correlationId;
+  uint32_t rng;
+  size_t scanned; // broker log entries already looked at
+  uint32_t served;
+  uint32_t dropped;
+  unsigned long acceptedMs;
+  unsigned long finishedMs;
+  bool succeeded;
+  std::string error;
+};
+
+static Server server;
+
+static uint32_t nextRandom() {
+  server.rng ^= server.rng << 13;
+  server.rng ^= server.rng >> 17;
+  server.rng ^= server.rng << 5;
+  return server.rng;
+}
+
+static void sendChunk(uint32_t index) {
+  size_t offset = (size_t)index * server.chunkSize;
+  if (offset >= server.image.size()) {
+    return;
+  }
+  size_t length = std::min((size_t)server.chunkSize,
+                           server.image.size() - offset);
+  std::vector<uint8_t> payload = {(uint8_t)(index >> 24),
+                                  (uint8_t)(index >> 16),
+                                  (uint8_t)(index >> 8), (uint8_t)index};
+  payload.insert(payload.end(), server.image.begin() + offset,
+                 server.image.begin() + offset + length);
+  simNetInject(RUNNER_TOPIC "ota/data", payload.data(), payload.size());
+  server.served++;
+}
+
+// {"id":"...","chunkSize":1024,"chunks":[3,4,5]}
+static void answerRequest(const std::string &payload) {
+  size_t at = payload.find("\"chunks\":[");
+  if (at == std::string::npos) {
+    return;
+  }
+  const char *cursor = payload.c_str() + at + 10;
+  while (*cursor && *cursor != ']') {
+    char *end;
+    uint32_t index = strtoul(cursor, &end, 10);
+    if (end == cursor) {
+      break;
+    }
+    if (nextRandom() % 100 < server.dropPercent) {
+      server.dropped++;
+    } else {
+      sendChunk(index);
+    }
+    cursor = *end == ',' ? end + 1 : end;
+  }
+}
+
+// Rejections come without "action", so match on the correlation id
+static void watchAck(const SimPublish &pub) {
+  std::string key = "\"correlationId\":\"" + server.correlationId + "\"";
+  if (pub.payload.find(key) == std::string::npos) {
+    return;
+  }
+  if (pub.payload.find("\"status\":\"accepted\"") != std::string::npos) {
+    server.acceptedMs = pub.timeMs;
+  } else if (pub.payload.find("\"status\":\"success\"") !=
+             std::string::npos) {
+    server.finishedMs = pub.timeMs;
+    server.succeeded = true;
+  } else if (pub.payload.find("\"status\":\"error\"") != std::string::npos) {
+    server.finishedMs = pub.timeMs;
+    size_t at = pub.payload.find("\"error\":\"");
+    server.error = at == std::string::npos
+                       ? "error"
+                       : pub.payload.substr(at + 9,
+                                            pub.payload.find('"', at + 9) -
+                                                at - 9);
+  }
+}
+
+// Runs on every clock advance, so requests are answered as they arrive
+static void serve(unsigned long nowMs) {
+  (void)nowMs;
+  simNetPoll();
+  const std::vector<SimPublish> &log = simNetPublishes();
+  for (; server.scanned < log.size(); server.scanned++) {
+    const SimPublish &pub = log[server.scanned];
+    std::string type = simNetTopicType(pub.topic);
+    if (type == "request") {
+      answerRequest(pub.payload);
+    } else if (type == "ack") {
+      watchAck(pub);
+    }
+  }
+}
+
+// ============================================================================
+// RUNS
+// ============================================================================
+
+struct Options {
+  std::vector<uint32_t> windows;
+  uint32_t sizeBytes;
+  uint32_t chunkSize;
+  SimNetFaults faults;
+  uint8_t dropPercent;
+  uint32_t seed;
+};
+
+struct RunResult {
+  uint32_t window;
+  bool ok;
+  bool imageMatches;
+  bool restarted;
+  unsigned long durationMs;
+  OtaMqttStats stats;
+};
+
+static std::vector<uint8_t> buildImage(uint32_t size, uint32_t seed) {
+  std::vector<uint8_t> image(size);
+  uint32_t x = seed | 1;
+  for (uint32_t i = 0; i < size; i++) {
+    x = x * 1664525u + 1013904223u;
+    image[i] = (uint8_t)(x >> 24);
+  }
+  return image;
+}
+
+static std::string sha256Hex(const std::vector<uint8_t> &data) {
+  mbedtls_sha256_context ctx;
+  uint8_t digest[32];
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+  mbedtls_sha256_update(&ctx, data.data(), data.size());
+  mbedtls_sha256_finish(&ctx, digest);
+  mbedtls_sha256_free(&ctx);
+  char hex[65];
+  for (int i = 0; i < 32; i++) {
+    snprintf(hex + 2 * i, 3, "%02x", digest[i]);
+  }
+  return hex;
+}
+
+static RunResult runWindow(const Options &options, uint32_t window) {
+  RunResult result = {};
+  result.window = window;
+
+  server = Server();
+  server.image = buildImage(options.sizeBytes, options.seed);
+  server.chunkSize = options.chunkSize;
+  server.dropPercent = options.dropPercent;
+  server.rng = options.seed | 1;
+  server.correlationId = "ota-bench-w" + std::to_string(window);
+
+  hostClockReset();
+  simNetReset();
+  simNetSeed(options.seed);
+  hostProvisionDevice("mqtt://broker.sim:1883");
+  hostSetWifiStatus(WL_CONNECTED);
+  hostSetClockHook(serve);
+
+  // No LAN peers here; skipping the peer phase times MQTT alone
+  char command[320];
+  snprintf(command, sizeof(command),
+           "{\"action\":\"ota_mqtt\",\"correlationId\":\"%s\","
+           "\"params\":{\"size\":%u,\"sha256\":\"%s\",\"chunkSize\":%u,"
+           "\"window\":%u,\"peers\":false}}",
+           server.correlationId.c_str(), (unsigned)options.sizeBytes,
+           sha256Hex(server.image).c_str(), (unsigned)options.chunkSize,
+           (unsigned)window);
+
+  bool sent = false;
+  try {
+    setup();
+    // The link is impaired only once the session is up, so every run
+    // starts the transfer from the same point
+    simNetSetFaults(options.faults);
+    while (millis() < RUN_TIMEOUT_MS && server.finishedMs == 0) {
+      if (!sent && simNetSessionUp()) {
+        simNetInject(RUNNER_TOPIC "command", (const uint8_t *)command,
+                     strlen(command));
+        sent = true;
+      }
+      unsigned long v0 = millis();
+      loop();
+      if (millis() == v0) {
+        hostClockAdvance(1);
+      }
+    }
+    // Give the restart its chance
+    unsigned long until = millis() + OTA_MQTT_RESTART_DELAY_MS + 5000;
+    while (server.succeeded && millis() < until) {
+      unsigned long v0 = millis();
+      loop();
+      if (millis() == v0) {
+        hostClockAdvance(1);
+      }
+    }
+  } catch (const HostRestart &) {
+    result.restarted = true;
+  }
+  hostSetClockHook(nullptr);
+
+  // A rejected command never started a transfer
+  if (server.acceptedMs) {
+    result.stats = otaMqttGetStats();
+  }
+  result.imageMatches = Update.hostImage() == server.image;
+  result.ok = server.succeeded && result.imageMatches && result.restarted;
+  result.durationMs = server.finishedMs - server.acceptedMs;
+  return result;
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static void usage() {
+  fprintf(stderr,
+          "usage: ota_bench [--windows 1,2,4,8,16] [--size-kb N] "
+          "[--chunk N]\n"
+          "                 [--latency-ms N] [--bandwidth-bps N] [--loss N] "
+          "[--drop N]\n"
+          "                 [--seed N] [--echo]\n");
+}
+
+static bool parseWindows(const char *list, std::vector<uint32_t> &out) {
+  out.clear();
+  const char *cursor = list;
+  while (*cursor) {
+    char *end;
+    unsigned long window = strtoul(cursor, &end, 10);
+    if (end == cursor || window == 0 || window > OTA_MQTT_WINDOW_MAX) {
+      return false;
+    }
+    out.push_back(window);
+    cursor = *end == ',' ? end + 1 : end;
+    if (*end && *end != ',') {
+      return false;
+    }
+  }
+  return !out.empty();
+}
+
+int main(int argc, char **argv) {
+  Options options = {};
+  options.windows = {1, 2, 4, 8, 16};
+  options.sizeBytes = 256 * 1024;
+  options.chunkSize = OTA_MQTT_CHUNK_SIZE;
+  options.faults.latencyMs = 40;
+  options.faults.bandwidthBps = 125000; // 1 Mbit/s
+  options.seed = 1;
+
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--windows" && hasValue) {
+      if (!parseWindows(argv[++i], options.windows)) {
+        usage();
+        return 2;
+      }
+    } else if (arg == "--size-kb" && hasValue) {
+      options.sizeBytes = strtoul(argv[++i], nullptr, 10) * 1024;
+    } else if (arg == "--chunk" && hasValue) {
+      options.chunkSize = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--latency-ms" && hasValue) {
+      options.faults.latencyMs = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--bandwidth-bps" && hasValue) {
+      options.faults.bandwidthBps = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--loss" && hasValue) {
+      options.faults.lossPercent = atoi(argv[++i]);
+    } else if (arg == "--drop" && hasValue) {
+      options.dropPercent = atoi(argv[++i]);
+    } else if (arg == "--seed" && hasValue) {
+      options.seed = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--echo") {
+      hostSetSerialEcho(true);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (options.sizeBytes == 0 || options.dropPercent >= 100) {
+    usage();
+    return 2;
+  }
+
+  printf("{\n  \"context\": {\"sizeBytes\": %u, \"chunkSize\": %u, "
+         "\"latencyMs\": %u, \"bandwidthBps\": %u, \"lossPercent\": %u, "
+         "\"dropPercent\": %u},\n  \"results\": [\n",
+         options.sizeBytes, options.chunkSize, options.faults.latencyMs,
+         options.faults.bandwidthBps, options.faults.lossPercent,
+         options.dropPercent);
+
+  bool failed = false;
+  for (size_t i = 0; i < options.windows.size(); i++) {
+    RunResult r = runWindow(options, options.windows[i]);
+    double bytesPerSecond =
+        r.ok && r.durationMs ? options.sizeBytes * 1000.0 / r.durationMs : 0;
+    printf("    {\"window\": %u, \"ok\": %s, \"durationMs\": %lu, "
+           "\"bytesPerSecond\": %.0f, \"requests\": %u, \"rerequested\": %u, "
+           "\"duplicates\": %u, \"served\": %u, \"dropped\": %u, "
+           "\"rttMs\": %u, \"imageMatches\": %s, \"restarted\": %s%s%s%s}%s\n",
+           r.window, r.ok ? "true" : "false", r.ok ? r.durationMs : 0,
+           bytesPerSecond, r.stats.requests, r.stats.rerequested,
+           r.stats.duplicates, server.served, server.dropped, r.stats.srttMs,
+           r.imageMatches ? "true" : "false",
+           r.restarted ? "true" : "false",
+           server.error.empty() ? "" : ", \"error\": \"",
+           server.error.c_str(), server.error.empty() ? "" : "\"",
+           i + 1 < options.windows.size() ? "," : "");
+    failed = failed || !r.ok;
+  }
+  printf("  ]\n}\n");
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,286 @@
+/**
+ * Trace replay runner
+ *
+ * Feeds an input trace recorded with -DTHINGBASE_TRACE (see trace.h) through
+ * the production setup()/loop() in virtual time and prints a JSON timing
+ * profile. Optional limits turn it into a regression gate (exit code 1).
+ *
+ *   replay <trace.log> [--echo] [--tail-ms N]
+ *          [--max-loop-p99-ms N] [--max-loop-ms N]
+ *          [--max-mqtt-connects N] [--publishes TYPE=MIN[:MAX]]...
+ */
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "config.h"
+#include "host_device.h"
+#include "sim_network.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+void setup();
+void loop();
+
+// ============================================================================
+// TRACE INPUTS
+// ============================================================================
+
+static std::vector<TraceRecord> records;
+static size_t nextRecord = 0;
+
+static bool loadTrace(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  static char line[TRACE_MAX_LINE + 64];
+  TraceRecord record;
+  while (fgets(line, sizeof(line), f)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (traceParse(line, &record)) {
+      records.push_back(record);
+    }
+  }
+  fclose(f);
+  std::stable_sort(records.begin(), records.end(),
+                   [](const TraceRecord &a, const TraceRecord &b) {
+                     return a.timeMs < b.timeMs;
+                   });
+  return true;
+}
+
+// Runs on every clock advance, including inside delay()
+static void applyInputs(unsigned long nowMs) {
+  while (nextRecord < records.size() && records[nextRecord].timeMs <= nowMs) {
+    const TraceRecord &r = records[nextRecord++];
+    switch (r.type) {
+    case TRACE_SENSOR:
+      hostSetSensor(r.temperature, r.humidity);
+      break;
+    case TRACE_WIFI:
+      hostSetWifiStatus(r.value);
+      break;
+    case TRACE_BUTTON:
+      hostSetPinInput(RESET_BUTTON_PIN, r.value ? LOW : HIGH);
+      break;
+    case TRACE_MQTT_IN:
+      simNetInject(r.topic, r.payload, r.payloadLen);
+      break;
+    }
+  }
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+struct PublishLimit {
+  std::string type;
+  long min;
+  long max;
+};
+
+struct Check {
+  std::string name;
+  bool ok;
+};
+
+template <typename T> static T percentile(std::vector<T> v, double p) {
+  if (v.empty()) {
+    return 0;
+  }
+  std::sort(v.begin(), v.end());
+  size_t idx = (size_t)(p * (v.size() - 1));
+  return v[idx];
+}
+
+static void usage() {
+  fprintf(stderr,
+          "usage: replay <trace.log> [--echo] [--tail-ms N]\n"
+          "              [--max-loop-p99-ms N] [--max-loop-ms N]\n"
+          "              [--max-mqtt-connects N] [--publishes TYPE=MIN[:MAX]]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 2;
+  }
+
+  const char *tracePath = argv[1];
+  unsigned long tailMs = TELEMETRY_INTERVAL_MS * 2;
+  long maxLoopP99 = -1;
+  long maxLoop = -1;
+  long maxMqttConnects = -1;
+  std::vector<PublishLimit> publishLimits;
+
+  for (int i = 2; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if (arg == "--echo") {
+      hostSetSerialEcho(true);
+    } else if (arg == "--tail-ms" && hasValue) {
+      tailMs = strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--max-loop-p99-ms" && hasValue) {
+      maxLoopP99 = strtol(argv[++i], nullptr, 10);
+    } else if (arg == "--max-loop-ms" && hasValue) {
+      maxLoop = strtol(argv[++i], nullptr, 10);
+    } else if (arg == "--max-mqtt-connects" && hasValue) {
+      maxMqttConnects = strtol(argv[++i], nullptr, 10);
+    } else if (arg == "--publishes" && hasValue) {
+      std::string spec = argv[++i];
+      size_t eq = spec.find('=');
+      if (eq == std::string::npos) {
+        usage();
+        return 2;
+      }
+      PublishLimit limit;
+      limit.type = spec.substr(0, eq);
+      std::string range = spec.substr(eq + 1);
+      size_t colon = range.find(':');
+      limit.min = strtol(range.c_str(), nullptr, 10);
+      limit.max = colon == std::string::npos
+                      ? -1
+                      : strtol(range.c_str() + colon + 1, nullptr, 10);
+      publishLimits.push_back(limit);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  if (!loadTrace(tracePath)) {
+    fprintf(stderr, "replay: cannot read %s\n", tracePath);
+    return 2;
+  }
+  // A message recorded cut short would replay a different input
+  size_t truncated = 0;
+  for (const TraceRecord &r : records) {
+    if (r.type == TRACE_MQTT_IN && r.length > r.payloadLen) {
+      if (truncated++ == 0) {
+        fprintf(stderr,
+                "replay: %s at %lu ms: %lu byte message on %s recorded as "
+                "%u\n",
+                tracePath, (unsigned long)r.timeMs, (unsigned long)r.length,
+                r.topic, (unsigned)r.payloadLen);
+      }
+    }
+  }
+  if (truncated > 0) {
+    fprintf(stderr,
+            "replay: %zu message(s) longer than TRACE_MAX_PAYLOAD (%d); "
+            "not replaying\n",
+            truncated, TRACE_MAX_PAYLOAD);
+    return 2;
+  }
+  unsigned long traceEnd = records.empty() ? 0 : records.back().timeMs;
+  unsigned long endMs = traceEnd + tailMs;
+
+  hostClockReset();
+  simNetReset();
+  hostProvisionDevice("mqtt://replay.local:1883");
+  hostSetWifiStatus(WL_CONNECTED);
+  hostSetClockHook(applyInputs);
+  applyInputs(0);
+
+  std::vector<unsigned long> loopVirtualMs;
+  std::vector<double> loopHostUs;
+  bool restarted = false;
+
+  auto wallStart = std::chrono::steady_clock::now();
+  try {
+    setup();
+    while (millis() < endMs) {
+      unsigned long v0 = millis();
+      auto h0 = std::chrono::steady_clock::now();
+      loop();
+      auto h1 = std::chrono::steady_clock::now();
+      loopVirtualMs.push_back(millis() - v0);
+      loopHostUs.push_back(
+          std::chrono::duration<double, std::micro>(h1 - h0).count());
+      if (millis() == v0) {
+        hostClockAdvance(1); // idle loop: one tick of virtual time
+      }
+    }
+  } catch (const HostRestart &) {
+    restarted = true;
+  }
+  double wallMs = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - wallStart)
+                      .count();
+
+  std::map<std::string, long> publishCounts;
+  for (const SimPublish &pub : simNetPublishes()) {
+    publishCounts[simNetTopicType(pub.topic)]++;
+  }
+  SimNetStats net = simNetGetStats();
+
+  std::vector<Check> checks;
+  unsigned long p99 = percentile(loopVirtualMs, 0.99);
+  unsigned long peak = percentile(loopVirtualMs, 1.0);
+  if (maxLoopP99 >= 0) {
+    checks.push_back({"loop p99 <= " + std::to_string(maxLoopP99) + " ms",
+                      (long)p99 <= maxLoopP99});
+  }
+  if (maxLoop >= 0) {
+    checks.push_back({"loop max <= " + std::to_string(maxLoop) + " ms",
+                      (long)peak <= maxLoop});
+  }
+  if (maxMqttConnects >= 0) {
+    checks.push_back(
+        {"mqtt connects <= " + std::to_string(maxMqttConnects),
+         (long)net.mqttConnects <= maxMqttConnects});
+  }
+  for (const PublishLimit &limit : publishLimits) {
+    long n = publishCounts[limit.type];
+    bool ok = n >= limit.min && (limit.max < 0 || n <= limit.max);
+    checks.push_back({limit.type + " publishes in [" +
+                          std::to_string(limit.min) + ", " +
+                          (limit.max < 0 ? "inf" : std::to_string(limit.max)) +
+                          "]",
+                      ok});
+  }
+
+  printf("{\n");
+  printf("  \"trace\": {\"records\": %zu, \"durationMs\": %lu},\n",
+         records.size(), traceEnd);
+  printf("  \"virtualMs\": %lu,\n", millis());
+  printf("  \"wallMs\": %.1f,\n", wallMs);
+  printf("  \"speedup\": %.0f,\n", wallMs > 0 ? millis() / wallMs : 0.0);
+  printf("  \"restarted\": %s,\n", restarted ? "true" : "false");
+  printf("  \"loops\": %zu,\n", loopVirtualMs.size());
+  printf("  \"loopVirtualMs\": {\"p50\": %lu, \"p95\": %lu, \"p99\": %lu, "
+         "\"max\": %lu},\n",
+         percentile(loopVirtualMs, 0.5), percentile(loopVirtualMs, 0.95), p99,
+         peak);
+  printf("  \"loopHostUs\": {\"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f},\n",
+         percentile(loopHostUs, 0.5), percentile(loopHostUs, 0.99),
+         percentile(loopHostUs, 1.0));
+  printf("  \"publishes\": {");
+  bool first = true;
+  for (const auto &kv : publishCounts) {
+    printf("%s\"%s\": %ld", first ? "" : ", ", kv.first.c_str(), kv.second);
+    first = false;
+  }
+  printf("},\n");
+  printf("  \"wifiBegins\": %u,\n", hostWifiBeginCount());
+  printf("  \"mqttConnects\": %u,\n", net.mqttConnects);
+  printf("  \"gpioRisingEdges\": {\"led\": %u, \"alertLed\": %u, "
+         "\"buzzer\": %u},\n",
+         hostPinRisingEdges(LED_PIN), hostPinRisingEdges(ALERT_LED_PIN),
+         hostPinRisingEdges(BUZZER_PIN));
+  printf("  \"checks\": [");
+  bool allOk = true;
+  for (size_t i = 0; i < checks.size(); i++) {
+    printf("%s\n    {\"check\": \"%s\", \"ok\": %s}", i ? "," : "",
+           checks[i].name.c_str(), checks[i].ok ? "true" : "false");
+    allOk = allOk && checks[i].ok;
+  }
+  printf("%s]\n}\n", checks.empty() ? "" : "\n  ");
+
+  return allOk ? 0 : 1;
+}
@@ -0,0 +1,24 @@
+#ifndef HOST_DHT_H
+#define HOST_DHT_H
+
+#include <stdint.h>
+
+#define DHT11 11
+#define DHT22 22
+
+// Returns whatever the runner last set with hostSetSensor()
+class DHT {
+public:
+  DHT(uint8_t pin, uint8_t type) : pin_(pin), type_(type) {}
+  void begin() {}
+  float readTemperature(bool fahrenheit = false, bool force = false);
+  float readHumidity(bool force = false);
+  float computeHeatIndex(float temperature, float humidity,
+                         bool fahrenheit = true);
+
+private:
+  uint8_t pin_;
+  uint8_t type_;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef HOST_HTTPCLIENT_H
+#define HOST_HTTPCLIENT_H
+
+// Host HTTPClient: there is no HTTP server behind the simulated network, so
+// every request fails as if the connection was refused.
+
+#include "Arduino.h"
+#include "WiFi.h"
+
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+
+class HTTPClient {
+public:
+  bool begin(WiFiClient &client, const String &url) {
+    (void)client;
+    (void)url;
+    return true;
+  }
+  void end() {}
+  void addHeader(const String &name, const String &value) {
+    (void)name;
+    (void)value;
+  }
+  void setTimeout(uint16_t timeoutMs) { (void)timeoutMs; }
+  void setReuse(bool reuse) { (void)reuse; }
+  int GET() { return HTTPC_ERROR_CONNECTION_REFUSED; }
+  int POST(const String &payload) {
+    (void)payload;
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  String getString() { return String(); }
+  static String errorToString(int error) {
+    return error == HTTPC_ERROR_CONNECTION_REFUSED
+               ? String("connection refused")
+               : String("unknown error");
+  }
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef HOST_IPADDRESS_H
+#define HOST_IPADDRESS_H
+
+#include "WString.h"
+#include <stdint.h>
+
+class IPAddress {
+public:
+  IPAddress() : bytes_{0, 0, 0, 0} {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes_{a, b, c, d} {}
+
+  uint8_t operator[](int i) const { return bytes_[i]; }
+  uint8_t &operator[](int i) { return bytes_[i]; }
+  bool operator==(const IPAddress &o) const {
+    return bytes_[0] == o.bytes_[0] && bytes_[1] == o.bytes_[1] &&
+           bytes_[2] == o.bytes_[2] && bytes_[3] == o.bytes_[3];
+  }
+
+  String toString() const {
+    return String(bytes_[0]) + "." + String(bytes_[1]) + "." +
+           String(bytes_[2]) + "." + String(bytes_[3]);
+  }
+
+private:
+  uint8_t bytes_[4];
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "Print.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+size_t Print::write(const uint8_t *buf, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buf++);
+  }
+  return n;
+}
+
+size_t Print::write(const char *s) {
+  return s ? write((const uint8_t *)s, strlen(s)) : 0;
+}
+
+size_t Print::print(const char *s) { return write(s); }
+size_t Print::print(const String &s) { return write(s.c_str()); }
+size_t Print::print(char c) { return write((uint8_t)c); }
+size_t Print::print(int v) { return printf("%d", v); }
+size_t Print::print(unsigned int v) { return printf("%u", v); }
+size_t Print::print(long v) { return printf("%ld", v); }
+size_t Print::print(unsigned long v) { return printf("%lu", v); }
+size_t Print::print(double v, int decimals) {
+  return printf("%.*f", decimals, v);
+}
+
+size_t Print::println() { return write("\r\n"); }
+
+size_t Print::printf(const char *format, ...) {
+  char buf[512];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+  if (n <= 0) {
+    return 0;
+  }
+  return write((const uint8_t *)buf, strnlen(buf, sizeof(buf)));
+}
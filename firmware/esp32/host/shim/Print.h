@@ -0,0 +1,34 @@
+#ifndef HOST_PRINT_H
+#define HOST_PRINT_H
+
+#include "WString.h"
+#include <stddef.h>
+#include <stdint.h>
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size);
+  size_t write(const char *s);
+
+  size_t print(const char *s);
+  size_t print(const String &s);
+  size_t print(char c);
+  size_t print(int v);
+  size_t print(unsigned int v);
+  size_t print(long v);
+  size_t print(unsigned long v);
+  size_t print(double v, int decimals = 2);
+
+  size_t println();
+  template <typename T> size_t println(const T &v) {
+    size_t n = print(v);
+    return n + println();
+  }
+
+  size_t printf(const char *format, ...)
+      __attribute__((format(printf, 2, 3)));
+};
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef HOST_STREAM_H
+#define HOST_STREAM_H
+
+#include "Print.h"
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual void flush() {}
+
+  void setTimeout(unsigned long timeoutMs) { timeoutMs_ = timeoutMs; }
+
+protected:
+  unsigned long timeoutMs_ = 1000;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef HOST_UPDATE_H
+#define HOST_UPDATE_H
+
+// Host Update: the "OTA partition" is a byte vector. end() succeeds once
+// exactly the announced size was written; nothing is ever booted.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class UpdateClass {
+public:
+  bool begin(size_t size) {
+    image.clear();
+    expected = size;
+    open = size > 0;
+    return open;
+  }
+  size_t write(uint8_t *data, size_t len) {
+    if (!open || image.size() + len > expected) {
+      return 0;
+    }
+    image.insert(image.end(), data, data + len);
+    return len;
+  }
+  bool end(bool evenIfRemaining = false) {
+    bool ok = open && (evenIfRemaining || image.size() == expected);
+    open = false;
+    return ok;
+  }
+  void abort() {
+    open = false;
+    image.clear();
+  }
+  size_t progress() const { return image.size(); }
+  const char *errorString() const { return open ? "" : "not open"; }
+
+  // Runner side: what was written
+  const std::vector<uint8_t> &hostImage() const { return image; }
+
+private:
+  std::vector<uint8_t> image;
+  size_t expected = 0;
+  bool open = false;
+};
+
+inline UpdateClass Update;
+
+#endif
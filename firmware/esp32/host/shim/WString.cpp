@@ -0,0 +1,135 @@
+#include "WString.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+String::String(int v) : s_(std::to_string(v)) {}
+String::String(unsigned int v) : s_(std::to_string(v)) {}
+String::String(long v) : s_(std::to_string(v)) {}
+String::String(unsigned long v) : s_(std::to_string(v)) {}
+
+String::String(double v, unsigned int decimals) {
+  char buf[48];
+  snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+  s_ = buf;
+}
+
+String &String::operator=(const char *s) {
+  valid_ = s != nullptr;
+  s_ = s ? s : "";
+  return *this;
+}
+
+bool String::reserve(unsigned int size) {
+  s_.reserve(size);
+  return true;
+}
+
+bool String::concat(const String &s) {
+  s_ += s.s_;
+  valid_ = true;
+  return true;
+}
+
+bool String::concat(const char *s) {
+  if (!s) {
+    return false;
+  }
+  s_ += s;
+  valid_ = true;
+  return true;
+}
+
+bool String::concat(const char *s, unsigned int len) {
+  if (!s) {
+    return false;
+  }
+  s_.append(s, len);
+  valid_ = true;
+  return true;
+}
+
+bool String::concat(char c) {
+  s_ += c;
+  valid_ = true;
+  return true;
+}
+
+String &String::operator+=(const String &s) {
+  concat(s);
+  return *this;
+}
+
+String &String::operator+=(const char *s) {
+  concat(s);
+  return *this;
+}
+
+String &String::operator+=(char c) {
+  concat(c);
+  return *this;
+}
+
+bool String::startsWith(const String &prefix) const {
+  return s_.compare(0, prefix.s_.size(), prefix.s_) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return s_.size() >= suffix.s_.size() &&
+         s_.compare(s_.size() - suffix.s_.size(), suffix.s_.size(),
+                    suffix.s_) == 0;
+}
+
+int String::indexOf(char c, unsigned int from) const {
+  size_t pos = s_.find(c, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+int String::indexOf(const String &s, unsigned int from) const {
+  size_t pos = s_.find(s.s_, from);
+  return pos == std::string::npos ? -1 : (int)pos;
+}
+
+String String::substring(unsigned int from) const {
+  return from < s_.size() ? String(s_.substr(from)) : String("");
+}
+
+String String::substring(unsigned int from, unsigned int to) const {
+  if (from > to) {
+    unsigned int tmp = from;
+    from = to;
+    to = tmp;
+  }
+  if (from >= s_.size()) {
+    return String("");
+  }
+  return String(s_.substr(from, to - from));
+}
+
+long String::toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+
+float String::toFloat() const { return strtof(s_.c_str(), nullptr); }
+
+void String::trim() {
+  size_t start = s_.find_first_not_of(" \t\r\n");
+  size_t end = s_.find_last_not_of(" \t\r\n");
+  s_ = start == std::string::npos ? "" : s_.substr(start, end - start + 1);
+}
+
+StringSumHelper operator+(const String &a, const String &b) {
+  StringSumHelper r(a);
+  r.concat(b);
+  return r;
+}
+
+StringSumHelper operator+(const String &a, const char *b) {
+  StringSumHelper r(a);
+  r.concat(b);
+  return r;
+}
+
+StringSumHelper operator+(const char *a, const String &b) {
+  StringSumHelper r(a);
+  r.concat(b);
+  return r;
+}
@@ -0,0 +1,70 @@
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+// Host stand-in for the Arduino String class, backed by std::string. Covers
+// the subset used by the firmware and ArduinoJson's String adapter.
+
+#include <stddef.h>
+#include <string>
+
+class String {
+public:
+  String() {}
+  String(const char *s) : valid_(s != nullptr), s_(s ? s : "") {}
+  String(const std::string &s) : s_(s) {}
+  explicit String(char c) : s_(1, c) {}
+  explicit String(int v);
+  explicit String(unsigned int v);
+  explicit String(long v);
+  explicit String(unsigned long v);
+  explicit String(double v, unsigned int decimals = 2);
+
+  String &operator=(const char *s);
+
+  const char *c_str() const { return s_.c_str(); }
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  bool reserve(unsigned int size);
+  operator bool() const { return valid_; }
+
+  bool concat(const String &s);
+  bool concat(const char *s);
+  bool concat(const char *s, unsigned int len);
+  bool concat(char c);
+  String &operator+=(const String &s);
+  String &operator+=(const char *s);
+  String &operator+=(char c);
+
+  bool equals(const char *s) const { return s && s_ == s; }
+  bool operator==(const String &s) const { return s_ == s.s_; }
+  bool operator==(const char *s) const { return equals(s); }
+  bool operator!=(const String &s) const { return s_ != s.s_; }
+  bool operator!=(const char *s) const { return !equals(s); }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+
+  bool startsWith(const String &prefix) const;
+  bool endsWith(const String &suffix) const;
+  int indexOf(char c, unsigned int from = 0) const;
+  int indexOf(const String &s, unsigned int from = 0) const;
+  String substring(unsigned int from) const;
+  String substring(unsigned int from, unsigned int to) const;
+  long toInt() const;
+  float toFloat() const;
+  void trim();
+
+private:
+  bool valid_ = true;
+  std::string s_;
+};
+
+// Result type of operator+, referenced by ArduinoJson's String adapter
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *s) : String(s) {}
+};
+
+StringSumHelper operator+(const String &a, const String &b);
+StringSumHelper operator+(const String &a, const char *b);
+StringSumHelper operator+(const char *a, const String &b);
+
+#endif
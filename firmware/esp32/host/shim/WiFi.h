@@ -0,0 +1,84 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include "Arduino.h"
+#include "Client.h"
+#include <functional>
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6,
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3,
+} wifi_mode_t;
+
+typedef enum {
+  WIFI_POWER_19_5dBm = 78,
+  WIFI_POWER_11dBm = 44,
+} wifi_power_t;
+
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_START = 2,
+  ARDUINO_EVENT_WIFI_STA_CONNECTED = 4,
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP = 7,
+} arduino_event_id_t;
+typedef arduino_event_id_t WiFiEvent_t;
+
+typedef union {
+  struct {
+    uint8_t reason;
+  } wifi_sta_disconnected;
+} WiFiEventInfo_t;
+
+typedef std::function<void(WiFiEvent_t, WiFiEventInfo_t)> WiFiEventFuncCb;
+
+class WiFiClass {
+public:
+  wl_status_t status();
+  wl_status_t begin(const char *ssid, const char *password = nullptr);
+  bool mode(wifi_mode_t mode);
+  void persistent(bool persistent) { (void)persistent; }
+  bool disconnect(bool wifiOff = false, bool eraseAp = false);
+  bool setHostname(const char *hostname);
+  bool setTxPower(wifi_power_t power);
+  IPAddress localIP();
+  int8_t RSSI();
+  String macAddress();
+  void onEvent(WiFiEventFuncCb cb);
+};
+
+extern WiFiClass WiFi;
+
+// TCP client backed by the simulated network (sim_network.h)
+class WiFiClient : public Client {
+public:
+  int connect(IPAddress ip, uint16_t port) override;
+  int connect(const char *host, uint16_t port) override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buf, size_t size) override;
+  int available() override;
+  int read() override;
+  int read(uint8_t *buf, size_t size) override;
+  int peek() override;
+  void flush() override {}
+  void stop() override;
+  uint8_t connected() override;
+  operator bool() override { return connected(); }
+
+protected:
+  virtual bool isSecure() const { return false; }
+  int handle_ = -1;
+};
+
+#endif
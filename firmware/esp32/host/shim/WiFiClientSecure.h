@@ -0,0 +1,15 @@
+#ifndef HOST_WIFICLIENTSECURE_H
+#define HOST_WIFICLIENTSECURE_H
+
+#include "WiFi.h"
+
+class WiFiClientSecure : public WiFiClient {
+public:
+  void setInsecure() {}
+  void setCACert(const char *rootCA) { (void)rootCA; }
+
+protected:
+  bool isSecure() const override { return true; }
+};
+
+#endif
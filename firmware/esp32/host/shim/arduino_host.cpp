@@ -0,0 +1,343 @@
+#include "Arduino.h"
+#include "DHT.h"
+#include "WiFi.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "sim_network.h"
+#include <string.h>
+
+// ============================================================================
+// VIRTUAL CLOCK
+// ============================================================================
+
+static unsigned long long nowMs = 0;
+static HostClockHook clockHook = nullptr;
+
+void hostClockReset() { nowMs = 0; }
+
+void hostClockAdvance(unsigned long ms) {
+  nowMs += ms;
+  if (clockHook) {
+    clockHook((unsigned long)nowMs);
+  }
+}
+
+void hostSetClockHook(HostClockHook hook) { clockHook = hook; }
+
+unsigned long millis() { return (unsigned long)nowMs; }
+unsigned long micros() { return (unsigned long)(nowMs * 1000); }
+void delay(unsigned long ms) { hostClockAdvance(ms); }
+void delayMicroseconds(unsigned int us) { (void)us; }
+void yield() { hostClockAdvance(1); }
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+#define HOST_PIN_COUNT 40
+
+static uint8_t pinModes[HOST_PIN_COUNT];
+static uint8_t pinOutputs[HOST_PIN_COUNT];
+static int pinInputs[HOST_PIN_COUNT];
+static bool pinInputsSet[HOST_PIN_COUNT];
+static uint32_t risingEdges[HOST_PIN_COUNT];
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < HOST_PIN_COUNT) {
+    pinModes[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+  if (pin >= HOST_PIN_COUNT) {
+    return;
+  }
+  if (level && !pinOutputs[pin]) {
+    risingEdges[pin]++;
+  }
+  pinOutputs[pin] = level ? HIGH : LOW;
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= HOST_PIN_COUNT) {
+    return LOW;
+  }
+  if (pinModes[pin] == OUTPUT) {
+    return pinOutputs[pin];
+  }
+  if (pinInputsSet[pin]) {
+    return pinInputs[pin];
+  }
+  return pinModes[pin] == INPUT_PULLUP ? HIGH : LOW;
+}
+
+void hostSetPinInput(uint8_t pin, int level) {
+  if (pin < HOST_PIN_COUNT) {
+    pinInputs[pin] = level;
+    pinInputsSet[pin] = true;
+  }
+}
+
+int hostGetPinOutput(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? pinOutputs[pin] : LOW;
+}
+
+uint32_t hostPinRisingEdges(uint8_t pin) {
+  return pin < HOST_PIN_COUNT ? risingEdges[pin] : 0;
+}
+
+// ============================================================================
+// SERIAL / ESP
+// ============================================================================
+
+static bool serialEcho = false;
+
+HardwareSerial Serial;
+EspClass ESP;
+
+void hostSetSerialEcho(bool echo) { serialEcho = echo; }
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (serialEcho) {
+    fputc(c, stderr);
+  }
+  return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t size) {
+  if (serialEcho) {
+    fwrite(buf, 1, size, stderr);
+  }
+  return size;
+}
+
+void EspClass::restart() { throw HostRestart(); }
+uint32_t EspClass::getFreeHeap() { return 200 * 1024; }
+uint32_t EspClass::getMinFreeHeap() { return 180 * 1024; }
+uint32_t EspClass::getMaxAllocHeap() { return 110 * 1024; }
+uint64_t EspClass::getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+
+static uint32_t rngState = 0x2545F491;
+
+uint32_t esp_random() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+// ============================================================================
+// RESET REASON & COREDUMP PARTITION
+// ============================================================================
+
+#define HOST_COREDUMP_SIZE 0x10000
+
+static esp_reset_reason_t resetReason = ESP_RST_POWERON;
+static uint8_t coreDump[HOST_COREDUMP_SIZE];
+static bool coreDumpInit = false;
+static const esp_partition_t coreDumpPartition = {
+    ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_COREDUMP, 0x3F0000,
+    HOST_COREDUMP_SIZE, "coredump"};
+
+static void coreDumpErase(size_t offset, size_t size) {
+  memset(coreDump + offset, 0xFF, size);
+  coreDumpInit = true;
+}
+
+void hostSetResetReason(int reason) {
+  resetReason = (esp_reset_reason_t)reason;
+}
+
+void hostSetCoreDump(const uint8_t *data, size_t length) {
+  coreDumpErase(0, HOST_COREDUMP_SIZE);
+  memcpy(coreDump, data, length < HOST_COREDUMP_SIZE ? length
+                                                     : HOST_COREDUMP_SIZE);
+}
+
+bool hostCoreDumpErased() {
+  for (size_t i = 0; coreDumpInit && i < HOST_COREDUMP_SIZE; i++) {
+    if (coreDump[i] != 0xFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+esp_reset_reason_t esp_reset_reason() { return resetReason; }
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type,
+                                                esp_partition_subtype_t subtype,
+                                                const char *label) {
+  (void)label;
+  if (type != ESP_PARTITION_TYPE_DATA ||
+      subtype != ESP_PARTITION_SUBTYPE_DATA_COREDUMP) {
+    return nullptr;
+  }
+  if (!coreDumpInit) {
+    coreDumpErase(0, HOST_COREDUMP_SIZE);
+  }
+  return &coreDumpPartition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition,
+                             size_t srcOffset, void *dst, size_t size) {
+  if (partition != &coreDumpPartition || srcOffset + size > partition->size) {
+    return ESP_FAIL;
+  }
+  memcpy(dst, coreDump + srcOffset, size);
+  return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition,
+                                    size_t offset, size_t size) {
+  if (partition != &coreDumpPartition || offset + size > partition->size) {
+    return ESP_FAIL;
+  }
+  coreDumpErase(offset, size);
+  return ESP_OK;
+}
+
+// ============================================================================
+// WIFI
+// ============================================================================
+
+static int wifiStatus = WL_DISCONNECTED;
+static uint32_t wifiBeginCount = 0;
+static WiFiEventFuncCb wifiEventCb;
+
+WiFiClass WiFi;
+
+void hostSetWifiStatus(int status) {
+  if (status == wifiStatus) {
+    return;
+  }
+  int previous = wifiStatus;
+  wifiStatus = status;
+  if (previous == WL_CONNECTED) {
+    simNetWifiLost();
+  }
+  if (!wifiEventCb) {
+    return;
+  }
+  WiFiEventInfo_t info = {};
+  if (status == WL_CONNECTED) {
+    wifiEventCb(ARDUINO_EVENT_WIFI_STA_CONNECTED, info);
+    wifiEventCb(ARDUINO_EVENT_WIFI_STA_GOT_IP, info);
+  } else if (previous == WL_CONNECTED) {
+    info.wifi_sta_disconnected.reason = 8; // ASSOC_LEAVE
+    wifiEventCb(ARDUINO_EVENT_WIFI_STA_DISCONNECTED, info);
+  }
+}
+
+int hostGetWifiStatus() { return wifiStatus; }
+uint32_t hostWifiBeginCount() { return wifiBeginCount; }
+
+wl_status_t WiFiClass::status() { return (wl_status_t)wifiStatus; }
+
+// Association itself is up to the runner; begin() only counts attempts
+wl_status_t WiFiClass::begin(const char *ssid, const char *password) {
+  (void)ssid;
+  (void)password;
+  wifiBeginCount++;
+  return (wl_status_t)wifiStatus;
+}
+
+bool WiFiClass::mode(wifi_mode_t mode) {
+  (void)mode;
+  return true;
+}
+
+bool WiFiClass::disconnect(bool wifiOff, bool eraseAp) {
+  (void)wifiOff;
+  (void)eraseAp;
+  return true;
+}
+
+bool WiFiClass::setHostname(const char *hostname) {
+  (void)hostname;
+  return true;
+}
+
+bool WiFiClass::setTxPower(wifi_power_t power) {
+  (void)power;
+  return true;
+}
+
+IPAddress WiFiClass::localIP() {
+  return wifiStatus == WL_CONNECTED ? IPAddress(192, 168, 1, 50)
+                                    : IPAddress();
+}
+
+int8_t WiFiClass::RSSI() { return wifiStatus == WL_CONNECTED ? -58 : 0; }
+
+String WiFiClass::macAddress() { return String("A1:B2:C3:D4:E5:F6"); }
+
+void WiFiClass::onEvent(WiFiEventFuncCb cb) { wifiEventCb = cb; }
+
+// ============================================================================
+// WIFI CLIENT
+// ============================================================================
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  handle_ = simNetConnect(host, port, isSecure());
+  return handle_ >= 0 ? 1 : 0;
+}
+
+size_t WiFiClient::write(uint8_t c) { return write(&c, 1); }
+
+size_t WiFiClient::write(const uint8_t *buf, size_t size) {
+  return simNetWrite(handle_, buf, size);
+}
+
+int WiFiClient::available() { return simNetAvailable(handle_); }
+
+int WiFiClient::read() {
+  uint8_t c;
+  return simNetRead(handle_, &c, 1) == 1 ? c : -1;
+}
+
+int WiFiClient::read(uint8_t *buf, size_t size) {
+  return simNetRead(handle_, buf, size);
+}
+
+int WiFiClient::peek() { return simNetPeek(handle_); }
+
+void WiFiClient::stop() {
+  simNetClose(handle_);
+  handle_ = -1;
+}
+
+uint8_t WiFiClient::connected() { return simNetConnected(handle_) ? 1 : 0; }
+
+// ============================================================================
+// DHT
+// ============================================================================
+
+static float sensorTemperature = NAN;
+static float sensorHumidity = NAN;
+
+void hostSetSensor(float temperature, float humidity) {
+  sensorTemperature = temperature;
+  sensorHumidity = humidity;
+}
+
+float DHT::readTemperature(bool fahrenheit, bool force) {
+  (void)force;
+  return fahrenheit ? sensorTemperature * 9 / 5 + 32 : sensorTemperature;
+}
+
+float DHT::readHumidity(bool force) {
+  (void)force;
+  return sensorHumidity;
+}
+
+float DHT::computeHeatIndex(float temperature, float humidity,
+                            bool fahrenheit) {
+  (void)humidity;
+  (void)fahrenheit;
+  return temperature;
+}
@@ -0,0 +1,15 @@
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+typedef enum {
+  WIFI_PS_NONE,
+  WIFI_PS_MIN_MODEM,
+  WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+inline int esp_wifi_set_ps(wifi_ps_type_t type) {
+  (void)type;
+  return 0;
+}
+
+#endif
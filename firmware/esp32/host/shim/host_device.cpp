@@ -0,0 +1,37 @@
+#include "host_device.h"
+#include "provisioning.h"
+#include "storage.h"
+#include "topics.h"
+
+// The SoftAP portal needs a real radio; host runs start from an already
+// provisioned NVS and treat provisioning as a dead end.
+
+static bool active = false;
+
+void provisioningStart(ProvisioningCompleteCallback callback) {
+  (void)callback;
+  active = true;
+}
+
+void provisioningStop() { active = false; }
+
+bool provisioningIsActive() { return active; }
+
+String provisioningGetAPName() { return String("ThingBase-HOST"); }
+
+void hostProvisionDevice(const char *broker) {
+  char telemetry[128], commands[128], ack[128], status[128];
+  topicBuild(telemetry, sizeof(telemetry), HOST_TENANT_ID, HOST_DEVICE_ID,
+             "telemetry");
+  topicBuild(commands, sizeof(commands), HOST_TENANT_ID, HOST_DEVICE_ID,
+             "command");
+  topicBuild(ack, sizeof(ack), HOST_TENANT_ID, HOST_DEVICE_ID, "ack");
+  topicBuild(status, sizeof(status), HOST_TENANT_ID, HOST_DEVICE_ID,
+             "status");
+
+  storageInit();
+  storageSaveWifi("host-ssid", "host-password");
+  storageSaveMqtt(broker, HOST_DEVICE_ID, HOST_DEVICE_ID, "host-secret",
+                  telemetry, commands, ack, status, HOST_TENANT_ID,
+                  HOST_DEVICE_ID);
+}
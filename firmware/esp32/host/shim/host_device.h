@@ -0,0 +1,12 @@
+#ifndef HOST_DEVICE_H
+#define HOST_DEVICE_H
+
+// Identity used for host runs; topics follow the platform layout
+#define HOST_TENANT_ID "tenant-host"
+#define HOST_DEVICE_ID "device-host"
+
+// Seed NVS as if the device had been claimed, so setup() goes straight to
+// WiFi + MQTT
+void hostProvisionDevice(const char *broker);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef HOST_ENV_H
+#define HOST_ENV_H
+
+// Control surface for host runners: virtual clock, pin inputs, WiFi status
+// and sensor values. Firmware code never includes this directly.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Thrown by ESP.restart(); runners catch it to end a scenario
+struct HostRestart {};
+
+// Virtual clock; the hook runs after every advance so runners can apply
+// scheduled inputs while the firmware is blocked in delay()
+typedef void (*HostClockHook)(unsigned long nowMs);
+void hostClockReset();
+void hostClockAdvance(unsigned long ms);
+void hostSetClockHook(HostClockHook hook);
+
+// GPIO
+void hostSetPinInput(uint8_t pin, int level);
+int hostGetPinOutput(uint8_t pin);
+uint32_t hostPinRisingEdges(uint8_t pin);
+
+// Radio and sensor
+void hostSetWifiStatus(int status);
+int hostGetWifiStatus();
+uint32_t hostWifiBeginCount();
+void hostSetSensor(float temperature, float humidity);
+
+// Why the "previous boot" ended, and what the panic handler left in the
+// coredump partition; the partition stays as the firmware leaves it
+void hostSetResetReason(int reason);
+void hostSetCoreDump(const uint8_t *data, size_t length);
+bool hostCoreDumpErased();
+
+// Serial output goes to stderr only when echo is on
+void hostSetSerialEcho(bool echo);
+
+#endif
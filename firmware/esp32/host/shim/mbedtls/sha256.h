@@ -0,0 +1,24 @@
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+// Portable SHA-256 behind the subset of the mbedTLS 3.x API the firmware
+// uses (sha256_host.cpp); SHA-224 is not supported
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct mbedtls_sha256_context {
+  uint32_t state[8];
+  uint64_t length; // bytes hashed so far
+  uint8_t block[64];
+};
+
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx,
+                          const unsigned char *input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx,
+                          unsigned char output[32]);
+
+#endif
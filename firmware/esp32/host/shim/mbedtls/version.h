@@ -0,0 +1,7 @@
+#ifndef HOST_MBEDTLS_VERSION_H
+#define HOST_MBEDTLS_VERSION_H
+
+// The host SHA-256 follows the mbedTLS 3.x API
+#define MBEDTLS_VERSION_NUMBER 0x03000000
+
+#endif
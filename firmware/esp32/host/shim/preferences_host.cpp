@@ -0,0 +1,107 @@
+#include "Preferences.h"
+#include <map>
+#include <string.h>
+#include <string>
+
+static std::map<std::string, std::map<std::string, std::string>> store;
+
+void hostPreferencesReset() { store.clear(); }
+
+static std::map<std::string, std::string> &ns(const String &name) {
+  return store[name.c_str()];
+}
+
+bool Preferences::begin(const char *name, bool readOnly) {
+  (void)readOnly;
+  ns_ = name;
+  ns(ns_);
+  return true;
+}
+
+bool Preferences::clear() {
+  ns(ns_).clear();
+  return true;
+}
+
+bool Preferences::remove(const char *key) { return ns(ns_).erase(key) > 0; }
+
+bool Preferences::isKey(const char *key) { return ns(ns_).count(key) > 0; }
+
+size_t Preferences::putString(const char *key, const char *value) {
+  ns(ns_)[key] = value ? value : "";
+  return value ? strlen(value) : 0;
+}
+
+size_t Preferences::putString(const char *key, const String &value) {
+  return putString(key, value.c_str());
+}
+
+String Preferences::getString(const char *key, const String &defaultValue) {
+  auto &kv = ns(ns_);
+  auto it = kv.find(key);
+  return it == kv.end() ? defaultValue : String(it->second.c_str());
+}
+
+size_t Preferences::putBytes(const char *key, const void *value, size_t len) {
+  ns(ns_)[key] = std::string((const char *)value, len);
+  return len;
+}
+
+size_t Preferences::getBytes(const char *key, void *buf, size_t maxLen) {
+  auto &kv = ns(ns_);
+  auto it = kv.find(key);
+  if (it == kv.end() || it->second.size() > maxLen) {
+    return 0;
+  }
+  memcpy(buf, it->second.data(), it->second.size());
+  return it->second.size();
+}
+
+size_t Preferences::getBytesLength(const char *key) {
+  auto &kv = ns(ns_);
+  auto it = kv.find(key);
+  return it == kv.end() ? 0 : it->second.size();
+}
+
+template <typename T>
+static size_t putValue(Preferences &p, const char *key, T v) {
+  return p.putBytes(key, &v, sizeof(v));
+}
+
+template <typename T>
+static T getValue(Preferences &p, const char *key, T defaultValue) {
+  T v;
+  return p.getBytes(key, &v, sizeof(v)) == sizeof(v) ? v : defaultValue;
+}
+
+size_t Preferences::putBool(const char *key, bool value) {
+  return putValue<uint8_t>(*this, key, value ? 1 : 0);
+}
+
+bool Preferences::getBool(const char *key, bool defaultValue) {
+  return getValue<uint8_t>(*this, key, defaultValue ? 1 : 0) != 0;
+}
+
+size_t Preferences::putUChar(const char *key, uint8_t value) {
+  return putValue(*this, key, value);
+}
+
+uint8_t Preferences::getUChar(const char *key, uint8_t defaultValue) {
+  return getValue(*this, key, defaultValue);
+}
+
+size_t Preferences::putUInt(const char *key, uint32_t value) {
+  return putValue(*this, key, value);
+}
+
+uint32_t Preferences::getUInt(const char *key, uint32_t defaultValue) {
+  return getValue(*this, key, defaultValue);
+}
+
+size_t Preferences::putULong64(const char *key, uint64_t value) {
+  return putValue(*this, key, value);
+}
+
+uint64_t Preferences::getULong64(const char *key, uint64_t defaultValue) {
+  return getValue(*this, key, defaultValue);
+}
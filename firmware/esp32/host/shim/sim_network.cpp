@@ -0,0 +1,529 @@
+#include "sim_network.h"
+#include "Arduino.h"
+#include <deque>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+// Bytes in flight on one direction of the link
+struct Segment {
+  unsigned long deliverAt;
+  std::vector<uint8_t> data;
+};
+
+struct Link {
+  std::deque<Segment> segments;
+  size_t queuedBytes;
+  unsigned long freeAt;      // end of the last segment's serialisation
+  unsigned long lastDeliver; // TCP delivers in order
+};
+
+static int nextHandle = 1;
+static int openHandle = -1;
+static bool sessionUp = false;
+static bool halfOpen = false;
+static bool secureSession = false; // every write() becomes a TLS record
+static Link uplink;   // device -> broker
+static Link downlink; // broker -> device
+static std::vector<uint8_t> fromDevice;
+static std::deque<uint8_t> toDevice;
+static std::vector<SimPublish> publishes;
+static std::vector<SimNetEvent> events;
+static SimNetStats stats;
+static SimNetFaults faults;
+static uint32_t rngState = 1;
+static unsigned long lastEmptyPollMs = 0;
+static bool lastPollEmpty = false;
+
+// Device-side view of the byte stream, to count packets as they are written
+static size_t writtenPacketRemaining = 0;
+static size_t writtenLengthMultiplier = 0; // non-zero while reading length
+
+static void recordEvent(SimNetEventType type) {
+  events.push_back({millis(), type});
+}
+
+static uint32_t nextRandom() {
+  // xorshift32: deterministic per seed, good enough for fault dice
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+// ============================================================================
+// LINK
+// ============================================================================
+
+static unsigned long serialisationMs(size_t len) {
+  if (faults.bandwidthBps == 0) {
+    return 0;
+  }
+  return (len * 1000 + faults.bandwidthBps - 1) / faults.bandwidthBps;
+}
+
+static void linkReset(Link &link) {
+  link.segments.clear();
+  link.queuedBytes = 0;
+  link.freeAt = 0;
+  link.lastDeliver = 0;
+}
+
+// recordOverhead: TLS framing around this write, on the wire but not in buf
+static size_t linkSend(Link &link, const uint8_t *buf, size_t len,
+                       size_t recordOverhead) {
+  size_t segments = 0;
+  for (size_t offset = 0; offset < len; offset += SIM_TCP_MSS) {
+    size_t chunk = len - offset < SIM_TCP_MSS ? len - offset : SIM_TCP_MSS;
+    size_t wire = chunk + (offset == 0 ? recordOverhead : 0);
+    unsigned long now = millis();
+    unsigned long start = link.freeAt > now ? link.freeAt : now;
+    link.freeAt = start + serialisationMs(wire);
+    segments++;
+
+    unsigned long at = link.freeAt + faults.latencyMs;
+    if (faults.jitterMs > 0) {
+      at += nextRandom() % (faults.jitterMs + 1);
+    }
+    // A lost segment arrives after one or more retransmission timeouts
+    unsigned long rto = SIM_TCP_RTO_MS + 2 * faults.latencyMs;
+    while (faults.lossPercent > 0 &&
+           nextRandom() % 100 < faults.lossPercent && rto < 60000) {
+      at += rto;
+      rto *= 2;
+      stats.retransmits++;
+    }
+    if (at < link.lastDeliver) {
+      at = link.lastDeliver;
+    }
+    link.lastDeliver = at;
+
+    Segment segment;
+    segment.deliverAt = at;
+    segment.data.assign(buf + offset, buf + offset + chunk);
+    link.segments.push_back(segment);
+    link.queuedBytes += chunk;
+  }
+  return segments;
+}
+
+// Everything still in flight is gone with the connection
+static void linkDrop(Link &link) {
+  stats.bytesLost += link.queuedBytes;
+  link.segments.clear();
+  link.queuedBytes = 0;
+}
+
+static void parseFromDevice();
+
+static void pumpLinks() {
+  if (halfOpen) {
+    return;
+  }
+  unsigned long now = millis();
+  while (!uplink.segments.empty() &&
+         uplink.segments.front().deliverAt <= now) {
+    Segment segment = uplink.segments.front();
+    uplink.segments.pop_front();
+    uplink.queuedBytes -= segment.data.size();
+    fromDevice.insert(fromDevice.end(), segment.data.begin(),
+                      segment.data.end());
+    parseFromDevice();
+  }
+  while (!downlink.segments.empty() &&
+         downlink.segments.front().deliverAt <= now) {
+    Segment &segment = downlink.segments.front();
+    toDevice.insert(toDevice.end(), segment.data.begin(), segment.data.end());
+    downlink.queuedBytes -= segment.data.size();
+    downlink.segments.pop_front();
+  }
+}
+
+// ============================================================================
+// MQTT PACKETS
+// ============================================================================
+
+static void sendToDevice(const uint8_t *buf, size_t len) {
+  stats.bytesToDevice += len;
+  if (halfOpen) {
+    stats.bytesLost += len;
+    return;
+  }
+  linkSend(downlink, buf, len, 0);
+}
+
+static void appendRemainingLength(std::vector<uint8_t> &out, size_t len) {
+  do {
+    uint8_t digit = len % 128;
+    len /= 128;
+    if (len > 0) {
+      digit |= 0x80;
+    }
+    out.push_back(digit);
+  } while (len > 0);
+}
+
+static void handlePacket(uint8_t header, const uint8_t *body, size_t len) {
+  switch (header & 0xF0) {
+  case 0x10: { // CONNECT
+    stats.mqttConnects++;
+    if (faults.connackRc != 0) {
+      stats.mqttRejects++;
+      const uint8_t connack[] = {0x20, 0x02, 0x00, faults.connackRc};
+      sendToDevice(connack, sizeof(connack));
+      break;
+    }
+    sessionUp = true;
+    recordEvent(SIM_SESSION_UP);
+    const uint8_t connack[] = {0x20, 0x02, 0x00, 0x00};
+    sendToDevice(connack, sizeof(connack));
+    break;
+  }
+  case 0x30: { // PUBLISH
+    if (len < 2) {
+      return;
+    }
+    size_t topicLen = (body[0] << 8) | body[1];
+    if (2 + topicLen > len) {
+      return;
+    }
+    size_t offset = 2 + topicLen;
+    uint8_t qos = (header >> 1) & 0x03;
+    if (qos > 0 && offset + 2 <= len) {
+      const uint8_t puback[] = {0x40, 0x02, body[offset], body[offset + 1]};
+      sendToDevice(puback, sizeof(puback));
+      offset += 2;
+    }
+    SimPublish pub;
+    pub.timeMs = millis();
+    pub.topic.assign((const char *)body + 2, topicLen);
+    pub.payload.assign((const char *)body + offset, len - offset);
+    pub.retained = header & 0x01;
+    publishes.push_back(pub);
+    break;
+  }
+  case 0x80: { // SUBSCRIBE
+    if (len < 2) {
+      return;
+    }
+    const uint8_t suback[] = {0x90, 0x03, body[0], body[1], 0x00};
+    sendToDevice(suback, sizeof(suback));
+    break;
+  }
+  case 0xC0: { // PINGREQ
+    const uint8_t pingresp[] = {0xD0, 0x00};
+    sendToDevice(pingresp, sizeof(pingresp));
+    break;
+  }
+  case 0xE0: // DISCONNECT
+    sessionUp = false;
+    break;
+  default:
+    break;
+  }
+}
+
+static void parseFromDevice() {
+  for (;;) {
+    if (fromDevice.size() < 2) {
+      return;
+    }
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    size_t pos = 1;
+    for (;;) {
+      if (pos >= fromDevice.size()) {
+        return; // length not complete yet
+      }
+      uint8_t digit = fromDevice[pos++];
+      remaining += (digit & 0x7F) * multiplier;
+      multiplier *= 128;
+      if (!(digit & 0x80)) {
+        break;
+      }
+    }
+    if (fromDevice.size() < pos + remaining) {
+      return;
+    }
+    handlePacket(fromDevice[0], fromDevice.data() + pos, remaining);
+    fromDevice.erase(fromDevice.begin(), fromDevice.begin() + pos + remaining);
+  }
+}
+
+// Counts PUBLISH packets as the device writes them, however the client
+// splits a packet across write() calls
+static void countWrittenPackets(const uint8_t *buf, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    if (writtenLengthMultiplier > 0) {
+      writtenPacketRemaining += (buf[i] & 0x7F) * writtenLengthMultiplier;
+      writtenLengthMultiplier =
+          buf[i] & 0x80 ? writtenLengthMultiplier * 128 : 0;
+    } else if (writtenPacketRemaining > 0) {
+      size_t skip = len - i < writtenPacketRemaining ? len - i
+                                                      : writtenPacketRemaining;
+      writtenPacketRemaining -= skip;
+      i += skip - 1;
+    } else {
+      writtenLengthMultiplier = 1;
+      stats.packetsWritten++;
+      if ((buf[i] & 0xF0) == 0x30) {
+        stats.publishesWritten++;
+      }
+    }
+  }
+}
+
+// ============================================================================
+// CLIENT SIDE
+// ============================================================================
+
+static void resetConnection() {
+  sessionUp = false;
+  halfOpen = false;
+  fromDevice.clear();
+  toDevice.clear();
+  linkReset(uplink);
+  linkReset(downlink);
+  writtenPacketRemaining = 0;
+  writtenLengthMultiplier = 0;
+}
+
+void simNetReset() {
+  openHandle = -1;
+  resetConnection();
+  publishes.clear();
+  events.clear();
+  stats = SimNetStats();
+  faults = SimNetFaults();
+  rngState = 1;
+  lastPollEmpty = false;
+}
+
+static bool isIpLiteral(const char *host) {
+  for (const char *p = host; *p; p++) {
+    if (!isdigit((unsigned char)*p) && *p != '.') {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int connectFailed(unsigned long blockedMs) {
+  hostClockAdvance(blockedMs);
+  stats.connectFailures++;
+  return -1;
+}
+
+// Blocks in virtual time like the real WiFiClient::connect()
+int simNetConnect(const char *host, uint16_t port, bool secure) {
+  (void)port;
+  if (hostGetWifiStatus() != 3) { // WL_CONNECTED
+    return connectFailed(0);
+  }
+  unsigned long rtt = 2 * faults.latencyMs;
+  if (!isIpLiteral(host) && faults.dnsFail) {
+    return connectFailed(rtt);
+  }
+  if (faults.blackhole || rtt >= SIM_CONNECT_TIMEOUT_MS) {
+    return connectFailed(SIM_CONNECT_TIMEOUT_MS);
+  }
+  if (faults.brokerDown) {
+    return connectFailed(rtt);
+  }
+
+  if (openHandle >= 0) {
+    simNetClose(openHandle);
+  }
+  hostClockAdvance(rtt); // SYN / SYN-ACK
+  if (secure) {
+    // ClientHello..Finished: two more round trips plus the certificate chain
+    hostClockAdvance(2 * rtt + serialisationMs(SIM_TLS_HANDSHAKE_BYTES));
+  }
+  openHandle = nextHandle++;
+  resetConnection();
+  secureSession = secure;
+  stats.connects++;
+  return openHandle;
+}
+
+void simNetClose(int handle) {
+  if (handle < 0 || handle != openHandle) {
+    return;
+  }
+  bool linkUp = !halfOpen && hostGetWifiStatus() == 3;
+  if (linkUp) {
+    // Graceful close: whatever was written still reaches the broker
+    for (Segment &segment : uplink.segments) {
+      fromDevice.insert(fromDevice.end(), segment.data.begin(),
+                        segment.data.end());
+    }
+    uplink.segments.clear();
+    uplink.queuedBytes = 0;
+    parseFromDevice();
+  } else {
+    linkDrop(uplink);
+  }
+  linkDrop(downlink);
+  recordEvent(SIM_SOCKET_CLOSED);
+  openHandle = -1;
+  resetConnection();
+}
+
+bool simNetConnected(int handle) {
+  if (handle < 0 || handle != openHandle) {
+    return false;
+  }
+  // A dropped radio takes the TCP session with it
+  if (hostGetWifiStatus() != 3) {
+    recordEvent(SIM_SESSION_LOST);
+    simNetClose(handle);
+    return false;
+  }
+  pumpLinks();
+  return true;
+}
+
+size_t simNetWrite(int handle, const uint8_t *buf, size_t len) {
+  if (!simNetConnected(handle)) {
+    return 0;
+  }
+  stats.writeCalls++;
+
+  // Full send buffer: block until the link drains or the write times out
+  unsigned long start = millis();
+  while (uplink.queuedBytes + len > SIM_TCP_SND_BUF) {
+    if (millis() - start >= SIM_WRITE_TIMEOUT_MS) {
+      return 0;
+    }
+    hostClockAdvance(1);
+    if (!simNetConnected(handle)) {
+      return 0;
+    }
+  }
+
+  stats.bytesFromDevice += len;
+  countWrittenPackets(buf, len);
+  size_t recordOverhead = 0;
+  if (secureSession) {
+    stats.tlsRecords++;
+    recordOverhead = SIM_TLS_RECORD_OVERHEAD;
+  }
+  size_t segments = linkSend(uplink, buf, len, recordOverhead);
+  stats.segmentsFromDevice += segments;
+  stats.wireBytesFromDevice +=
+      len + recordOverhead + segments * SIM_TCP_IP_OVERHEAD;
+  pumpLinks();
+  return len;
+}
+
+int simNetAvailable(int handle) {
+  if (!simNetConnected(handle)) {
+    return 0;
+  }
+  if (!toDevice.empty()) {
+    lastPollEmpty = false;
+    return (int)toDevice.size();
+  }
+  // Busy-wait loops (PubSubClient waiting for CONNACK) must see time pass
+  unsigned long now = millis();
+  if (lastPollEmpty && lastEmptyPollMs == now) {
+    hostClockAdvance(1);
+  }
+  lastPollEmpty = true;
+  lastEmptyPollMs = millis();
+  return 0;
+}
+
+int simNetRead(int handle, uint8_t *buf, size_t len) {
+  if (!simNetConnected(handle) || toDevice.empty()) {
+    return -1;
+  }
+  size_t n = 0;
+  while (n < len && !toDevice.empty()) {
+    buf[n++] = toDevice.front();
+    toDevice.pop_front();
+  }
+  return (int)n;
+}
+
+int simNetPeek(int handle) {
+  if (!simNetConnected(handle) || toDevice.empty()) {
+    return -1;
+  }
+  return toDevice.front();
+}
+
+// ============================================================================
+// RUNNER SIDE
+// ============================================================================
+
+void simNetInject(const char *topic, const uint8_t *payload, size_t len) {
+  if (openHandle < 0 || !sessionUp) {
+    return; // QoS 0: nobody connected, message is lost
+  }
+  size_t topicLen = strlen(topic);
+  std::vector<uint8_t> packet;
+  packet.push_back(0x30);
+  appendRemainingLength(packet, 2 + topicLen + len);
+  packet.push_back((uint8_t)(topicLen >> 8));
+  packet.push_back((uint8_t)(topicLen & 0xFF));
+  packet.insert(packet.end(), topic, topic + topicLen);
+  packet.insert(packet.end(), payload, payload + len);
+  sendToDevice(packet.data(), packet.size());
+}
+
+void simNetPoll() {
+  if (openHandle >= 0) {
+    pumpLinks();
+  }
+}
+
+// RST from the far end: the device sees the socket closed on its next call
+void simNetDropConnection() {
+  if (openHandle < 0) {
+    return;
+  }
+  recordEvent(SIM_SESSION_LOST);
+  linkDrop(uplink);
+  linkDrop(downlink);
+  openHandle = -1;
+  resetConnection();
+}
+
+// Losing the IP aborts every TCP connection bound to it
+void simNetWifiLost() { simNetDropConnection(); }
+
+const std::vector<SimPublish> &simNetPublishes() { return publishes; }
+
+SimNetStats simNetGetStats() { return stats; }
+
+// ============================================================================
+// FAULT INJECTION
+// ============================================================================
+
+void simNetSetFaults(const SimNetFaults &newFaults) { faults = newFaults; }
+
+SimNetFaults simNetGetFaults() { return faults; }
+
+void simNetSeed(uint32_t seed) { rngState = seed ? seed : 1; }
+
+void simNetHalfOpen() {
+  if (openHandle < 0 || halfOpen) {
+    return;
+  }
+  recordEvent(SIM_SESSION_LOST);
+  halfOpen = true;
+  // Unacknowledged uplink data stays queued so the send buffer fills up;
+  // it is counted as lost when the device finally closes the socket
+  linkDrop(downlink);
+}
+
+bool simNetSessionUp() { return openHandle >= 0 && sessionUp && !halfOpen; }
+
+const std::vector<SimNetEvent> &simNetEvents() { return events; }
+
+std::string simNetTopicType(const std::string &topic) {
+  size_t slash = topic.rfind('/');
+  return slash == std::string::npos ? topic : topic.substr(slash + 1);
+}
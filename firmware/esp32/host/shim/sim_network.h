@@ -0,0 +1,107 @@
+#ifndef HOST_SIM_NETWORK_H
+#define HOST_SIM_NETWORK_H
+
+// Simulated network behind WiFiClient: an in-process MQTT 3.1.1 broker that
+// answers CONNECT/SUBSCRIBE/PINGREQ, logs device publishes and lets runners
+// inject inbound messages. The link between device and broker can be
+// impaired (latency, bandwidth, loss, half-open TCP, DNS and broker faults).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct SimPublish {
+  unsigned long timeMs;
+  std::string topic;
+  std::string payload;
+  bool retained;
+};
+
+struct SimNetStats {
+  uint32_t connects;         // TCP connects that succeeded
+  uint32_t connectFailures;  // DNS, refused, timed out or WiFi down
+  uint32_t mqttConnects;     // CONNECT packets seen by the broker
+  uint32_t mqttRejects;      // CONNECTs answered with a non-zero return code
+  uint32_t writeCalls;       // Client::write() calls from the device
+  uint32_t packetsWritten;   // MQTT packets of any type handed to the socket
+  uint32_t publishesWritten; // PUBLISH packets handed to the socket
+  uint32_t tlsRecords;       // one per write() on a TLS connection
+  uint32_t segmentsFromDevice;
+  uint32_t retransmits;      // segments delayed by simulated loss
+  uint64_t bytesFromDevice;
+  uint64_t wireBytesFromDevice; // plus TLS record and TCP/IP headers
+  uint64_t bytesToDevice;
+  uint64_t bytesLost; // in flight when the connection died
+};
+
+// Link and broker impairments; a zero-initialised struct is a clean network
+struct SimNetFaults {
+  uint32_t latencyMs;    // one-way delay per direction
+  uint32_t jitterMs;     // extra uniform 0..jitterMs per segment
+  uint32_t bandwidthBps; // bytes/s per direction, 0 = unlimited
+  uint8_t lossPercent;   // segments that need a retransmission
+  bool dnsFail;          // broker hostname does not resolve
+  bool brokerDown;       // TCP connect refused (RST)
+  bool blackhole;        // SYNs vanish: connect() blocks until timeout
+  uint8_t connackRc;     // broker rejects CONNECT with this code (0 = accept)
+};
+
+#define SIM_CONNECT_TIMEOUT_MS 3000  // arduino-esp32 WiFiClient default
+#define SIM_WRITE_TIMEOUT_MS 10000   // select() retries in WiFiClient::write
+#define SIM_TCP_SND_BUF 5744         // lwIP TCP_SND_BUF on ESP32
+#define SIM_TCP_MSS 1436
+#define SIM_TCP_RTO_MS 250           // first retransmission timeout
+#define SIM_TLS_HANDSHAKE_BYTES 4096 // server hello + certificate chain
+#define SIM_TLS_RECORD_OVERHEAD 29   // header 5 + AES-GCM nonce 8 + tag 16
+#define SIM_TCP_IP_OVERHEAD 40       // IPv4 + TCP headers per segment
+
+enum SimNetEventType {
+  SIM_SESSION_UP,   // broker accepted CONNECT
+  SIM_SESSION_LOST, // link died under an open connection
+  SIM_SOCKET_CLOSED // device closed its socket
+};
+
+struct SimNetEvent {
+  unsigned long timeMs;
+  SimNetEventType type;
+};
+
+void simNetReset();
+
+// Client side (used by WiFiClient)
+int simNetConnect(const char *host, uint16_t port, bool secure);
+void simNetClose(int handle);
+bool simNetConnected(int handle);
+size_t simNetWrite(int handle, const uint8_t *buf, size_t len);
+int simNetAvailable(int handle);
+int simNetRead(int handle, uint8_t *buf, size_t len);
+int simNetPeek(int handle);
+
+// Radio side (called by the WiFi shim when the station loses its IP)
+void simNetWifiLost();
+
+// Runner side
+void simNetInject(const char *topic, const uint8_t *payload, size_t len);
+// Delivers segments that are due. The device's socket calls do this; a
+// runner calls it while the device sits in delay() and TCP would still be
+// moving data.
+void simNetPoll();
+void simNetDropConnection();
+const std::vector<SimPublish> &simNetPublishes();
+SimNetStats simNetGetStats();
+
+// Fault injection
+void simNetSetFaults(const SimNetFaults &faults);
+SimNetFaults simNetGetFaults();
+void simNetSeed(uint32_t seed);
+// The open connection silently stops carrying data in both directions while
+// the device still sees it as connected
+void simNetHalfOpen();
+bool simNetSessionUp();
+const std::vector<SimNetEvent> &simNetEvents();
+
+// Last path segment of a topic ("iot/t/devices/d/telemetry" -> "telemetry")
+std::string simNetTopicType(const std::string &topic);
+
+#endif
@@ -0,0 +1,135 @@
+// Seqlock stress runner: one writer thread publishes DeviceState values
+// whose fields are all derived from a counter, N reader threads check every
+// snapshot they get is one of those values and that versions never go back.
+// Build with -fsanitize=thread (env:native-stress) to have TSan watch it.
+//
+//   .pio/build/native-stress/program [--readers N] [--writes N]
+
+#include "device_state.h"
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+struct ReaderResult {
+  uint64_t reads;
+  uint64_t retries;
+  uint64_t torn;
+  uint64_t backwards;
+};
+
+static std::atomic<bool> writerDone(false);
+
+// Every field is a function of n, so a mix of two writes is detectable
+static DeviceState stateFor(uint32_t n) {
+  DeviceState state = {};
+  state.temperatureCenti = (int16_t)(n & 0xFFFF);
+  state.humidityCenti = (int16_t)((n * 7) & 0xFFFF);
+  state.derived.dewPointCenti = (int16_t)((n * 3) & 0xFFFF);
+  state.derived.absoluteHumidityCenti = (int16_t)((n * 5) & 0xFFFF);
+  state.derived.heatIndexCenti = (int16_t)((n * 11) & 0xFFFF);
+  state.sampleMs = n;
+  state.sensorConnected = (n & 1) != 0;
+  state.alert = (n & 2) != 0;
+  return state;
+}
+
+static bool consistent(const DeviceState &state, uint32_t version) {
+  // Version v is the v-th write, which published stateFor(v)
+  DeviceState expected = stateFor(version);
+  return state.sampleMs == version &&
+         state.temperatureCenti == expected.temperatureCenti &&
+         state.humidityCenti == expected.humidityCenti &&
+         state.derived.dewPointCenti == expected.derived.dewPointCenti &&
+         state.derived.absoluteHumidityCenti ==
+             expected.derived.absoluteHumidityCenti &&
+         state.derived.heatIndexCenti == expected.derived.heatIndexCenti &&
+         state.sensorConnected == expected.sensorConnected &&
+         state.alert == expected.alert;
+}
+
+static void writer(uint32_t writes) {
+  for (uint32_t n = 1; n <= writes; n++) {
+    deviceStateWrite(stateFor(n));
+  }
+  writerDone.store(true, std::memory_order_release);
+}
+
+static void reader(ReaderResult *result) {
+  uint32_t lastVersion = 0;
+  bool last = false;
+  do {
+    last = writerDone.load(std::memory_order_acquire);
+    DeviceState state;
+    uint32_t retries = 0;
+    uint32_t version = deviceStateRead(state, &retries);
+    result->reads++;
+    result->retries += retries;
+    if (version != 0 && !consistent(state, version)) {
+      result->torn++;
+    }
+    if (version < lastVersion) {
+      result->backwards++;
+    }
+    lastVersion = version;
+  } while (!last);
+}
+
+static void usage() {
+  fprintf(stderr, "usage: state_stress [--readers N] [--writes N]\n");
+}
+
+int main(int argc, char **argv) {
+  unsigned readers = 3;
+  uint32_t writes = 2000000;
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    if (strcmp(argv[i], "--readers") == 0 && hasValue) {
+      readers = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--writes") == 0 && hasValue) {
+      writes = strtoul(argv[++i], nullptr, 10);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+
+  std::vector<ReaderResult> results(readers, ReaderResult{});
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < readers; i++) {
+    threads.emplace_back(reader, &results[i]);
+  }
+  std::thread writerThread(writer, writes);
+  writerThread.join();
+  for (std::thread &t : threads) {
+    t.join();
+  }
+
+  ReaderResult total = {};
+  for (const ReaderResult &r : results) {
+    total.reads += r.reads;
+    total.retries += r.retries;
+    total.torn += r.torn;
+    total.backwards += r.backwards;
+  }
+
+  DeviceState final;
+  uint32_t finalVersion = deviceStateRead(final);
+  bool ok = total.torn == 0 && total.backwards == 0 &&
+            finalVersion == writes && consistent(final, finalVersion);
+
+  printf("{\n");
+  printf("  \"writes\": %u,\n", (unsigned)writes);
+  printf("  \"readers\": %u,\n", readers);
+  printf("  \"reads\": %llu,\n", (unsigned long long)total.reads);
+  printf("  \"retries\": %llu,\n", (unsigned long long)total.retries);
+  printf("  \"torn\": %llu,\n", (unsigned long long)total.torn);
+  printf("  \"versionWentBack\": %llu,\n", (unsigned long long)total.backwards);
+  printf("  \"finalVersion\": %u,\n", (unsigned)finalVersion);
+  printf("  \"ok\": %s\n", ok ? "true" : "false");
+  printf("}\n");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,329 @@
+/**
+ * TLS handshake benchmark
+ *
+ * Runs full TLS 1.2 handshakes in-process between an OpenSSL client that
+ * offers what a profile from tls_profile.h offers and a local OpenSSL server
+ * holding either an RSA-2048 or an ECDSA P-256 certificate (generated at
+ * start). Bytes move through memory BIOs, so nothing but the handshake is
+ * measured. Per profile and certificate it reports the suite the server
+ * picked, client and server CPU time per handshake, the ClientHello size
+ * and the bytes and flights in each direction, as JSON on stdout. The exit
+ * code is 1 if a handshake fails.
+ *
+ *   tls_bench [--iterations N]
+ */
+
+#include "tls_profile.h"
+#include <algorithm>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <time.h>
+#include <vector>
+
+// ============================================================================
+// SERVER CERTIFICATES
+// ============================================================================
+
+struct ServerKey {
+  const char *name;
+  EVP_PKEY *key;
+  X509 *cert;
+};
+
+static EVP_PKEY *generateKey(bool ecdsa) {
+  EVP_PKEY_CTX *ctx = EVP_PKEY_CTX_new_id(ecdsa ? EVP_PKEY_EC : EVP_PKEY_RSA,
+                                          nullptr);
+  EVP_PKEY *key = nullptr;
+  if (ctx && EVP_PKEY_keygen_init(ctx) > 0 &&
+      (ecdsa ? EVP_PKEY_CTX_set_ec_paramgen_curve_nid(
+                   ctx, NID_X9_62_prime256v1)
+             : EVP_PKEY_CTX_set_rsa_keygen_bits(ctx, 2048)) > 0) {
+    EVP_PKEY_keygen(ctx, &key);
+  }
+  EVP_PKEY_CTX_free(ctx);
+  return key;
+}
+
+// Self-signed, like a broker's leaf certificate minus the chain
+static X509 *selfSign(EVP_PKEY *key) {
+  X509 *cert = X509_new();
+  X509_set_version(cert, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+  X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+  X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+  X509_set_pubkey(cert, key);
+  X509_NAME *name = X509_get_subject_name(cert);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+                             (const unsigned char *)"broker.local", -1, -1, 0);
+  X509_set_issuer_name(cert, name);
+  if (X509_sign(cert, key, EVP_sha256()) == 0) {
+    X509_free(cert);
+    return nullptr;
+  }
+  return cert;
+}
+
+// ============================================================================
+// PROFILES ON OPENSSL
+// ============================================================================
+
+// IANA suite ids to OpenSSL's "A:B:C" names; empty if none is known
+static std::string cipherList(SSL_CTX *ctx, const uint16_t *suites) {
+  SSL *probe = SSL_new(ctx);
+  std::string list;
+  for (const uint16_t *s = suites; *s; s++) {
+    const unsigned char id[2] = {(unsigned char)(*s >> 8),
+                                 (unsigned char)(*s & 0xFF)};
+    const SSL_CIPHER *cipher = SSL_CIPHER_find(probe, id);
+    if (cipher) {
+      list += list.empty() ? "" : ":";
+      list += SSL_CIPHER_get_name(cipher);
+    }
+  }
+  SSL_free(probe);
+  return list;
+}
+
+static int groupNid(uint16_t group) {
+  switch (group) {
+  case 23:
+    return NID_X9_62_prime256v1;
+  case 24:
+    return NID_secp384r1;
+  case 29:
+    return NID_X25519;
+  default:
+    return NID_undef;
+  }
+}
+
+// The device speaks TLS 1.2 (mbedTLS 2.x in arduino-esp32)
+static SSL_CTX *clientContext(const TlsProfile &profile) {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+  SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+  SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, nullptr); // setInsecure()
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  if (profile.suites) {
+    std::string list = cipherList(ctx, profile.suites);
+    if (list.empty() || !SSL_CTX_set_cipher_list(ctx, list.c_str())) {
+      SSL_CTX_free(ctx);
+      return nullptr;
+    }
+  }
+  if (profile.groups) {
+    std::vector<int> nids;
+    for (const uint16_t *g = profile.groups; *g; g++) {
+      if (groupNid(*g) != NID_undef) {
+        nids.push_back(groupNid(*g));
+      }
+    }
+    if (!nids.empty()) {
+      SSL_CTX_set1_groups(ctx, nids.data(), (long)nids.size());
+    }
+  }
+  return ctx;
+}
+
+static SSL_CTX *serverContext(const ServerKey &server) {
+  SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+  SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+  SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET); // every run a full handshake
+  SSL_CTX_set_cipher_list(ctx, "ALL:!aNULL:!eNULL");
+  SSL_CTX_use_certificate(ctx, server.cert);
+  SSL_CTX_use_PrivateKey(ctx, server.key);
+  return ctx;
+}
+
+// ============================================================================
+// HANDSHAKE
+// ============================================================================
+
+struct Handshake {
+  bool ok;
+  double clientCpuUs;
+  double serverCpuUs;
+  size_t clientHelloBytes;
+  size_t clientBytes; // client -> server
+  size_t serverBytes; // server -> client
+  int clientFlights;
+  int serverFlights;
+  uint16_t suite;
+  std::string suiteName;
+};
+
+static double threadCpuUs() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// Moves what one side wrote to the other side's input; bytes moved
+static size_t transfer(BIO *from, BIO *to) {
+  char buf[4096];
+  size_t total = 0;
+  int n;
+  while ((n = BIO_read(from, buf, sizeof(buf))) > 0) {
+    BIO_write(to, buf, n);
+    total += n;
+  }
+  return total;
+}
+
+static bool step(SSL *ssl, double &cpuUs) {
+  double t0 = threadCpuUs();
+  int rc = SSL_do_handshake(ssl);
+  cpuUs += threadCpuUs() - t0;
+  if (rc == 1) {
+    return true;
+  }
+  int err = SSL_get_error(ssl, rc);
+  return err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE;
+}
+
+static Handshake handshake(SSL_CTX *clientCtx, SSL_CTX *serverCtx) {
+  Handshake h = {};
+  SSL *client = SSL_new(clientCtx);
+  SSL *server = SSL_new(serverCtx);
+  BIO *clientIn = BIO_new(BIO_s_mem());
+  BIO *clientOut = BIO_new(BIO_s_mem());
+  BIO *serverIn = BIO_new(BIO_s_mem());
+  BIO *serverOut = BIO_new(BIO_s_mem());
+  SSL_set_bio(client, clientIn, clientOut);
+  SSL_set_bio(server, serverIn, serverOut);
+  SSL_set_connect_state(client);
+  SSL_set_accept_state(server);
+  SSL_set_tlsext_host_name(client, "broker.local");
+
+  bool ok = true;
+  for (int round = 0; round < 16 && ok; round++) {
+    ok = step(client, h.clientCpuUs);
+    size_t sent = transfer(clientOut, serverIn);
+    if (sent > 0) {
+      if (h.clientFlights == 0) {
+        h.clientHelloBytes = sent;
+      }
+      h.clientFlights++;
+      h.clientBytes += sent;
+    }
+    if (SSL_is_init_finished(client) && SSL_is_init_finished(server)) {
+      break;
+    }
+
+    ok = ok && step(server, h.serverCpuUs);
+    sent = transfer(serverOut, clientIn);
+    if (sent > 0) {
+      h.serverFlights++;
+      h.serverBytes += sent;
+    }
+  }
+
+  h.ok = ok && SSL_is_init_finished(client) && SSL_is_init_finished(server);
+  if (h.ok) {
+    const SSL_CIPHER *cipher = SSL_get_current_cipher(client);
+    h.suite = SSL_CIPHER_get_protocol_id(cipher);
+    h.suiteName = SSL_CIPHER_get_name(cipher);
+  }
+  SSL_free(client);
+  SSL_free(server);
+  return h;
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static double percentile(std::vector<double> values, double p) {
+  std::sort(values.begin(), values.end());
+  size_t i = (size_t)(p * (values.size() - 1) + 0.5);
+  return values[i];
+}
+
+static void usage() { fprintf(stderr, "usage: tls_bench [--iterations N]\n"); }
+
+int main(int argc, char **argv) {
+  int iterations = 50;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if (iterations < 1) {
+    usage();
+    return 2;
+  }
+
+  ServerKey servers[] = {{"rsa2048", nullptr, nullptr},
+                         {"ecdsa-p256", nullptr, nullptr}};
+  for (ServerKey &server : servers) {
+    server.key = generateKey(strcmp(server.name, "ecdsa-p256") == 0);
+    server.cert = server.key ? selfSign(server.key) : nullptr;
+    if (!server.cert) {
+      fprintf(stderr, "tls_bench: cannot create %s certificate\n",
+              server.name);
+      return 2;
+    }
+  }
+
+  bool failed = false;
+  printf("{\n  \"context\": {\"library\": \"%s\", \"protocol\": \"TLS1.2\", "
+         "\"iterations\": %d},\n  \"results\": [\n",
+         OpenSSL_version(OPENSSL_VERSION), iterations);
+
+  bool first = true;
+  for (size_t p = 0; p < tlsProfileCount(); p++) {
+    const TlsProfile &profile = *tlsProfileAt(p);
+    SSL_CTX *clientCtx = clientContext(profile);
+    if (!clientCtx) {
+      fprintf(stderr, "tls_bench: no suite of profile %s is known\n",
+              profile.name);
+      return 2;
+    }
+    for (const ServerKey &server : servers) {
+      SSL_CTX *serverCtx = serverContext(server);
+      std::vector<double> clientUs, serverUs;
+      Handshake last = {};
+      bool ok = true;
+      for (int i = 0; i < iterations && ok; i++) {
+        last = handshake(clientCtx, serverCtx);
+        ok = last.ok;
+        clientUs.push_back(last.clientCpuUs);
+        serverUs.push_back(last.serverCpuUs);
+      }
+      SSL_CTX_free(serverCtx);
+      failed = failed || !ok;
+
+      printf("%s    {\"profile\": \"%s\", \"server\": \"%s\", \"ok\": %s, "
+             "\"suite\": \"0x%04X\", \"suiteName\": \"%s\",\n"
+             "     \"clientCpuUs\": {\"median\": %.1f, \"p90\": %.1f}, "
+             "\"serverCpuUs\": {\"median\": %.1f, \"p90\": %.1f},\n"
+             "     \"clientHelloBytes\": %zu, \"clientBytes\": %zu, "
+             "\"serverBytes\": %zu, \"clientFlights\": %d, "
+             "\"serverFlights\": %d}",
+             first ? "" : ",\n", profile.name, server.name,
+             ok ? "true" : "false", last.suite, last.suiteName.c_str(),
+             percentile(clientUs, 0.5), percentile(clientUs, 0.9),
+             percentile(serverUs, 0.5), percentile(serverUs, 0.9),
+             last.clientHelloBytes, last.clientBytes, last.serverBytes,
+             last.clientFlights, last.serverFlights);
+      first = false;
+    }
+    SSL_CTX_free(clientCtx);
+  }
+  printf("\n  ]\n}\n");
+
+  for (ServerKey &server : servers) {
+    X509_free(server.cert);
+    EVP_PKEY_free(server.key);
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef ASYNC_COMMAND_H
+#define ASYNC_COMMAND_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+
+// ============================================================================
+// LONG-RUNNING COMMANDS
+// ============================================================================
+
+// Actions that take seconds run as jobs stepped from loop() instead of
+// inside handleCommand(). Every message goes to the ack topic with the
+// command's correlationId:
+//   {"status":"accepted"}                     right away
+//   {"status":"progress","progress":40}       at most once a second
+//   {"status":"success"|"error"|"cancelled","result":{...}}   at the end
+// {"action":"cancel","params":{"correlationId":...}} stops a running job.
+
+#define ASYNC_CORRELATION_ID_MAX 48
+
+enum AsyncJobState {
+  ASYNC_RUNNING,
+  ASYNC_SUCCEEDED,
+  ASYNC_FAILED,
+  ASYNC_CANCELLED,
+};
+
+struct AsyncJob {
+  char correlationId[ASYNC_CORRELATION_ID_MAX];
+  const struct AsyncAction *action;
+  AsyncJobState state;
+  uint32_t startedMs;
+  uint32_t finishedMs;
+  uint32_t wakeMs;   // next step is due at this millis(), set by the step
+  uint8_t progress;  // percent, set by the step
+  const char *error; // static string when state is ASYNC_FAILED
+  bool cancelRequested;
+  bool reported; // final message published
+  uint8_t lastProgressSent;
+  uint32_t lastProgressMs;
+};
+
+// One action, implemented as non-blocking callbacks. At most one job per
+// action runs at a time, so per-action scratch state can be static.
+struct AsyncAction {
+  const char *name;
+  // Validate params and reset scratch state; false (and job.error) rejects
+  bool (*start)(AsyncJob &job, JsonObject params);
+  // Do a bounded slice of work; return ASYNC_RUNNING until finished
+  AsyncJobState (*step)(AsyncJob &job, uint32_t nowMs);
+  // Fill the final message's "result" object (optional)
+  void (*result)(const AsyncJob &job, JsonObject result);
+  // Release what start() took, however the job ended, cancel included
+  // (optional)
+  void (*end)(AsyncJob &job);
+};
+
+// Publishes one JSON message to the ack topic; false if it was not sent
+typedef bool (*AsyncPublishFn)(const char *payload);
+
+void asyncCommandSetPublisher(AsyncPublishFn publish);
+
+// Starts a job and publishes "accepted"; false with *error set when the
+// action is already running, no slot is free or start() rejected it
+bool asyncCommandStart(const AsyncAction &action, const char *correlationId,
+                       JsonObject params, uint32_t nowMs, const char **error);
+
+// Flags a running job; it ends as "cancelled" on the next service pass
+bool asyncCommandCancel(const char *correlationId);
+
+// Steps due jobs and publishes progress and results. Final messages are
+// retried until they go out, so a job finished offline is still reported.
+void asyncCommandService(uint32_t nowMs);
+
+uint8_t asyncCommandActiveCount();
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef BIST_H
+#define BIST_H
+
+#include <ArduinoJson.h>
+#include <stdint.h>
+
+// ============================================================================
+// BUILT-IN SELF-TEST
+// ============================================================================
+
+// Hardware checks run once per boot, one short step per call, from the WiFi
+// connect wait and the main loop, so they overlap network bring-up instead
+// of adding to it:
+//   sensor  the DHT answers with a plausible reading, after its power-up
+//           settle time and with retries spaced by its minimum interval
+//   gpio    each output reads back both levels when driven for a few
+//           microseconds (too short to see or hear), and the reset button
+//           idles high on its pull-up
+//   nvs     a counter in the thingbase namespace survives a write and read
+//           back, and the partition has free entries left
+// The result goes into the status message:
+//   "bist":{"state":"pass","ms":2010}
+//   "bist":{"state":"fail","ms":8310,"failed":{"sensor":"no reading"}}
+// with "state":"running" until every check has finished.
+
+// Fills both with the sensor's current reading; NaN if it failed
+typedef void (*BistSensorReadFn)(float *temperature, float *humidity);
+
+// Starts the checks; nowMs is the time the sensor was powered up
+void bistBegin(uint32_t nowMs, BistSensorReadFn readSensor);
+
+// Runs the next check that is due; each takes a few milliseconds at most
+void bistService(uint32_t nowMs);
+
+bool bistDone();
+bool bistPassed();
+
+// Adds the "bist" object described above
+void bistReport(JsonObject out);
+
+#endif
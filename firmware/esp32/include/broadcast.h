@@ -0,0 +1,49 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// BROADCAST COMMAND TOPICS
+// ============================================================================
+
+// Besides its own command topic the device listens on
+//   iot/{tenantId}/broadcast/command          every device of the tenant
+//   iot/{tenantId}/groups/{group}/command     each group it belongs to
+// so one publish reaches a whole fleet or group. Commands from these
+// topics run right away, but their ACKs (still on the device's own ack
+// topic) wait a random 0..BROADCAST_ACK_JITTER_MS so thousands of devices
+// do not answer in the same instant.
+
+// Loads group memberships from NVS
+void broadcastInit();
+
+uint8_t broadcastGroupCount();
+const char *broadcastGroup(uint8_t index);
+
+// Replaces the memberships and stores them; false (nothing changed) if
+// there are too many or a name is empty, too long or not [A-Za-z0-9_-]
+bool broadcastSetGroups(const char *const *groups, uint8_t count);
+
+// Topics to subscribe to: the tenant-wide one, then one per group
+uint8_t broadcastTopicCount();
+bool broadcastTopic(uint8_t index, const char *tenantId, char *out,
+                    size_t outLen);
+
+// ============================================================================
+// JITTERED ACKS
+// ============================================================================
+
+typedef bool (*BroadcastPublishFn)(const char *payload);
+
+void broadcastSetPublisher(BroadcastPublishFn publish);
+
+// Holds an ACK until its random delay has passed; publishes right away if
+// every slot is taken
+void broadcastQueueAck(const char *payload, uint32_t nowMs);
+
+// Publishes ACKs that are due; ones that fail are retried
+void broadcastService(uint32_t nowMs);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CAPABILITIES_H
+#define CAPABILITIES_H
+
+#include <stdint.h>
+
+// ============================================================================
+// CAPABILITY BITS (advertised as "caps" in the online status message)
+// ============================================================================
+// Bits are append-only: the platform keys behaviour off them per device.
+#define CAP_TIME_SYNC (1UL << 0)         // Answers time_sync replies
+#define CAP_DELTA_TELEMETRY (1UL << 1)   // Can omit unchanged state fields
+#define CAP_PROFILE_SWITCH (1UL << 2)    // Accepts the use_profile command
+#define CAP_CMD_SET_STATE (1UL << 3)     // set_state command
+#define CAP_CMD_TOGGLE_LED (1UL << 4)    // toggle-led command
+#define CAP_ASYNC_COMMANDS (1UL << 5)    // Accepted/progress/result and cancel
+#define CAP_CMD_SENSOR_CHECK (1UL << 6)  // sensor_check command (async)
+#define CAP_TELEMETRY_RESEND (1UL << 7)  // boot/seq in telemetry, resend cmd
+#define CAP_BROADCAST_COMMANDS (1UL << 8) // Tenant/group topics, set_groups
+#define CAP_OTA_MQTT (1UL << 9)           // ota_mqtt command (async)
+#define CAP_OTA_PEER (1UL << 10)          // ota_mqtt shares images on the LAN
+#define CAP_CRASH_REPORT (1UL << 11)      // Crash topics, crash_report cmd
+#define CAP_DERIVED_METRICS (1UL << 12)   // dewPoint etc. in telemetry
+#define CAP_ROLLUPS (1UL << 13)           // Minute and hour buckets on rollup
+
+// ============================================================================
+// TELEMETRY PROFILES (selected by the platform via "use_profile")
+// ============================================================================
+#define PROFILE_FULL 0  // Every field in every message (default)
+#define PROFILE_DELTA 1 // Sensor values always, state fields only on change
+
+struct TelemetryProfile {
+  uint8_t id;
+  const char *name;
+  uint32_t requiredCaps;
+};
+
+// Capabilities compiled into this firmware
+uint32_t capabilitiesGetMask();
+
+// nullptr if the id is unknown
+const TelemetryProfile *capabilitiesFindProfile(uint8_t id);
+
+// Known and all required capabilities present
+bool capabilitiesProfileSupported(uint8_t id);
+
+#endif
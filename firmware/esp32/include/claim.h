@@ -16,4 +16,8 @@ struct ClaimResult {
 // Claim device using token and get MQTT credentials
 ClaimResult claimDevice(const char *serverUrl, const char *claimToken);
 
+// Parse a 200/201 claim response body into result; false with result.error
+// set if the body is malformed or reports failure
+bool claimParseResponse(const char *json, size_t length, ClaimResult &result);
+
 #endif
@@ -0,0 +1,51 @@
+#ifndef COMMAND_QUEUE_H
+#define COMMAND_QUEUE_H
+
+#include "config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// INBOUND COMMAND QUEUE
+// ============================================================================
+
+// PubSubClient calls back from inside loop() with its shared packet buffer,
+// so the callback only copies the message here. loop() drains the queue
+// and runs each command with the client idle, where publishing the ACK
+// cannot clobber the buffer being parsed. Single task: no locking.
+struct QueuedCommand {
+  uint32_t receivedMs; // millis() in the MQTT callback
+  bool broadcast;      // came in on a tenant or group topic
+  size_t length;
+  char payload[MQTT_BUFFER_SIZE + 1]; // NUL-terminated copy
+};
+
+struct CommandQueueStats {
+  uint32_t enqueued;
+  uint32_t dropped;  // queue full or message too large
+  uint32_t executed;
+  uint32_t overruns; // commands that took longer than their budget
+  uint8_t depthMax;
+  uint32_t waitMaxMs; // received -> started
+  uint32_t waitTotalMs;
+  uint32_t runMaxMs;
+};
+
+void commandQueueReset();
+
+// Copies the message; false if it does not fit or the queue is full
+bool commandQueuePush(const uint8_t *payload, size_t length,
+                      uint32_t receivedMs, bool broadcast);
+
+// Oldest queued command or nullptr; stays valid until commandQueuePop()
+const QueuedCommand *commandQueuePeek();
+void commandQueuePop();
+
+uint8_t commandQueueDepth();
+
+// Bookkeeping for one executed command
+void commandQueueRecord(uint32_t waitMs, uint32_t runMs, uint32_t budgetMs);
+
+CommandQueueStats commandQueueGetStats();
+
+#endif
@@ -6,6 +6,19 @@
 // ============================================================================
 #define FIRMWARE_VERSION "1.0.0"
 #define DEVICE_MODEL "ESP32-DevKit"
+#ifndef FIRMWARE_BUILD
+#define FIRMWARE_BUILD 0 // CI overrides with -DFIRMWARE_BUILD=<build number>
+#endif
+#define TELEMETRY_SCHEMA_VERSION 2 // Bump when message layouts change
+
+// ============================================================================
+// MQTT
+// ============================================================================
+#define MQTT_BUFFER_SIZE 512 // PubSubClient packet buffer (in and out)
+#define MQTT_FRAME_SIZE 1024 // Largest outbound packet (mqtt_publish.h)
+#define TELEMETRY_FULL_SNAPSHOT_EVERY 6 // Delta profile: full message every N
+#define TELEMETRY_RETENTION 64 // Samples kept for resend_telemetry (~10 min)
+#define TELEMETRY_RESEND_BURST 4 // Resent messages per loop pass
 
 // ============================================================================
 // HARDWARE PINS
@@ -24,10 +37,35 @@
 // ============================================================================
 // WAREHOUSE MONITORING THRESHOLDS
 // ============================================================================
-#define TEMP_HIGH_THRESHOLD 30.0     // Alert if temperature > 30°C
-#define TEMP_LOW_THRESHOLD 10.0      // Alert if temperature < 10°C
-#define HUMIDITY_HIGH_THRESHOLD 70.0 // Alert if humidity > 70%
-#define HUMIDITY_LOW_THRESHOLD 30.0  // Alert if humidity < 30%
+// In hundredths, as readings are held (fixed_point.h): 3000 = 30.00°C
+#define TEMP_HIGH_THRESHOLD_CENTI 3000     // Alert if temperature > 30°C
+#define TEMP_LOW_THRESHOLD_CENTI 1000      // Alert if temperature < 10°C
+#define HUMIDITY_HIGH_THRESHOLD_CENTI 7000 // Alert if humidity > 70%
+#define HUMIDITY_LOW_THRESHOLD_CENTI 3000  // Alert if humidity < 30%
+
+// ============================================================================
+// SENSOR PIPELINE (stages from the DHT to telemetry, see sensor_pipeline.h)
+// ============================================================================
+#define PIPELINE_BATCH_SIZE 1             // Readings averaged per pass
+#define PIPELINE_TEMP_MIN_CENTI -4000     // DHT22 range; outside is a bad read
+#define PIPELINE_TEMP_MAX_CENTI 8000
+#define PIPELINE_HUMIDITY_MIN_CENTI 0
+#define PIPELINE_HUMIDITY_MAX_CENTI 10000
+#define PIPELINE_SPIKE_TEMP_CENTI 0       // Drop a lone jump over this, 0 = off
+#define PIPELINE_SPIKE_HUMIDITY_CENTI 0
+#define PIPELINE_MAX_STAGES 8
+
+// ============================================================================
+// DERIVED METRICS (dew point etc. in telemetry, see derived_metrics.h)
+// ============================================================================
+#define DERIVED_METRICS_ENABLED 1 // 0 = no derive stage, fields left out
+
+// ============================================================================
+// ROLLUPS (per-minute and per-hour buckets on .../rollup, see rollup.h)
+// ============================================================================
+#define ROLLUP_SHORT_S 60  // Short bucket, seconds
+#define ROLLUP_LONG_S 3600 // Long bucket, seconds
+#define ROLLUP_RETAIN 32   // Closed buckets kept until sent (max 255)
 
 // ============================================================================
 // PROVISIONING SETTINGS
@@ -47,4 +85,105 @@
 #define HEARTBEAT_INTERVAL_MS 5000   // Heartbeat LED blink every 5 seconds
 #define SENSOR_READ_INTERVAL_MS 2000 // Read DHT sensor every 2 seconds
 
+// ============================================================================
+// TIME SYNC (request/response over MQTT, see timesync.h)
+// ============================================================================
+#define TIME_SYNC_BURST_SIZE 8            // Exchanges per sync round
+#define TIME_SYNC_SPACING_MS 1000         // Gap between exchanges in a round
+#define TIME_SYNC_TIMEOUT_MS 3000         // Give up on a reply after this
+#define TIME_SYNC_MAX_DELAY_MS 3000       // Discard slower round trips
+#define TIME_SYNC_INTERVAL_MS 3600000     // Re-sync every hour once synced
+#define TIME_SYNC_RETRY_MS 30000          // Retry sooner while unsynced
+#define TIME_SYNC_MIN_DRIFT_SPAN_MS 60000 // Shortest span used for drift
+#define TIME_SYNC_MAX_DRIFT_PPM 500       // Clamp for the drift estimate
+
+// ============================================================================
+// COMMAND QUEUE (inbound commands run from loop(), see command_queue.h)
+// ============================================================================
+#define COMMAND_QUEUE_DEPTH 4           // Messages buffered between loop passes
+#define COMMAND_BUDGET_MS 50            // Default time budget per command
+#define COMMAND_LOOP_BUDGET_MS 100      // Cap on draining per loop pass
+#define ASYNC_COMMAND_SLOTS 2           // Long-running commands in parallel
+#define ASYNC_PROGRESS_INTERVAL_MS 1000 // Min gap between progress messages
+
+// ============================================================================
+// EVENT BUS (samples, alerts, commands, connectivity, see event_bus.h)
+// ============================================================================
+#define EVENT_QUEUE_DEPTH 8  // Events waiting for loop() to dispatch them
+#define EVENT_DISPATCH_MAX 8 // Cap on events dispatched per loop pass
+
+// ============================================================================
+// TLS (mqtts:// broker and claim API, see tls_profile.h)
+// ============================================================================
+#define TLS_PROFILE TLS_PROFILE_ECDSA // Suites and curves offered
+
+// ============================================================================
+// BROADCAST COMMANDS (tenant and group topics, see broadcast.h)
+// ============================================================================
+#define BROADCAST_MAX_GROUPS 4       // Group memberships per device
+#define BROADCAST_GROUP_NAME_MAX 32  // Characters per group name
+#define BROADCAST_ACK_JITTER_MS 5000 // Spread fleet ACKs over this window
+#define BROADCAST_PENDING_ACKS 4     // ACKs waiting out their jitter
+
+// ============================================================================
+// FACTORY PROVISIONING (NVS images over UART, see factory.h)
+// ============================================================================
+#define FACTORY_LISTEN_MS 1000       // Boot window for a line station
+#define FACTORY_IMAGE_MAX 65536      // Largest image accepted, bytes
+#define FACTORY_RX_BUFFER 8192       // UART receive buffer during transfer
+#define FACTORY_BYTE_TIMEOUT_MS 2000 // Silence that aborts a transfer
+#define FACTORY_LINE_MAX 80          // Longest protocol line
+
+// ============================================================================
+// OTA OVER MQTT (chunked image transfer, see ota_mqtt.h)
+// ============================================================================
+#define OTA_MQTT_CHUNK_SIZE 1024       // Default bytes per chunk
+#define OTA_MQTT_CHUNK_MIN 64          // Smallest chunk accepted
+#define OTA_MQTT_CHUNK_MAX 4096        // Largest chunk accepted
+#define OTA_MQTT_WINDOW 8              // Default chunks outstanding
+#define OTA_MQTT_WINDOW_MAX 16         // Largest window accepted
+#define OTA_MQTT_WINDOW_BYTES 32768    // RAM cap for window x chunk size
+#define OTA_MQTT_PACKET_OVERHEAD 192   // Topic and headers around a chunk
+#define OTA_MQTT_WRITE_BURST 4         // Chunks to flash per loop pass
+#define OTA_MQTT_RTO_INITIAL_MS 3000   // Re-request timeout before a sample
+#define OTA_MQTT_RTO_MIN_MS 500        // Floor for the re-request timeout
+#define OTA_MQTT_RTO_MAX_MS 30000      // Cap after backoff
+#define OTA_MQTT_MAX_TRIES 8           // Requests per chunk before failing
+#define OTA_MQTT_RESTART_DELAY_MS 1000 // Lets the result leave before restart
+
+// ============================================================================
+// OTA FROM LAN PEERS (image sharing over mDNS + HTTP, see ota_peer.h)
+// ============================================================================
+#define OTA_PEER_PORT 8070              // HTTP port the verified image is on
+#define OTA_PEER_SERVE_DEFAULT true     // Share an installed image by default
+#define OTA_PEER_MAX_CLIENTS 2          // Downloads served at once (503 beyond)
+#define OTA_PEER_MAX_CANDIDATES 6       // Peers considered per discovery
+#define OTA_PEER_QUERY_MS 1000          // mDNS query time (polled, not waited)
+#define OTA_PEER_CONNECT_TIMEOUT_MS 500 // Per peer, probe and download request
+#define OTA_PEER_POLL_MS 5000           // Re-discovery while waiting on a peer
+#define OTA_PEER_ELECTION_MS 10000      // Random wait before fetching for all
+#define OTA_PEER_ANNOUNCE_MS 2000       // Lets a "fetching" advert reach peers
+#define OTA_PEER_WAIT_MAX_MS 900000     // Longest wait on a peer's cloud fetch
+#define OTA_PEER_READ_TIMEOUT_MS 5000   // Silence that drops a peer download
+#define OTA_PEER_READ_BURST 8192        // Bytes taken from a peer per loop pass
+
+// ============================================================================
+// CRASH REPORTS (core dump upload after a crash, see crash_report.h)
+// ============================================================================
+#define CRASH_CHUNK_SIZE 768        // Dump bytes per data message
+#define CRASH_CHUNK_INTERVAL_MS 100 // Gap between crash messages
+#define CRASH_MAX_CHUNKS 128        // Largest dump sent: 96 KB
+
+// ============================================================================
+// BUILT-IN SELF-TEST (boot-time hardware checks, see bist.h)
+// ============================================================================
+#define BIST_SENSOR_SETTLE_MS 2000   // DHT22 needs this after power-up
+#define BIST_SENSOR_RETRY_MS 2100    // Just over the DHT minimum interval
+#define BIST_SENSOR_TRIES 3          // Readings before the sensor fails
+#define BIST_TEMP_MIN -40.0          // DHT22 range; outside it is a bad read
+#define BIST_TEMP_MAX 80.0
+#define BIST_GPIO_SETTLE_US 5        // Pad settle time before read-back
+#define BIST_NVS_MIN_FREE_ENTRIES 32 // Below this, settings may not save
+#define BIST_WAIT_STEP_MS 10         // Service interval in the WiFi wait
+
 #endif
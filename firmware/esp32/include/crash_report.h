@@ -0,0 +1,54 @@
+#ifndef CRASH_REPORT_H
+#define CRASH_REPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// CRASH REPORTS
+// ============================================================================
+
+// After a panic, watchdog or brownout reset, the next boot reports why,
+// how long the crashed boot had been up (kept in RTC memory, which survives
+// everything but a power cut) and the core dump the panic handler wrote to
+// the coredump partition:
+//   iot/{tenantId}/devices/{deviceId}/crash
+//     {"type":"begin","id":"<bootId>","reason":"panic","crashedBoot":"...",
+//      "uptimeMs":..., "fw":"1.0.0","dumpSize":N,"chunkSize":768,
+//      "chunks":K,"crc32":"<hex>"}
+//     {"type":"end","id":"<bootId>","chunks":K}
+//   iot/{tenantId}/devices/{deviceId}/crash/data
+//     report id (the 8 hex digit boot ID as 4 bytes, big-endian), chunk
+//     index (4 bytes, big-endian), then the chunk; only the last is short
+// Messages go out one at a time, spaced, and only while no command is
+// queued or running. The dump stays in flash, and the report is sent again
+// with the same id after every boot, until the platform sends crash_report
+// with "erase"; "chunks" asks for lost chunks again. host/crash decodes it.
+
+// Publishes on .../crash (data false, JSON) or .../crash/data (data true)
+typedef bool (*CrashPublishFn)(bool data, const uint8_t *payload,
+                               size_t length);
+
+void crashReportSetPublisher(CrashPublishFn publish);
+
+// Reads the reset reason, the previous boot's uptime and the coredump
+// partition, and starts a report if there is something to say
+void crashReportBegin(uint32_t bootId);
+
+// Records uptime for the next boot; cheap, call every loop pass
+void crashReportTick(uint32_t nowMs);
+
+// Sends at most one message; idle means nothing more urgent is going out
+void crashReportService(uint32_t nowMs, bool idle);
+
+// crash_report command: false with *error set if id is not the current
+// report
+bool crashReportResend(const char *id, const uint32_t *chunks, size_t count,
+                       const char **error);
+bool crashReportErase(const char *id, const char **error);
+
+// "panic", "task_wdt", ... for the reset that started this boot
+const char *crashReportResetReason();
+bool crashReportPending();
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef DERIVED_METRICS_H
+#define DERIVED_METRICS_H
+
+#include <stdint.h>
+
+// ============================================================================
+// DERIVED METRICS
+// ============================================================================
+
+// Computed on the device from one temperature/humidity pair, so the
+// platform stores them instead of deriving them per row at query time.
+// Inputs and outputs are hundredths (fixed_point.h).
+//
+// Dew point and absolute humidity come from a table of the Magnus
+// saturation vapour pressure (6.112 hPa, 17.62, 243.12 °C) at every whole
+// degree over the DHT22's -40..80 °C, interpolated linearly: no exp() or
+// log(), and within 0.1 °C and 0.5 % (0.01 g/m³ when drier) of the closed
+// form. The heat index is the NWS one (Steadman below 80 °F, Rothfusz
+// regression above), capped at what an int16_t holds.
+
+struct DerivedMetrics {
+  int16_t dewPointCenti;         // °C, floored at -40
+  int16_t absoluteHumidityCenti; // g/m³
+  int16_t heatIndexCenti;        // °C, "feels like"
+};
+
+void derivedCompute(int16_t temperatureCenti, int16_t humidityCenti,
+                    DerivedMetrics &out);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef DEVICE_STATE_H
+#define DEVICE_STATE_H
+
+#include "derived_metrics.h"
+#include <stdint.h>
+
+// ============================================================================
+// SHARED DEVICE STATE (seqlock)
+// ============================================================================
+
+// Latest sensor-derived state, readable from any task. Writes bump a
+// sequence counter around the copy; readers retry when it changed under
+// them, so a reader never sees half of one write and half of another.
+//
+// Writers must be serialised (today they all run on the loop task); under
+// that rule a write never waits. LED levels are not mirrored here: a GPIO
+// read is a single register load and cannot tear.
+struct DeviceState {
+  int16_t temperatureCenti; // hundredths of a degree C, see fixed_point.h
+  int16_t humidityCenti;    // hundredths of a percent RH
+  DerivedMetrics derived;   // zero unless DERIVED_METRICS_ENABLED
+  uint32_t sampleMs; // millis() when the sensor was read
+  bool sensorConnected;
+  bool alert;
+};
+
+// Copies the latest state into out; returns its version (number of writes
+// so far). retries, when given, receives how often the read had to restart.
+uint32_t deviceStateRead(DeviceState &out, uint32_t *retries = nullptr);
+
+// Publishes a new state; returns the new version
+uint32_t deviceStateWrite(const DeviceState &state);
+
+#endif
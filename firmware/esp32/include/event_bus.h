@@ -0,0 +1,109 @@
+#ifndef EVENT_BUS_H
+#define EVENT_BUS_H
+
+#include "config.h"
+#include <stdint.h>
+
+// ============================================================================
+// EVENT BUS
+// ============================================================================
+
+// Producers publish what happened; consumers are listed once, in a const
+// table in main.cpp, so a new consumer (rules, history, LAN stream) is one
+// table row instead of an edit to every producer. Events are fixed-size
+// records copied into a ring of EVENT_QUEUE_DEPTH and handed out from
+// loop() by eventBusService(), at most EVENT_DISPATCH_MAX per call.
+// Nothing is allocated, and a handler that publishes only queues the event,
+// so dispatch never recurses. Single task: no locking.
+
+enum EventType : uint8_t {
+  EVENT_SAMPLE,       // every sensor read, failed ones included
+  EVENT_ALERT,        // thresholds crossed or back in range
+  EVENT_COMMAND,      // a command finished and was acknowledged
+  EVENT_CONNECTIVITY, // see ConnectivityChange
+  EVENT_TYPE_COUNT
+};
+
+// Values in hundredths (fixed_point.h); the last good reading when the
+// sensor failed
+struct SampleEvent {
+  int16_t temperatureCenti;
+  int16_t humidityCenti;
+  uint8_t exceeded; // THRESHOLD_* bits
+  bool sensorConnected;
+  bool alert;
+};
+
+struct AlertEvent {
+  int16_t temperatureCenti;
+  int16_t humidityCenti;
+  uint8_t exceeded; // THRESHOLD_* bits, 0 when cleared
+  bool active;      // raised, or cleared
+};
+
+#define EVENT_ACTION_MAX 24 // Longer action names are cut short
+
+struct CommandEvent {
+  char action[EVENT_ACTION_MAX];
+  bool success;
+  bool broadcast;
+  bool statusChanged; // the retained status message is out of date
+};
+
+enum ConnectivityChange : uint8_t {
+  CONNECTIVITY_PROVISIONED, // credentials stored, broker not tried yet
+  CONNECTIVITY_MQTT_UP,
+  CONNECTIVITY_MQTT_DOWN
+};
+
+struct ConnectivityEvent {
+  uint8_t change; // ConnectivityChange
+};
+
+struct Event {
+  uint8_t type; // EventType
+  uint32_t timeMs;
+  union {
+    SampleEvent sample;
+    AlertEvent alert;
+    CommandEvent command;
+    ConnectivityEvent connectivity;
+  };
+};
+
+typedef void (*EventHandler)(const Event &event);
+
+// One row per consumer of one event type; handlers of a type run in table
+// order
+struct EventSubscriber {
+  uint8_t type; // EventType
+  EventHandler handler;
+};
+
+struct EventBusStats {
+  uint32_t published;
+  uint32_t dropped; // queue full
+  uint32_t dispatched;
+  uint8_t depthMax;
+};
+
+// Takes the subscriber table (kept, not copied) and empties the queue
+void eventBusBegin(const EventSubscriber *subscribers,
+                   uint8_t subscriberCount);
+
+// Queue an event stamped nowMs; false (and counted) if the queue is full
+bool eventPublishSample(const SampleEvent &sample, uint32_t nowMs);
+bool eventPublishAlert(const AlertEvent &alert, uint32_t nowMs);
+bool eventPublishCommand(const char *action, bool success, bool broadcast,
+                         bool statusChanged, uint32_t nowMs);
+bool eventPublishConnectivity(ConnectivityChange change, uint32_t nowMs);
+
+// Hands queued events to their subscribers, oldest first, up to
+// EVENT_DISPATCH_MAX of them; returns how many were dispatched
+uint8_t eventBusService();
+
+uint8_t eventBusDepth();
+
+EventBusStats eventBusGetStats();
+
+#endif
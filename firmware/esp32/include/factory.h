@@ -0,0 +1,33 @@
+#ifndef FACTORY_H
+#define FACTORY_H
+
+#include <stdint.h>
+
+// ============================================================================
+// FACTORY PROVISIONING OVER UART
+// ============================================================================
+
+// A line station (host/factory) writes a complete, prebuilt NVS partition
+// into each unit over the USB serial port: WiFi, broker, credentials and
+// settings in one go, no SoftAP or claim. Images come from ESP-IDF's
+// nvs_partition_gen.py (see factory_image.h). During the boot window:
+//
+//   device  @factory-ready <chipId> <nvsBytes>
+//   host    @factory-begin <bytes> <crc32 hex> <baud>
+//   device  @factory-baud <baud>            both sides switch speed
+//   host    <image bytes>
+//   device  @factory-ok <crc32 hex>  or  @factory-error <reason>
+//
+// then the unit restarts and boots from the new NVS. The image is checked
+// (CRC, page layout) before flash is touched; pages are written with their
+// state words still erased and read back, and only then are the state
+// words written. NVS ignores pages whose state word is erased, so power
+// lost before that point leaves an empty, unprovisioned unit rather than
+// a half-written configuration.
+
+// Listens for a station for windowMs (the old boot delay) and returns if
+// none shows up. Must run before anything opens NVS. A session always ends
+// in a restart.
+void factoryListen(uint32_t windowMs);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef FACTORY_IMAGE_H
+#define FACTORY_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// NVS PARTITION IMAGES (factory provisioning, see factory.h)
+// ============================================================================
+
+// Images come from ESP-IDF's nvs_partition_gen.py: whole 4 KB pages, each
+// starting with a 32-byte header whose first word is the page state. Both
+// the firmware and the station tool check images with these.
+
+#define FACTORY_PAGE_SIZE 4096
+
+#define NVS_PAGE_STATE_UNINITIALIZED 0xFFFFFFFFu
+#define NVS_PAGE_STATE_ACTIVE 0xFFFFFFFEu
+#define NVS_PAGE_STATE_FULL 0xFFFFFFFCu
+
+// CRC-32 (IEEE, as zlib and binascii.crc32); pass the previous value to
+// continue over several buffers
+uint32_t factoryCrc32(const uint8_t *data, size_t length, uint32_t crc = 0);
+
+// nullptr if the image can go into a partition of partitionSize bytes,
+// otherwise why not: partial pages, too large, a page state NVS would not
+// load, data in an unused page, or no data at all
+const char *factoryImageCheck(const uint8_t *image, size_t length,
+                              size_t partitionSize);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// FIXED-POINT SENSOR VALUES
+// ============================================================================
+
+// Temperature and humidity are carried in hundredths (2345 = 23.45 °C or
+// 23.45 %RH) from the moment the DHT library hands them over. Thresholds
+// compare integers, and these format them without float-to-text
+// conversion. The DHT22 spans -40..80 °C and 0..100 %RH at 0.1 resolution,
+// so an int16_t holds any reading.
+
+#define FIXED_SCALE 100
+
+// Longest text fixedFormat() writes, with the terminator: "-21474836.48"
+#define FIXED_TEXT_MAX 13
+
+// Rounds a sensor float to hundredths, saturating at the int16_t range.
+// The one float operation per reading; callers reject NaN first.
+int16_t fixedFromFloat(float value);
+
+// Writes value / 100 with exactly decimals (0..2) places, rounding half
+// away from zero, like printf("%.1f"). Returns the length.
+size_t fixedFormat(int32_t value, uint8_t decimals, char *out);
+
+// Writes value / 100 as a JSON number with no trailing zeros ("23.4",
+// "45", "-0.05"), the way ArduinoJson prints a float. Returns the length.
+size_t fixedFormatJson(int32_t value, char *out);
+
+#endif
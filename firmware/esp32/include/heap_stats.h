@@ -0,0 +1,34 @@
+#ifndef HEAP_STATS_H
+#define HEAP_STATS_H
+
+#include <stdint.h>
+
+// ============================================================================
+// HEAP AROUND TLS SESSIONS
+// ============================================================================
+
+// A TLS session is by far the largest allocation the firmware makes: with
+// the stock mbedTLS build each one reserves fixed 16 KB input and 4 KB
+// output record buffers plus handshake state. These bracket the two places
+// sessions are opened (claim API, MQTT connect) and keep what they cost,
+// for the status message.
+
+enum HeapPhase {
+  HEAP_PHASE_CLAIM, // claimDevice(): HTTPS request, client torn down after
+  HEAP_PHASE_MQTT,  // mqttClient.connect() over mqtts://
+  HEAP_PHASE_COUNT
+};
+
+struct HeapPhaseStats {
+  uint32_t peakBytes; // most heap in use at once during the phase, 0 if the
+                      // low-water mark did not move (not a new low)
+  uint32_t heldBytes; // still in use when the phase ended
+  uint32_t runs;
+};
+
+void heapPhaseBegin(HeapPhase phase);
+void heapPhaseEnd(HeapPhase phase);
+
+HeapPhaseStats heapPhaseGetStats(HeapPhase phase);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef MQTT_PUBLISH_H
+#define MQTT_PUBLISH_H
+
+#include <PubSubClient.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// SINGLE-WRITE PUBLISH
+// ============================================================================
+
+// Every write() on WiFiClientSecure is sealed as its own TLS record (29
+// bytes of header, nonce and tag with AES-GCM) and usually leaves as its
+// own TCP segment. A PUBLISH that reaches the socket in pieces, as
+// PubSubClient's beginPublish()/write() path and publish_P() do, pays that
+// per piece. These build the whole QoS 0 packet in one buffer and hand it
+// to the socket in a single write, independent of the library's buffer
+// size, so packets up to MQTT_FRAME_SIZE go out as one record.
+
+// Encodes a QoS 0 PUBLISH into out; returns its length, 0 if it does not fit
+size_t mqttEncodePublish(uint8_t *out, size_t outLen, const char *topic,
+                         const uint8_t *payload, size_t length,
+                         bool retained);
+
+// Encodes into a static frame and passes it to the socket in one write
+// through the client, which keeps its keepalive timing; false if not
+// connected, too large for MQTT_FRAME_SIZE or the write came up short
+bool mqttPublishFramed(PubSubClient &client, const char *topic,
+                       const uint8_t *payload, size_t length, bool retained);
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef OTA_MQTT_H
+#define OTA_MQTT_H
+
+#include <mbedtls/sha256.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// FIRMWARE UPDATE OVER MQTT
+// ============================================================================
+
+// For sites that only allow outbound MQTT. The device pulls the image as
+// numbered chunks:
+//   device  iot/{tenantId}/devices/{deviceId}/ota/request
+//           {"id":"<correlationId>","chunkSize":1024,"chunks":[12,13,17]}
+//   server  iot/{tenantId}/devices/{deviceId}/ota/data
+//           chunk index (4 bytes, big-endian), then the chunk; only the
+//           last one may be short
+// At most `window` chunks are outstanding. The front of the window goes
+// through SHA-256 and into the OTA partition as soon as it arrives; chunks
+// that overtake it wait in RAM. A chunk missing for longer than the
+// retransmission timeout (from the measured request round trip, doubled
+// per retry) is asked for again on its own. The new image is marked
+// bootable only if its hash matches.
+
+#define OTA_MQTT_SHA256_LEN 32
+
+enum OtaMqttResult {
+  OTA_MQTT_RUNNING,
+  OTA_MQTT_DONE, // image verified and set to boot next
+  OTA_MQTT_FAILED,
+};
+
+struct OtaMqttStats {
+  uint32_t size;
+  uint32_t written;     // bytes hashed and in flash
+  uint32_t chunks;      // chunks in the image
+  uint32_t requests;    // request messages sent
+  uint32_t rerequested; // chunks asked for more than once
+  uint32_t duplicates;  // chunks that arrived outside the window or twice
+  uint32_t rejected;    // data messages of the wrong length
+  uint32_t srttMs;      // smoothed request round trip, 0 before a sample
+};
+
+// Publishes one message to the request topic; false if it was not sent
+typedef bool (*OtaMqttPublishFn)(const char *payload);
+
+void otaMqttSetPublisher(OtaMqttPublishFn publish);
+
+// 64 hex digits to bytes; false if malformed
+bool otaMqttParseSha256(const char *hex, uint8_t out[OTA_MQTT_SHA256_LEN]);
+
+// SHA-256 for mbedTLS 2 and 3 alike, for every image hash on the device.
+// Start also initialises the context; free it with mbedtls_sha256_free.
+void otaMqttSha256Start(mbedtls_sha256_context *ctx);
+void otaMqttSha256Update(mbedtls_sha256_context *ctx, const uint8_t *data,
+                         size_t length);
+void otaMqttSha256Finish(mbedtls_sha256_context *ctx,
+                         uint8_t out[OTA_MQTT_SHA256_LEN]);
+
+// Allocates the window and opens the OTA partition; false with *error set
+// if a transfer is running, a parameter is out of range or either fails
+bool otaMqttBegin(const char *id, uint32_t size,
+                  const uint8_t sha256[OTA_MQTT_SHA256_LEN],
+                  uint32_t chunkSize, uint32_t window, const char **error);
+
+// A message from the data topic; copied, so safe from the MQTT callback
+void otaMqttOnData(const uint8_t *payload, size_t length, uint32_t nowMs);
+
+// Writes what is in order, then asks for new and overdue chunks. While
+// offline nothing is requested; once back, every outstanding chunk is
+// asked for again, as requests and replies died with the connection.
+OtaMqttResult otaMqttService(uint32_t nowMs, bool online, const char **error);
+
+// The image from another source (a LAN peer, see ota_peer.h), in order and
+// through the same hash check. Only before any chunk has come over MQTT.
+OtaMqttResult otaMqttFeed(const uint8_t *data, size_t length,
+                          const char **error);
+
+// Drops what was written and reopens the partition, so a source that failed
+// part way can be replaced; false if the partition cannot be reopened
+bool otaMqttRewind();
+
+// Frees the window; the partition is abandoned unless the image was
+// verified
+void otaMqttEnd();
+
+bool otaMqttActive();
+uint32_t otaMqttChunkSize();
+uint8_t otaMqttProgress();
+OtaMqttStats otaMqttGetStats();
+
+#endif
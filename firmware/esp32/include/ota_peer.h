@@ -0,0 +1,60 @@
+#ifndef OTA_PEER_H
+#define OTA_PEER_H
+
+#include <stdint.h>
+
+// ============================================================================
+// FIRMWARE UPDATE FROM LAN PEERS
+// ============================================================================
+
+// A site downloads a new image from the cloud about once. A device that
+// installed an image re-hashes it at boot and, if it still matches, serves
+// it over HTTP and advertises it with mDNS:
+//   _thingbase-ota._tcp  instance = deviceId, port OTA_PEER_PORT
+//   TXT  sha256=<hex>  size=<bytes>  state=ready|fetching
+//   GET /ota?sha256=<hex>  -> the image, 404 for another hash, 503 when busy
+// An ota_mqtt update first looks for a "ready" peer with the wanted hash and
+// downloads from the one that answers a TCP connect fastest. If none has it
+// yet but one is "fetching" it from the cloud, it waits for that one. If
+// none is doing either, every device holds off a random time and the first
+// to come out advertises "fetching" and goes to the cloud; of two that come
+// out together, the lower deviceId goes. Whatever the source, the bytes go
+// through ota_mqtt, so the hash from the platform command decides.
+
+enum OtaPeerResult {
+  OTA_PEER_SEARCHING, // discovering, holding off or waiting on a peer
+  OTA_PEER_FETCHING,  // downloading from a peer
+  OTA_PEER_USE_CLOUD, // no peer will have it; fetch over MQTT
+  OTA_PEER_DONE,      // image verified by ota_mqtt
+  OTA_PEER_FAILED,    // the partition could not be reopened
+};
+
+struct OtaPeerStats {
+  char peer[64];       // deviceId of the peer the image came from
+  uint32_t bytes;      // bytes received from peers, failed attempts included
+  uint8_t peersTried;  // downloads started
+  uint8_t discoveries; // mDNS queries made
+};
+
+// Starts mDNS as `instance` and, if the recorded image is the one running
+// and serving is on, the image server; once WiFi is up. Repeat calls are
+// ignored.
+void otaPeerBegin(const char *instance);
+
+// Records a verified image (before the restart into it) so the next boot
+// can serve it
+void otaPeerRecordImage(const char *sha256Hex, uint32_t size, bool serve);
+
+// Peer phase of an update; ota_mqtt must have begun with the same image
+void otaPeerFetchBegin(const char *sha256Hex, uint32_t size, uint32_t nowMs);
+OtaPeerResult otaPeerFetchStep(uint32_t nowMs, const char **error);
+
+// Closes a peer download and withdraws a "fetching" advert
+void otaPeerFetchEnd();
+
+OtaPeerStats otaPeerGetStats();
+
+// Whether this device is serving an image
+bool otaPeerServing();
+
+#endif
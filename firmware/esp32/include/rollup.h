@@ -0,0 +1,57 @@
+#ifndef ROLLUP_H
+#define ROLLUP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// ROLLUPS
+// ============================================================================
+
+// Every good reading is folded into one open bucket per resolution
+// (ROLLUP_SHORT_S and ROLLUP_LONG_S, 1 minute and 1 hour by default),
+// aligned to the synced clock. A bucket closes when the clock passes its
+// end and goes out on its own message, so long-range charts can be drawn
+// from these instead of the raw rows:
+//   iot/{tenantId}/devices/{deviceId}/rollup
+//     {"periodS":60,"start":"2026-01-01T00:01:00.000Z","scale":100,
+//      "temperature":{"count":30,"min":2150,"max":2210,"sum":65130,
+//                     "sumSq":141410500},
+//      "humidity":{...}}
+// Values are integers in 1/scale units: mean = sum / count / scale and
+// variance = (sumSq / count - (sum / count)^2) / scale^2. Readings taken
+// before the first time sync are left out, so the first bucket of a boot
+// may hold fewer than a full period's.
+//
+// Closed buckets wait in a ring of ROLLUP_RETAIN until they are sent, one
+// per rollupService() call while connected; when it is full the oldest is
+// dropped. Ring and open buckets live in RTC memory, like the crash
+// report's uptime marker, so an outage and a reset during it lose nothing
+// short of a power cut.
+
+// Publishes one bucket on .../rollup; false leaves it queued
+typedef bool (*RollupPublishFn)(const char *payload);
+
+struct RollupStats {
+  uint32_t pending; // closed, not sent yet
+  uint32_t sent;
+  uint32_t dropped; // ring full, or too large to send
+};
+
+void rollupSetPublisher(RollupPublishFn publish);
+
+// Keeps buckets from before a reset if RTC memory still holds them
+void rollupBegin();
+
+// One reading in hundredths (fixed_point.h), read at sampleMs (millis());
+// ignored until the clock is synced
+void rollupAdd(int16_t temperatureCenti, int16_t humidityCenti,
+               uint32_t sampleMs);
+
+// Closes buckets whose period is over and, when connected, sends the
+// oldest closed one. Call every loop pass, online or not.
+void rollupService(uint32_t nowMs, bool connected);
+
+RollupStats rollupGetStats();
+
+#endif
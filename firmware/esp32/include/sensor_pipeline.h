@@ -0,0 +1,82 @@
+#ifndef SENSOR_PIPELINE_H
+#define SENSOR_PIPELINE_H
+
+#include "config.h"
+#include "derived_metrics.h"
+#include <ArduinoJson.h>
+#include <stdint.h>
+
+// ============================================================================
+// SENSOR PIPELINE
+// ============================================================================
+
+// A reading goes through a fixed list of stages, each of which works on a
+// batch of samples in place:
+//   acquire    read the sensor into the batch (main.cpp)
+//   filter     mark implausible readings invalid, drop single-reading spikes
+//   derive     dew point, absolute humidity and heat index per reading,
+//              when DERIVED_METRICS_ENABLED (derived_metrics.h)
+//   aggregate  reduce the batch to one sample, the mean of the valid ones
+//   rules      threshold bits for the aggregated sample
+//   publish    device state, log lines and events (main.cpp)
+// The list is a const table in main.cpp and the filter and batch size come
+// from config.h, so one stage can be swapped or tuned without touching the
+// others. Every stage run is timed, and the heap it left allocated is
+// noted; pipelineReport() puts both in the status message:
+//   "pipeline":{"acquire":{"runs":40,"meanUs":5120,"maxUs":5230,"heap":0},
+//               ...}
+
+// Values in hundredths (fixed_point.h)
+struct PipelineSample {
+  int16_t temperatureCenti;
+  int16_t humidityCenti;
+  uint32_t timeMs;        // millis() when read
+  DerivedMetrics derived; // set by the derive stage, zero without it
+  uint8_t exceeded;       // THRESHOLD_* bits, set by the rules stage
+  bool valid;             // false: the read failed or the filter rejected it
+};
+
+struct PipelineBatch {
+  PipelineSample samples[PIPELINE_BATCH_SIZE];
+  uint8_t count;
+};
+
+// Returns false to end the pass. When the first stage does, the batch is
+// kept for the next pass (still filling); after any other stage, and after
+// the last one, it starts empty again.
+typedef bool (*PipelineStageFn)(PipelineBatch &batch, uint32_t nowMs);
+
+struct PipelineStage {
+  const char *name;
+  PipelineStageFn process;
+};
+
+struct PipelineStageStats {
+  uint32_t runs;
+  uint32_t totalUs;
+  uint32_t maxUs;
+  uint32_t heapHeldMax; // most free heap one run did not give back
+};
+
+// Takes the stage table (kept, not copied) and clears batch and stats
+void pipelineBegin(const PipelineStage *stages, uint8_t stageCount);
+
+// One pass through the stages, called at the sensor read interval
+void pipelineRun(uint32_t nowMs);
+
+uint8_t pipelineStageCount();
+PipelineStageStats pipelineStageStats(uint8_t index);
+
+// Adds the "pipeline" object described above
+void pipelineReport(JsonObject out);
+
+// ============================================================================
+// BUILT-IN STAGES
+// ============================================================================
+
+bool pipelineFilter(PipelineBatch &batch, uint32_t nowMs);
+bool pipelineDerive(PipelineBatch &batch, uint32_t nowMs);
+bool pipelineAggregate(PipelineBatch &batch, uint32_t nowMs);
+bool pipelineRules(PipelineBatch &batch, uint32_t nowMs);
+
+#endif
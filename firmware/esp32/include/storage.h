@@ -27,6 +27,24 @@ struct MqttCredentials {
   bool isValid;
 };
 
+// Last image an update verified, for serving to LAN peers (see ota_peer.h)
+struct OtaImageRecord {
+  char sha256[65];    // hex, as given by the platform
+  uint32_t size;
+  char partition[17]; // label of the partition it was written to
+  bool serve;
+  bool isValid;
+};
+
+// Crash report kept until the platform confirms it (see crash_report.h)
+struct CrashRecord {
+  char id[9];          // boot ID that first reported it
+  char crashedBoot[9]; // boot ID that crashed, empty if unknown
+  uint8_t reason;      // esp_reset_reason_t of that crash
+  uint32_t uptimeMs;   // 0 if unknown
+  bool isValid;
+};
+
 // ============================================================================
 // STORAGE FUNCTIONS
 // ============================================================================
@@ -46,4 +64,21 @@ void storageSaveMqtt(const char *broker, const char *clientId,
                      const char *tenantId, const char *deviceId);
 MqttCredentials storageLoadMqtt();
 
+void storageSaveProfile(uint8_t profile);
+uint8_t storageLoadProfile();
+
+// Broadcast group memberships, comma separated (see broadcast.h)
+void storageSaveGroups(const char *groups);
+String storageLoadGroups();
+
+void storageSaveOtaImage(const OtaImageRecord &record);
+OtaImageRecord storageLoadOtaImage();
+
+void storageSaveCrash(const CrashRecord &record);
+CrashRecord storageLoadCrash();
+void storageClearCrash();
+
+// Bumps a counter and reads it back; false if NVS did not keep it
+bool storageSelfTest();
+
 #endif
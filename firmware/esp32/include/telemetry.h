@@ -0,0 +1,68 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "config.h"
+#include "derived_metrics.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// TELEMETRY PAYLOAD
+// ============================================================================
+
+// Optional fields; temperature and humidity are always sent
+#define TELEMETRY_FIELD_UPTIME (1 << 0)
+#define TELEMETRY_FIELD_RSSI (1 << 1)
+#define TELEMETRY_FIELD_LED (1 << 2)
+#define TELEMETRY_FIELD_ALERT_LED (1 << 3)
+#define TELEMETRY_FIELD_ALERT (1 << 4)
+#define TELEMETRY_FIELD_SENSOR (1 << 5)
+#define TELEMETRY_FIELD_DERIVED (1 << 6) // dewPoint, absHumidity, heatIndex
+#if DERIVED_METRICS_ENABLED
+#define TELEMETRY_FIELDS_ALL 0x7F
+#else
+#define TELEMETRY_FIELDS_ALL 0x3F
+#endif
+
+struct TelemetryReading {
+  int16_t temperatureCenti; // hundredths, see fixed_point.h
+  int16_t humidityCenti;
+  DerivedMetrics derived;
+  uint32_t uptimeS;
+  int8_t rssi;
+  bool led;
+  bool alertLed;
+  bool alert;
+  bool sensorConnected;
+  uint32_t sampleMs; // millis() when the sensor was read
+  uint32_t seq;      // assigned by telemetryRecord()
+};
+
+// Serialise {"boot":...,"seq":...,"data":{...},"timestamp":...}; the
+// timestamp is left out until the clock is synced. resent marks a replay
+// from the retention buffer. Returns the length, 0 if it does not fit.
+size_t telemetrySerialize(const TelemetryReading &reading, uint8_t fields,
+                          bool resent, char *out, size_t outLen);
+
+// ============================================================================
+// SEQUENCE & RETENTION
+// ============================================================================
+
+// Every sample gets the next per-boot sequence number (from 1) and is kept
+// in a ring of the last TELEMETRY_RETENTION samples, published or not. The
+// platform spots gaps in seq and asks for them with resend_telemetry; a new
+// boot ID tells it the gap is a reboot, not loss.
+void telemetryBegin(uint32_t bootId);
+const char *telemetryBootId(); // 8 hex digits, as sent in "boot"
+
+// Assigns reading.seq and retains a copy
+uint32_t telemetryRecord(TelemetryReading &reading);
+
+// nullptr once the sample has been overwritten (or was never taken)
+const TelemetryReading *telemetryFindRetained(uint32_t seq);
+
+// Oldest and newest retained seq; both 0 before the first sample
+uint32_t telemetryOldestRetained();
+uint32_t telemetryLastSeq();
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef THRESHOLDS_H
+#define THRESHOLDS_H
+
+#include <stdint.h>
+
+// ============================================================================
+// THRESHOLD EVALUATION (limits in config.h)
+// ============================================================================
+#define THRESHOLD_TEMP_HIGH (1 << 0)
+#define THRESHOLD_TEMP_LOW (1 << 1)
+#define THRESHOLD_HUMIDITY_HIGH (1 << 2)
+#define THRESHOLD_HUMIDITY_LOW (1 << 3)
+
+// Bitmask of exceeded limits, 0 when the reading is within range. Values
+// are hundredths (fixed_point.h), like the limits.
+uint8_t thresholdsEvaluate(int16_t temperatureCenti, int16_t humidityCenti);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef TIMESYNC_H
+#define TIMESYNC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// TIME SYNC STRUCTURES
+// ============================================================================
+
+// NTP-style exchange over MQTT:
+//   t0 = device send (local ms)    t1 = server receive (epoch ms)
+//   t2 = server send (epoch ms)    t3 = device receive (local ms)
+//   offset = ((t1 - t0) + (t2 - t3)) / 2
+//   delay  = (t3 - t0) - (t2 - t1)
+struct TimeSyncSample {
+  int64_t offsetMs; // server epoch minus device local time
+  uint32_t delayMs; // network round trip without server processing
+  uint32_t localMs; // device time the reply arrived (t3)
+};
+
+struct TimeSyncQuality {
+  bool synced;
+  uint32_t uncertaintyMs; // best sample delay / 2 plus drift since sync
+  int32_t driftPpm;       // local oscillator rate error vs server
+  uint8_t samples;        // samples accepted in the last round
+  uint32_t ageMs;         // time since the last committed round
+};
+
+// ============================================================================
+// TIME SYNC FUNCTIONS
+// ============================================================================
+
+void timeSyncReset();
+
+// Exchange handling: one request in flight at a time
+uint32_t timeSyncBeginExchange(uint32_t nowLocalMs);
+bool timeSyncExchangePending();
+bool timeSyncHandleResponse(uint32_t t0, uint64_t t1, uint64_t t2,
+                            uint32_t t3);
+
+// Pick the lowest-delay sample of the round, update offset and drift
+bool timeSyncCommitRound();
+
+bool timeSyncIsSynced();
+TimeSyncQuality timeSyncGetQuality(uint32_t nowLocalMs);
+
+// Convert a local millis() reading to server time
+uint64_t timeSyncToEpochMs(uint32_t localMs);
+
+// Format as "YYYY-MM-DDTHH:MM:SS.mmmZ"; false if not synced
+bool timeSyncFormatIso8601(uint32_t localMs, char *out, size_t outLen);
+
+// The same for a time already in server epoch ms
+bool timeSyncFormatEpochIso8601(uint64_t epochMs, char *out, size_t outLen);
+
+#endif
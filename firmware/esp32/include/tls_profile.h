@@ -0,0 +1,38 @@
+#ifndef TLS_PROFILE_H
+#define TLS_PROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// TLS PROFILES (what the device offers in its ClientHello)
+// ============================================================================
+
+// The stock mbedTLS build offers every suite it has, well over a hundred,
+// and a server may well pick plain RSA-2048 key exchange, which the ESP32
+// computes in software. A profile narrows the offer to a few suites and
+// curves in preference order. The server still chooses: ECDHE-ECDSA with
+// P-256 when it has an ECDSA certificate, the ECDHE-RSA fallback otherwise.
+#define TLS_PROFILE_COMPAT 0 // Library defaults, nothing narrowed
+#define TLS_PROFILE_ECDSA 1  // ECDHE-ECDSA P-256 + AES-GCM first
+
+struct TlsProfile {
+  uint8_t id;
+  const char *name;
+  const uint16_t *suites; // IANA ids, 0-terminated; nullptr = library default
+  const uint16_t *groups; // IANA named groups, 0-terminated; nullptr = default
+};
+
+// nullptr if the id is unknown
+const TlsProfile *tlsProfileFind(uint8_t id);
+
+size_t tlsProfileCount();
+const TlsProfile *tlsProfileAt(size_t index);
+
+// Narrows what every later TLS connection offers (MQTT and claim), so call
+// it before the first one. Returns the number of suites offered, 0 if the
+// library defaults were left in place (COMPAT, or nothing in the profile is
+// built into this mbedTLS).
+size_t tlsProfileApply(const TlsProfile &profile);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef TOPICS_H
+#define TOPICS_H
+
+#include <stddef.h>
+
+// Build "iot/{tenantId}/devices/{deviceId}/{type}" (same layout as the
+// platform's MQTT_TOPICS); returns false if the result would be truncated
+bool topicBuild(char *out, size_t outLen, const char *tenantId,
+                const char *deviceId, const char *type);
+
+#endif
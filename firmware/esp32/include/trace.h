@@ -0,0 +1,76 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "config.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// INPUT TRACE (record on device with -DTHINGBASE_TRACE, replay on host)
+// ============================================================================
+// One line per input event, streamed to Serial so a plain monitor log is a
+// replayable trace:
+//   @trace <ms> S <temperature> <humidity>   sensor sample (nan = failed)
+//   @trace <ms> M <topic> <payload hex> [<length>]
+//                                            inbound MQTT message; length
+//                                            only when it was cut short
+//   @trace <ms> W <wl_status>                WiFi status change
+//   @trace <ms> B <0|1>                      button edge (1 = pressed)
+
+#define TRACE_LINE_PREFIX "@trace "
+#define TRACE_MAX_TOPIC 128
+// Every command fits; larger messages (OTA data) are recorded cut short,
+// with their length, and host/replay refuses such a trace
+#define TRACE_MAX_PAYLOAD MQTT_BUFFER_SIZE
+#define TRACE_MAX_LINE (48 + TRACE_MAX_TOPIC + TRACE_MAX_PAYLOAD * 2)
+
+#define TRACE_SENSOR 'S'
+#define TRACE_MQTT_IN 'M'
+#define TRACE_WIFI 'W'
+#define TRACE_BUTTON 'B'
+
+struct TraceRecord {
+  uint32_t timeMs;
+  char type;
+  float temperature; // TRACE_SENSOR
+  float humidity;    // TRACE_SENSOR
+  int value;         // TRACE_WIFI status, TRACE_BUTTON level
+  char topic[TRACE_MAX_TOPIC];
+  uint8_t payload[TRACE_MAX_PAYLOAD];
+  uint16_t payloadLen;
+  uint32_t length; // TRACE_MQTT_IN as received; above payloadLen if cut
+};
+
+// Returns the line length, 0 if it does not fit
+size_t traceFormat(const TraceRecord &record, char *out, size_t outLen);
+
+// Parses one line; false for anything that is not a trace record
+bool traceParse(const char *line, TraceRecord *record);
+
+// ============================================================================
+// RECORDING HOOKS (compiled out unless THINGBASE_TRACE is defined)
+// ============================================================================
+
+#ifdef THINGBASE_TRACE
+typedef void (*TraceSink)(const char *line);
+
+void traceSetSink(TraceSink sink);
+void traceSensor(uint32_t nowMs, float temperature, float humidity);
+void traceMqttIn(uint32_t nowMs, const char *topic, const uint8_t *payload,
+                 unsigned int length);
+void traceWifiStatus(uint32_t nowMs, int status);
+void traceButton(uint32_t nowMs, bool pressed);
+
+#define TRACE_SENSOR_SAMPLE(t, h) traceSensor(millis(), t, h)
+#define TRACE_MQTT_MESSAGE(topic, payload, len)                                \
+  traceMqttIn(millis(), topic, payload, len)
+#define TRACE_WIFI_STATUS(status) traceWifiStatus(millis(), status)
+#define TRACE_BUTTON_EDGE(pressed) traceButton(millis(), pressed)
+#else
+#define TRACE_SENSOR_SAMPLE(t, h) ((void)0)
+#define TRACE_MQTT_MESSAGE(topic, payload, len) ((void)0)
+#define TRACE_WIFI_STATUS(status) ((void)0)
+#define TRACE_BUTTON_EDGE(pressed) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,170 @@
+#include "async_command.h"
+#include "config.h"
+#include "timesync.h"
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static AsyncJob jobs[ASYNC_COMMAND_SLOTS];
+static bool slotUsed[ASYNC_COMMAND_SLOTS];
+static AsyncPublishFn publisher = nullptr;
+
+// ============================================================================
+// MESSAGES
+// ============================================================================
+
+static const char *statusName(AsyncJobState state) {
+  switch (state) {
+  case ASYNC_SUCCEEDED:
+    return "success";
+  case ASYNC_FAILED:
+    return "error";
+  case ASYNC_CANCELLED:
+    return "cancelled";
+  default:
+    return "progress";
+  }
+}
+
+static bool publishJob(const AsyncJob &job, const char *status,
+                       uint32_t nowMs) {
+  if (!publisher) {
+    return false;
+  }
+
+  JsonDocument doc;
+  doc["correlationId"] = job.correlationId;
+  doc["action"] = job.action->name;
+  doc["status"] = status;
+  if (job.state == ASYNC_RUNNING) {
+    doc["progress"] = job.progress;
+  } else {
+    doc["durationMs"] = job.finishedMs - job.startedMs;
+    if (job.state == ASYNC_FAILED && job.error) {
+      doc["error"] = job.error;
+    }
+    if (job.action->result) {
+      job.action->result(job, doc["result"].to<JsonObject>());
+    }
+  }
+
+  // Results are stamped with when the job ended, even if sent later
+  uint32_t stampMs = job.state == ASYNC_RUNNING ? nowMs : job.finishedMs;
+  char iso[32];
+  if (timeSyncFormatIso8601(stampMs, iso, sizeof(iso))) {
+    doc["timestamp"] = iso;
+  }
+
+  char buffer[MQTT_BUFFER_SIZE];
+  if (measureJson(doc) >= sizeof(buffer)) {
+    return false;
+  }
+  serializeJson(doc, buffer, sizeof(buffer));
+  return publisher(buffer);
+}
+
+// ============================================================================
+// JOBS
+// ============================================================================
+
+void asyncCommandSetPublisher(AsyncPublishFn publish) { publisher = publish; }
+
+bool asyncCommandStart(const AsyncAction &action, const char *correlationId,
+                       JsonObject params, uint32_t nowMs, const char **error) {
+  int slot = -1;
+  for (int i = 0; i < ASYNC_COMMAND_SLOTS; i++) {
+    if (!slotUsed[i]) {
+      if (slot < 0) {
+        slot = i;
+      }
+    } else if (jobs[i].action == &action) {
+      *error = "Already running";
+      return false;
+    }
+  }
+  if (slot < 0) {
+    *error = "Too many running commands";
+    return false;
+  }
+
+  AsyncJob &job = jobs[slot];
+  memset(&job, 0, sizeof(job));
+  strncpy(job.correlationId, correlationId ? correlationId : "",
+          sizeof(job.correlationId) - 1);
+  job.action = &action;
+  job.state = ASYNC_RUNNING;
+  job.startedMs = nowMs;
+  job.wakeMs = nowMs;
+  job.lastProgressMs = nowMs;
+
+  if (!action.start(job, params)) {
+    *error = job.error ? job.error : "Invalid parameters";
+    return false;
+  }
+
+  slotUsed[slot] = true;
+  publishJob(job, "accepted", nowMs);
+  return true;
+}
+
+bool asyncCommandCancel(const char *correlationId) {
+  if (!correlationId) {
+    return false;
+  }
+  for (int i = 0; i < ASYNC_COMMAND_SLOTS; i++) {
+    if (slotUsed[i] && jobs[i].state == ASYNC_RUNNING &&
+        strcmp(jobs[i].correlationId, correlationId) == 0) {
+      jobs[i].cancelRequested = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+void asyncCommandService(uint32_t nowMs) {
+  for (int i = 0; i < ASYNC_COMMAND_SLOTS; i++) {
+    if (!slotUsed[i]) {
+      continue;
+    }
+    AsyncJob &job = jobs[i];
+
+    if (job.state == ASYNC_RUNNING) {
+      if (job.cancelRequested) {
+        job.state = ASYNC_CANCELLED;
+      } else if ((int32_t)(nowMs - job.wakeMs) >= 0) {
+        job.state = job.action->step(job, nowMs);
+      }
+      if (job.state != ASYNC_RUNNING) {
+        job.finishedMs = nowMs;
+        if (job.action->end) {
+          job.action->end(job);
+        }
+      }
+    }
+
+    if (job.state == ASYNC_RUNNING) {
+      if (job.progress != job.lastProgressSent &&
+          nowMs - job.lastProgressMs >= ASYNC_PROGRESS_INTERVAL_MS &&
+          publishJob(job, "progress", nowMs)) {
+        job.lastProgressSent = job.progress;
+        job.lastProgressMs = nowMs;
+      }
+      continue;
+    }
+
+    // Finished: keep the slot until the result is out
+    if (publishJob(job, statusName(job.state), nowMs)) {
+      slotUsed[i] = false;
+    }
+  }
+}
+
+uint8_t asyncCommandActiveCount() {
+  uint8_t count = 0;
+  for (int i = 0; i < ASYNC_COMMAND_SLOTS; i++) {
+    count += slotUsed[i] ? 1 : 0;
+  }
+  return count;
+}
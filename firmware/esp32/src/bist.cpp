@@ -0,0 +1,169 @@
+#include "bist.h"
+#include "config.h"
+#include "storage.h"
+#include <Arduino.h>
+#include <math.h>
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <nvs.h>
+#endif
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+enum BistCheck { BIST_GPIO, BIST_NVS, BIST_SENSOR, BIST_CHECKS };
+
+static const char *const checkNames[BIST_CHECKS] = {"gpio", "nvs", "sensor"};
+
+static BistSensorReadFn sensorRead = nullptr;
+static bool started = false;
+static uint8_t next = 0;        // first check not yet finished
+static uint8_t sensorTries = 0;
+static uint32_t startMs = 0;
+static uint32_t sensorDueMs = 0;
+static uint32_t elapsedMs = 0;
+static char failures[BIST_CHECKS][32]; // empty while passing
+
+static void fail(BistCheck check, const char *reason) {
+  strncpy(failures[check], reason, sizeof(failures[check]) - 1);
+  Serial.printf("[BIST] %s: %s\n", checkNames[check], reason);
+}
+
+// ============================================================================
+// CHECKS
+// ============================================================================
+
+// An output pin keeps its input buffer, so it reads back what the pad is
+// at; one that stays put is shorted or held by something off board
+static bool outputFollows(uint8_t pin) {
+  int level = digitalRead(pin);
+  digitalWrite(pin, !level);
+  delayMicroseconds(BIST_GPIO_SETTLE_US);
+  bool follows = digitalRead(pin) == !level;
+  digitalWrite(pin, level);
+  delayMicroseconds(BIST_GPIO_SETTLE_US);
+  return follows && digitalRead(pin) == level;
+}
+
+static void checkGpio() {
+  static const uint8_t outputs[] = {LED_PIN, ALERT_LED_PIN, BUZZER_PIN};
+  static const char *const names[] = {"led stuck", "alert led stuck",
+                                      "buzzer stuck"};
+  for (size_t i = 0; i < sizeof(outputs); i++) {
+    if (!outputFollows(outputs[i])) {
+      fail(BIST_GPIO, names[i]);
+      return;
+    }
+  }
+  // Held at boot is as likely a stuck button as a user about to reset
+  if (digitalRead(RESET_BUTTON_PIN) != HIGH) {
+    fail(BIST_GPIO, "button low");
+  }
+}
+
+static void checkNvs() {
+  if (!storageSelfTest()) {
+    fail(BIST_NVS, "write not read back");
+    return;
+  }
+#ifdef ARDUINO_ARCH_ESP32
+  nvs_stats_t stats;
+  if (nvs_get_stats(nullptr, &stats) != ESP_OK) {
+    fail(BIST_NVS, "no stats");
+  } else if (stats.free_entries < BIST_NVS_MIN_FREE_ENTRIES) {
+    char reason[sizeof(failures[0])];
+    snprintf(reason, sizeof(reason), "%u entries free",
+             (unsigned)stats.free_entries);
+    fail(BIST_NVS, reason);
+  }
+#endif
+}
+
+// False while it should be tried again
+static bool checkSensor() {
+  float temperature = NAN;
+  float humidity = NAN;
+  sensorRead(&temperature, &humidity);
+  bool plausible = temperature >= BIST_TEMP_MIN &&
+                   temperature <= BIST_TEMP_MAX && humidity >= 0 &&
+                   humidity <= 100;
+  if (plausible) {
+    return true;
+  }
+  if (++sensorTries < BIST_SENSOR_TRIES) {
+    return false;
+  }
+  fail(BIST_SENSOR, isnan(temperature) || isnan(humidity) ? "no reading"
+                                                          : "out of range");
+  return true;
+}
+
+// ============================================================================
+// SCHEDULE
+// ============================================================================
+
+void bistBegin(uint32_t nowMs, BistSensorReadFn readSensor) {
+  sensorRead = readSensor;
+  memset(failures, 0, sizeof(failures));
+  next = 0;
+  sensorTries = 0;
+  startMs = nowMs;
+  sensorDueMs = nowMs + BIST_SENSOR_SETTLE_MS;
+  started = true;
+}
+
+void bistService(uint32_t nowMs) {
+  if (!started || bistDone()) {
+    return;
+  }
+  switch (next) {
+  case BIST_GPIO:
+    checkGpio();
+    break;
+  case BIST_NVS:
+    checkNvs();
+    break;
+  case BIST_SENSOR:
+    if ((int32_t)(nowMs - sensorDueMs) < 0) {
+      return;
+    }
+    if (!checkSensor()) {
+      sensorDueMs = nowMs + BIST_SENSOR_RETRY_MS;
+      return;
+    }
+    break;
+  }
+  if (++next == BIST_CHECKS) {
+    elapsedMs = nowMs - startMs;
+    if (bistPassed()) {
+      Serial.printf("[BIST] Passed in %u ms\n", (unsigned)elapsedMs);
+    }
+  }
+}
+
+bool bistDone() { return started && next == BIST_CHECKS; }
+
+bool bistPassed() {
+  for (uint8_t i = 0; i < BIST_CHECKS; i++) {
+    if (failures[i][0]) {
+      return false;
+    }
+  }
+  return bistDone();
+}
+
+void bistReport(JsonObject out) {
+  if (!bistDone()) {
+    out["state"] = "running";
+    return;
+  }
+  out["state"] = bistPassed() ? "pass" : "fail";
+  out["ms"] = elapsedMs;
+  for (uint8_t i = 0; i < BIST_CHECKS; i++) {
+    if (failures[i][0]) {
+      out["failed"][checkNames[i]] = failures[i];
+    }
+  }
+}
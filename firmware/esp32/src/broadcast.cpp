@@ -0,0 +1,144 @@
+#include "broadcast.h"
+#include "config.h"
+#include "storage.h"
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+#define BROADCAST_ACK_MAX 256 // Same as the ACK buffer in handleCommand()
+
+struct PendingAck {
+  bool used;
+  uint32_t dueMs;
+  char payload[BROADCAST_ACK_MAX];
+};
+
+static char groups[BROADCAST_MAX_GROUPS][BROADCAST_GROUP_NAME_MAX + 1];
+static uint8_t groupCount = 0;
+
+static PendingAck pending[BROADCAST_PENDING_ACKS];
+static BroadcastPublishFn publisher = nullptr;
+
+// ============================================================================
+// GROUPS
+// ============================================================================
+
+// Group names end up in a topic: no wildcards, separators or empty levels
+static bool validGroupName(const char *name) {
+  size_t length = strlen(name);
+  if (length == 0 || length > BROADCAST_GROUP_NAME_MAX) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    char c = name[i];
+    if (!isalnum((unsigned char)c) && c != '-' && c != '_') {
+      return false;
+    }
+  }
+  return true;
+}
+
+void broadcastInit() {
+  groupCount = 0;
+  String stored = storageLoadGroups();
+  const char *cursor = stored.c_str();
+  while (*cursor && groupCount < BROADCAST_MAX_GROUPS) {
+    const char *comma = strchr(cursor, ',');
+    size_t length = comma ? (size_t)(comma - cursor) : strlen(cursor);
+    if (length > 0 && length <= BROADCAST_GROUP_NAME_MAX) {
+      memcpy(groups[groupCount], cursor, length);
+      groups[groupCount][length] = '\0';
+      if (validGroupName(groups[groupCount])) {
+        groupCount++;
+      }
+    }
+    cursor += length + (comma ? 1 : 0);
+  }
+  Serial.printf("[Broadcast] %u group(s): %s\n", groupCount,
+                stored.length() ? stored.c_str() : "-");
+}
+
+uint8_t broadcastGroupCount() { return groupCount; }
+
+const char *broadcastGroup(uint8_t index) {
+  return index < groupCount ? groups[index] : nullptr;
+}
+
+bool broadcastSetGroups(const char *const *names, uint8_t count) {
+  if (count > BROADCAST_MAX_GROUPS) {
+    return false;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    if (!names[i] || !validGroupName(names[i])) {
+      return false;
+    }
+  }
+
+  char joined[BROADCAST_MAX_GROUPS * (BROADCAST_GROUP_NAME_MAX + 1)];
+  joined[0] = '\0';
+  for (uint8_t i = 0; i < count; i++) {
+    strncpy(groups[i], names[i], BROADCAST_GROUP_NAME_MAX);
+    groups[i][BROADCAST_GROUP_NAME_MAX] = '\0';
+    if (i > 0) {
+      strcat(joined, ",");
+    }
+    strcat(joined, groups[i]);
+  }
+  groupCount = count;
+  storageSaveGroups(joined);
+  return true;
+}
+
+uint8_t broadcastTopicCount() { return 1 + groupCount; }
+
+bool broadcastTopic(uint8_t index, const char *tenantId, char *out,
+                    size_t outLen) {
+  int n;
+  if (index == 0) {
+    n = snprintf(out, outLen, "iot/%s/broadcast/command", tenantId);
+  } else if (index <= groupCount) {
+    n = snprintf(out, outLen, "iot/%s/groups/%s/command", tenantId,
+                 groups[index - 1]);
+  } else {
+    return false;
+  }
+  return n > 0 && (size_t)n < outLen;
+}
+
+// ============================================================================
+// JITTERED ACKS
+// ============================================================================
+
+void broadcastSetPublisher(BroadcastPublishFn publish) { publisher = publish; }
+
+void broadcastQueueAck(const char *payload, uint32_t nowMs) {
+  for (int i = 0; i < BROADCAST_PENDING_ACKS; i++) {
+    if (!pending[i].used) {
+      pending[i].used = true;
+      pending[i].dueMs = nowMs + esp_random() % (BROADCAST_ACK_JITTER_MS + 1);
+      strncpy(pending[i].payload, payload, sizeof(pending[i].payload) - 1);
+      pending[i].payload[sizeof(pending[i].payload) - 1] = '\0';
+      return;
+    }
+  }
+  // A burst of broadcasts: better an early ACK than none
+  if (publisher) {
+    publisher(payload);
+  }
+}
+
+void broadcastService(uint32_t nowMs) {
+  if (!publisher) {
+    return;
+  }
+  for (int i = 0; i < BROADCAST_PENDING_ACKS; i++) {
+    if (pending[i].used && (int32_t)(nowMs - pending[i].dueMs) >= 0 &&
+        publisher(pending[i].payload)) {
+      pending[i].used = false;
+    }
+  }
+}
@@ -0,0 +1,37 @@
+#include "capabilities.h"
+#include "config.h"
+#include <stddef.h>
+
+static const TelemetryProfile profiles[] = {
+    {PROFILE_FULL, "full", 0},
+    {PROFILE_DELTA, "delta", CAP_DELTA_TELEMETRY},
+};
+
+uint32_t capabilitiesGetMask() {
+  uint32_t mask = CAP_TIME_SYNC | CAP_DELTA_TELEMETRY | CAP_PROFILE_SWITCH |
+                  CAP_CMD_SET_STATE | CAP_CMD_TOGGLE_LED | CAP_ASYNC_COMMANDS |
+                  CAP_CMD_SENSOR_CHECK | CAP_TELEMETRY_RESEND |
+                  CAP_BROADCAST_COMMANDS | CAP_OTA_MQTT | CAP_OTA_PEER |
+                  CAP_CRASH_REPORT | CAP_ROLLUPS;
+#if DERIVED_METRICS_ENABLED
+  mask |= CAP_DERIVED_METRICS;
+#endif
+  return mask;
+}
+
+const TelemetryProfile *capabilitiesFindProfile(uint8_t id) {
+  for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+    if (profiles[i].id == id) {
+      return &profiles[i];
+    }
+  }
+  return nullptr;
+}
+
+bool capabilitiesProfileSupported(uint8_t id) {
+  const TelemetryProfile *profile = capabilitiesFindProfile(id);
+  if (!profile) {
+    return false;
+  }
+  return (profile->requiredCaps & ~capabilitiesGetMask()) == 0;
+}
@@ -5,6 +5,56 @@
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 
+bool claimParseResponse(const char *json, size_t length, ClaimResult &result) {
+  result.success = false;
+
+  JsonDocument responseDoc;
+  DeserializationError error = deserializeJson(responseDoc, json, length);
+
+  if (error) {
+    result.error = "Failed to parse response: " + String(error.c_str());
+    return false;
+  }
+
+  if (responseDoc["success"].as<bool>() != true) {
+    result.error = responseDoc["error"].as<String>();
+    return false;
+  }
+
+  JsonObject data = responseDoc["data"];
+
+  result.deviceId = data["deviceId"].as<String>();
+  result.tenantId = data["tenantId"].as<String>();
+
+  JsonObject mqtt = data["mqtt"];
+  strncpy(result.mqtt.broker, mqtt["broker"] | "",
+          sizeof(result.mqtt.broker) - 1);
+  strncpy(result.mqtt.clientId, mqtt["clientId"] | "",
+          sizeof(result.mqtt.clientId) - 1);
+  strncpy(result.mqtt.username, mqtt["username"] | "",
+          sizeof(result.mqtt.username) - 1);
+  strncpy(result.mqtt.password, mqtt["password"] | "",
+          sizeof(result.mqtt.password) - 1);
+
+  JsonObject topics = mqtt["topics"];
+  strncpy(result.mqtt.topicTelemetry, topics["telemetry"] | "",
+          sizeof(result.mqtt.topicTelemetry) - 1);
+  strncpy(result.mqtt.topicCommands, topics["commands"] | "",
+          sizeof(result.mqtt.topicCommands) - 1);
+  strncpy(result.mqtt.topicAck, topics["ack"] | "",
+          sizeof(result.mqtt.topicAck) - 1);
+  strncpy(result.mqtt.topicStatus, topics["status"] | "",
+          sizeof(result.mqtt.topicStatus) - 1);
+  strncpy(result.mqtt.tenantId, result.tenantId.c_str(),
+          sizeof(result.mqtt.tenantId) - 1);
+  strncpy(result.mqtt.deviceId, result.deviceId.c_str(),
+          sizeof(result.mqtt.deviceId) - 1);
+  result.mqtt.isValid = true;
+
+  result.success = true;
+  return true;
+}
+
 ClaimResult claimDevice(const char *serverUrl, const char *claimToken) {
   ClaimResult result;
   result.success = false;
@@ -14,6 +64,7 @@ ClaimResult claimDevice(const char *serverUrl, const char *claimToken) {
   client.setTimeout(15000); // 15 second timeout
 
   HTTPClient http;
+  http.setReuse(false); // One request: no keep-alive session to hold on to
 
   // Build URL: serverUrl might be like "https://api.example.com/api/v1"
   String url = String(serverUrl);
@@ -54,50 +105,8 @@ ClaimResult claimDevice(const char *serverUrl, const char *claimToken) {
     String response = http.getString();
     Serial.printf("[Claim] Response: %s\n", response.c_str());
 
-    JsonDocument responseDoc;
-    DeserializationError error = deserializeJson(responseDoc, response);
-
-    if (error) {
-      result.error = "Failed to parse response: " + String(error.c_str());
-      http.end();
-      return result;
-    }
-
-    if (responseDoc["success"].as<bool>() == true) {
-      JsonObject data = responseDoc["data"];
-
-      result.deviceId = data["deviceId"].as<String>();
-      result.tenantId = data["tenantId"].as<String>();
-
-      JsonObject mqtt = data["mqtt"];
-      strncpy(result.mqtt.broker, mqtt["broker"] | "",
-              sizeof(result.mqtt.broker) - 1);
-      strncpy(result.mqtt.clientId, mqtt["clientId"] | "",
-              sizeof(result.mqtt.clientId) - 1);
-      strncpy(result.mqtt.username, mqtt["username"] | "",
-              sizeof(result.mqtt.username) - 1);
-      strncpy(result.mqtt.password, mqtt["password"] | "",
-              sizeof(result.mqtt.password) - 1);
-
-      JsonObject topics = mqtt["topics"];
-      strncpy(result.mqtt.topicTelemetry, topics["telemetry"] | "",
-              sizeof(result.mqtt.topicTelemetry) - 1);
-      strncpy(result.mqtt.topicCommands, topics["commands"] | "",
-              sizeof(result.mqtt.topicCommands) - 1);
-      strncpy(result.mqtt.topicAck, topics["ack"] | "",
-              sizeof(result.mqtt.topicAck) - 1);
-      strncpy(result.mqtt.topicStatus, topics["status"] | "",
-              sizeof(result.mqtt.topicStatus) - 1);
-      strncpy(result.mqtt.tenantId, result.tenantId.c_str(),
-              sizeof(result.mqtt.tenantId) - 1);
-      strncpy(result.mqtt.deviceId, result.deviceId.c_str(),
-              sizeof(result.mqtt.deviceId) - 1);
-      result.mqtt.isValid = true;
-
-      result.success = true;
+    if (claimParseResponse(response.c_str(), response.length(), result)) {
       Serial.println("[Claim] Device claimed successfully!");
-    } else {
-      result.error = responseDoc["error"].as<String>();
     }
   } else if (httpCode > 0) {
     String response = http.getString();
@@ -113,6 +122,9 @@ ClaimResult claimDevice(const char *serverUrl, const char *claimToken) {
     result.error = "Connection failed: " + http.errorToString(httpCode);
   }
 
+  // Close here rather than in the destructors: the TLS session and its
+  // record buffers must be gone before the MQTT client opens its own
   http.end();
+  client.stop();
   return result;
 }
@@ -0,0 +1,77 @@
+#include "command_queue.h"
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static QueuedCommand slots[COMMAND_QUEUE_DEPTH];
+static uint8_t head = 0; // oldest
+static uint8_t count = 0;
+static CommandQueueStats stats = {};
+
+// ============================================================================
+// QUEUE
+// ============================================================================
+
+void commandQueueReset() {
+  head = 0;
+  count = 0;
+  stats = CommandQueueStats();
+}
+
+bool commandQueuePush(const uint8_t *payload, size_t length,
+                      uint32_t receivedMs, bool broadcast) {
+  if (count >= COMMAND_QUEUE_DEPTH || length > MQTT_BUFFER_SIZE) {
+    stats.dropped++;
+    return false;
+  }
+
+  QueuedCommand &slot = slots[(head + count) % COMMAND_QUEUE_DEPTH];
+  slot.receivedMs = receivedMs;
+  slot.broadcast = broadcast;
+  slot.length = length;
+  memcpy(slot.payload, payload, length);
+  slot.payload[length] = '\0';
+
+  count++;
+  stats.enqueued++;
+  if (count > stats.depthMax) {
+    stats.depthMax = count;
+  }
+  return true;
+}
+
+const QueuedCommand *commandQueuePeek() {
+  return count > 0 ? &slots[head] : nullptr;
+}
+
+void commandQueuePop() {
+  if (count == 0) {
+    return;
+  }
+  head = (head + 1) % COMMAND_QUEUE_DEPTH;
+  count--;
+}
+
+uint8_t commandQueueDepth() { return count; }
+
+// ============================================================================
+// METRICS
+// ============================================================================
+
+void commandQueueRecord(uint32_t waitMs, uint32_t runMs, uint32_t budgetMs) {
+  stats.executed++;
+  stats.waitTotalMs += waitMs;
+  if (waitMs > stats.waitMaxMs) {
+    stats.waitMaxMs = waitMs;
+  }
+  if (runMs > stats.runMaxMs) {
+    stats.runMaxMs = runMs;
+  }
+  if (runMs > budgetMs) {
+    stats.overruns++;
+  }
+}
+
+CommandQueueStats commandQueueGetStats() { return stats; }
@@ -0,0 +1,301 @@
+#include "crash_report.h"
+#include "config.h"
+#include "factory_image.h"
+#include "storage.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_partition.h>
+#include <esp_system.h>
+#include <string.h>
+
+#ifndef RTC_NOINIT_ATTR
+#define RTC_NOINIT_ATTR // host: a static survives a simulated restart
+#endif
+
+#define CRASH_MARKER_MAGIC 0x43524153 // "CRAS"
+#define CRASH_HEADER_LEN 8            // report id + chunk index
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+// Written every loop pass, read once by the next boot
+struct UptimeMarker {
+  uint32_t magic;
+  uint32_t bootId;
+  uint32_t uptimeMs;
+};
+
+static RTC_NOINIT_ATTR UptimeMarker marker;
+
+static esp_reset_reason_t resetReason = ESP_RST_UNKNOWN;
+static const esp_partition_t *partition = nullptr;
+static CrashRecord report;
+static bool pending = false;
+static bool beginSent = false;
+static bool endSent = false;
+static uint32_t reportId = 0;
+static uint32_t dumpSize = 0;
+static uint32_t dumpCrc = 0;
+static uint32_t chunks = 0;
+static uint32_t unsent[(CRASH_MAX_CHUNKS + 31) / 32]; // bit set: still to go
+static uint32_t lastSendMs = 0;
+static CrashPublishFn publisher = nullptr;
+
+// Indexed by esp_reset_reason_t
+static const char *const reasonNames[] = {
+    "unknown",  "poweron", "ext",       "sw",       "panic", "int_wdt",
+    "task_wdt", "wdt",     "deepsleep", "brownout", "sdio",
+};
+
+static const char *reasonName(uint8_t reason) {
+  return reason < sizeof(reasonNames) / sizeof(reasonNames[0])
+             ? reasonNames[reason]
+             : "unknown";
+}
+
+static bool abnormal(esp_reset_reason_t reason) {
+  return reason == ESP_RST_PANIC || reason == ESP_RST_INT_WDT ||
+         reason == ESP_RST_TASK_WDT || reason == ESP_RST_WDT ||
+         reason == ESP_RST_BROWNOUT || reason == ESP_RST_UNKNOWN;
+}
+
+// ============================================================================
+// DUMP
+// ============================================================================
+
+// The dump starts with its total length; erased flash reads 0xFFFFFFFF
+static uint32_t readDumpSize() {
+  uint32_t length = 0;
+  if (!partition ||
+      esp_partition_read(partition, 0, &length, sizeof(length)) != ESP_OK ||
+      length == 0xFFFFFFFF || length < 4 || length > partition->size) {
+    return 0;
+  }
+  return length;
+}
+
+static uint32_t dumpCrc32() {
+  uint8_t block[256];
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < dumpSize; offset += sizeof(block)) {
+    size_t length = min((uint32_t)sizeof(block), dumpSize - offset);
+    if (esp_partition_read(partition, offset, block, length) != ESP_OK) {
+      return 0;
+    }
+    crc = factoryCrc32(block, length, crc);
+  }
+  return crc;
+}
+
+static void markAllUnsent() {
+  memset(unsent, 0, sizeof(unsent));
+  for (uint32_t i = 0; i < chunks; i++) {
+    unsent[i / 32] |= 1UL << (i % 32);
+  }
+}
+
+static int32_t nextUnsent() {
+  for (uint32_t i = 0; i < chunks; i++) {
+    if (unsent[i / 32] & (1UL << (i % 32))) {
+      return (int32_t)i;
+    }
+  }
+  return -1;
+}
+
+// ============================================================================
+// BOOT
+// ============================================================================
+
+void crashReportSetPublisher(CrashPublishFn publish) { publisher = publish; }
+
+void crashReportBegin(uint32_t bootId) {
+  resetReason = esp_reset_reason();
+  bool markerValid = marker.magic == CRASH_MARKER_MAGIC;
+  UptimeMarker previous = marker;
+  marker.magic = CRASH_MARKER_MAGIC;
+  marker.bootId = bootId;
+  marker.uptimeMs = 0;
+
+  if (markerValid) {
+    Serial.printf("[Crash] Reset reason: %s (boot %08x was up %u ms)\n",
+                  reasonName(resetReason), (unsigned)previous.bootId,
+                  (unsigned)previous.uptimeMs);
+  } else {
+    Serial.printf("[Crash] Reset reason: %s\n", reasonName(resetReason));
+  }
+
+  partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                       ESP_PARTITION_SUBTYPE_DATA_COREDUMP,
+                                       nullptr);
+  dumpSize = readDumpSize();
+  if (dumpSize > CRASH_MAX_CHUNKS * CRASH_CHUNK_SIZE) {
+    Serial.printf("[Crash] Core dump of %u bytes too large to send\n",
+                  (unsigned)dumpSize);
+    dumpSize = 0;
+  }
+
+  // A dump not yet confirmed keeps the id and cause it was first sent
+  // with, unless this boot follows a new crash that replaced it
+  report = storageLoadCrash();
+  if (dumpSize > 0 && report.isValid && !abnormal(resetReason)) {
+    Serial.printf("[Crash] Core dump of report %s not confirmed yet\n",
+                  report.id);
+  } else if (dumpSize > 0 || abnormal(resetReason)) {
+    report = CrashRecord();
+    snprintf(report.id, sizeof(report.id), "%08x", (unsigned)bootId);
+    if (markerValid) {
+      snprintf(report.crashedBoot, sizeof(report.crashedBoot), "%08x",
+               (unsigned)previous.bootId);
+      report.uptimeMs = previous.uptimeMs;
+    }
+    report.reason = resetReason;
+    report.isValid = true;
+    if (dumpSize > 0) {
+      storageSaveCrash(report);
+    }
+  } else {
+    return;
+  }
+
+  reportId = strtoul(report.id, nullptr, 16);
+  dumpCrc = dumpCrc32();
+  chunks = (dumpSize + CRASH_CHUNK_SIZE - 1) / CRASH_CHUNK_SIZE;
+  markAllUnsent();
+  beginSent = false;
+  endSent = false;
+  pending = true;
+  Serial.printf("[Crash] Report %s: %s, %u byte core dump\n", report.id,
+                reasonName(report.reason), (unsigned)dumpSize);
+}
+
+void crashReportTick(uint32_t nowMs) { marker.uptimeMs = nowMs; }
+
+// ============================================================================
+// UPLOAD
+// ============================================================================
+
+static bool sendBegin() {
+  JsonDocument doc;
+  doc["type"] = "begin";
+  doc["id"] = report.id;
+  doc["reason"] = reasonName(report.reason);
+  if (report.crashedBoot[0]) {
+    doc["crashedBoot"] = report.crashedBoot;
+    doc["uptimeMs"] = report.uptimeMs;
+  }
+  doc["fw"] = FIRMWARE_VERSION;
+  doc["dumpSize"] = dumpSize;
+  doc["chunkSize"] = CRASH_CHUNK_SIZE;
+  doc["chunks"] = chunks;
+  char crc[9];
+  snprintf(crc, sizeof(crc), "%08x", (unsigned)dumpCrc);
+  doc["crc32"] = crc;
+  char payload[320];
+  size_t length = serializeJson(doc, payload, sizeof(payload));
+  return publisher(false, (const uint8_t *)payload, length);
+}
+
+static bool sendEnd() {
+  JsonDocument doc;
+  doc["type"] = "end";
+  doc["id"] = report.id;
+  doc["chunks"] = chunks;
+  char payload[96];
+  size_t length = serializeJson(doc, payload, sizeof(payload));
+  return publisher(false, (const uint8_t *)payload, length);
+}
+
+static bool sendChunk(uint32_t index) {
+  static uint8_t payload[CRASH_HEADER_LEN + CRASH_CHUNK_SIZE];
+  uint32_t offset = index * CRASH_CHUNK_SIZE;
+  uint32_t length = min((uint32_t)CRASH_CHUNK_SIZE, dumpSize - offset);
+  for (int i = 0; i < 4; i++) {
+    payload[i] = (uint8_t)(reportId >> (24 - 8 * i));
+    payload[4 + i] = (uint8_t)(index >> (24 - 8 * i));
+  }
+  if (esp_partition_read(partition, offset, payload + CRASH_HEADER_LEN,
+                         length) != ESP_OK) {
+    return true; // nothing sensible to send; the platform will see the gap
+  }
+  return publisher(true, payload, CRASH_HEADER_LEN + length);
+}
+
+void crashReportService(uint32_t nowMs, bool idle) {
+  if (!pending || !publisher || !idle ||
+      nowMs - lastSendMs < CRASH_CHUNK_INTERVAL_MS) {
+    return;
+  }
+  int32_t next = nextUnsent();
+  bool sent;
+  if (!beginSent) {
+    sent = beginSent = sendBegin();
+  } else if (next >= 0) {
+    sent = sendChunk((uint32_t)next);
+    if (sent) {
+      unsent[next / 32] &= ~(1UL << (next % 32));
+    }
+  } else if (!endSent) {
+    sent = endSent = sendEnd();
+    if (sent) {
+      Serial.printf("[Crash] Report %s sent\n", report.id);
+      // Without a dump there is nothing for the platform to confirm
+      pending = dumpSize > 0;
+    }
+  } else {
+    return; // waiting for crash_report
+  }
+  if (sent) {
+    lastSendMs = nowMs;
+  }
+}
+
+static bool isCurrent(const char *id, const char **error) {
+  if (!pending || !id || strcmp(id, report.id) != 0) {
+    *error = "Unknown report";
+    return false;
+  }
+  return true;
+}
+
+bool crashReportResend(const char *id, const uint32_t *list, size_t count,
+                       const char **error) {
+  if (!isCurrent(id, error)) {
+    return false;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (list[i] >= chunks) {
+      *error = "Chunk out of range";
+      return false;
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    unsent[list[i] / 32] |= 1UL << (list[i] % 32);
+  }
+  endSent = false;
+  return true;
+}
+
+bool crashReportErase(const char *id, const char **error) {
+  if (!isCurrent(id, error)) {
+    return false;
+  }
+  if (dumpSize > 0 &&
+      esp_partition_erase_range(partition, 0, partition->size) != ESP_OK) {
+    *error = "Erase failed";
+    return false;
+  }
+  storageClearCrash();
+  pending = false;
+  Serial.printf("[Crash] Report %s confirmed, core dump erased\n", report.id);
+  return true;
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+const char *crashReportResetReason() { return reasonName(resetReason); }
+
+bool crashReportPending() { return pending; }
@@ -0,0 +1,122 @@
+#include "derived_metrics.h"
+#include <math.h>
+
+// ============================================================================
+// SATURATION VAPOUR PRESSURE
+// ============================================================================
+
+#define TABLE_MIN_CENTI -4000
+#define TABLE_MAX_CENTI 8000
+#define TABLE_STEP_CENTI 100
+#define TABLE_SIZE 121
+
+// 6.112 * exp(17.62 * t / (243.12 + t)) in thousandths of a hPa, for
+// t = -40..80 °C
+static const uint32_t saturationMilliHpa[TABLE_SIZE] = {
+    190,    211,    234,    259,    286,    316,    348,    384,    423,
+    465,    512,    562,    617,    676,    741,    811,    887,    970,
+    1059,   1155,   1260,   1372,   1494,   1625,   1766,   1919,   2083,
+    2259,   2448,   2652,   2870,   3105,   3356,   3625,   3913,   4222,
+    4552,   4904,   5281,   5683,   6112,   6569,   7057,   7576,   8129,
+    8717,   9343,   10008,  10714,  11464,  12260,  13105,  14000,  14948,
+    15953,  17017,  18142,  19333,  20591,  21921,  23326,  24809,  26374,
+    28025,  29766,  31601,  33533,  35569,  37711,  39966,  42337,  44830,
+    47450,  50203,  53094,  56128,  59313,  62653,  66156,  69827,  73675,
+    77704,  81924,  86341,  90963,  95797,  100852, 106137, 111659, 117427,
+    123452, 129741, 136304, 143152, 150294, 157742, 165504, 173593, 182020,
+    190796, 199933, 209443, 219338, 229632, 240337, 251467, 263035, 275056,
+    287543, 300512, 313977, 327954, 342458, 357506, 373114, 389299, 406077,
+    423468, 441487, 460155, 479489,
+};
+
+static uint32_t saturationPressure(int32_t temperatureCenti) {
+  if (temperatureCenti <= TABLE_MIN_CENTI) {
+    return saturationMilliHpa[0];
+  }
+  if (temperatureCenti >= TABLE_MAX_CENTI) {
+    return saturationMilliHpa[TABLE_SIZE - 1];
+  }
+  uint32_t offset = temperatureCenti - TABLE_MIN_CENTI;
+  uint32_t i = offset / TABLE_STEP_CENTI;
+  uint32_t fraction = offset % TABLE_STEP_CENTI;
+  uint32_t low = saturationMilliHpa[i];
+  return low + (saturationMilliHpa[i + 1] - low) * fraction / TABLE_STEP_CENTI;
+}
+
+// The temperature at which the table reaches pressure: a binary search for
+// the degree, then linear within it
+static int16_t saturationTemperature(uint32_t pressure) {
+  if (pressure <= saturationMilliHpa[0]) {
+    return TABLE_MIN_CENTI;
+  }
+  if (pressure >= saturationMilliHpa[TABLE_SIZE - 1]) {
+    return TABLE_MAX_CENTI;
+  }
+  uint32_t low = 0;
+  uint32_t high = TABLE_SIZE - 1;
+  while (high - low > 1) {
+    uint32_t mid = (low + high) / 2;
+    if (saturationMilliHpa[mid] <= pressure) {
+      low = mid;
+    } else {
+      high = mid;
+    }
+  }
+  uint32_t span = saturationMilliHpa[high] - saturationMilliHpa[low];
+  uint32_t above = pressure - saturationMilliHpa[low];
+  return TABLE_MIN_CENTI + low * TABLE_STEP_CENTI +
+         (above * TABLE_STEP_CENTI + span / 2) / span;
+}
+
+// ============================================================================
+// HEAT INDEX
+// ============================================================================
+
+// NWS formulation in °F; single precision is plenty for a "feels like"
+static int16_t heatIndex(int16_t temperatureCenti, int16_t humidityCenti) {
+  float t = temperatureCenti * 0.018f + 32.0f;
+  float rh = humidityCenti * 0.01f;
+
+  float hi = 0.5f * (t + 61.0f + (t - 68.0f) * 1.2f + rh * 0.094f);
+  if ((hi + t) * 0.5f >= 80.0f) {
+    hi = -42.379f + 2.04901523f * t + 10.14333127f * rh -
+         0.22475541f * t * rh - 0.00683783f * t * t -
+         0.05481717f * rh * rh + 0.00122874f * t * t * rh +
+         0.00085282f * t * rh * rh - 0.00000199f * t * t * rh * rh;
+    if (rh < 13.0f && t > 80.0f && t < 112.0f) {
+      hi -= (13.0f - rh) * 0.25f * sqrtf((17.0f - fabsf(t - 95.0f)) / 17.0f);
+    } else if (rh > 85.0f && t > 80.0f && t < 87.0f) {
+      hi += (rh - 85.0f) * 0.1f * (87.0f - t) * 0.2f;
+    }
+  }
+
+  // The regression runs away far outside the conditions it was fitted to
+  float celsiusCenti = (hi - 32.0f) * (100.0f / 1.8f);
+  if (celsiusCenti >= INT16_MAX) {
+    return INT16_MAX;
+  }
+  return (int16_t)(celsiusCenti < 0 ? celsiusCenti - 0.5f
+                                    : celsiusCenti + 0.5f);
+}
+
+// ============================================================================
+// DERIVED METRICS
+// ============================================================================
+
+void derivedCompute(int16_t temperatureCenti, int16_t humidityCenti,
+                    DerivedMetrics &out) {
+  uint32_t humidity = humidityCenti < 0      ? 0
+                      : humidityCenti > 10000 ? 10000
+                                              : humidityCenti;
+  uint32_t vapour =
+      (uint64_t)saturationPressure(temperatureCenti) * humidity / 10000;
+
+  out.dewPointCenti = saturationTemperature(vapour);
+
+  // 216.7 g K / (m³ hPa) * e / T, with e in thousandths and T in hundredths
+  uint32_t kelvinCenti = 27315 + temperatureCenti;
+  out.absoluteHumidityCenti =
+      (int16_t)(((uint64_t)vapour * 2167 + kelvinCenti / 2) / kelvinCenti);
+
+  out.heatIndexCenti = heatIndex(temperatureCenti, humidityCenti);
+}
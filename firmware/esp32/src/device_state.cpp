@@ -0,0 +1,82 @@
+#include "device_state.h"
+#include <atomic>
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#else
+#include <thread>
+#endif
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+// The payload is kept in atomic words rather than a plain struct so a reader
+// racing a writer is well-defined. Release stores / acquire loads on the
+// words (instead of standalone fences) order them against the sequence
+// counter in a way TSan can model.
+#define DEVICE_STATE_WORDS ((sizeof(DeviceState) + 3) / 4)
+
+// After this many back-to-back conflicts the reader gives up its time slice:
+// on a single core a spinning reader would starve a preempted writer
+#define DEVICE_STATE_SPIN_LIMIT 64
+
+static std::atomic<uint32_t> sequence(0); // odd while a write is in progress
+static std::atomic<uint32_t> words[DEVICE_STATE_WORDS];
+
+static void backOff() {
+#ifdef ARDUINO_ARCH_ESP32
+  vTaskDelay(1);
+#else
+  std::this_thread::yield();
+#endif
+}
+
+// ============================================================================
+// READ / WRITE
+// ============================================================================
+
+uint32_t deviceStateRead(DeviceState &out, uint32_t *retries) {
+  uint32_t copy[DEVICE_STATE_WORDS];
+  uint32_t attempts = 0;
+  uint32_t before;
+  uint32_t after;
+
+  for (;;) {
+    before = sequence.load(std::memory_order_acquire);
+    if ((before & 1) == 0) {
+      for (size_t i = 0; i < DEVICE_STATE_WORDS; i++) {
+        copy[i] = words[i].load(std::memory_order_acquire);
+      }
+      after = sequence.load(std::memory_order_relaxed);
+      if (before == after) {
+        break;
+      }
+    }
+    attempts++;
+    if (attempts % DEVICE_STATE_SPIN_LIMIT == 0) {
+      backOff();
+    }
+  }
+
+  memcpy(&out, copy, sizeof(DeviceState));
+  if (retries) {
+    *retries = attempts;
+  }
+  return before / 2;
+}
+
+uint32_t deviceStateWrite(const DeviceState &state) {
+  uint32_t copy[DEVICE_STATE_WORDS] = {};
+  memcpy(copy, &state, sizeof(DeviceState));
+
+  uint32_t start = sequence.load(std::memory_order_relaxed);
+  sequence.store(start + 1, std::memory_order_relaxed);
+  for (size_t i = 0; i < DEVICE_STATE_WORDS; i++) {
+    words[i].store(copy[i], std::memory_order_release);
+  }
+  sequence.store(start + 2, std::memory_order_release);
+  return (start + 2) / 2;
+}
@@ -0,0 +1,111 @@
+#include "event_bus.h"
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static Event queue[EVENT_QUEUE_DEPTH];
+static uint8_t head = 0; // oldest
+static uint8_t count = 0;
+static const EventSubscriber *table = nullptr;
+static uint8_t tableSize = 0;
+static EventBusStats stats = {};
+
+void eventBusBegin(const EventSubscriber *subscribers,
+                   uint8_t subscriberCount) {
+  table = subscribers;
+  tableSize = subscriberCount;
+  head = 0;
+  count = 0;
+  stats = EventBusStats();
+}
+
+// ============================================================================
+// PUBLISH
+// ============================================================================
+
+// Next free record, type and time filled in; nullptr when full
+static Event *reserve(EventType type, uint32_t nowMs) {
+  if (count >= EVENT_QUEUE_DEPTH) {
+    stats.dropped++;
+    return nullptr;
+  }
+  Event &event = queue[(head + count) % EVENT_QUEUE_DEPTH];
+  memset(&event, 0, sizeof(event));
+  event.type = type;
+  event.timeMs = nowMs;
+
+  count++;
+  stats.published++;
+  if (count > stats.depthMax) {
+    stats.depthMax = count;
+  }
+  return &event;
+}
+
+bool eventPublishSample(const SampleEvent &sample, uint32_t nowMs) {
+  Event *event = reserve(EVENT_SAMPLE, nowMs);
+  if (event) {
+    event->sample = sample;
+  }
+  return event != nullptr;
+}
+
+bool eventPublishAlert(const AlertEvent &alert, uint32_t nowMs) {
+  Event *event = reserve(EVENT_ALERT, nowMs);
+  if (event) {
+    event->alert = alert;
+  }
+  return event != nullptr;
+}
+
+bool eventPublishCommand(const char *action, bool success, bool broadcast,
+                         bool statusChanged, uint32_t nowMs) {
+  Event *event = reserve(EVENT_COMMAND, nowMs);
+  if (!event) {
+    return false;
+  }
+  if (action) {
+    strncpy(event->command.action, action, EVENT_ACTION_MAX - 1);
+  }
+  event->command.success = success;
+  event->command.broadcast = broadcast;
+  event->command.statusChanged = statusChanged;
+  return true;
+}
+
+bool eventPublishConnectivity(ConnectivityChange change, uint32_t nowMs) {
+  Event *event = reserve(EVENT_CONNECTIVITY, nowMs);
+  if (event) {
+    event->connectivity.change = change;
+  }
+  return event != nullptr;
+}
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+uint8_t eventBusService() {
+  uint8_t dispatched = 0;
+  while (count > 0 && dispatched < EVENT_DISPATCH_MAX) {
+    // Copied out and released first: handlers may publish into the slot
+    Event event = queue[head];
+    head = (head + 1) % EVENT_QUEUE_DEPTH;
+    count--;
+
+    for (uint8_t i = 0; i < tableSize; i++) {
+      if (table[i].type == event.type) {
+        table[i].handler(event);
+      }
+    }
+    dispatched++;
+    stats.dispatched++;
+  }
+  return dispatched;
+}
+
+uint8_t eventBusDepth() { return count; }
+
+EventBusStats eventBusGetStats() { return stats; }
@@ -0,0 +1,169 @@
+#include "factory.h"
+#include "config.h"
+#include "factory_image.h"
+#include <Arduino.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <esp_partition.h>
+#include <nvs_flash.h>
+#endif
+
+#ifdef ARDUINO_ARCH_ESP32
+
+// ============================================================================
+// FLASH
+// ============================================================================
+
+static bool writeImage(const esp_partition_t *nvs, const uint8_t *image,
+                       size_t size) {
+  // Nothing may have NVS open while it is replaced underneath
+  nvs_flash_deinit();
+  if (esp_partition_erase_range(nvs, 0, nvs->size) != ESP_OK) {
+    return false;
+  }
+
+  // Page bodies first; with the state word still erased NVS treats every
+  // page as unused
+  for (size_t page = 0; page < size; page += FACTORY_PAGE_SIZE) {
+    if (esp_partition_write(nvs, page + 4, image + page + 4,
+                            FACTORY_PAGE_SIZE - 4) != ESP_OK) {
+      return false;
+    }
+  }
+
+  uint8_t readBack[256];
+  for (size_t offset = 0; offset < size; offset += sizeof(readBack)) {
+    if (esp_partition_read(nvs, offset, readBack, sizeof(readBack)) !=
+        ESP_OK) {
+      return false;
+    }
+    size_t from = offset % FACTORY_PAGE_SIZE == 0 ? 4 : 0;
+    if (memcmp(readBack + from, image + offset + from,
+               sizeof(readBack) - from) != 0) {
+      return false;
+    }
+  }
+
+  // Commit: the state words, back to back
+  for (size_t page = 0; page < size; page += FACTORY_PAGE_SIZE) {
+    if (esp_partition_write(nvs, page, image + page, 4) != ESP_OK) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// ============================================================================
+// SESSION
+// ============================================================================
+
+static void finish(const char *reason, uint32_t crc) {
+  if (reason) {
+    Serial.printf("@factory-error %s\n", reason);
+    Serial.printf("[Factory] Provisioning failed: %s\n", reason);
+  } else {
+    Serial.printf("@factory-ok %08lx\n", (unsigned long)crc);
+    Serial.println("[Factory] Provisioned, restarting");
+  }
+  Serial.flush();
+  delay(100);
+  ESP.restart();
+}
+
+// Errors before the speed switch go back on the same line and the unit
+// keeps listening; after it, every session ends in a restart
+static void runSession(const esp_partition_t *nvs, const char *args) {
+  unsigned long size = 0, crc = 0, baud = 0;
+  if (sscanf(args, "%lu %lx %lu", &size, &crc, &baud) != 3 || baud == 0) {
+    Serial.println("@factory-error bad begin");
+    return;
+  }
+  if (size == 0 || size > FACTORY_IMAGE_MAX || size > nvs->size) {
+    Serial.println("@factory-error size");
+    return;
+  }
+  uint8_t *image = (uint8_t *)malloc(size);
+  if (!image) {
+    Serial.println("@factory-error memory");
+    return;
+  }
+
+  // The receive buffer can only be resized while the UART is stopped
+  Serial.printf("@factory-baud %lu\n", baud);
+  Serial.flush();
+  Serial.end();
+  Serial.setRxBufferSize(FACTORY_RX_BUFFER);
+  Serial.begin(baud);
+
+  size_t received = 0;
+  uint32_t lastByteMs = millis();
+  while (received < size &&
+         millis() - lastByteMs < FACTORY_BYTE_TIMEOUT_MS) {
+    int available = Serial.available();
+    if (available > 0) {
+      size_t want = min((size_t)available, (size_t)size - received);
+      received += Serial.readBytes(image + received, want);
+      lastByteMs = millis();
+    }
+  }
+
+  const char *reason = nullptr;
+  if (received < size) {
+    reason = "timeout";
+  } else if (factoryCrc32(image, size) != crc) {
+    reason = "crc";
+  } else {
+    reason = factoryImageCheck(image, size, nvs->size);
+  }
+  if (!reason && !writeImage(nvs, image, size)) {
+    reason = "flash";
+  }
+  free(image);
+  finish(reason, crc);
+}
+
+#endif
+
+// ============================================================================
+// BOOT WINDOW
+// ============================================================================
+
+void factoryListen(uint32_t windowMs) {
+#ifdef ARDUINO_ARCH_ESP32
+  const esp_partition_t *nvs = esp_partition_find_first(
+      ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, nullptr);
+  if (!nvs) {
+    delay(windowMs);
+    return;
+  }
+  Serial.printf("@factory-ready %016llX %u\n", ESP.getEfuseMac(),
+                (unsigned)nvs->size);
+
+  char line[FACTORY_LINE_MAX];
+  size_t length = 0;
+  uint32_t start = millis();
+  while (millis() - start < windowMs) {
+    while (Serial.available()) {
+      char c = (char)Serial.read();
+      if (c == '\r') {
+        continue;
+      }
+      if (c != '\n') {
+        if (length < sizeof(line) - 1) {
+          line[length++] = c;
+        }
+        continue;
+      }
+      line[length] = '\0';
+      length = 0;
+      if (strncmp(line, "@factory-begin ", 15) == 0) {
+        runSession(nvs, line + 15);
+      }
+    }
+    delay(1);
+  }
+#else
+  // The host build has no serial input
+  delay(windowMs);
+#endif
+}
@@ -0,0 +1,53 @@
+#include "factory_image.h"
+
+// ============================================================================
+// CRC
+// ============================================================================
+
+uint32_t factoryCrc32(const uint8_t *data, size_t length, uint32_t crc) {
+  crc = ~crc;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+// ============================================================================
+// IMAGE CHECK
+// ============================================================================
+
+static uint32_t readLe32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+const char *factoryImageCheck(const uint8_t *image, size_t length,
+                              size_t partitionSize) {
+  if (length == 0 || length % FACTORY_PAGE_SIZE != 0) {
+    return "not whole pages";
+  }
+  if (length > partitionSize) {
+    return "larger than the NVS partition";
+  }
+
+  bool hasData = false;
+  for (size_t page = 0; page < length; page += FACTORY_PAGE_SIZE) {
+    uint32_t state = readLe32(image + page);
+    if (state == NVS_PAGE_STATE_ACTIVE || state == NVS_PAGE_STATE_FULL) {
+      hasData = true;
+    } else if (state == NVS_PAGE_STATE_UNINITIALIZED) {
+      // Unused pages are written erased; anything else is a broken image
+      for (size_t i = 4; i < FACTORY_PAGE_SIZE; i++) {
+        if (image[page + i] != 0xFF) {
+          return "data in an unused page";
+        }
+      }
+    } else {
+      return "page state NVS does not load";
+    }
+  }
+  return hasData ? nullptr : "no data";
+}
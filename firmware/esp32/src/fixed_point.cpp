@@ -0,0 +1,74 @@
+#include "fixed_point.h"
+
+int16_t fixedFromFloat(float value) {
+  float scaled = value * FIXED_SCALE;
+  if (scaled >= INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (scaled <= INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t)(scaled < 0 ? scaled - 0.5f : scaled + 0.5f);
+}
+
+// ============================================================================
+// FORMATTING
+// ============================================================================
+
+static size_t formatUnsigned(uint32_t value, char *out) {
+  char digits[10];
+  size_t count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  for (size_t i = 0; i < count; i++) {
+    out[i] = digits[count - 1 - i];
+  }
+  return count;
+}
+
+// magnitude is in units of the last printed place; the sign is left off
+// when the value rounded to zero, so nothing prints "-0.0"
+static size_t formatScaled(bool negative, uint32_t magnitude,
+                           uint8_t decimals, char *out) {
+  uint32_t unit = decimals == 2 ? 100 : decimals == 1 ? 10 : 1;
+  uint32_t fraction = magnitude % unit;
+  size_t length = 0;
+  if (negative && magnitude != 0) {
+    out[length++] = '-';
+  }
+  length += formatUnsigned(magnitude / unit, out + length);
+  if (decimals > 0) {
+    out[length++] = '.';
+    if (decimals == 2) {
+      out[length++] = '0' + fraction / 10;
+    }
+    out[length++] = '0' + fraction % 10;
+  }
+  out[length] = '\0';
+  return length;
+}
+
+size_t fixedFormat(int32_t value, uint8_t decimals, char *out) {
+  if (decimals > 2) {
+    decimals = 2;
+  }
+  bool negative = value < 0;
+  uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+  uint32_t dropped = decimals == 2 ? 1 : decimals == 1 ? 10 : 100;
+  magnitude = (magnitude + dropped / 2) / dropped;
+  return formatScaled(negative, magnitude, decimals, out);
+}
+
+size_t fixedFormatJson(int32_t value, char *out) {
+  bool negative = value < 0;
+  uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+  if (magnitude % 100 == 0) {
+    return formatScaled(negative, magnitude / 100, 0, out);
+  }
+  if (magnitude % 10 == 0) {
+    return formatScaled(negative, magnitude / 10, 1, out);
+  }
+  return formatScaled(negative, magnitude, 2, out);
+}
@@ -0,0 +1,54 @@
+#include "heap_stats.h"
+#include <Arduino.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+struct PhaseState {
+  uint32_t freeAtBegin;
+  uint32_t minAtBegin;
+  HeapPhaseStats stats;
+};
+
+static PhaseState phases[HEAP_PHASE_COUNT];
+
+static const char *const phaseNames[HEAP_PHASE_COUNT] = {"claim", "mqtt"};
+
+// ============================================================================
+// PHASES
+// ============================================================================
+
+void heapPhaseBegin(HeapPhase phase) {
+  phases[phase].freeAtBegin = ESP.getFreeHeap();
+  phases[phase].minAtBegin = ESP.getMinFreeHeap();
+}
+
+void heapPhaseEnd(HeapPhase phase) {
+  PhaseState &p = phases[phase];
+  uint32_t freeNow = ESP.getFreeHeap();
+  uint32_t minNow = ESP.getMinFreeHeap();
+
+  // The boot-wide low-water mark is the only peak the heap keeps; it tells
+  // how deep this phase went only if the phase set a new low
+  uint32_t peak = 0;
+  if (minNow < p.minAtBegin && minNow < p.freeAtBegin) {
+    peak = p.freeAtBegin - minNow;
+  }
+  uint32_t held = freeNow < p.freeAtBegin ? p.freeAtBegin - freeNow : 0;
+
+  if (peak > p.stats.peakBytes) {
+    p.stats.peakBytes = peak;
+  }
+  p.stats.heldBytes = held;
+  p.stats.runs++;
+
+  Serial.printf("[Heap] %s: peak %u, held %u, free %u, min %u, largest %u\n",
+                phaseNames[phase], (unsigned)peak, (unsigned)held,
+                (unsigned)freeNow, (unsigned)minNow,
+                (unsigned)ESP.getMaxAllocHeap());
+}
+
+HeapPhaseStats heapPhaseGetStats(HeapPhase phase) {
+  return phases[phase].stats;
+}
@@ -1,8 +1,33 @@
+#include "capabilities.h"
+#include "async_command.h"
+#include "bist.h"
+#include "broadcast.h"
 #include "claim.h"
+#include "command_queue.h"
 #include "config.h"
+#include "crash_report.h"
+#include "device_state.h"
 #include "esp_wifi.h"
+#include "event_bus.h"
+#include "factory.h"
+#include "fixed_point.h"
+#include "heap_stats.h"
+#include "mqtt_publish.h"
+#include "ota_mqtt.h"
+#include "ota_peer.h"
 #include "provisioning.h"
+#include "rollup.h"
+#include "sensor_pipeline.h"
 #include "storage.h"
+#include "telemetry.h"
+#include "thresholds.h"
+#include "timesync.h"
+#include "tls_profile.h"
+#include "topics.h"
+#include "trace.h"
+#ifdef THINGBASE_BENCH
+#include "bench.h"
+#endif
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <DHT.h>
@@ -30,10 +55,45 @@ bool buttonWasPressed = false;
 DHT dht(DHT_PIN, DHT_TYPE);
 unsigned long lastHeartbeat = 0;
 unsigned long lastSensorRead = 0;
-bool alertMode = false;
-bool sensorConnected = false;
-float lastTemperature = 0;
-float lastHumidity = 0;
+
+// Telemetry profile (selected by the platform, see capabilities.h)
+uint8_t activeProfile = PROFILE_FULL;
+uint8_t telemetrySinceFull = 0;
+bool lastSentLed = false;
+bool lastSentAlertLed = false;
+bool lastSentAlert = false;
+bool lastSentSensorConnected = false;
+
+// Time sync (see timesync.h)
+char topicTime[128];
+bool timeSyncRoundDue = true;
+bool timeSyncRoundActive = false;
+uint8_t timeSyncRequestsSent = 0;
+unsigned long lastTimeSyncRequest = 0;
+unsigned long lastTimeSyncRound = 0;
+
+// Firmware update over MQTT (see ota_mqtt.h)
+char topicOtaData[128];
+char topicOtaRequest[128];
+bool otaRestartPending = false;
+
+// Where the running update gets its bytes (see ota_peer.h)
+char otaSha256Hex[65];
+bool otaFromCloud = false;
+bool otaServeImage = OTA_PEER_SERVE_DEFAULT;
+
+// Crash report of the previous boot (see crash_report.h)
+char topicCrash[128];
+char topicCrashData[128];
+
+// Closed rollup buckets go to .../rollup (see rollup.h)
+char topicRollup[128];
+
+// Boot-time self-test (see bist.h); status goes out again once it is done
+bool statusHasBist = false;
+
+// Last connection state announced on the event bus
+bool mqttUp = false;
 
 // ============================================================================
 // FORWARD DECLARATIONS
@@ -41,26 +101,95 @@ float lastHumidity = 0;
 
 void onProvisioningComplete(bool success);
 void connectToWiFi();
+void waitRunningBist(unsigned long ms);
 void connectToMQTT();
 void mqttCallback(char *topic, byte *payload, unsigned int length);
+void serviceCommands();
+void executeCommand(const QueuedCommand &queued);
 void sendTelemetry();
 void sendStatus(bool online);
-void handleCommand(const JsonObject &command);
+void handleCommand(const JsonObject &command, bool broadcast);
+void subscribeBroadcastTopics(bool subscribe);
+const AsyncAction *findAsyncAction(const char *action);
+bool publishAck(const char *payload);
+bool publishOtaRequest(const char *payload);
+bool publishCrash(bool data, const uint8_t *payload, size_t length);
+bool publishRollup(const char *payload);
+void subscribeOtaData(bool subscribe);
+bool mqttPublish(const char *topic, const char *payload,
+                 bool retained = false);
 void checkFactoryReset();
 
+// Time sync functions
+void serviceTimeSync();
+void sendTimeSyncRequest(uint32_t t0);
+void setTimestamp(JsonDocument &doc, unsigned long localMs);
+
 // Warehouse monitoring functions
-void readSensorAndCheckThresholds();
+bool sensorAcquire(PipelineBatch &batch, uint32_t nowMs);
+bool sensorPublish(PipelineBatch &batch, uint32_t nowMs);
+void publishSample(const DeviceState &state, uint8_t exceeded);
+void bistReadSensor(float *temperature, float *humidity);
 void heartbeatBlink();
 void triggerAlert();
 void clearAlert();
 
+// Event subscribers
+void onSampleTelemetry(const Event &event);
+void onSampleAlert(const Event &event);
+void onAlertChange(const Event &event);
+void onCommandStatus(const Event &event);
+void onConnectivityMqtt(const Event &event);
+void onConnectivityTelemetry(const Event &event);
+void onConnectivityStatus(const Event &event);
+void onSampleRollup(const Event &event);
+
+// ============================================================================
+// EVENT SUBSCRIBERS (see event_bus.h)
+// ============================================================================
+
+// Every consumer of every event; handlers of one type run in this order
+static const EventSubscriber eventSubscribers[] = {
+    {EVENT_SAMPLE, onSampleTelemetry},
+    {EVENT_SAMPLE, onSampleAlert},
+    {EVENT_SAMPLE, onSampleRollup},
+    {EVENT_ALERT, onAlertChange},
+    {EVENT_COMMAND, onCommandStatus},
+    {EVENT_CONNECTIVITY, onConnectivityMqtt},
+    {EVENT_CONNECTIVITY, onConnectivityTelemetry},
+    {EVENT_CONNECTIVITY, onConnectivityStatus},
+};
+
+// ============================================================================
+// SENSOR PIPELINE STAGES (see sensor_pipeline.h)
+// ============================================================================
+
+static const PipelineStage sensorStages[] = {
+    {"acquire", sensorAcquire},
+    {"filter", pipelineFilter},
+#if DERIVED_METRICS_ENABLED
+    {"derive", pipelineDerive},
+#endif
+    {"aggregate", pipelineAggregate},
+    {"rules", pipelineRules},
+    {"publish", sensorPublish},
+};
+
 // ============================================================================
 // SETUP & LOOP
 // ============================================================================
 
 void setup() {
   Serial.begin(115200);
-  delay(1000);
+  factoryListen(FACTORY_LISTEN_MS);
+
+#ifdef THINGBASE_TRACE
+  traceSetSink([](const char *line) { Serial.println(line); });
+#endif
+
+#ifdef THINGBASE_BENCH
+  benchSerialMain();
+#endif
 
   Serial.println();
   Serial.println("========================================");
@@ -84,8 +213,41 @@ void setup() {
   dht.begin();
   Serial.println("[Sensor] DHT22 initialized on GPIO 4");
 
+  // Checks run while WiFi associates; nothing here waits for them
+  bistBegin(millis(), bistReadSensor);
+
   // Initialize storage
   storageInit();
+  activeProfile = storageLoadProfile();
+  if (!capabilitiesProfileSupported(activeProfile)) {
+    activeProfile = PROFILE_FULL;
+  }
+  asyncCommandSetPublisher(publishAck);
+  broadcastInit();
+  broadcastSetPublisher(publishAck);
+  otaMqttSetPublisher(publishOtaRequest);
+  crashReportSetPublisher(publishCrash);
+  rollupSetPublisher(publishRollup);
+  rollupBegin();
+  eventBusBegin(eventSubscribers,
+                sizeof(eventSubscribers) / sizeof(eventSubscribers[0]));
+  pipelineBegin(sensorStages, sizeof(sensorStages) / sizeof(sensorStages[0]));
+
+  // Before the first handshake, which may be the pending claim below
+  const TlsProfile *tlsProfile = tlsProfileFind(TLS_PROFILE);
+  if (tlsProfile) {
+    size_t suites = tlsProfileApply(*tlsProfile);
+    if (suites > 0) {
+      Serial.printf("[TLS] Profile %s: %u suites\n", tlsProfile->name,
+                    (unsigned)suites);
+    } else {
+      Serial.printf("[TLS] Profile %s: library defaults\n", tlsProfile->name);
+    }
+  }
+  uint32_t bootId = esp_random();
+  telemetryBegin(bootId);
+  Serial.printf("[Telemetry] Boot ID %s\n", telemetryBootId());
+  crashReportBegin(bootId);
 
   // Check if we have a pending claim (after reboot from provisioning)
   Preferences prefs;
@@ -165,7 +327,9 @@ void setup() {
                       WiFi.localIP().toString().c_str());
         Serial.println("[Main] Calling claim API...");
 
+        heapPhaseBegin(HEAP_PHASE_CLAIM);
         ClaimResult result = claimDevice(claimUrl.c_str(), claimToken.c_str());
+        heapPhaseEnd(HEAP_PHASE_CLAIM);
 
         if (result.success) {
           Serial.println("[Main] CLAIM SUCCESS!");
@@ -224,15 +388,37 @@ void setup() {
 }
 
 void loop() {
+  crashReportTick(millis());
+  bistService(millis());
+
   // Check for factory reset button
   checkFactoryReset();
 
+  // What the last pass published: telemetry, alerts, status, reconnects
+  eventBusService();
+
   // If in provisioning mode, nothing else to do
   if (provisioningIsActive()) {
     return;
   }
 
+  // Long-running commands keep going while offline; results wait for MQTT
+  asyncCommandService(millis());
+  broadcastService(millis());
+
+  // Buckets close on time offline too; they are sent once connected
+  rollupService(millis(), mqttClient.connected());
+
+  // A verified MQTT update boots once its result is out and no job runs
+  if (otaRestartPending && asyncCommandActiveCount() == 0) {
+    otaRestartPending = false;
+    Serial.println("[OTA] Restarting into the new firmware...");
+    delay(OTA_MQTT_RESTART_DELAY_MS);
+    ESP.restart();
+  }
+
   // Handle WiFi reconnection
+  TRACE_WIFI_STATUS(WiFi.status());
   if (WiFi.status() != WL_CONNECTED) {
     Serial.println("[Main] WiFi disconnected, reconnecting...");
     connectToWiFi();
@@ -241,6 +427,10 @@ void loop() {
 
   // Handle MQTT
   if (!mqttClient.connected()) {
+    if (mqttUp) {
+      mqttUp = false;
+      eventPublishConnectivity(CONNECTIVITY_MQTT_DOWN, millis());
+    }
     unsigned long now = millis();
     if (now - lastReconnectAttempt > MQTT_RECONNECT_DELAY_MS) {
       lastReconnectAttempt = now;
@@ -248,29 +438,30 @@ void loop() {
     }
   } else {
     mqttClient.loop();
-  }
-
-  // Send telemetry periodically
-  unsigned long now = millis();
-  if (now - lastTelemetryTime > TELEMETRY_INTERVAL_MS) {
-    lastTelemetryTime = now;
-    if (mqttClient.connected()) {
-      sendTelemetry();
+    serviceCommands();
+    serviceTimeSync();
+    crashReportService(millis(), commandQueueDepth() == 0 &&
+                                     asyncCommandActiveCount() == 0);
+    if (bistDone() && !statusHasBist) {
+      sendStatus(true);
     }
   }
 
   // Heartbeat blink (every 5 seconds, only when not in alert mode)
+  unsigned long now = millis();
   if (now - lastHeartbeat >= HEARTBEAT_INTERVAL_MS) {
     lastHeartbeat = now;
-    if (!alertMode) {
+    DeviceState state;
+    deviceStateRead(state);
+    if (!state.alert) {
       heartbeatBlink();
     }
   }
 
-  // Read sensor and check thresholds (every 2 seconds)
+  // Read the sensor through the pipeline (every 2 seconds)
   if (now - lastSensorRead >= SENSOR_READ_INTERVAL_MS) {
     lastSensorRead = now;
-    readSensorAndCheckThresholds();
+    pipelineRun(now);
   }
 }
 
@@ -281,8 +472,7 @@ void loop() {
 void onProvisioningComplete(bool success) {
   if (success) {
     Serial.println("[Main] Provisioning successful! Loading credentials...");
-    mqttCreds = storageLoadMqtt();
-    connectToMQTT();
+    eventPublishConnectivity(CONNECTIVITY_PROVISIONED, millis());
   } else {
     Serial.println("[Main] Provisioning failed. Restarting provisioning...");
     delay(2000);
@@ -290,6 +480,13 @@ void onProvisioningComplete(bool success) {
   }
 }
 
+void onConnectivityMqtt(const Event &event) {
+  if (event.connectivity.change == CONNECTIVITY_PROVISIONED) {
+    mqttCreds = storageLoadMqtt();
+    connectToMQTT();
+  }
+}
+
 // ============================================================================
 // WIFI
 // ============================================================================
@@ -309,8 +506,9 @@ void connectToWiFi() {
   unsigned long startTime = millis();
   while (WiFi.status() != WL_CONNECTED &&
          millis() - startTime < WIFI_CONNECT_TIMEOUT_MS) {
-    delay(500);
+    waitRunningBist(500);
     Serial.print(".");
+    TRACE_WIFI_STATUS(WiFi.status());
   }
   Serial.println();
 
@@ -322,6 +520,19 @@ void connectToWiFi() {
   }
 }
 
+// The association wait is dead time, so the self-test fills it
+void waitRunningBist(unsigned long ms) {
+  unsigned long start = millis();
+  while (!bistDone() && millis() - start < ms) {
+    bistService(millis());
+    delay(BIST_WAIT_STEP_MS);
+  }
+  unsigned long waited = millis() - start;
+  if (waited < ms) {
+    delay(ms - waited);
+  }
+}
+
 // ============================================================================
 // MQTT
 // ============================================================================
@@ -362,7 +573,10 @@ void connectToMQTT() {
 
   // Configure client based on TLS requirement
   if (useTLS) {
-    // Use secure client for mqtts:// connections (HiveMQ Cloud, etc.)
+    // Use secure client for mqtts:// connections (HiveMQ Cloud, etc.).
+    // A session that died without stop() still holds its record buffers;
+    // free them before the handshake allocates a new set.
+    espSecureClient.stop();
     espSecureClient
         .setInsecure(); // Skip certificate verification (for simplicity)
     mqttClient.setClient(espSecureClient);
@@ -371,14 +585,13 @@ void connectToMQTT() {
     mqttClient.setClient(espClient);
   }
 
-  mqttClient.setBufferSize(512);
+  mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
   mqttClient.setServer(host.c_str(), port);
   mqttClient.setCallback(mqttCallback);
 
-  // Create LWT payload
+  // Create LWT payload (no timestamp: the broker publishes it much later)
   JsonDocument lwtDoc;
   lwtDoc["status"] = "offline";
-  lwtDoc["timestamp"] = "2024-01-01T00:00:00Z";
   char lwtBuffer[128];
   serializeJson(lwtDoc, lwtBuffer);
 
@@ -387,17 +600,50 @@ void connectToMQTT() {
   Serial.printf("[MQTT] DEBUG - Password len: %d\n",
                 strlen(mqttCreds.password));
 
-  if (mqttClient.connect(mqttCreds.clientId, mqttCreds.username,
+  heapPhaseBegin(HEAP_PHASE_MQTT);
+  bool connected =
+      mqttClient.connect(mqttCreds.clientId, mqttCreds.username,
                          mqttCreds.password, mqttCreds.topicStatus, 1, true,
-                         lwtBuffer)) {
+                         lwtBuffer);
+  heapPhaseEnd(HEAP_PHASE_MQTT);
+
+  if (connected) {
     Serial.println("[MQTT] Connected!");
 
     // Subscribe to commands
     mqttClient.subscribe(mqttCreds.topicCommands);
     Serial.printf("[MQTT] Subscribed to: %s\n", mqttCreds.topicCommands);
+    subscribeBroadcastTopics(true);
+
+    // Time sync requests go up on .../time, replies come back as commands
+    topicBuild(topicTime, sizeof(topicTime), mqttCreds.tenantId,
+               mqttCreds.deviceId, "time");
+    timeSyncRoundDue = true;
+    timeSyncRoundActive = false;
+
+    // Chunks of a running update come on .../ota/data, requests go up on
+    // .../ota/request
+    topicBuild(topicOtaData, sizeof(topicOtaData), mqttCreds.tenantId,
+               mqttCreds.deviceId, "ota/data");
+    topicBuild(topicOtaRequest, sizeof(topicOtaRequest), mqttCreds.tenantId,
+               mqttCreds.deviceId, "ota/request");
+    if (otaMqttActive() && otaFromCloud) {
+      subscribeOtaData(true);
+    }
+    otaPeerBegin(mqttCreds.deviceId);
 
-    // Send online status
-    sendStatus(true);
+    // Report of the previous boot's crash, if any, goes to .../crash and
+    // .../crash/data
+    topicBuild(topicCrash, sizeof(topicCrash), mqttCreds.tenantId,
+               mqttCreds.deviceId, "crash");
+    topicBuild(topicCrashData, sizeof(topicCrashData), mqttCreds.tenantId,
+               mqttCreds.deviceId, "crash/data");
+    topicBuild(topicRollup, sizeof(topicRollup), mqttCreds.tenantId,
+               mqttCreds.deviceId, "rollup");
+
+    // Online status and a full telemetry snapshot follow from the event
+    mqttUp = true;
+    eventPublishConnectivity(CONNECTIVITY_MQTT_UP, millis());
 
     // Blink LED to indicate connected
     for (int i = 0; i < 3; i++) {
@@ -412,75 +658,395 @@ void connectToMQTT() {
 }
 
 void mqttCallback(char *topic, byte *payload, unsigned int length) {
+  // Capture t3 before anything slow happens
+  uint32_t receivedAt = millis();
+  TRACE_MQTT_MESSAGE(topic, payload, length);
+
+  // Update chunks are copied into the transfer window, without a log line
+  if (otaMqttActive() && strcmp(topic, topicOtaData) == 0) {
+    otaMqttOnData(payload, length, receivedAt);
+    return;
+  }
   Serial.printf("[MQTT] Message on %s\n", topic);
 
-  String message;
-  for (unsigned int i = 0; i < length; i++) {
-    message += (char)payload[i];
+  // payload is PubSubClient's packet buffer: copy it out and run the
+  // command from loop(), where publishing the ACK cannot overwrite it
+  bool broadcast = strcmp(topic, mqttCreds.topicCommands) != 0;
+  if (!commandQueuePush(payload, length, receivedAt, broadcast)) {
+    Serial.printf("[Cmd] Dropped %u byte message, queue depth %u\n", length,
+                  commandQueueDepth());
+  }
+}
+
+// Time budget per action; an overrun is logged and counted, not aborted
+static uint32_t commandBudgetMs(const char *action) {
+  if (action && strcmp(action, "use_profile") == 0) {
+    return 200; // NVS write plus the retained status publish
+  }
+  return COMMAND_BUDGET_MS;
+}
+
+void serviceCommands() {
+  unsigned long start = millis();
+  const QueuedCommand *queued;
+  while ((queued = commandQueuePeek()) != nullptr) {
+    executeCommand(*queued);
+    commandQueuePop();
+    // Leave the rest for the next pass so telemetry and the sensor keep up
+    if (millis() - start >= COMMAND_LOOP_BUDGET_MS) {
+      break;
+    }
   }
+}
+
+void executeCommand(const QueuedCommand &queued) {
+  unsigned long started = millis();
 
   JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, message);
+  DeserializationError error =
+      deserializeJson(doc, queued.payload, queued.length);
 
   if (error) {
     Serial.printf("[MQTT] JSON parse failed: %s\n", error.c_str());
     return;
   }
 
-  handleCommand(doc.as<JsonObject>());
+  // Time sync replies are not commands: no ACK, t3 is the receive time.
+  // They answer this device's own request, so never on a shared topic.
+  const char *action = doc["action"];
+  if (action && strcmp(action, "time_sync") == 0) {
+    if (queued.broadcast) {
+      return;
+    }
+    JsonObject params = doc["params"];
+    if (!timeSyncHandleResponse(params["t0"].as<uint32_t>(),
+                                params["t1"].as<uint64_t>(),
+                                params["t2"].as<uint64_t>(),
+                                queued.receivedMs)) {
+      Serial.println("[Time] Ignored stale or implausible reply");
+    }
+    return;
+  }
+
+  handleCommand(doc.as<JsonObject>(), queued.broadcast);
+
+  uint32_t waitMs = started - queued.receivedMs;
+  uint32_t runMs = millis() - started;
+  uint32_t budgetMs = commandBudgetMs(action);
+  commandQueueRecord(waitMs, runMs, budgetMs);
+  if (runMs > budgetMs) {
+    Serial.printf("[Cmd] %s took %u ms (budget %u ms)\n", action,
+                  (unsigned)runMs, (unsigned)budgetMs);
+  }
 }
 
 void sendStatus(bool online) {
   JsonDocument doc;
   doc["status"] = online ? "online" : "offline";
-  doc["timestamp"] = "2024-01-01T00:00:00Z"; // TODO: Use NTP
+  setTimestamp(doc, millis());
+
+  // Birth message: what this firmware can do, so the platform can pick a
+  // profile per device instead of the slowest common format
+  doc["fw"] = FIRMWARE_VERSION;
+  doc["build"] = FIRMWARE_BUILD;
+  doc["schema"] = TELEMETRY_SCHEMA_VERSION;
+  doc["boot"] = telemetryBootId();
+  doc["caps"] = capabilitiesGetMask();
+  doc["profile"] = activeProfile;
+  JsonObject limits = doc["limits"].to<JsonObject>();
+  limits["mqttBuffer"] = MQTT_BUFFER_SIZE;
+  bistReport(doc["bist"].to<JsonObject>());
+  statusHasBist = bistDone();
+
+  // Command queue health since boot
+  CommandQueueStats cq = commandQueueGetStats();
+  JsonObject commands = doc["cmdQueue"].to<JsonObject>();
+  commands["executed"] = cq.executed;
+  commands["dropped"] = cq.dropped;
+  commands["overruns"] = cq.overruns;
+  commands["depthMax"] = cq.depthMax;
+  commands["waitMaxMs"] = cq.waitMaxMs;
+
+  // Event bus health since boot
+  EventBusStats eb = eventBusGetStats();
+  JsonObject events = doc["events"].to<JsonObject>();
+  events["published"] = eb.published;
+  events["dropped"] = eb.dropped;
+  events["depthMax"] = eb.depthMax;
+
+  // Rollup buckets waiting for the broker, sent and lost since boot
+  RollupStats rs = rollupGetStats();
+  JsonObject rollups = doc["rollups"].to<JsonObject>();
+  rollups["pending"] = rs.pending;
+  rollups["sent"] = rs.sent;
+  rollups["dropped"] = rs.dropped;
+
+  // Time and heap per sensor pipeline stage
+  pipelineReport(doc["pipeline"].to<JsonObject>());
+
+  // Heap, and what the claim and MQTT TLS sessions took (heap_stats.h)
+  JsonObject heap = doc["heap"].to<JsonObject>();
+  heap["free"] = ESP.getFreeHeap();
+  heap["min"] = ESP.getMinFreeHeap();
+  heap["largest"] = ESP.getMaxAllocHeap();
+  HeapPhaseStats claim = heapPhaseGetStats(HEAP_PHASE_CLAIM);
+  if (claim.runs > 0) {
+    heap["claimPeak"] = claim.peakBytes;
+    heap["claimHeld"] = claim.heldBytes;
+  }
+  HeapPhaseStats mqtt = heapPhaseGetStats(HEAP_PHASE_MQTT);
+  heap["mqttPeak"] = mqtt.peakBytes;
+  heap["mqttHeld"] = mqtt.heldBytes;
 
-  char buffer[128];
-  serializeJson(doc, buffer);
+  JsonArray groups = doc["groups"].to<JsonArray>();
+  for (uint8_t i = 0; i < broadcastGroupCount(); i++) {
+    groups.add(broadcastGroup(i));
+  }
+
+  if (timeSyncIsSynced()) {
+    TimeSyncQuality q = timeSyncGetQuality(millis());
+    JsonObject timeSync = doc["timeSync"].to<JsonObject>();
+    timeSync["uncertaintyMs"] = q.uncertaintyMs;
+    timeSync["driftPpm"] = q.driftPpm;
+    timeSync["samples"] = q.samples;
+  }
 
-  mqttClient.publish(mqttCreds.topicStatus, buffer, true);
+  // Can outgrow the PubSubClient buffer; mqttPublish() is not bound by it,
+  // but a message is still at most MQTT_FRAME_SIZE. Diagnostics go first,
+  // largest first, so the retained birth message is never cut short.
+  static const char *const diagnostics[] = {"pipeline", "heap", "cmdQueue",
+                                            "events", "rollups"};
+  size_t length = measureJson(doc);
+  for (size_t i = 0; length >= MQTT_FRAME_SIZE &&
+                     i < sizeof(diagnostics) / sizeof(diagnostics[0]);
+       i++) {
+    Serial.printf("[MQTT] Status is %u bytes, leaving out %s\n",
+                  (unsigned)length, diagnostics[i]);
+    doc.remove(diagnostics[i]);
+    length = measureJson(doc);
+  }
+  if (length >= MQTT_FRAME_SIZE) {
+    Serial.printf("[MQTT] Status is %u bytes, not sent\n", (unsigned)length);
+    return;
+  }
+  char buffer[MQTT_FRAME_SIZE];
+  serializeJson(doc, buffer, sizeof(buffer));
+
+  mqttPublish(mqttCreds.topicStatus, buffer, true);
   Serial.printf("[MQTT] Status: %s\n", online ? "online" : "offline");
 }
 
+void onConnectivityStatus(const Event &event) {
+  if (event.connectivity.change == CONNECTIVITY_MQTT_UP) {
+    sendStatus(true);
+  }
+}
+
 void sendTelemetry() {
-  JsonDocument doc;
+  DeviceState state;
+  deviceStateRead(state);
+  bool led = digitalRead(LED_PIN) == HIGH;
+  bool alertLed = digitalRead(ALERT_LED_PIN) == HIGH;
+
+  // Every sample gets a seq and is retained, connected or not, so the
+  // platform can tell loss from silence and ask for the gap
+  TelemetryReading reading;
+  reading.temperatureCenti = state.temperatureCenti;
+  reading.humidityCenti = state.humidityCenti;
+  reading.derived = state.derived;
+  reading.uptimeS = millis() / 1000;
+  reading.rssi = WiFi.RSSI();
+  reading.led = led;
+  reading.alertLed = alertLed;
+  reading.alert = state.alert;
+  reading.sensorConnected = state.sensorConnected;
+  reading.sampleMs = state.sampleMs;
+  telemetryRecord(reading);
 
-  JsonObject data = doc["data"].to<JsonObject>();
-  data["temperature"] = lastTemperature;
-  data["humidity"] = lastHumidity;
-  data["uptime"] = millis() / 1000;
-  data["rssi"] = WiFi.RSSI();
-  data["led"] = digitalRead(LED_PIN) == HIGH;
-  data["alertLed"] = digitalRead(ALERT_LED_PIN) == HIGH;
-  data["alert"] = alertMode;
-  data["sensorConnected"] = sensorConnected;
+  if (!mqttClient.connected()) {
+    Serial.printf("[Telemetry] Offline, seq %u retained\n",
+                  (unsigned)reading.seq);
+    return;
+  }
+
+  // Delta profile: the platform merges into the device shadow, so unchanged
+  // state fields can be left out between periodic full snapshots
+  bool full = activeProfile != PROFILE_DELTA ||
+              telemetrySinceFull >= TELEMETRY_FULL_SNAPSHOT_EVERY;
+  telemetrySinceFull = full ? 1 : telemetrySinceFull + 1;
 
-  doc["timestamp"] = "2024-01-01T00:00:00Z"; // TODO: Use NTP
+  // Derived values travel with the sensor values, in every message
+  uint8_t fields = TELEMETRY_FIELDS_ALL & TELEMETRY_FIELD_DERIVED;
+  if (full) {
+    fields |= TELEMETRY_FIELD_UPTIME | TELEMETRY_FIELD_RSSI;
+  }
+  if (full || led != lastSentLed) {
+    fields |= TELEMETRY_FIELD_LED;
+  }
+  if (full || alertLed != lastSentAlertLed) {
+    fields |= TELEMETRY_FIELD_ALERT_LED;
+  }
+  if (full || state.alert != lastSentAlert) {
+    fields |= TELEMETRY_FIELD_ALERT;
+  }
+  if (full || state.sensorConnected != lastSentSensorConnected) {
+    fields |= TELEMETRY_FIELD_SENSOR;
+  }
+  lastSentLed = led;
+  lastSentAlertLed = alertLed;
+  lastSentAlert = state.alert;
+  lastSentSensorConnected = state.sensorConnected;
 
   char buffer[512];
+  if (!telemetrySerialize(reading, fields, false, buffer, sizeof(buffer))) {
+    Serial.println("[Telemetry] Message too large, dropped");
+    return;
+  }
+
+  mqttPublish(mqttCreds.topicTelemetry, buffer);
+  char temperatureText[FIXED_TEXT_MAX];
+  char humidityText[FIXED_TEXT_MAX];
+  fixedFormat(state.temperatureCenti, 1, temperatureText);
+  fixedFormat(state.humidityCenti, 1, humidityText);
+  Serial.printf("[Telemetry] temp=%s°C, hum=%s%%, alert=%s, sensor=%s\n",
+                temperatureText, humidityText, state.alert ? "ACTIVE" : "off",
+                state.sensorConnected ? "OK" : "FAIL");
+}
+
+// Goes out with the first sample of each interval, failed reads included
+void onSampleTelemetry(const Event &event) {
+  if (event.timeMs - lastTelemetryTime >= TELEMETRY_INTERVAL_MS) {
+    lastTelemetryTime = event.timeMs;
+    sendTelemetry();
+  }
+}
+
+// Good readings only; a failed read repeats the last good values
+void onSampleRollup(const Event &event) {
+  if (event.sample.sensorConnected) {
+    rollupAdd(event.sample.temperatureCenti, event.sample.humidityCenti,
+              event.timeMs);
+  }
+}
+
+// First telemetry after (re)connect is always a full snapshot
+void onConnectivityTelemetry(const Event &event) {
+  if (event.connectivity.change == CONNECTIVITY_MQTT_UP) {
+    telemetrySinceFull = TELEMETRY_FULL_SNAPSHOT_EVERY;
+  }
+}
+
+// ============================================================================
+// TIME SYNC
+// ============================================================================
+
+void serviceTimeSync() {
+  unsigned long now = millis();
+
+  if (!timeSyncRoundActive) {
+    unsigned long interval =
+        timeSyncIsSynced() ? TIME_SYNC_INTERVAL_MS : TIME_SYNC_RETRY_MS;
+    if (!timeSyncRoundDue && now - lastTimeSyncRound < interval) {
+      return;
+    }
+    timeSyncRoundDue = false;
+    timeSyncRoundActive = true;
+    timeSyncRequestsSent = 0;
+  }
+
+  // One exchange in flight at a time; wait for the reply or its timeout
+  if (timeSyncExchangePending() &&
+      now - lastTimeSyncRequest < TIME_SYNC_TIMEOUT_MS) {
+    return;
+  }
+
+  if (timeSyncRequestsSent >= TIME_SYNC_BURST_SIZE) {
+    timeSyncRoundActive = false;
+    lastTimeSyncRound = now;
+
+    if (timeSyncCommitRound()) {
+      TimeSyncQuality q = timeSyncGetQuality(now);
+      Serial.printf("[Time] Synced: +/-%lu ms, drift %ld ppm, %u samples\n",
+                    (unsigned long)q.uncertaintyMs, (long)q.driftPpm,
+                    q.samples);
+      // Republish status so the platform sees the sync quality
+      sendStatus(true);
+    } else {
+      Serial.println("[Time] Sync round got no usable replies");
+    }
+    return;
+  }
+
+  if (now - lastTimeSyncRequest >= TIME_SYNC_SPACING_MS) {
+    lastTimeSyncRequest = now;
+    timeSyncRequestsSent++;
+    sendTimeSyncRequest(timeSyncBeginExchange(now));
+  }
+}
+
+void sendTimeSyncRequest(uint32_t t0) {
+  JsonDocument doc;
+  doc["t0"] = t0;
+
+  char buffer[64];
   serializeJson(doc, buffer);
 
-  mqttClient.publish(mqttCreds.topicTelemetry, buffer);
-  Serial.printf("[Telemetry] temp=%.1f°C, hum=%.1f%%, alert=%s, sensor=%s\n",
-                lastTemperature, lastHumidity, alertMode ? "ACTIVE" : "off",
-                sensorConnected ? "OK" : "FAIL");
+  mqttPublish(topicTime, buffer);
+}
+
+void setTimestamp(JsonDocument &doc, unsigned long localMs) {
+  // Leave the field out until synced; the platform falls back to receive time
+  char iso[32];
+  if (timeSyncFormatIso8601(localMs, iso, sizeof(iso))) {
+    doc["timestamp"] = iso;
+  }
 }
 
 // ============================================================================
 // COMMAND HANDLING
 // ============================================================================
 
-void handleCommand(const JsonObject &command) {
+// Jobs would run (and stream progress) across a fleet in lockstep, and
+// memberships are per device: those only come on the device's own topic
+static bool broadcastAllowed(const char *action) {
+  return !findAsyncAction(action) &&
+         !(action && (strcmp(action, "cancel") == 0 ||
+                      strcmp(action, "set_groups") == 0 ||
+                      strcmp(action, "crash_report") == 0));
+}
+
+void handleCommand(const JsonObject &command, bool broadcast) {
   const char *action = command["action"];
   const char *correlationId = command["correlationId"];
   JsonObject params = command["params"];
 
-  Serial.printf("[Cmd] Received: %s (ID: %s)\n", action, correlationId);
+  Serial.printf("[Cmd] Received: %s (ID: %s)%s\n", action, correlationId,
+                broadcast ? " via broadcast" : "");
 
   bool success = false;
+  bool republishStatus = false;
   String errorMsg = "";
 
-  if (action && strcmp(action, "set_state") == 0) {
+  const AsyncAction *asyncAction = findAsyncAction(action);
+  if (broadcast && !broadcastAllowed(action)) {
+    errorMsg = "Not available on broadcast";
+    success = false;
+  } else if (asyncAction) {
+    const char *error = nullptr;
+    if (asyncCommandStart(*asyncAction, correlationId, params, millis(),
+                          &error)) {
+      // "accepted" is out; progress and the result follow from loop()
+      Serial.printf("[Cmd] %s accepted\n", action);
+      return;
+    }
+    errorMsg = error;
+    success = false;
+  } else if (action && strcmp(action, "cancel") == 0) {
+    success = asyncCommandCancel(params["correlationId"]);
+    if (!success) {
+      errorMsg = "No running command with that correlationId";
+    }
+  } else if (action && strcmp(action, "set_state") == 0) {
     // Generic state setter - handles any parameter
     for (JsonPair kv : params) {
       if (strcmp(kv.key().c_str(), "led") == 0) {
@@ -494,6 +1060,64 @@ void handleCommand(const JsonObject &command) {
     bool state = params["state"] | false;
     digitalWrite(LED_PIN, state ? HIGH : LOW);
     success = true;
+  } else if (action && strcmp(action, "use_profile") == 0) {
+    // Range-checked before narrowing, so 257 cannot pass as profile 1
+    int requested = params["profile"] | (int)PROFILE_FULL;
+    uint8_t profile = (uint8_t)requested;
+    if (requested >= 0 && requested <= UINT8_MAX &&
+        capabilitiesProfileSupported(profile)) {
+      activeProfile = profile;
+      telemetrySinceFull = TELEMETRY_FULL_SNAPSHOT_EVERY;
+      storageSaveProfile(profile);
+      Serial.printf("[Cmd] Telemetry profile: %s\n",
+                    capabilitiesFindProfile(profile)->name);
+      republishStatus = true;
+      success = true;
+    } else {
+      errorMsg = "Unsupported profile";
+      success = false;
+    }
+  } else if (action && strcmp(action, "set_groups") == 0) {
+    JsonArray list = params["groups"];
+    const char *names[BROADCAST_MAX_GROUPS];
+    uint8_t count = 0;
+    bool valid = !list.isNull() && list.size() <= BROADCAST_MAX_GROUPS;
+    for (JsonVariant name : list) {
+      if (!valid || !name.is<const char *>()) {
+        valid = false;
+        break;
+      }
+      names[count++] = name.as<const char *>();
+    }
+    // Drop the old group topics while they can still be named
+    subscribeBroadcastTopics(false);
+    success = valid && broadcastSetGroups(names, count);
+    subscribeBroadcastTopics(true);
+    if (success) {
+      republishStatus = true;
+    } else {
+      errorMsg = "Invalid groups";
+    }
+  } else if (action && strcmp(action, "crash_report") == 0) {
+    // Lost chunks again, or "erase" once the report is stored
+    const char *id = params["id"];
+    const char *error = nullptr;
+    if (params["erase"] | false) {
+      success = crashReportErase(id, &error);
+    } else {
+      JsonArray list = params["chunks"];
+      uint32_t chunks[CRASH_MAX_CHUNKS];
+      size_t count = 0;
+      for (JsonVariant chunk : list) {
+        if (count < CRASH_MAX_CHUNKS) {
+          chunks[count++] = chunk | UINT32_MAX;
+        }
+      }
+      success = crashReportResend(id, chunks, count, &error);
+    }
+    if (!success) {
+      errorMsg = error;
+    }
   } else {
     errorMsg = "Unknown command";
     success = true; // Still ACK unknown commands
@@ -511,13 +1135,28 @@ void handleCommand(const JsonObject &command) {
   JsonObject state = ackDoc["state"].to<JsonObject>();
   state["led"] = digitalRead(LED_PIN) == HIGH;
 
-  ackDoc["timestamp"] = "2024-01-01T00:00:00Z"; // TODO: Use NTP
+  setTimestamp(ackDoc, millis());
 
   char buffer[256];
   serializeJson(ackDoc, buffer);
 
-  mqttClient.publish(mqttCreds.topicAck, buffer);
-  Serial.printf("[Cmd] ACK sent: %s\n", success ? "success" : "error");
+  if (broadcast) {
+    // Every device in the group got this at once: spread the answers
+    broadcastQueueAck(buffer, millis());
+    Serial.printf("[Cmd] ACK queued: %s\n", success ? "success" : "error");
+  } else {
+    mqttPublish(mqttCreds.topicAck, buffer);
+    Serial.printf("[Cmd] ACK sent: %s\n", success ? "success" : "error");
+  }
+
+  // Retained status carries the active profile and groups
+  eventPublishCommand(action, success, broadcast, republishStatus, millis());
+}
+
+void onCommandStatus(const Event &event) {
+  if (event.command.statusChanged) {
+    sendStatus(true);
+  }
 }
 
 // ============================================================================
@@ -528,6 +1167,7 @@ void checkFactoryReset() {
   bool buttonPressed = digitalRead(RESET_BUTTON_PIN) == LOW;
 
   if (buttonPressed && !buttonWasPressed) {
+    TRACE_BUTTON_EDGE(true);
     buttonPressStart = millis();
     buttonWasPressed = true;
     Serial.println(
@@ -553,21 +1193,379 @@ void checkFactoryReset() {
       ESP.restart();
     }
   } else {
+    if (buttonWasPressed) {
+      TRACE_BUTTON_EDGE(false);
+    }
     buttonWasPressed = false;
   }
 }
 
+bool publishAck(const char *payload) {
+  return mqttPublish(mqttCreds.topicAck, payload);
+}
+
+bool publishOtaRequest(const char *payload) {
+  return mqttPublish(topicOtaRequest, payload);
+}
+
+// The data topic carries whole chunks, so the receive buffer grows with
+// them; never below MQTT_BUFFER_SIZE, or commands such as a cancel for the
+// transfer would no longer fit
+void subscribeOtaData(bool subscribe) {
+  if (subscribe) {
+    uint32_t chunkPacket = otaMqttChunkSize() + OTA_MQTT_PACKET_OVERHEAD;
+    mqttClient.setBufferSize(max((uint32_t)MQTT_BUFFER_SIZE, chunkPacket));
+  }
+  if (mqttClient.connected()) {
+    if (subscribe) {
+      mqttClient.subscribe(topicOtaData);
+      Serial.printf("[MQTT] Subscribed to: %s\n", topicOtaData);
+    } else {
+      mqttClient.unsubscribe(topicOtaData);
+    }
+  }
+  if (!subscribe) {
+    mqttClient.setBufferSize(MQTT_BUFFER_SIZE);
+  }
+}
+
+bool publishCrash(bool data, const uint8_t *payload, size_t length) {
+  return mqttPublishFramed(mqttClient, data ? topicCrashData : topicCrash,
+                           payload, length, false);
+}
+
+bool publishRollup(const char *payload) {
+  return mqttPublish(topicRollup, payload);
+}
+
+// Whole packet in one write, so over TLS it is one record (mqtt_publish.h)
+bool mqttPublish(const char *topic, const char *payload, bool retained) {
+  return mqttPublishFramed(mqttClient, topic, (const uint8_t *)payload,
+                           strlen(payload), retained);
+}
+
+// Tenant-wide and group command topics (see broadcast.h)
+void subscribeBroadcastTopics(bool subscribe) {
+  if (!mqttClient.connected()) {
+    return;
+  }
+  char topic[128];
+  for (uint8_t i = 0; i < broadcastTopicCount(); i++) {
+    if (!broadcastTopic(i, mqttCreds.tenantId, topic, sizeof(topic))) {
+      continue;
+    }
+    if (subscribe) {
+      mqttClient.subscribe(topic);
+      Serial.printf("[MQTT] Subscribed to: %s\n", topic);
+    } else {
+      mqttClient.unsubscribe(topic);
+    }
+  }
+}
+
+// ============================================================================
+// ASYNC ACTIONS (see async_command.h)
+// ============================================================================
+
+// sensor_check: read the DHT22 "samples" times "intervalMs" apart and
+// report the spread and failed reads, e.g. after rewiring on site
+#define SENSOR_CHECK_MAX_SAMPLES 30
+#define SENSOR_CHECK_MIN_INTERVAL_MS 2000 // DHT22 sampling period
+
+struct SensorCheck {
+  uint8_t samples;
+  uint8_t taken;
+  uint8_t failures;
+  uint32_t intervalMs;
+  float minTemp, maxTemp, sumTemp;
+  float minHum, maxHum, sumHum;
+};
+
+static SensorCheck sensorCheck;
+
+static bool sensorCheckStart(AsyncJob &job, JsonObject params) {
+  int samples = params["samples"] | 5;
+  uint32_t intervalMs = params["intervalMs"] | SENSOR_CHECK_MIN_INTERVAL_MS;
+  if (samples < 1 || samples > SENSOR_CHECK_MAX_SAMPLES) {
+    job.error = "samples must be 1-30";
+    return false;
+  }
+  if (intervalMs < SENSOR_CHECK_MIN_INTERVAL_MS) {
+    job.error = "intervalMs must be at least 2000";
+    return false;
+  }
+
+  sensorCheck = SensorCheck();
+  sensorCheck.samples = samples;
+  sensorCheck.intervalMs = intervalMs;
+  return true;
+}
+
+static AsyncJobState sensorCheckStep(AsyncJob &job, uint32_t nowMs) {
+  float humidity = dht.readHumidity();
+  float temperature = dht.readTemperature();
+  TRACE_SENSOR_SAMPLE(temperature, humidity);
+
+  SensorCheck &c = sensorCheck;
+  if (isnan(humidity) || isnan(temperature)) {
+    c.failures++;
+  } else {
+    bool first = c.taken == c.failures;
+    c.minTemp = first ? temperature : fminf(c.minTemp, temperature);
+    c.maxTemp = first ? temperature : fmaxf(c.maxTemp, temperature);
+    c.minHum = first ? humidity : fminf(c.minHum, humidity);
+    c.maxHum = first ? humidity : fmaxf(c.maxHum, humidity);
+    c.sumTemp += temperature;
+    c.sumHum += humidity;
+  }
+  c.taken++;
+  job.progress = c.taken * 100 / c.samples;
+
+  if (c.taken < c.samples) {
+    job.wakeMs = nowMs + c.intervalMs;
+    return ASYNC_RUNNING;
+  }
+  if (c.failures == c.taken) {
+    job.error = "No valid reading";
+    return ASYNC_FAILED;
+  }
+  return ASYNC_SUCCEEDED;
+}
+
+static void sensorCheckResult(const AsyncJob &job, JsonObject result) {
+  const SensorCheck &c = sensorCheck;
+  result["samples"] = c.taken;
+  result["failures"] = c.failures;
+
+  uint8_t valid = c.taken - c.failures;
+  if (valid == 0) {
+    return;
+  }
+  JsonObject temperature = result["temperature"].to<JsonObject>();
+  temperature["min"] = c.minTemp;
+  temperature["max"] = c.maxTemp;
+  temperature["mean"] = c.sumTemp / valid;
+  JsonObject humidity = result["humidity"].to<JsonObject>();
+  humidity["min"] = c.minHum;
+  humidity["max"] = c.maxHum;
+  humidity["mean"] = c.sumHum / valid;
+}
+
+// resend_telemetry: republish retained samples "from".."to" of boot "boot"
+// as full messages marked "resent", a few per loop pass
+struct TelemetryResend {
+  uint32_t next;
+  uint32_t to;
+  uint32_t total;
+  uint32_t resent;
+  uint32_t unavailable; // already overwritten in the retention buffer
+};
+
+static TelemetryResend telemetryResend;
+
+static bool telemetryResendStart(AsyncJob &job, JsonObject params) {
+  const char *boot = params["boot"];
+  uint32_t from = params["from"] | 0;
+  uint32_t to = params["to"] | 0;
+  if (!boot || strcmp(boot, telemetryBootId()) != 0) {
+    job.error = "Unknown boot";
+    return false;
+  }
+  if (from == 0 || to < from || to > telemetryLastSeq()) {
+    job.error = "Invalid range";
+    return false;
+  }
+
+  telemetryResend = TelemetryResend();
+  telemetryResend.next = from;
+  telemetryResend.to = to;
+  telemetryResend.total = to - from + 1;
+  return true;
+}
+
+static AsyncJobState telemetryResendStep(AsyncJob &job, uint32_t nowMs) {
+  TelemetryResend &r = telemetryResend;
+  if (!mqttClient.connected()) {
+    job.wakeMs = nowMs + MQTT_RECONNECT_DELAY_MS;
+    return ASYNC_RUNNING;
+  }
+
+  for (int i = 0; i < TELEMETRY_RESEND_BURST && r.next <= r.to; i++) {
+    const TelemetryReading *reading = telemetryFindRetained(r.next);
+    if (!reading) {
+      r.unavailable++;
+      r.next++;
+      continue;
+    }
+    char buffer[512];
+    if (!telemetrySerialize(*reading, TELEMETRY_FIELDS_ALL, true, buffer,
+                            sizeof(buffer))) {
+      r.unavailable++;
+      r.next++;
+      continue;
+    }
+    if (!mqttPublish(mqttCreds.topicTelemetry, buffer)) {
+      break; // retry this seq on the next pass
+    }
+    r.resent++;
+    r.next++;
+  }
+
+  uint32_t done = r.resent + r.unavailable;
+  job.progress = done * 100 / r.total;
+  return done < r.total ? ASYNC_RUNNING : ASYNC_SUCCEEDED;
+}
+
+static void telemetryResendResult(const AsyncJob &job, JsonObject result) {
+  result["resent"] = telemetryResend.resent;
+  result["unavailable"] = telemetryResend.unavailable;
+  result["oldestRetained"] = telemetryOldestRetained();
+}
+
+// ota_mqtt: get a firmware image from a LAN peer or over MQTT (see
+// ota_peer.h, ota_mqtt.h) and boot it once the result is out. params: size,
+// sha256 (hex), and optionally chunkSize, window, peers (false: straight to
+// MQTT) and serve (false: do not share the image once installed).
+static bool otaMqttStart(AsyncJob &job, JsonObject params) {
+  uint8_t sha256[OTA_MQTT_SHA256_LEN];
+  const char *sha256Hex = params["sha256"];
+  if (!otaMqttParseSha256(sha256Hex, sha256)) {
+    job.error = "Invalid sha256";
+    return false;
+  }
+  uint32_t size = params["size"] | 0;
+  uint32_t chunkSize = params["chunkSize"] | OTA_MQTT_CHUNK_SIZE;
+  uint32_t window = params["window"] | OTA_MQTT_WINDOW;
+  if (!otaMqttBegin(job.correlationId, size, sha256, chunkSize, window,
+                    &job.error)) {
+    return false;
+  }
+  strncpy(otaSha256Hex, sha256Hex, sizeof(otaSha256Hex) - 1);
+  otaSha256Hex[sizeof(otaSha256Hex) - 1] = '\0';
+  otaServeImage = params["serve"] | OTA_PEER_SERVE_DEFAULT;
+  otaFromCloud = !(params["peers"] | true);
+  otaPeerFetchBegin(otaSha256Hex, size, millis());
+  if (otaFromCloud) {
+    subscribeOtaData(true);
+  }
+  return true;
+}
+
+static AsyncJobState otaMqttStep(AsyncJob &job, uint32_t nowMs) {
+  const char *error = nullptr;
+  OtaMqttResult result = OTA_MQTT_RUNNING;
+  if (!otaFromCloud) {
+    OtaPeerResult peer = otaPeerFetchStep(nowMs, &error);
+    if (peer == OTA_PEER_FAILED) {
+      result = OTA_MQTT_FAILED;
+    } else if (peer == OTA_PEER_DONE) {
+      result = OTA_MQTT_DONE;
+    } else if (peer == OTA_PEER_USE_CLOUD) {
+      otaFromCloud = true;
+      subscribeOtaData(true);
+    }
+  }
+  if (otaFromCloud) {
+    result = otaMqttService(nowMs, mqttClient.connected(), &error);
+  }
+  job.progress = otaMqttProgress();
+  if (result == OTA_MQTT_FAILED) {
+    job.error = error;
+    return ASYNC_FAILED;
+  }
+  if (result == OTA_MQTT_DONE) {
+    otaPeerRecordImage(otaSha256Hex, otaMqttGetStats().size, otaServeImage);
+    otaRestartPending = true;
+    return ASYNC_SUCCEEDED;
+  }
+  return ASYNC_RUNNING;
+}
+
+static void otaMqttResult(const AsyncJob &job, JsonObject result) {
+  OtaMqttStats stats = otaMqttGetStats();
+  OtaPeerStats peerStats = otaPeerGetStats();
+  result["source"] = otaFromCloud ? "cloud" : "peer";
+  if (!otaFromCloud && peerStats.peer[0]) {
+    result["peer"] = peerStats.peer;
+  }
+  result["peerBytes"] = peerStats.bytes;
+  result["peersTried"] = peerStats.peersTried;
+  result["bytes"] = stats.written;
+  result["chunks"] = stats.chunks;
+  result["requests"] = stats.requests;
+  result["rerequested"] = stats.rerequested;
+  result["duplicates"] = stats.duplicates;
+  result["rejected"] = stats.rejected;
+  result["rttMs"] = stats.srttMs;
+  uint32_t durationMs = job.finishedMs - job.startedMs;
+  if (durationMs > 0) {
+    result["bytesPerSecond"] = (uint64_t)stats.written * 1000 / durationMs;
+  }
+}
+
+static void otaMqttStop(AsyncJob &job) {
+  otaPeerFetchEnd();
+  otaMqttEnd();
+  if (otaFromCloud) {
+    subscribeOtaData(false);
+  }
+}
+
+static const AsyncAction asyncActions[] = {
+    {"sensor_check", sensorCheckStart, sensorCheckStep, sensorCheckResult,
+     nullptr},
+    {"resend_telemetry", telemetryResendStart, telemetryResendStep,
+     telemetryResendResult, nullptr},
+    {"ota_mqtt", otaMqttStart, otaMqttStep, otaMqttResult, otaMqttStop},
+};
+
+const AsyncAction *findAsyncAction(const char *action) {
+  if (!action) {
+    return nullptr;
+  }
+  for (size_t i = 0; i < sizeof(asyncActions) / sizeof(asyncActions[0]);
+       i++) {
+    if (strcmp(asyncActions[i].name, action) == 0) {
+      return &asyncActions[i];
+    }
+  }
+  return nullptr;
+}
+
 // ============================================================================
 // WAREHOUSE MONITORING FUNCTIONS
 // ============================================================================
 
-void readSensorAndCheckThresholds() {
+// Stage "acquire": one reading into the batch; the pass goes on once the
+// batch is full
+bool sensorAcquire(PipelineBatch &batch, uint32_t nowMs) {
   float humidity = dht.readHumidity();
   float temperature = dht.readTemperature();
+  TRACE_SENSOR_SAMPLE(temperature, humidity);
+
+  // From here on the reading is in hundredths
+  PipelineSample &sample = batch.samples[batch.count++];
+  sample.valid = !isnan(humidity) && !isnan(temperature);
+  sample.temperatureCenti = sample.valid ? fixedFromFloat(temperature) : 0;
+  sample.humidityCenti = sample.valid ? fixedFromFloat(humidity) : 0;
+  sample.timeMs = millis();
+  sample.derived = DerivedMetrics();
+  sample.exceeded = 0;
+  return batch.count >= PIPELINE_BATCH_SIZE;
+}
+
+// Stage "publish": the aggregated sample becomes device state; the alert
+// indicators, telemetry and their log lines follow from the events
+bool sensorPublish(PipelineBatch &batch, uint32_t nowMs) {
+  const PipelineSample &sample = batch.samples[0];
+
+  // This is the only writer, so the snapshot read here stays current
+  DeviceState state;
+  deviceStateRead(state);
 
   // Check if reading failed
-  if (isnan(humidity) || isnan(temperature)) {
-    if (sensorConnected) {
+  if (!sample.valid) {
+    if (state.sensorConnected) {
       // Only log on state change to avoid log spam
       Serial.println("[Sensor] ❌ ERROR: Lost connection to DHT22!");
       Serial.println("[Sensor] Troubleshooting: Check wiring DATA->GPIO4, "
@@ -575,63 +1573,61 @@ void readSensorAndCheckThresholds() {
       Serial.println(
           "[Sensor] Ensure 4.7kΩ pull-up resistor between DATA and VCC");
     }
-    sensorConnected = false;
+    if (state.sensorConnected) {
+      state.sensorConnected = false;
+      deviceStateWrite(state);
+    }
 
     // Blink alert LED slowly to indicate sensor error
     digitalWrite(ALERT_LED_PIN, !digitalRead(ALERT_LED_PIN));
-    return;
+    publishSample(state, 0);
+    return true;
   }
 
-  // Sensor is working - update state
-  if (!sensorConnected) {
+  if (!state.sensorConnected) {
+    char temperatureText[FIXED_TEXT_MAX];
+    char humidityText[FIXED_TEXT_MAX];
+    fixedFormat(sample.temperatureCenti, 1, temperatureText);
+    fixedFormat(sample.humidityCenti, 1, humidityText);
     Serial.println("[Sensor] ✓ DHT22 sensor connected successfully!");
-    Serial.printf("[Sensor] Initial reading: %.1f°C, %.1f%% humidity\n",
-                  temperature, humidity);
-  }
-  sensorConnected = true;
-  lastTemperature = temperature;
-  lastHumidity = humidity;
-
-  // Check thresholds
-  bool tempHigh = temperature > TEMP_HIGH_THRESHOLD;
-  bool tempLow = temperature < TEMP_LOW_THRESHOLD;
-  bool humidityHigh = humidity > HUMIDITY_HIGH_THRESHOLD;
-  bool humidityLow = humidity < HUMIDITY_LOW_THRESHOLD;
-  bool shouldAlert = tempHigh || tempLow || humidityHigh || humidityLow;
-
-  if (shouldAlert) {
-    if (!alertMode) {
-      // New alert - log details
-      Serial.println("[Alert] ⚠️ THRESHOLD EXCEEDED - TRIGGERING ALERT!");
-      if (tempHigh) {
-        Serial.printf(
-            "[Alert] 🔥 Temperature HIGH: %.1f°C (threshold: %.1f°C)\n",
-            temperature, TEMP_HIGH_THRESHOLD);
-      }
-      if (tempLow) {
-        Serial.printf("[Alert] ❄️ Temperature LOW: %.1f°C (threshold: %.1f°C)\n",
-                      temperature, TEMP_LOW_THRESHOLD);
-      }
-      if (humidityHigh) {
-        Serial.printf("[Alert] 💧 Humidity HIGH: %.1f%% (threshold: %.1f%%)\n",
-                      humidity, HUMIDITY_HIGH_THRESHOLD);
-      }
-      if (humidityLow) {
-        Serial.printf("[Alert] 🏜️ Humidity LOW: %.1f%% (threshold: %.1f%%)\n",
-                      humidity, HUMIDITY_LOW_THRESHOLD);
-      }
-    }
-    alertMode = true;
-    triggerAlert();
-  } else {
-    if (alertMode) {
-      Serial.println("[Alert] ✓ Conditions normalized - clearing alert");
-      Serial.printf("[Alert] Current: %.1f°C, %.1f%% humidity\n", temperature,
-                    humidity);
-      clearAlert();
-    }
-    alertMode = false;
+    Serial.printf("[Sensor] Initial reading: %s°C, %s%% humidity\n",
+                  temperatureText, humidityText);
   }
+  state.sensorConnected = true;
+  state.temperatureCenti = sample.temperatureCenti;
+  state.humidityCenti = sample.humidityCenti;
+  state.derived = sample.derived;
+  state.sampleMs = sample.timeMs;
+
+  bool wasAlert = state.alert;
+  state.alert = sample.exceeded != 0;
+  deviceStateWrite(state);
+
+  if (state.alert != wasAlert) {
+    AlertEvent alert;
+    alert.temperatureCenti = sample.temperatureCenti;
+    alert.humidityCenti = sample.humidityCenti;
+    alert.exceeded = sample.exceeded;
+    alert.active = state.alert;
+    eventPublishAlert(alert, state.sampleMs);
+  }
+  publishSample(state, sample.exceeded);
+  return true;
+}
+
+void publishSample(const DeviceState &state, uint8_t exceeded) {
+  SampleEvent sample;
+  sample.temperatureCenti = state.temperatureCenti;
+  sample.humidityCenti = state.humidityCenti;
+  sample.exceeded = exceeded;
+  sample.sensorConnected = state.sensorConnected;
+  sample.alert = state.alert;
+  eventPublishSample(sample, millis());
+}
+
+void bistReadSensor(float *temperature, float *humidity) {
+  *humidity = dht.readHumidity();
+  *temperature = dht.readTemperature();
 }
 
 void heartbeatBlink() {
@@ -667,3 +1663,50 @@ void clearAlert() {
   digitalWrite(BUZZER_PIN, LOW);
   Serial.println("[Alert] Alert indicators cleared");
 }
+
+// Flash and beep after every reading while the alert stands
+void onSampleAlert(const Event &event) {
+  if (event.sample.sensorConnected && event.sample.alert) {
+    triggerAlert();
+  }
+}
+
+void onAlertChange(const Event &event) {
+  const AlertEvent &alert = event.alert;
+  char temperatureText[FIXED_TEXT_MAX];
+  char humidityText[FIXED_TEXT_MAX];
+  fixedFormat(alert.temperatureCenti, 1, temperatureText);
+  fixedFormat(alert.humidityCenti, 1, humidityText);
+
+  if (!alert.active) {
+    Serial.println("[Alert] ✓ Conditions normalized - clearing alert");
+    Serial.printf("[Alert] Current: %s°C, %s%% humidity\n", temperatureText,
+                  humidityText);
+    clearAlert();
+    return;
+  }
+
+  // New alert - log details
+  Serial.println("[Alert] ⚠️ THRESHOLD EXCEEDED - TRIGGERING ALERT!");
+  char limitText[FIXED_TEXT_MAX];
+  if (alert.exceeded & THRESHOLD_TEMP_HIGH) {
+    fixedFormat(TEMP_HIGH_THRESHOLD_CENTI, 1, limitText);
+    Serial.printf("[Alert] 🔥 Temperature HIGH: %s°C (threshold: %s°C)\n",
+                  temperatureText, limitText);
+  }
+  if (alert.exceeded & THRESHOLD_TEMP_LOW) {
+    fixedFormat(TEMP_LOW_THRESHOLD_CENTI, 1, limitText);
+    Serial.printf("[Alert] ❄️ Temperature LOW: %s°C (threshold: %s°C)\n",
+                  temperatureText, limitText);
+  }
+  if (alert.exceeded & THRESHOLD_HUMIDITY_HIGH) {
+    fixedFormat(HUMIDITY_HIGH_THRESHOLD_CENTI, 1, limitText);
+    Serial.printf("[Alert] 💧 Humidity HIGH: %s%% (threshold: %s%%)\n",
+                  humidityText, limitText);
+  }
+  if (alert.exceeded & THRESHOLD_HUMIDITY_LOW) {
+    fixedFormat(HUMIDITY_LOW_THRESHOLD_CENTI, 1, limitText);
+    Serial.printf("[Alert] 🏜️ Humidity LOW: %s%% (threshold: %s%%)\n",
+                  humidityText, limitText);
+  }
+}
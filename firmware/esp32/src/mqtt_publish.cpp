@@ -0,0 +1,69 @@
+#include "mqtt_publish.h"
+#include "config.h"
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+// Only loop() publishes, so one frame is enough
+static uint8_t frame[MQTT_FRAME_SIZE];
+
+// ============================================================================
+// ENCODING
+// ============================================================================
+
+size_t mqttEncodePublish(uint8_t *out, size_t outLen, const char *topic,
+                         const uint8_t *payload, size_t length,
+                         bool retained) {
+  size_t topicLength = strlen(topic);
+  if (topicLength > 0xFFFF) {
+    return 0;
+  }
+  size_t remaining = 2 + topicLength + length;
+
+  // Fixed header: type and flags, then the remaining length as 7-bit groups
+  uint8_t header[5];
+  size_t headerLength = 0;
+  header[headerLength++] = 0x30 | (retained ? 0x01 : 0x00);
+  size_t value = remaining;
+  do {
+    uint8_t digit = value % 128;
+    value /= 128;
+    header[headerLength++] = value > 0 ? digit | 0x80 : digit;
+  } while (value > 0 && headerLength < sizeof(header));
+  if (value > 0 || headerLength + remaining > outLen) {
+    return 0;
+  }
+
+  uint8_t *p = out;
+  memcpy(p, header, headerLength);
+  p += headerLength;
+  *p++ = (uint8_t)(topicLength >> 8);
+  *p++ = (uint8_t)(topicLength & 0xFF);
+  memcpy(p, topic, topicLength);
+  p += topicLength;
+  if (length > 0) {
+    memcpy(p, payload, length);
+    p += length;
+  }
+  return p - out;
+}
+
+// ============================================================================
+// SENDING
+// ============================================================================
+
+bool mqttPublishFramed(PubSubClient &client, const char *topic,
+                       const uint8_t *payload, size_t length, bool retained) {
+  if (!client.connected()) {
+    return false;
+  }
+  size_t size =
+      mqttEncodePublish(frame, sizeof(frame), topic, payload, length, retained);
+  if (size == 0) {
+    return false;
+  }
+  // PubSubClient::write() goes straight to the socket as one call
+  return client.write(frame, size) == size;
+}
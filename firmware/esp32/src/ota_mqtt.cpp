@@ -0,0 +1,401 @@
+#include "ota_mqtt.h"
+#include "config.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <Update.h>
+#include <mbedtls/version.h>
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+#define OTA_MQTT_ID_MAX 48 // Same as ASYNC_CORRELATION_ID_MAX
+
+enum SlotState : uint8_t {
+  SLOT_IDLE,      // not asked for yet
+  SLOT_REQUESTED, // asked for, waiting
+  SLOT_RECEIVED,  // in RAM, waiting for the chunks before it
+};
+
+// Chunk i lives in slot i % window while base <= i < base + window
+struct Slot {
+  SlotState state;
+  uint8_t tries;
+  uint32_t requestedMs;
+};
+
+static bool active = false;
+static bool verified = false;
+static bool wasOffline = false;
+static char requestId[OTA_MQTT_ID_MAX];
+static uint32_t chunkSize = 0;
+static uint32_t window = 0;
+static uint32_t base = 0; // next chunk to hash and write
+static uint8_t *buffer = nullptr;
+static Slot slots[OTA_MQTT_WINDOW_MAX];
+static uint8_t expected[OTA_MQTT_SHA256_LEN];
+static mbedtls_sha256_context sha;
+static uint32_t srttMs = 0;
+static uint32_t rttVarMs = 0;
+static OtaMqttStats stats;
+static OtaMqttPublishFn publisher = nullptr;
+
+static uint32_t chunkLength(uint32_t index) {
+  uint32_t offset = index * chunkSize;
+  return min(chunkSize, stats.size - offset);
+}
+
+// ============================================================================
+// ROUND TRIP
+// ============================================================================
+
+// Jacobson/Karels as in TCP; only chunks asked for once give a sample
+static void rttSample(uint32_t sampleMs) {
+  if (srttMs == 0) {
+    srttMs = max(sampleMs, (uint32_t)1);
+    rttVarMs = sampleMs / 2;
+    return;
+  }
+  uint32_t delta = sampleMs > srttMs ? sampleMs - srttMs : srttMs - sampleMs;
+  rttVarMs = (3 * rttVarMs + delta) / 4;
+  srttMs = max((7 * srttMs + sampleMs) / 8, (uint32_t)1);
+}
+
+static uint32_t retransmitTimeout(uint8_t tries) {
+  uint32_t rto = srttMs ? srttMs + 4 * rttVarMs : OTA_MQTT_RTO_INITIAL_MS;
+  rto = max(rto, (uint32_t)OTA_MQTT_RTO_MIN_MS);
+  for (uint8_t i = 1; i < tries && rto < OTA_MQTT_RTO_MAX_MS; i++) {
+    rto *= 2;
+  }
+  return min(rto, (uint32_t)OTA_MQTT_RTO_MAX_MS);
+}
+
+// ============================================================================
+// TRANSFER
+// ============================================================================
+
+void otaMqttSetPublisher(OtaMqttPublishFn publish) { publisher = publish; }
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool otaMqttParseSha256(const char *hex, uint8_t out[OTA_MQTT_SHA256_LEN]) {
+  if (!hex || strlen(hex) != OTA_MQTT_SHA256_LEN * 2) {
+    return false;
+  }
+  for (int i = 0; i < OTA_MQTT_SHA256_LEN; i++) {
+    int high = hexValue(hex[2 * i]);
+    int low = hexValue(hex[2 * i + 1]);
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    out[i] = (uint8_t)(high << 4 | low);
+  }
+  return true;
+}
+
+// mbedTLS 3 dropped the _ret suffix
+void otaMqttSha256Start(mbedtls_sha256_context *ctx) {
+  mbedtls_sha256_init(ctx);
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+  mbedtls_sha256_starts_ret(ctx, 0);
+#else
+  mbedtls_sha256_starts(ctx, 0);
+#endif
+}
+
+void otaMqttSha256Update(mbedtls_sha256_context *ctx, const uint8_t *data,
+                         size_t length) {
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+  mbedtls_sha256_update_ret(ctx, data, length);
+#else
+  mbedtls_sha256_update(ctx, data, length);
+#endif
+}
+
+void otaMqttSha256Finish(mbedtls_sha256_context *ctx,
+                         uint8_t out[OTA_MQTT_SHA256_LEN]) {
+#if MBEDTLS_VERSION_NUMBER < 0x03000000
+  mbedtls_sha256_finish_ret(ctx, out);
+#else
+  mbedtls_sha256_finish(ctx, out);
+#endif
+}
+
+bool otaMqttBegin(const char *id, uint32_t size,
+                  const uint8_t sha256[OTA_MQTT_SHA256_LEN],
+                  uint32_t newChunkSize, uint32_t newWindow,
+                  const char **error) {
+  if (active) {
+    *error = "Update already running";
+    return false;
+  }
+  if (size == 0 || newChunkSize < OTA_MQTT_CHUNK_MIN ||
+      newChunkSize > OTA_MQTT_CHUNK_MAX || newWindow == 0 ||
+      newWindow > OTA_MQTT_WINDOW_MAX ||
+      newChunkSize * newWindow > OTA_MQTT_WINDOW_BYTES) {
+    *error = "Invalid size, chunkSize or window";
+    return false;
+  }
+  buffer = (uint8_t *)malloc(newChunkSize * newWindow);
+  if (!buffer) {
+    *error = "Out of memory";
+    return false;
+  }
+  if (!Update.begin(size)) {
+    free(buffer);
+    buffer = nullptr;
+    *error = "Cannot open OTA partition";
+    return false;
+  }
+
+  strncpy(requestId, id, sizeof(requestId) - 1);
+  requestId[sizeof(requestId) - 1] = '\0';
+  memcpy(expected, sha256, OTA_MQTT_SHA256_LEN);
+  chunkSize = newChunkSize;
+  window = newWindow;
+  base = 0;
+  memset(slots, 0, sizeof(slots));
+  srttMs = 0;
+  rttVarMs = 0;
+  stats = OtaMqttStats();
+  stats.size = size;
+  stats.chunks = (size + chunkSize - 1) / chunkSize;
+  otaMqttSha256Start(&sha);
+  verified = false;
+  wasOffline = false;
+  active = true;
+  Serial.printf("[OTA] MQTT transfer: %u bytes, %u chunks of %u, window %u\n",
+                (unsigned)size, (unsigned)stats.chunks, (unsigned)chunkSize,
+                (unsigned)window);
+  return true;
+}
+
+void otaMqttOnData(const uint8_t *payload, size_t length, uint32_t nowMs) {
+  if (!active || length < 4) {
+    return;
+  }
+  uint32_t index = (uint32_t)payload[0] << 24 | (uint32_t)payload[1] << 16 |
+                   (uint32_t)payload[2] << 8 | payload[3];
+  if (index < base || index >= base + window || index >= stats.chunks) {
+    stats.duplicates++;
+    return;
+  }
+  Slot &slot = slots[index % window];
+  if (slot.state == SLOT_RECEIVED) {
+    stats.duplicates++;
+    return;
+  }
+  if (length - 4 != chunkLength(index)) {
+    stats.rejected++; // asked for again when it times out
+    return;
+  }
+
+  memcpy(buffer + (index % window) * chunkSize, payload + 4, length - 4);
+  if (slot.state == SLOT_REQUESTED && slot.tries == 1) {
+    rttSample(nowMs - slot.requestedMs);
+  }
+  slot.state = SLOT_RECEIVED;
+}
+
+// Hashes and writes the front of the window; false on a flash error
+static bool writeInOrder() {
+  for (int i = 0; i < OTA_MQTT_WRITE_BURST && base < stats.chunks; i++) {
+    Slot &slot = slots[base % window];
+    if (slot.state != SLOT_RECEIVED) {
+      break;
+    }
+    uint8_t *data = buffer + (base % window) * chunkSize;
+    uint32_t length = chunkLength(base);
+    otaMqttSha256Update(&sha, data, length);
+    if (Update.write(data, length) != length) {
+      return false;
+    }
+    stats.written += length;
+    slot = Slot();
+    base++;
+  }
+  return true;
+}
+
+static bool finishImage(const char **error) {
+  uint8_t digest[OTA_MQTT_SHA256_LEN];
+  otaMqttSha256Finish(&sha, digest);
+  if (memcmp(digest, expected, sizeof(digest)) != 0) {
+    *error = "SHA-256 mismatch";
+    return false;
+  }
+  if (!Update.end()) {
+    *error = "Image rejected";
+    return false;
+  }
+  verified = true;
+  Serial.printf("[OTA] Image verified: %u bytes, %u chunk(s) re-requested\n",
+                (unsigned)stats.written, (unsigned)stats.rerequested);
+  return true;
+}
+
+// New slots and overdue ones, in one message
+static bool sendRequests(uint32_t nowMs, const char **error) {
+  uint32_t wanted[OTA_MQTT_WINDOW_MAX];
+  uint8_t count = 0;
+  uint32_t end = min(base + window, stats.chunks);
+  for (uint32_t index = base; index < end; index++) {
+    const Slot &slot = slots[index % window];
+    if (slot.state == SLOT_RECEIVED ||
+        (slot.state == SLOT_REQUESTED &&
+         nowMs - slot.requestedMs < retransmitTimeout(slot.tries))) {
+      continue;
+    }
+    if (slot.tries >= OTA_MQTT_MAX_TRIES) {
+      *error = "Transfer stalled";
+      return false;
+    }
+    wanted[count++] = index;
+  }
+  if (count == 0 || !publisher) {
+    return true;
+  }
+
+  JsonDocument doc;
+  doc["id"] = requestId;
+  doc["chunkSize"] = chunkSize;
+  JsonArray chunks = doc["chunks"].to<JsonArray>();
+  for (uint8_t i = 0; i < count; i++) {
+    chunks.add(wanted[i]);
+  }
+  char payload[256];
+  serializeJson(doc, payload, sizeof(payload));
+  if (!publisher(payload)) {
+    return true; // nothing marked, so the next pass tries again
+  }
+
+  stats.requests++;
+  for (uint8_t i = 0; i < count; i++) {
+    Slot &slot = slots[wanted[i] % window];
+    if (slot.tries > 0) {
+      stats.rerequested++;
+    }
+    slot.state = SLOT_REQUESTED;
+    slot.tries++;
+    slot.requestedMs = nowMs;
+  }
+  return true;
+}
+
+OtaMqttResult otaMqttService(uint32_t nowMs, bool online, const char **error) {
+  if (!active) {
+    *error = "Update not running";
+    return OTA_MQTT_FAILED;
+  }
+  if (verified) {
+    return OTA_MQTT_DONE;
+  }
+  if (!writeInOrder()) {
+    *error = "Flash write failed";
+    return OTA_MQTT_FAILED;
+  }
+  if (base == stats.chunks) {
+    return finishImage(error) ? OTA_MQTT_DONE : OTA_MQTT_FAILED;
+  }
+
+  if (!online) {
+    wasOffline = true;
+    return OTA_MQTT_RUNNING;
+  }
+  if (wasOffline) {
+    // Not a retry: nothing was lost by the server, so no backoff either
+    wasOffline = false;
+    for (uint32_t i = 0; i < window; i++) {
+      if (slots[i].state == SLOT_REQUESTED) {
+        slots[i] = Slot();
+        stats.rerequested++;
+      }
+    }
+  }
+  return sendRequests(nowMs, error) ? OTA_MQTT_RUNNING : OTA_MQTT_FAILED;
+}
+
+OtaMqttResult otaMqttFeed(const uint8_t *data, size_t length,
+                          const char **error) {
+  if (!active || base != 0) {
+    *error = "Update not running";
+    return OTA_MQTT_FAILED;
+  }
+  if (verified) {
+    return OTA_MQTT_DONE;
+  }
+  if (length > stats.size - stats.written) {
+    *error = "Image too long";
+    return OTA_MQTT_FAILED;
+  }
+  otaMqttSha256Update(&sha, data, length);
+  if (Update.write((uint8_t *)data, length) != length) {
+    *error = "Flash write failed";
+    return OTA_MQTT_FAILED;
+  }
+  stats.written += length;
+  if (stats.written < stats.size) {
+    return OTA_MQTT_RUNNING;
+  }
+  return finishImage(error) ? OTA_MQTT_DONE : OTA_MQTT_FAILED;
+}
+
+bool otaMqttRewind() {
+  if (!active || verified) {
+    return false;
+  }
+  Update.abort();
+  mbedtls_sha256_free(&sha);
+  if (!Update.begin(stats.size)) {
+    return false;
+  }
+  base = 0;
+  memset(slots, 0, sizeof(slots));
+  stats.written = 0;
+  otaMqttSha256Start(&sha);
+  return true;
+}
+
+void otaMqttEnd() {
+  if (!active) {
+    return;
+  }
+  if (!verified) {
+    Update.abort();
+  }
+  mbedtls_sha256_free(&sha);
+  free(buffer);
+  buffer = nullptr;
+  active = false;
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+bool otaMqttActive() { return active; }
+
+uint32_t otaMqttChunkSize() { return chunkSize; }
+
+uint8_t otaMqttProgress() {
+  return stats.size ? (uint8_t)((uint64_t)stats.written * 100 / stats.size)
+                    : 0;
+}
+
+OtaMqttStats otaMqttGetStats() {
+  OtaMqttStats current = stats;
+  current.srttMs = srttMs;
+  return current;
+}
@@ -0,0 +1,580 @@
+#include "ota_peer.h"
+#include "config.h"
+#include "ota_mqtt.h"
+#include "storage.h"
+#include <Arduino.h>
+#include <string.h>
+
+#ifdef ARDUINO_ARCH_ESP32
+#include <ESPAsyncWebServer.h>
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include <esp_idf_version.h>
+#include <esp_ota_ops.h>
+#include <esp_partition.h>
+#include <mdns.h>
+#include <strings.h>
+#endif
+
+#define OTA_PEER_SERVICE "_thingbase-ota"
+#define OTA_PEER_PROTO "_tcp"
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+struct Candidate {
+  char name[64];
+  uint32_t ip; // as IPAddress holds it
+  uint16_t port;
+  bool ready; // serving the image; otherwise fetching it
+  uint32_t connectMs;
+};
+
+enum Phase : uint8_t {
+  PHASE_DISCOVER,
+  PHASE_DOWNLOAD,
+  PHASE_CLOUD,
+};
+
+static char instanceName[64];
+static bool started = false;
+static OtaImageRecord served; // valid while serving
+
+// What the mDNS service says now; state nullptr when not advertised
+static const char *advertState = nullptr;
+static char advertSha[65];
+static uint32_t advertSize = 0;
+
+static Phase phase = PHASE_DISCOVER;
+static char wantedSha[65];
+static uint32_t wantedSize = 0;
+static uint32_t nextQueryMs = 0;
+static bool querying = false; // an mDNS query is out, answers not yet read
+static uint32_t waitingSinceMs = 0;
+static bool sawFetching = false; // a peer was getting it from the cloud
+static bool holdingOff = false;  // random wait before going ourselves
+static bool candidate = false;   // advertising "fetching", checking rivals
+static bool recorded = false;    // image verified; keep the advert
+static Candidate peers[OTA_PEER_MAX_CANDIDATES];
+static uint8_t peerCount = 0;
+static uint8_t nextPeer = 0;
+static uint32_t lastByteMs = 0;
+static OtaPeerStats stats;
+
+// ============================================================================
+// PLATFORM
+// ============================================================================
+
+#ifdef ARDUINO_ARCH_ESP32
+
+static AsyncWebServer *server = nullptr;
+static const esp_partition_t *servedPartition = nullptr;
+static uint8_t activeClients = 0; // only touched on the async_tcp task
+static WiFiClient peerClient;
+static HTTPClient peerHttp;
+static WiFiClient *peerStream = nullptr;
+static mdns_search_once_t *search = nullptr;
+
+static bool mdnsStart() {
+  if (mdns_init() != ESP_OK) {
+    return false;
+  }
+  mdns_hostname_set(instanceName);
+  mdns_instance_name_set(instanceName);
+  return true;
+}
+
+static void mdnsAdvertise(bool added) {
+  char size[12];
+  snprintf(size, sizeof(size), "%u", (unsigned)advertSize);
+  if (!advertState) {
+    mdns_service_remove(OTA_PEER_SERVICE, OTA_PEER_PROTO);
+    return;
+  }
+  mdns_txt_item_t txt[] = {
+      {"sha256", advertSha}, {"size", size}, {"state", advertState}};
+  if (!added) {
+    mdns_service_add(instanceName, OTA_PEER_SERVICE, OTA_PEER_PROTO,
+                     OTA_PEER_PORT, txt, 3);
+    return;
+  }
+  for (const mdns_txt_item_t &item : txt) {
+    mdns_service_txt_item_set(OTA_PEER_SERVICE, OTA_PEER_PROTO, item.key,
+                              item.value);
+  }
+}
+
+static const char *txtValue(const mdns_result_t *result, const char *key) {
+  for (size_t i = 0; i < result->txt_count; i++) {
+    if (strcmp(result->txt[i].key, key) == 0) {
+      return result->txt[i].value ? result->txt[i].value : "";
+    }
+  }
+  return "";
+}
+
+static uint32_t probeMs(const Candidate &peer) {
+  WiFiClient probe;
+  uint32_t startMs = millis();
+  if (!probe.connect(IPAddress(peer.ip), peer.port,
+                     OTA_PEER_CONNECT_TIMEOUT_MS)) {
+    return UINT32_MAX;
+  }
+  uint32_t elapsedMs = millis() - startMs;
+  probe.stop();
+  return elapsedMs;
+}
+
+// Sends the query and returns; the answers are read by mdnsQueryPoll()
+static bool mdnsQueryStart(uint8_t max) {
+#if ESP_IDF_VERSION_MAJOR >= 5
+  search = mdns_query_async_new(nullptr, OTA_PEER_SERVICE, OTA_PEER_PROTO,
+                                MDNS_TYPE_PTR, OTA_PEER_QUERY_MS, max + 1,
+                                nullptr);
+#else
+  search = mdns_query_async_new(nullptr, OTA_PEER_SERVICE, OTA_PEER_PROTO,
+                                MDNS_TYPE_PTR, OTA_PEER_QUERY_MS, max + 1);
+#endif
+  return search != nullptr;
+}
+
+// Peers other than us that have or are getting wantedSha; -1 until the
+// query time is up
+static int mdnsQueryPoll(Candidate *out, uint8_t max) {
+  mdns_result_t *results = nullptr;
+#if ESP_IDF_VERSION_MAJOR >= 5
+  uint8_t resultCount = 0;
+  if (!mdns_query_async_get_results(search, 0, &results, &resultCount)) {
+    return -1;
+  }
+#else
+  if (!mdns_query_async_get_results(search, 0, &results)) {
+    return -1;
+  }
+#endif
+  mdns_query_async_delete(search);
+  search = nullptr;
+  uint8_t count = 0;
+  for (mdns_result_t *r = results; r && count < max; r = r->next) {
+    if (!r->instance_name || strcmp(r->instance_name, instanceName) == 0 ||
+        strcasecmp(txtValue(r, "sha256"), wantedSha) != 0 ||
+        (uint32_t)atol(txtValue(r, "size")) != wantedSize) {
+      continue;
+    }
+    mdns_ip_addr_t *addr = r->addr;
+    while (addr && addr->addr.type != ESP_IPADDR_TYPE_V4) {
+      addr = addr->next;
+    }
+    if (!addr) {
+      continue;
+    }
+    Candidate &peer = out[count];
+    strncpy(peer.name, r->instance_name, sizeof(peer.name) - 1);
+    peer.name[sizeof(peer.name) - 1] = '\0';
+    peer.ip = addr->addr.u_addr.ip4.addr;
+    peer.port = r->port;
+    peer.ready = strcmp(txtValue(r, "state"), "ready") == 0;
+    peer.connectMs = peer.ready ? probeMs(peer) : UINT32_MAX;
+    if (!peer.ready || peer.connectMs != UINT32_MAX) {
+      count++;
+    }
+  }
+  mdns_query_results_free(results);
+  return count;
+}
+
+static bool peerOpen(const Candidate &peer) {
+  String uri = String("/ota?sha256=") + wantedSha;
+  if (!peerHttp.begin(peerClient, IPAddress(peer.ip).toString(), peer.port,
+                      uri)) {
+    return false;
+  }
+  peerHttp.setConnectTimeout(OTA_PEER_CONNECT_TIMEOUT_MS);
+  peerHttp.setTimeout(OTA_PEER_READ_TIMEOUT_MS);
+  int code = peerHttp.GET();
+  if (code != 200 || peerHttp.getSize() != (int)wantedSize) {
+    Serial.printf("[OTA] Peer %s answered %d\n", peer.name, code);
+    peerHttp.end();
+    return false;
+  }
+  peerStream = peerHttp.getStreamPtr();
+  return true;
+}
+
+// Bytes read, 0 if none yet, -1 once the peer has closed
+static int peerRead(uint8_t *buffer, size_t length) {
+  int available = peerStream->available();
+  if (available > 0) {
+    return peerStream->read(buffer, min((size_t)available, length));
+  }
+  return peerStream->connected() ? 0 : -1;
+}
+
+static void peerClose() {
+  if (peerStream) {
+    peerHttp.end();
+    peerStream = nullptr;
+  }
+}
+
+static void handleImage(AsyncWebServerRequest *request) {
+  if (!request->hasParam("sha256") ||
+      !request->getParam("sha256")->value().equalsIgnoreCase(served.sha256)) {
+    request->send(404);
+    return;
+  }
+  if (activeClients >= OTA_PEER_MAX_CLIENTS) {
+    request->send(503);
+    return;
+  }
+  activeClients++;
+  request->onDisconnect([]() { activeClients--; });
+  AsyncWebServerResponse *response = request->beginResponse(
+      "application/octet-stream", served.size,
+      [](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+        size_t length = min(maxLen, (size_t)(served.size - index));
+        if (esp_partition_read(servedPartition, index, buffer, length) !=
+            ESP_OK) {
+          return 0;
+        }
+        return length;
+      });
+  request->send(response);
+}
+
+static bool partitionMatches(const esp_partition_t *partition,
+                             const OtaImageRecord &record) {
+  uint8_t expected[OTA_MQTT_SHA256_LEN];
+  uint8_t digest[OTA_MQTT_SHA256_LEN];
+  uint8_t block[1024];
+  if (!otaMqttParseSha256(record.sha256, expected) ||
+      record.size > partition->size) {
+    return false;
+  }
+  mbedtls_sha256_context sha;
+  otaMqttSha256Start(&sha);
+  bool readOk = true;
+  for (uint32_t offset = 0; offset < record.size && readOk;
+       offset += sizeof(block)) {
+    size_t length = min((size_t)(record.size - offset), sizeof(block));
+    readOk = esp_partition_read(partition, offset, block, length) == ESP_OK;
+    otaMqttSha256Update(&sha, block, length);
+  }
+  otaMqttSha256Finish(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  return readOk && memcmp(digest, expected, sizeof(digest)) == 0;
+}
+
+// Serves the running image if it is the recorded one and still hashes right
+static bool serverStart(const OtaImageRecord &record) {
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  if (!running || strcmp(running->label, record.partition) != 0) {
+    return false;
+  }
+  if (!partitionMatches(running, record)) {
+    Serial.println("[OTA] Running image does not match its record");
+    return false;
+  }
+  servedPartition = running;
+  server = new AsyncWebServer(OTA_PEER_PORT);
+  server->on("/ota", HTTP_GET, handleImage);
+  server->begin();
+  return true;
+}
+
+static void bootPartitionLabel(char *label, size_t length) {
+  const esp_partition_t *partition = esp_ota_get_boot_partition();
+  strncpy(label, partition ? partition->label : "", length - 1);
+  label[length - 1] = '\0';
+}
+
+#else
+
+// Host: nothing on the LAN, so every update goes to the cloud
+static bool mdnsStart() { return true; }
+static void mdnsAdvertise(bool) {}
+static bool mdnsQueryStart(uint8_t) { return false; }
+static int mdnsQueryPoll(Candidate *, uint8_t) { return 0; }
+static bool peerOpen(const Candidate &) { return false; }
+static int peerRead(uint8_t *, size_t) { return -1; }
+static void peerClose() {}
+static bool serverStart(const OtaImageRecord &) { return false; }
+
+static void bootPartitionLabel(char *label, size_t length) {
+  strncpy(label, "host", length - 1);
+  label[length - 1] = '\0';
+}
+
+#endif
+
+// ============================================================================
+// ADVERTISING
+// ============================================================================
+
+static void advertise(const char *state, const char *sha, uint32_t size) {
+  if (!started) {
+    return;
+  }
+  bool added = advertState != nullptr;
+  advertState = state;
+  if (state) {
+    strncpy(advertSha, sha, sizeof(advertSha) - 1);
+    advertSha[sizeof(advertSha) - 1] = '\0';
+    advertSize = size;
+  }
+  mdnsAdvertise(added);
+}
+
+// Back to what we serve, if anything
+static void advertiseServed() {
+  if (served.isValid) {
+    advertise("ready", served.sha256, served.size);
+  } else {
+    advertise(nullptr, nullptr, 0);
+  }
+}
+
+void otaPeerBegin(const char *instance) {
+  if (started) {
+    return;
+  }
+  strncpy(instanceName, instance, sizeof(instanceName) - 1);
+  instanceName[sizeof(instanceName) - 1] = '\0';
+  if (!mdnsStart()) {
+    Serial.println("[OTA] mDNS failed to start; no LAN peers");
+    return;
+  }
+  started = true;
+
+  OtaImageRecord record = storageLoadOtaImage();
+  if (record.isValid && record.serve && serverStart(record)) {
+    served = record;
+    advertiseServed();
+    Serial.printf("[OTA] Serving this image to LAN peers on port %d\n",
+                  OTA_PEER_PORT);
+  }
+}
+
+void otaPeerRecordImage(const char *sha256Hex, uint32_t size, bool serve) {
+  OtaImageRecord record = {};
+  strncpy(record.sha256, sha256Hex, sizeof(record.sha256) - 1);
+  record.size = size;
+  bootPartitionLabel(record.partition, sizeof(record.partition));
+  record.serve = serve;
+  record.isValid = true;
+  storageSaveOtaImage(record);
+  recorded = true;
+}
+
+// ============================================================================
+// FETCHING
+// ============================================================================
+
+void otaPeerFetchBegin(const char *sha256Hex, uint32_t size, uint32_t nowMs) {
+  strncpy(wantedSha, sha256Hex, sizeof(wantedSha) - 1);
+  wantedSha[sizeof(wantedSha) - 1] = '\0';
+  wantedSize = size;
+  phase = PHASE_DISCOVER;
+  nextQueryMs = nowMs;
+  waitingSinceMs = nowMs;
+  sawFetching = false;
+  holdingOff = false;
+  candidate = false;
+  recorded = false;
+  peerCount = 0;
+  nextPeer = 0;
+  stats = OtaPeerStats();
+}
+
+static void goToCloud() {
+  advertise("fetching", wantedSha, wantedSize);
+  phase = PHASE_CLOUD;
+  Serial.println("[OTA] No LAN peer has the image; fetching from the cloud");
+}
+
+// Ready peers first, fastest connect first among them
+static bool before(const Candidate &a, const Candidate &b) {
+  if (a.ready != b.ready) {
+    return a.ready;
+  }
+  return a.connectMs < b.connectMs;
+}
+
+static void sortPeers() {
+  for (uint8_t i = 1; i < peerCount; i++) {
+    Candidate peer = peers[i];
+    uint8_t j = i;
+    for (; j > 0 && before(peer, peers[j - 1]); j--) {
+      peers[j] = peers[j - 1];
+    }
+    peers[j] = peer;
+  }
+}
+
+// Starts on the next ready peer; false when none is left
+static bool downloadNext(uint32_t nowMs) {
+  while (nextPeer < peerCount && peers[nextPeer].ready) {
+    const Candidate &peer = peers[nextPeer++];
+    stats.peersTried++;
+    if (peerOpen(peer)) {
+      strncpy(stats.peer, peer.name, sizeof(stats.peer) - 1);
+      stats.peer[sizeof(stats.peer) - 1] = '\0';
+      lastByteMs = nowMs;
+      phase = PHASE_DOWNLOAD;
+      Serial.printf("[OTA] Fetching image from LAN peer %s (%u ms)\n",
+                    peer.name, (unsigned)peer.connectMs);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Acts on the answers to a query: `found` peers are in peers[]
+static void discovered(uint32_t nowMs, uint8_t found) {
+  peerCount = found;
+  nextPeer = 0;
+  sortPeers();
+  nextQueryMs = nowMs + OTA_PEER_POLL_MS;
+
+  if (peerCount > 0 && peers[0].ready) {
+    if (candidate) {
+      candidate = false;
+      advertiseServed();
+    }
+    downloadNext(nowMs);
+    return; // busy peers are asked again next poll
+  }
+
+  // Someone is getting it from the cloud; a tie goes to the lower deviceId
+  bool rivalBelow = false;
+  for (uint8_t i = 0; i < peerCount; i++) {
+    if (strcmp(peers[i].name, instanceName) < 0) {
+      rivalBelow = true;
+    }
+  }
+  if (candidate) {
+    if (!rivalBelow) {
+      goToCloud();
+      return;
+    }
+    candidate = false;
+    advertiseServed();
+  }
+  if (peerCount > 0) {
+    if (!sawFetching) {
+      sawFetching = true;
+      waitingSinceMs = nowMs;
+    }
+    holdingOff = false;
+    if (nowMs - waitingSinceMs >= OTA_PEER_WAIT_MAX_MS) {
+      goToCloud();
+    }
+    return;
+  }
+
+  // Nobody has it or is getting it: hold off, then volunteer
+  sawFetching = false;
+  if (!holdingOff) {
+    holdingOff = true;
+    nextQueryMs = nowMs + esp_random() % (OTA_PEER_ELECTION_MS + 1);
+    return;
+  }
+  holdingOff = false;
+  candidate = true;
+  advertise("fetching", wantedSha, wantedSize);
+  nextQueryMs = nowMs + OTA_PEER_ANNOUNCE_MS;
+}
+
+// A peer that stalls, closes early or sends a bad image: try the next one
+static bool dropPeer(uint32_t nowMs, const char *reason) {
+  Serial.printf("[OTA] LAN peer %s dropped: %s\n", stats.peer, reason);
+  peerClose();
+  if (!otaMqttRewind()) {
+    return false;
+  }
+  phase = PHASE_DISCOVER;
+  if (!downloadNext(nowMs)) {
+    nextQueryMs = nowMs + OTA_PEER_POLL_MS;
+  }
+  return true;
+}
+
+static OtaPeerResult download(uint32_t nowMs, const char **error) {
+  static uint8_t block[1024];
+  const char *dropReason = nullptr;
+  for (uint32_t taken = 0; taken < OTA_PEER_READ_BURST;) {
+    int length = peerRead(block, sizeof(block));
+    if (length <= 0) {
+      dropReason = length < 0 ? "closed early" : nullptr;
+      break;
+    }
+    taken += length;
+    stats.bytes += length;
+    lastByteMs = nowMs;
+    OtaMqttResult result = otaMqttFeed(block, length, &dropReason);
+    if (result == OTA_MQTT_DONE) {
+      peerClose();
+      return OTA_PEER_DONE;
+    }
+    if (result == OTA_MQTT_FAILED) {
+      break;
+    }
+    dropReason = nullptr;
+  }
+  if (!dropReason && nowMs - lastByteMs >= OTA_PEER_READ_TIMEOUT_MS) {
+    dropReason = "stalled";
+  }
+  if (dropReason && !dropPeer(nowMs, dropReason)) {
+    *error = "Cannot open OTA partition";
+    return OTA_PEER_FAILED;
+  }
+  return phase == PHASE_DOWNLOAD ? OTA_PEER_FETCHING : OTA_PEER_SEARCHING;
+}
+
+OtaPeerResult otaPeerFetchStep(uint32_t nowMs, const char **error) {
+  if (phase == PHASE_CLOUD || !started) {
+    return OTA_PEER_USE_CLOUD;
+  }
+  if (phase == PHASE_DOWNLOAD) {
+    return download(nowMs, error);
+  }
+  // The query runs on the mDNS task; the loop only looks for its answers.
+  // One left out by otaPeerFetchEnd() is read by the next fetch, filtered
+  // for the new image.
+  if (querying) {
+    int found = mdnsQueryPoll(peers, OTA_PEER_MAX_CANDIDATES);
+    if (found >= 0) {
+      querying = false;
+      discovered(nowMs, (uint8_t)found);
+    }
+  } else if ((int32_t)(nowMs - nextQueryMs) >= 0) {
+    stats.discoveries++;
+    querying = mdnsQueryStart(OTA_PEER_MAX_CANDIDATES);
+    if (!querying) {
+      discovered(nowMs, 0);
+    }
+  }
+  if (phase == PHASE_CLOUD) {
+    return OTA_PEER_USE_CLOUD;
+  }
+  return phase == PHASE_DOWNLOAD ? OTA_PEER_FETCHING : OTA_PEER_SEARCHING;
+}
+
+void otaPeerFetchEnd() {
+  peerClose();
+  // Through the restart, so waiting peers do not elect another fetcher
+  if (!recorded && (candidate || phase == PHASE_CLOUD)) {
+    advertiseServed();
+  }
+  candidate = false;
+  phase = PHASE_DISCOVER;
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+OtaPeerStats otaPeerGetStats() { return stats; }
+
+bool otaPeerServing() { return served.isValid; }
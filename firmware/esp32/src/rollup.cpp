@@ -0,0 +1,188 @@
+#include "rollup.h"
+#include "config.h"
+#include "timesync.h"
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <string.h>
+
+#ifndef RTC_NOINIT_ATTR
+#define RTC_NOINIT_ATTR // host: a static survives a simulated restart
+#endif
+
+#define ROLLUP_MAGIC 0x524F4C4C // "ROLL"
+#define ROLLUP_LEVELS 2
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static const uint32_t periods[ROLLUP_LEVELS] = {ROLLUP_SHORT_S,
+                                                ROLLUP_LONG_S};
+
+// Incremental accumulators: two buckets merge by adding them up
+struct Accumulator {
+  uint32_t count;
+  int32_t sum;
+  uint64_t sumSquares;
+  int16_t min;
+  int16_t max;
+};
+
+struct Bucket {
+  uint32_t startS; // epoch seconds, a multiple of the period
+  uint32_t periodS;
+  Accumulator temperature;
+  Accumulator humidity;
+};
+
+// Kept across resets; the size is part of the check, so a build with a
+// different layout starts clean
+struct RollupStore {
+  uint32_t magic;
+  uint32_t size;
+  Bucket open[ROLLUP_LEVELS]; // count 0: nothing open
+  Bucket closed[ROLLUP_RETAIN];
+  uint8_t head; // oldest closed bucket
+  uint8_t count;
+};
+
+static RTC_NOINIT_ATTR RollupStore store;
+
+static RollupPublishFn publisher = nullptr;
+static uint32_t sent = 0;
+static uint32_t dropped = 0;
+
+void rollupSetPublisher(RollupPublishFn publish) { publisher = publish; }
+
+void rollupBegin() {
+  if (store.magic == ROLLUP_MAGIC && store.size == sizeof(store) &&
+      store.head < ROLLUP_RETAIN && store.count <= ROLLUP_RETAIN) {
+    if (store.count > 0) {
+      Serial.printf("[Rollup] %u bucket(s) kept from before the reset\n",
+                    store.count);
+    }
+    return;
+  }
+  memset(&store, 0, sizeof(store));
+  store.magic = ROLLUP_MAGIC;
+  store.size = sizeof(store);
+}
+
+// ============================================================================
+// ACCUMULATION
+// ============================================================================
+
+static void fold(Accumulator &a, int16_t value) {
+  if (a.count == 0 || value < a.min) {
+    a.min = value;
+  }
+  if (a.count == 0 || value > a.max) {
+    a.max = value;
+  }
+  a.count++;
+  a.sum += value;
+  a.sumSquares += (uint64_t)((int32_t)value * value);
+}
+
+static void closeBucket(uint8_t level) {
+  Bucket &bucket = store.open[level];
+  if (store.count == ROLLUP_RETAIN) {
+    store.head = (store.head + 1) % ROLLUP_RETAIN;
+    store.count--;
+    dropped++;
+  }
+  store.closed[(store.head + store.count) % ROLLUP_RETAIN] = bucket;
+  store.count++;
+  memset(&bucket, 0, sizeof(bucket));
+}
+
+void rollupAdd(int16_t temperatureCenti, int16_t humidityCenti,
+               uint32_t sampleMs) {
+  if (!timeSyncIsSynced()) {
+    return;
+  }
+  uint32_t epochS = (uint32_t)(timeSyncToEpochMs(sampleMs) / 1000);
+  for (uint8_t level = 0; level < ROLLUP_LEVELS; level++) {
+    Bucket &bucket = store.open[level];
+    uint32_t startS = epochS - epochS % periods[level];
+    // Also when the clock was stepped back into an earlier period
+    if (bucket.temperature.count > 0 && bucket.startS != startS) {
+      closeBucket(level);
+    }
+    if (bucket.temperature.count == 0) {
+      bucket.startS = startS;
+      bucket.periodS = periods[level];
+    }
+    fold(bucket.temperature, temperatureCenti);
+    fold(bucket.humidity, humidityCenti);
+  }
+}
+
+// ============================================================================
+// PUBLISHING
+// ============================================================================
+
+static void putAccumulator(JsonObject out, const Accumulator &a) {
+  out["count"] = a.count;
+  out["min"] = a.min;
+  out["max"] = a.max;
+  out["sum"] = a.sum;
+  out["sumSq"] = a.sumSquares;
+}
+
+// True when the bucket is done with: sent, or dropped as too large
+static bool send(const Bucket &bucket) {
+  char start[32];
+  timeSyncFormatEpochIso8601((uint64_t)bucket.startS * 1000, start,
+                             sizeof(start));
+
+  JsonDocument doc;
+  doc["periodS"] = bucket.periodS;
+  doc["start"] = start;
+  doc["scale"] = 100;
+  putAccumulator(doc["temperature"].to<JsonObject>(), bucket.temperature);
+  putAccumulator(doc["humidity"].to<JsonObject>(), bucket.humidity);
+  char payload[320];
+  size_t length = measureJson(doc);
+  if (length >= sizeof(payload)) {
+    // Would go out cut short and never fits, so it must not block the ring
+    Serial.printf("[Rollup] Bucket is %u bytes, dropped\n", (unsigned)length);
+    dropped++;
+    return true;
+  }
+  serializeJson(doc, payload, sizeof(payload));
+  if (!publisher(payload)) {
+    return false;
+  }
+  sent++;
+  return true;
+}
+
+void rollupService(uint32_t nowMs, bool connected) {
+  if (timeSyncIsSynced()) {
+    uint32_t nowS = (uint32_t)(timeSyncToEpochMs(nowMs) / 1000);
+    for (uint8_t level = 0; level < ROLLUP_LEVELS; level++) {
+      const Bucket &bucket = store.open[level];
+      if (bucket.temperature.count > 0 &&
+          nowS >= bucket.startS + bucket.periodS) {
+        closeBucket(level);
+      }
+    }
+  }
+
+  if (!connected || !publisher || store.count == 0) {
+    return;
+  }
+  if (send(store.closed[store.head])) {
+    store.head = (store.head + 1) % ROLLUP_RETAIN;
+    store.count--;
+  }
+}
+
+RollupStats rollupGetStats() {
+  RollupStats stats;
+  stats.pending = store.count;
+  stats.sent = sent;
+  stats.dropped = dropped;
+  return stats;
+}
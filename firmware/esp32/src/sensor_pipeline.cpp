@@ -0,0 +1,206 @@
+#include "sensor_pipeline.h"
+#include "thresholds.h"
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static const PipelineStage *stages = nullptr;
+static uint8_t stageTotal = 0;
+static PipelineBatch batch;
+static PipelineStageStats stats[PIPELINE_MAX_STAGES];
+
+// Spike filter: the last reading let through, and whether the one before
+// this was held back as a spike
+static PipelineSample lastAccepted;
+static bool haveAccepted = false;
+static bool spikeHeld = false;
+
+void pipelineBegin(const PipelineStage *stageTable, uint8_t stageCount) {
+  stages = stageTable;
+  stageTotal = stageCount < PIPELINE_MAX_STAGES ? stageCount
+                                                : PIPELINE_MAX_STAGES;
+  batch.count = 0;
+  memset(stats, 0, sizeof(stats));
+  haveAccepted = false;
+  spikeHeld = false;
+}
+
+// ============================================================================
+// RUNNER
+// ============================================================================
+
+static void record(PipelineStageStats &s, uint32_t us, uint32_t held) {
+  s.runs++;
+  s.totalUs += us;
+  if (us > s.maxUs) {
+    s.maxUs = us;
+  }
+  if (held > s.heapHeldMax) {
+    s.heapHeldMax = held;
+  }
+}
+
+void pipelineRun(uint32_t nowMs) {
+  for (uint8_t i = 0; i < stageTotal; i++) {
+    uint32_t freeBefore = ESP.getFreeHeap();
+    uint32_t start = micros();
+    bool more = stages[i].process(batch, nowMs);
+    uint32_t us = micros() - start;
+    uint32_t freeAfter = ESP.getFreeHeap();
+    record(stats[i], us, freeBefore > freeAfter ? freeBefore - freeAfter : 0);
+
+    if (!more) {
+      if (i > 0) {
+        batch.count = 0;
+      }
+      return;
+    }
+  }
+  batch.count = 0;
+}
+
+uint8_t pipelineStageCount() { return stageTotal; }
+
+PipelineStageStats pipelineStageStats(uint8_t index) {
+  return index < stageTotal ? stats[index] : PipelineStageStats();
+}
+
+void pipelineReport(JsonObject out) {
+  for (uint8_t i = 0; i < stageTotal; i++) {
+    const PipelineStageStats &s = stats[i];
+    JsonObject stage = out[stages[i].name].to<JsonObject>();
+    stage["runs"] = s.runs;
+    stage["meanUs"] = s.runs ? s.totalUs / s.runs : 0;
+    stage["maxUs"] = s.maxUs;
+    stage["heap"] = s.heapHeldMax;
+  }
+}
+
+// ============================================================================
+// FILTER
+// ============================================================================
+
+static bool inRange(const PipelineSample &sample) {
+  return sample.temperatureCenti >= PIPELINE_TEMP_MIN_CENTI &&
+         sample.temperatureCenti <= PIPELINE_TEMP_MAX_CENTI &&
+         sample.humidityCenti >= PIPELINE_HUMIDITY_MIN_CENTI &&
+         sample.humidityCenti <= PIPELINE_HUMIDITY_MAX_CENTI;
+}
+
+// A jump is held back once; if the next reading stays up there, it was
+// real and goes through
+static bool isSpike(const PipelineSample &sample) {
+  if (!haveAccepted || spikeHeld) {
+    return false;
+  }
+  int32_t temperatureJump =
+      abs(sample.temperatureCenti - lastAccepted.temperatureCenti);
+  int32_t humidityJump = abs(sample.humidityCenti - lastAccepted.humidityCenti);
+  return (PIPELINE_SPIKE_TEMP_CENTI > 0 &&
+          temperatureJump > PIPELINE_SPIKE_TEMP_CENTI) ||
+         (PIPELINE_SPIKE_HUMIDITY_CENTI > 0 &&
+          humidityJump > PIPELINE_SPIKE_HUMIDITY_CENTI);
+}
+
+// Out-of-range readings stay in the batch as failed reads; spikes leave it
+bool pipelineFilter(PipelineBatch &b, uint32_t nowMs) {
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < b.count; i++) {
+    PipelineSample sample = b.samples[i];
+    if (sample.valid && !inRange(sample)) {
+      sample.valid = false;
+    }
+    if (sample.valid) {
+      if (isSpike(sample)) {
+        spikeHeld = true;
+        continue;
+      }
+      spikeHeld = false;
+      lastAccepted = sample;
+      haveAccepted = true;
+    }
+    b.samples[kept++] = sample;
+  }
+  b.count = kept;
+  return kept > 0;
+}
+
+// ============================================================================
+// DERIVE, AGGREGATE & RULES
+// ============================================================================
+
+// Per reading, before aggregate: the metrics are not linear in temperature
+// and humidity, so the metric of a mean is not the mean of the metric
+bool pipelineDerive(PipelineBatch &b, uint32_t nowMs) {
+  for (uint8_t i = 0; i < b.count; i++) {
+    PipelineSample &sample = b.samples[i];
+    if (sample.valid) {
+      derivedCompute(sample.temperatureCenti, sample.humidityCenti,
+                     sample.derived);
+    }
+  }
+  return true;
+}
+
+// Rounded half away from zero
+static int16_t mean(int32_t sum, uint8_t count) {
+  int32_t half = count / 2;
+  return (int16_t)((sum + (sum < 0 ? -half : half)) / count);
+}
+
+// Mean of the valid samples, derived metrics included, rounded and stamped
+// with the last of them; the last failed one when none is valid
+bool pipelineAggregate(PipelineBatch &b, uint32_t nowMs) {
+  if (b.count == 0) {
+    return false;
+  }
+  int32_t temperatureSum = 0;
+  int32_t humiditySum = 0;
+  int32_t dewPointSum = 0;
+  int32_t absoluteHumiditySum = 0;
+  int32_t heatIndexSum = 0;
+  uint8_t valid = 0;
+  uint32_t timeMs = 0;
+  for (uint8_t i = 0; i < b.count; i++) {
+    const PipelineSample &sample = b.samples[i];
+    if (sample.valid) {
+      temperatureSum += sample.temperatureCenti;
+      humiditySum += sample.humidityCenti;
+      dewPointSum += sample.derived.dewPointCenti;
+      absoluteHumiditySum += sample.derived.absoluteHumidityCenti;
+      heatIndexSum += sample.derived.heatIndexCenti;
+      timeMs = sample.timeMs;
+      valid++;
+    }
+  }
+  if (valid == 0) {
+    b.samples[0] = b.samples[b.count - 1];
+  } else {
+    PipelineSample &out = b.samples[0];
+    out.temperatureCenti = mean(temperatureSum, valid);
+    out.humidityCenti = mean(humiditySum, valid);
+    out.derived.dewPointCenti = mean(dewPointSum, valid);
+    out.derived.absoluteHumidityCenti = mean(absoluteHumiditySum, valid);
+    out.derived.heatIndexCenti = mean(heatIndexSum, valid);
+    out.timeMs = timeMs;
+    out.exceeded = 0;
+    out.valid = true;
+  }
+  b.count = 1;
+  return true;
+}
+
+bool pipelineRules(PipelineBatch &b, uint32_t nowMs) {
+  for (uint8_t i = 0; i < b.count; i++) {
+    PipelineSample &sample = b.samples[i];
+    sample.exceeded =
+        sample.valid
+            ? thresholdsEvaluate(sample.temperatureCenti, sample.humidityCenti)
+            : 0;
+  }
+  return true;
+}
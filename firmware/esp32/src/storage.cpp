@@ -54,6 +54,43 @@ void storageSaveMqtt(const char *broker, const char *clientId,
   Serial.printf("[Storage] MQTT saved: %s\n", broker);
 }
 
+void storageSaveProfile(uint8_t profile) {
+  prefs.putUChar("tele_profile", profile);
+  Serial.printf("[Storage] Telemetry profile saved: %u\n", profile);
+}
+
+uint8_t storageLoadProfile() { return prefs.getUChar("tele_profile", 0); }
+
+void storageSaveGroups(const char *groups) {
+  prefs.putString("groups", groups);
+  Serial.printf("[Storage] Groups saved: %s\n", groups);
+}
+
+String storageLoadGroups() { return prefs.getString("groups", ""); }
+
+void storageSaveOtaImage(const OtaImageRecord &record) {
+  prefs.putString("ota_sha", record.sha256);
+  prefs.putUInt("ota_size", record.size);
+  prefs.putString("ota_part", record.partition);
+  prefs.putBool("ota_serve", record.serve);
+  Serial.printf("[Storage] OTA image saved: %u bytes in %s\n",
+                (unsigned)record.size, record.partition);
+}
+
+OtaImageRecord storageLoadOtaImage() {
+  OtaImageRecord record = {};
+  String sha = prefs.getString("ota_sha", "");
+  if (sha.length() == sizeof(record.sha256) - 1) {
+    strncpy(record.sha256, sha.c_str(), sizeof(record.sha256) - 1);
+    record.size = prefs.getUInt("ota_size", 0);
+    strncpy(record.partition, prefs.getString("ota_part", "").c_str(),
+            sizeof(record.partition) - 1);
+    record.serve = prefs.getBool("ota_serve", false);
+    record.isValid = record.size > 0;
+  }
+  return record;
+}
+
 MqttCredentials storageLoadMqtt() {
   MqttCredentials creds;
 
@@ -85,3 +122,37 @@ MqttCredentials storageLoadMqtt() {
 
   return creds;
 }
+
+void storageSaveCrash(const CrashRecord &record) {
+  prefs.putString("crash_id", record.id);
+  prefs.putString("crash_boot", record.crashedBoot);
+  prefs.putUChar("crash_reason", record.reason);
+  prefs.putUInt("crash_uptime", record.uptimeMs);
+}
+
+CrashRecord storageLoadCrash() {
+  CrashRecord record = {};
+  String id = prefs.getString("crash_id", "");
+  if (id.length() == sizeof(record.id) - 1) {
+    strncpy(record.id, id.c_str(), sizeof(record.id) - 1);
+    strncpy(record.crashedBoot, prefs.getString("crash_boot", "").c_str(),
+            sizeof(record.crashedBoot) - 1);
+    record.reason = prefs.getUChar("crash_reason", 0);
+    record.uptimeMs = prefs.getUInt("crash_uptime", 0);
+    record.isValid = true;
+  }
+  return record;
+}
+
+void storageClearCrash() {
+  prefs.remove("crash_id");
+  prefs.remove("crash_boot");
+  prefs.remove("crash_reason");
+  prefs.remove("crash_uptime");
+}
+
+bool storageSelfTest() {
+  uint32_t value = prefs.getUInt("bist_seq", 0) + 1;
+  return prefs.putUInt("bist_seq", value) == sizeof(value) &&
+         prefs.getUInt("bist_seq", 0) == value;
+}
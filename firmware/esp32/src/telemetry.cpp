@@ -0,0 +1,168 @@
+#include "telemetry.h"
+#include "config.h"
+#include "fixed_point.h"
+#include "timesync.h"
+#include <stdio.h>
+#include <string.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static char bootId[9] = "00000000";
+static uint32_t lastSeq = 0;
+
+// Sequence numbers are contiguous, so seq % size is the slot
+static TelemetryReading retained[TELEMETRY_RETENTION];
+
+// ============================================================================
+// SERIALISATION
+// ============================================================================
+
+// Written by hand rather than through a JsonDocument: the shape is fixed,
+// nothing needs escaping, and the sensor values are already hundredths, so
+// there is no pool to allocate and no float to print. Fields and their
+// order are as serializeJson() wrote them.
+struct JsonWriter {
+  char *out;
+  size_t outLen;
+  size_t length;
+  bool overflow; // once set, nothing more is written
+};
+
+static void put(JsonWriter &w, const char *text, size_t length) {
+  if (w.overflow || w.length + length >= w.outLen) {
+    w.overflow = true;
+    return;
+  }
+  memcpy(w.out + w.length, text, length);
+  w.length += length;
+}
+
+static void putLiteral(JsonWriter &w, const char *text) {
+  put(w, text, strlen(text));
+}
+
+static void putUnsigned(JsonWriter &w, uint32_t value) {
+  char digits[10];
+  size_t count = sizeof(digits);
+  do {
+    digits[--count] = '0' + value % 10;
+    value /= 10;
+  } while (value);
+  put(w, digits + count, sizeof(digits) - count);
+}
+
+static void putInteger(JsonWriter &w, int32_t value) {
+  if (value < 0) {
+    put(w, "-", 1);
+  }
+  putUnsigned(w, value < 0 ? 0u - (uint32_t)value : (uint32_t)value);
+}
+
+static void putFixed(JsonWriter &w, int32_t value) {
+  char text[FIXED_TEXT_MAX];
+  put(w, text, fixedFormatJson(value, text));
+}
+
+static void putBool(JsonWriter &w, bool value) {
+  putLiteral(w, value ? "true" : "false");
+}
+
+size_t telemetrySerialize(const TelemetryReading &reading, uint8_t fields,
+                          bool resent, char *out, size_t outLen) {
+  JsonWriter w = {out, outLen, 0, false};
+  putLiteral(w, "{\"boot\":\"");
+  putLiteral(w, bootId);
+  putLiteral(w, "\",\"seq\":");
+  putUnsigned(w, reading.seq);
+  if (resent) {
+    putLiteral(w, ",\"resent\":true");
+  }
+
+  putLiteral(w, ",\"data\":{\"temperature\":");
+  putFixed(w, reading.temperatureCenti);
+  putLiteral(w, ",\"humidity\":");
+  putFixed(w, reading.humidityCenti);
+  if (fields & TELEMETRY_FIELD_DERIVED) {
+    putLiteral(w, ",\"dewPoint\":");
+    putFixed(w, reading.derived.dewPointCenti);
+    putLiteral(w, ",\"absHumidity\":");
+    putFixed(w, reading.derived.absoluteHumidityCenti);
+    putLiteral(w, ",\"heatIndex\":");
+    putFixed(w, reading.derived.heatIndexCenti);
+  }
+  if (fields & TELEMETRY_FIELD_UPTIME) {
+    putLiteral(w, ",\"uptime\":");
+    putUnsigned(w, reading.uptimeS);
+  }
+  if (fields & TELEMETRY_FIELD_RSSI) {
+    putLiteral(w, ",\"rssi\":");
+    putInteger(w, reading.rssi);
+  }
+  if (fields & TELEMETRY_FIELD_LED) {
+    putLiteral(w, ",\"led\":");
+    putBool(w, reading.led);
+  }
+  if (fields & TELEMETRY_FIELD_ALERT_LED) {
+    putLiteral(w, ",\"alertLed\":");
+    putBool(w, reading.alertLed);
+  }
+  if (fields & TELEMETRY_FIELD_ALERT) {
+    putLiteral(w, ",\"alert\":");
+    putBool(w, reading.alert);
+  }
+  if (fields & TELEMETRY_FIELD_SENSOR) {
+    putLiteral(w, ",\"sensorConnected\":");
+    putBool(w, reading.sensorConnected);
+  }
+  putLiteral(w, "}");
+
+  // Stamp with the time the sample was taken, not when it is sent
+  char iso[32];
+  if (timeSyncFormatIso8601(reading.sampleMs, iso, sizeof(iso))) {
+    putLiteral(w, ",\"timestamp\":\"");
+    putLiteral(w, iso);
+    putLiteral(w, "\"");
+  }
+  putLiteral(w, "}");
+
+  if (w.overflow) {
+    return 0;
+  }
+  out[w.length] = '\0';
+  return w.length;
+}
+
+// ============================================================================
+// SEQUENCE & RETENTION
+// ============================================================================
+
+void telemetryBegin(uint32_t id) {
+  snprintf(bootId, sizeof(bootId), "%08x", (unsigned)id);
+  lastSeq = 0;
+  memset(retained, 0, sizeof(retained));
+}
+
+const char *telemetryBootId() { return bootId; }
+
+uint32_t telemetryRecord(TelemetryReading &reading) {
+  reading.seq = ++lastSeq;
+  retained[reading.seq % TELEMETRY_RETENTION] = reading;
+  return reading.seq;
+}
+
+const TelemetryReading *telemetryFindRetained(uint32_t seq) {
+  const TelemetryReading &slot = retained[seq % TELEMETRY_RETENTION];
+  return seq != 0 && slot.seq == seq ? &slot : nullptr;
+}
+
+uint32_t telemetryOldestRetained() {
+  if (lastSeq == 0) {
+    return 0;
+  }
+  return lastSeq > TELEMETRY_RETENTION ? lastSeq - TELEMETRY_RETENTION + 1
+                                       : 1;
+}
+
+uint32_t telemetryLastSeq() { return lastSeq; }
@@ -0,0 +1,19 @@
+#include "thresholds.h"
+#include "config.h"
+
+uint8_t thresholdsEvaluate(int16_t temperatureCenti, int16_t humidityCenti) {
+  uint8_t exceeded = 0;
+  if (temperatureCenti > TEMP_HIGH_THRESHOLD_CENTI) {
+    exceeded |= THRESHOLD_TEMP_HIGH;
+  }
+  if (temperatureCenti < TEMP_LOW_THRESHOLD_CENTI) {
+    exceeded |= THRESHOLD_TEMP_LOW;
+  }
+  if (humidityCenti > HUMIDITY_HIGH_THRESHOLD_CENTI) {
+    exceeded |= THRESHOLD_HUMIDITY_HIGH;
+  }
+  if (humidityCenti < HUMIDITY_LOW_THRESHOLD_CENTI) {
+    exceeded |= THRESHOLD_HUMIDITY_LOW;
+  }
+  return exceeded;
+}
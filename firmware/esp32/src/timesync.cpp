@@ -0,0 +1,205 @@
+#include "timesync.h"
+#include "config.h"
+#include <stdio.h>
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static TimeSyncSample samples[TIME_SYNC_BURST_SIZE];
+static uint8_t sampleCount = 0;
+static uint8_t lastRoundSamples = 0;
+
+static bool pending = false;
+static uint32_t pendingT0 = 0;
+
+// Clock model: epoch(local) = refEpochMs + elapsed + elapsed * driftPpb / 1e9
+static bool synced = false;
+static uint32_t refLocalMs = 0;
+static uint64_t refEpochMs = 0;
+static int64_t driftPpb = 0;
+static uint32_t bestDelayMs = 0;
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+static uint64_t modelEpochMs(uint32_t localMs) {
+  int64_t elapsed = (int32_t)(localMs - refLocalMs);
+  return refEpochMs + elapsed + (elapsed * driftPpb) / 1000000000LL;
+}
+
+// Howard Hinnant's civil_from_days: days since 1970-01-01 -> y/m/d
+static void civilFromDays(int64_t z, int *year, unsigned *month,
+                          unsigned *day) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = (unsigned)(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  *day = doy - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+// ============================================================================
+// EXCHANGES
+// ============================================================================
+
+void timeSyncReset() {
+  sampleCount = 0;
+  lastRoundSamples = 0;
+  pending = false;
+  synced = false;
+  driftPpb = 0;
+  bestDelayMs = 0;
+}
+
+uint32_t timeSyncBeginExchange(uint32_t nowLocalMs) {
+  pending = true;
+  pendingT0 = nowLocalMs;
+  return nowLocalMs;
+}
+
+bool timeSyncExchangePending() { return pending; }
+
+bool timeSyncHandleResponse(uint32_t t0, uint64_t t1, uint64_t t2,
+                            uint32_t t3) {
+  // Only the outstanding request counts; late replies would skew the filter
+  if (!pending || t0 != pendingT0) {
+    return false;
+  }
+  pending = false;
+
+  if (t2 < t1) {
+    return false;
+  }
+
+  int64_t roundTrip = (int64_t)(uint32_t)(t3 - t0);
+  int64_t serverTime = (int64_t)(t2 - t1);
+  int64_t delay = roundTrip - serverTime;
+  if (delay < 0 || delay > TIME_SYNC_MAX_DELAY_MS) {
+    return false;
+  }
+
+  // t3 is rebuilt as t0 + roundTrip so a millis() wrap inside the exchange
+  // cannot corrupt the offset
+  TimeSyncSample sample;
+  int64_t t3Local = (int64_t)t0 + roundTrip;
+  sample.offsetMs =
+      (((int64_t)t1 - (int64_t)t0) + ((int64_t)t2 - t3Local)) / 2;
+  sample.delayMs = (uint32_t)delay;
+  sample.localMs = t3;
+
+  if (sampleCount < TIME_SYNC_BURST_SIZE) {
+    samples[sampleCount++] = sample;
+  } else {
+    // Window full: replace the worst (highest delay) sample
+    uint8_t worst = 0;
+    for (uint8_t i = 1; i < sampleCount; i++) {
+      if (samples[i].delayMs > samples[worst].delayMs) {
+        worst = i;
+      }
+    }
+    if (sample.delayMs < samples[worst].delayMs) {
+      samples[worst] = sample;
+    }
+  }
+  return true;
+}
+
+bool timeSyncCommitRound() {
+  pending = false;
+  lastRoundSamples = sampleCount;
+  if (sampleCount == 0) {
+    return false;
+  }
+
+  // Clock filter: the lowest-delay exchange has the least asymmetry error
+  uint8_t best = 0;
+  for (uint8_t i = 1; i < sampleCount; i++) {
+    if (samples[i].delayMs < samples[best].delayMs) {
+      best = i;
+    }
+  }
+  const TimeSyncSample &s = samples[best];
+  sampleCount = 0;
+
+  uint64_t measuredEpoch = (uint64_t)((int64_t)s.localMs + s.offsetMs);
+
+  if (synced) {
+    int64_t elapsed = (int32_t)(s.localMs - refLocalMs);
+    if (elapsed >= TIME_SYNC_MIN_DRIFT_SPAN_MS) {
+      // Residual rate error since the last round, folded in at half gain
+      int64_t errorMs = (int64_t)(measuredEpoch - modelEpochMs(s.localMs));
+      driftPpb += (errorMs * 1000000000LL / elapsed) / 2;
+      const int64_t maxPpb = (int64_t)TIME_SYNC_MAX_DRIFT_PPM * 1000;
+      if (driftPpb > maxPpb) {
+        driftPpb = maxPpb;
+      } else if (driftPpb < -maxPpb) {
+        driftPpb = -maxPpb;
+      }
+    }
+  }
+
+  refLocalMs = s.localMs;
+  refEpochMs = measuredEpoch;
+  bestDelayMs = s.delayMs;
+  synced = true;
+  return true;
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+bool timeSyncIsSynced() { return synced; }
+
+TimeSyncQuality timeSyncGetQuality(uint32_t nowLocalMs) {
+  TimeSyncQuality q;
+  q.synced = synced;
+  q.samples = lastRoundSamples;
+  q.driftPpm = (int32_t)(driftPpb / 1000);
+  if (!synced) {
+    q.uncertaintyMs = 0;
+    q.ageMs = 0;
+    return q;
+  }
+
+  q.ageMs = nowLocalMs - refLocalMs;
+  // Residual drift is bounded by the filter gain; assume 10 ppm worst case
+  uint64_t driftErr = (uint64_t)q.ageMs * 10 / 1000000;
+  q.uncertaintyMs = bestDelayMs / 2 + (uint32_t)driftErr;
+  return q;
+}
+
+uint64_t timeSyncToEpochMs(uint32_t localMs) {
+  return synced ? modelEpochMs(localMs) : 0;
+}
+
+bool timeSyncFormatIso8601(uint32_t localMs, char *out, size_t outLen) {
+  if (!synced) {
+    return false;
+  }
+  return timeSyncFormatEpochIso8601(modelEpochMs(localMs), out, outLen);
+}
+
+bool timeSyncFormatEpochIso8601(uint64_t epochMs, char *out, size_t outLen) {
+  if (outLen < 25) {
+    return false;
+  }
+
+  int64_t secs = (int64_t)(epochMs / 1000);
+  unsigned ms = (unsigned)(epochMs % 1000);
+  int64_t days = secs / 86400;
+  unsigned sod = (unsigned)(secs % 86400);
+
+  int year;
+  unsigned month, day;
+  civilFromDays(days, &year, &month, &day);
+
+  snprintf(out, outLen, "%04d-%02u-%02uT%02u:%02u:%02u.%03uZ", year, month,
+           day, sod / 3600, (sod / 60) % 60, sod % 60, ms);
+  return true;
+}
@@ -0,0 +1,124 @@
+#include "tls_profile.h"
+#ifdef ARDUINO_ARCH_ESP32
+#include <mbedtls/ecp.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/ssl_ciphersuites.h>
+#include <mbedtls/version.h>
+#endif
+
+// ============================================================================
+// PROFILES
+// ============================================================================
+
+// TLS 1.2 suites; the RSA ones are for brokers with only an RSA certificate
+static const uint16_t ecdsaSuites[] = {
+    0xC02B, // TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256
+    0xC02C, // TLS_ECDHE_ECDSA_WITH_AES_256_GCM_SHA384
+    0xC02F, // TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256
+    0xC030, // TLS_ECDHE_RSA_WITH_AES_256_GCM_SHA384
+    0,
+};
+
+static const uint16_t ecdsaGroups[] = {
+    23, // secp256r1
+    0,
+};
+
+static const TlsProfile profiles[] = {
+    {TLS_PROFILE_COMPAT, "compat", nullptr, nullptr},
+    {TLS_PROFILE_ECDSA, "ecdsa", ecdsaSuites, ecdsaGroups},
+};
+
+const TlsProfile *tlsProfileFind(uint8_t id) {
+  for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+    if (profiles[i].id == id) {
+      return &profiles[i];
+    }
+  }
+  return nullptr;
+}
+
+size_t tlsProfileCount() { return sizeof(profiles) / sizeof(profiles[0]); }
+
+const TlsProfile *tlsProfileAt(size_t index) {
+  return index < tlsProfileCount() ? &profiles[index] : nullptr;
+}
+
+// ============================================================================
+// APPLYING
+// ============================================================================
+
+#if defined(ARDUINO_ARCH_ESP32) && !defined(MBEDTLS_SSL_CIPHERSUITES)
+
+// WiFiClientSecure builds its mbedtls_ssl_config inside connect() and
+// exposes no way to set suites on it. mbedtls_ssl_config_defaults() takes
+// the offer from mbedtls_ssl_list_ciphersuites() (and, before mbedTLS 3,
+// the curves from mbedtls_ecp_grp_id_list()): static arrays in RAM, filled
+// on first use. Narrowing those in place reaches every later handshake.
+// With MBEDTLS_SSL_CIPHERSUITES set the list is const and left alone.
+size_t tlsProfileApply(const TlsProfile &profile) {
+  if (!profile.suites) {
+    return 0;
+  }
+
+  // Keep only what this build has; the list is never made longer
+  int *list = const_cast<int *>(mbedtls_ssl_list_ciphersuites());
+  int kept[8];
+  size_t count = 0;
+  for (const uint16_t *s = profile.suites;
+       *s && count < sizeof(kept) / sizeof(kept[0]); s++) {
+    if (mbedtls_ssl_ciphersuite_from_id(*s)) {
+      kept[count++] = *s;
+    }
+  }
+  if (count == 0) {
+    return 0;
+  }
+  size_t available = 0;
+  while (list[available] != 0) {
+    available++;
+  }
+  if (count > available) {
+    return 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    list[i] = kept[i];
+  }
+  list[count] = 0;
+
+#if MBEDTLS_VERSION_MAJOR < 3 && defined(MBEDTLS_ECP_C)
+  if (profile.groups) {
+    mbedtls_ecp_group_id *curves =
+        const_cast<mbedtls_ecp_group_id *>(mbedtls_ecp_grp_id_list());
+    mbedtls_ecp_group_id keptCurves[4];
+    size_t curveCount = 0;
+    for (const uint16_t *g = profile.groups;
+         *g && curveCount < sizeof(keptCurves) / sizeof(keptCurves[0]); g++) {
+      const mbedtls_ecp_curve_info *info =
+          mbedtls_ecp_curve_info_from_tls_id(*g);
+      if (info) {
+        keptCurves[curveCount++] = info->grp_id;
+      }
+    }
+    // Same rule as the suites: nothing usable leaves the defaults
+    for (size_t i = 0; i < curveCount; i++) {
+      curves[i] = keptCurves[i];
+    }
+    if (curveCount > 0) {
+      curves[curveCount] = MBEDTLS_ECP_DP_NONE;
+    }
+  }
+#endif
+
+  return count;
+}
+
+#else
+
+// Host builds have no mbedTLS; host/tls maps the profiles onto OpenSSL
+size_t tlsProfileApply(const TlsProfile &profile) {
+  (void)profile;
+  return 0;
+}
+
+#endif
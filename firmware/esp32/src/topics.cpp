@@ -0,0 +1,9 @@
+#include "topics.h"
+#include <stdio.h>
+
+bool topicBuild(char *out, size_t outLen, const char *tenantId,
+                const char *deviceId, const char *type) {
+  int n = snprintf(out, outLen, "iot/%s/devices/%s/%s", tenantId, deviceId,
+                   type);
+  return n > 0 && (size_t)n < outLen;
+}
@@ -0,0 +1,182 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ============================================================================
+// FORMAT / PARSE
+// ============================================================================
+
+static const char hexDigits[] = "0123456789abcdef";
+
+static int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+size_t traceFormat(const TraceRecord &record, char *out, size_t outLen) {
+  int n;
+  switch (record.type) {
+  case TRACE_SENSOR:
+    n = snprintf(out, outLen, TRACE_LINE_PREFIX "%lu S %.2f %.2f",
+                 (unsigned long)record.timeMs, record.temperature,
+                 record.humidity);
+    break;
+  case TRACE_WIFI:
+  case TRACE_BUTTON:
+    n = snprintf(out, outLen, TRACE_LINE_PREFIX "%lu %c %d",
+                 (unsigned long)record.timeMs, record.type, record.value);
+    break;
+  case TRACE_MQTT_IN: {
+    n = snprintf(out, outLen, TRACE_LINE_PREFIX "%lu M %s ",
+                 (unsigned long)record.timeMs, record.topic);
+    if (n < 0 || (size_t)n + record.payloadLen * 2 >= outLen) {
+      return 0;
+    }
+    char *p = out + n;
+    for (uint16_t i = 0; i < record.payloadLen; i++) {
+      *p++ = hexDigits[record.payload[i] >> 4];
+      *p++ = hexDigits[record.payload[i] & 0x0F];
+    }
+    *p = '\0';
+    if (record.length > record.payloadLen) {
+      size_t used = p - out;
+      int m = snprintf(p, outLen - used, " %lu", (unsigned long)record.length);
+      if (m < 0 || used + m >= outLen) {
+        return 0;
+      }
+      p += m;
+    }
+    return p - out;
+  }
+  default:
+    return 0;
+  }
+  return (n > 0 && (size_t)n < outLen) ? (size_t)n : 0;
+}
+
+bool traceParse(const char *line, TraceRecord *record) {
+  const char *p = strstr(line, TRACE_LINE_PREFIX);
+  if (!p) {
+    return false;
+  }
+  p += strlen(TRACE_LINE_PREFIX);
+
+  char *end;
+  unsigned long timeMs = strtoul(p, &end, 10);
+  if (end == p || *end != ' ') {
+    return false;
+  }
+  p = end + 1;
+
+  record->timeMs = (uint32_t)timeMs;
+  record->type = *p++;
+  record->payloadLen = 0;
+  record->length = 0;
+  record->topic[0] = '\0';
+
+  switch (record->type) {
+  case TRACE_SENSOR:
+    return sscanf(p, " %f %f", &record->temperature, &record->humidity) == 2;
+  case TRACE_WIFI:
+  case TRACE_BUTTON:
+    return sscanf(p, " %d", &record->value) == 1;
+  case TRACE_MQTT_IN: {
+    while (*p == ' ') {
+      p++;
+    }
+    const char *topicEnd = strchr(p, ' ');
+    if (!topicEnd || (size_t)(topicEnd - p) >= sizeof(record->topic)) {
+      return false;
+    }
+    memcpy(record->topic, p, topicEnd - p);
+    record->topic[topicEnd - p] = '\0';
+
+    p = topicEnd + 1;
+    while (p[0] && p[1] && record->payloadLen < TRACE_MAX_PAYLOAD) {
+      int hi = hexValue(p[0]);
+      int lo = hexValue(p[1]);
+      if (hi < 0 || lo < 0) {
+        break;
+      }
+      record->payload[record->payloadLen++] = (uint8_t)((hi << 4) | lo);
+      p += 2;
+    }
+    record->length = record->payloadLen;
+    if (*p == ' ') {
+      record->length = strtoul(p + 1, nullptr, 10);
+    }
+    return true;
+  }
+  default:
+    return false;
+  }
+}
+
+// ============================================================================
+// RECORDING
+// ============================================================================
+
+#ifdef THINGBASE_TRACE
+
+static TraceSink sink = nullptr;
+static int lastWifiStatus = -1;
+static TraceRecord record;
+static char line[TRACE_MAX_LINE];
+
+static void emit() {
+  if (sink && traceFormat(record, line, sizeof(line)) > 0) {
+    sink(line);
+  }
+}
+
+void traceSetSink(TraceSink newSink) { sink = newSink; }
+
+void traceSensor(uint32_t nowMs, float temperature, float humidity) {
+  record.timeMs = nowMs;
+  record.type = TRACE_SENSOR;
+  record.temperature = temperature;
+  record.humidity = humidity;
+  emit();
+}
+
+void traceMqttIn(uint32_t nowMs, const char *topic, const uint8_t *payload,
+                 unsigned int length) {
+  record.timeMs = nowMs;
+  record.type = TRACE_MQTT_IN;
+  strncpy(record.topic, topic, sizeof(record.topic) - 1);
+  record.topic[sizeof(record.topic) - 1] = '\0';
+  record.payloadLen =
+      length < TRACE_MAX_PAYLOAD ? (uint16_t)length : TRACE_MAX_PAYLOAD;
+  record.length = length;
+  memcpy(record.payload, payload, record.payloadLen);
+  emit();
+}
+
+void traceWifiStatus(uint32_t nowMs, int status) {
+  if (status == lastWifiStatus) {
+    return;
+  }
+  lastWifiStatus = status;
+  record.timeMs = nowMs;
+  record.type = TRACE_WIFI;
+  record.value = status;
+  emit();
+}
+
+void traceButton(uint32_t nowMs, bool pressed) {
+  record.timeMs = nowMs;
+  record.type = TRACE_BUTTON;
+  record.value = pressed ? 1 : 0;
+  emit();
+}
+
+#endif
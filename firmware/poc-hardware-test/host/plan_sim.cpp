@@ -0,0 +1,175 @@
+// Runs a test plan against simulated pins and a simulated DHT on a virtual
+// millisecond clock, printing the same lines the board would. For trying
+// plans, and for checking the interpreter, without hardware:
+//
+//   plan_sim [options] "led count=3; dht count=5; button press=1"
+//
+//   --stuck PIN=LEVEL       output PIN always reads LEVEL (0 or 1)
+//   --press AT_MS:HOLD_MS   button goes low at AT_MS for HOLD_MS; repeatable
+//   --bounce MS             each button change chatters for MS first
+//   --dht-fail-every N      every Nth DHT read fails
+//   --sensor TEMP:HUM       values the DHT returns (default 24.0:55.0)
+//   --limit-ms MS           give up after MS of virtual time (default 600000)
+//
+// Exit status: 0 if every step passed, 1 if one failed, 2 if the plan was
+// rejected or did not finish.
+
+#include "test_runner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define SIM_PINS 40
+#define STATUS_LED_PIN 2
+#define RED_LED_PIN 5
+#define BUZZER_PIN 18
+#define RESET_BUTTON_PIN 0
+
+struct Press {
+  uint32_t atMs;
+  uint32_t holdMs;
+};
+
+static uint32_t nowMs = 0;
+static int outputs[SIM_PINS];
+static int stuck[SIM_PINS]; // -1 when the pin works
+static std::vector<Press> presses;
+static uint32_t bounceMs = 0;
+static uint32_t dhtFailEvery = 0;
+static uint32_t dhtReads = 0;
+static float sensorTemperature = 24.0f;
+static float sensorHumidity = 55.0f;
+static int failedSteps = 0;
+static bool planEnded = false;
+
+// ============================================================================
+// SIMULATED HARDWARE
+// ============================================================================
+
+static void simPinWrite(uint8_t pin, int level) { outputs[pin] = level; }
+
+// Low while a press is held; during the bounce window after either edge
+// it alternates every millisecond
+static int buttonLevel() {
+  for (const Press &p : presses) {
+    uint32_t releaseMs = p.atMs + p.holdMs;
+    if (nowMs >= p.atMs && nowMs < p.atMs + bounceMs) {
+      return (nowMs - p.atMs) % 2;
+    }
+    if (nowMs >= releaseMs && nowMs < releaseMs + bounceMs) {
+      return 1 - (nowMs - releaseMs) % 2;
+    }
+    if (nowMs >= p.atMs && nowMs < releaseMs) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int simPinRead(uint8_t pin) {
+  if (pin == RESET_BUTTON_PIN) {
+    return buttonLevel();
+  }
+  return stuck[pin] >= 0 ? stuck[pin] : outputs[pin];
+}
+
+static bool simReadSensor(float *temperature, float *humidity) {
+  dhtReads++;
+  if (dhtFailEvery && dhtReads % dhtFailEvery == 0) {
+    return false;
+  }
+  *temperature = sensorTemperature;
+  *humidity = sensorHumidity;
+  return true;
+}
+
+static void simEmit(const char *line) {
+  printf("%8u %s\n", (unsigned)nowMs, line);
+  if (strncmp(line, "@plan", 5) == 0 && !strstr(line, "\"start\"")) {
+    planEnded = true;
+  }
+}
+
+static void simStepDone(const char *test, bool passed) {
+  (void)test;
+  failedSteps += passed ? 0 : 1;
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+static int usage() {
+  fprintf(stderr, "usage: plan_sim [--stuck PIN=LEVEL] [--press AT:HOLD] "
+                  "[--bounce MS]\n"
+                  "                [--dht-fail-every N] [--sensor T:H] "
+                  "[--limit-ms MS] \"plan\"\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  uint32_t limitMs = 600000;
+  const char *plan = nullptr;
+  for (int i = 0; i < SIM_PINS; i++) {
+    stuck[i] = -1;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    bool hasValue = i + 1 < argc;
+    unsigned a = 0, b = 0;
+    float t = 0, h = 0;
+    if (strcmp(argv[i], "--stuck") == 0 && hasValue &&
+        sscanf(argv[++i], "%u=%u", &a, &b) == 2 && a < SIM_PINS) {
+      stuck[a] = b ? 1 : 0;
+    } else if (strcmp(argv[i], "--press") == 0 && hasValue &&
+               sscanf(argv[++i], "%u:%u", &a, &b) == 2) {
+      presses.push_back({a, b});
+    } else if (strcmp(argv[i], "--bounce") == 0 && hasValue) {
+      bounceMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--dht-fail-every") == 0 && hasValue) {
+      dhtFailEvery = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(argv[i], "--sensor") == 0 && hasValue &&
+               sscanf(argv[++i], "%f:%f", &t, &h) == 2) {
+      sensorTemperature = t;
+      sensorHumidity = h;
+    } else if (strcmp(argv[i], "--limit-ms") == 0 && hasValue) {
+      limitMs = strtoul(argv[++i], nullptr, 10);
+    } else if (argv[i][0] != '-' && !plan) {
+      plan = argv[i];
+    } else {
+      return usage();
+    }
+  }
+  if (!plan) {
+    return usage();
+  }
+
+  TestHal hal = {};
+  hal.pinWrite = simPinWrite;
+  hal.pinRead = simPinRead;
+  hal.readSensor = simReadSensor;
+  hal.emit = simEmit;
+  hal.stepDone = simStepDone;
+  hal.statusLedPin = STATUS_LED_PIN;
+  hal.alertLedPin = RED_LED_PIN;
+  hal.buzzerPin = BUZZER_PIN;
+  hal.buttonPin = RESET_BUTTON_PIN;
+  testRunnerBegin(hal);
+
+  if (!testRunnerStart(plan, nowMs)) {
+    return 2;
+  }
+  // The board's loop comes round far more often than once a millisecond;
+  // a millisecond is as fine as any plan parameter
+  while (testRunnerService(nowMs)) {
+    if (++nowMs > limitMs) {
+      testRunnerAbort(nowMs);
+      return 2;
+    }
+  }
+  if (!planEnded) {
+    return 2;
+  }
+  return failedSteps > 0 ? 1 : 0;
+}
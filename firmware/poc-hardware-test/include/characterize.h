@@ -0,0 +1,59 @@
+#ifndef CHARACTERIZE_H
+#define CHARACTERIZE_H
+
+#include <stdint.h>
+
+// ============================================================================
+// HARDWARE CHARACTERIZATION
+// ============================================================================
+
+// Measures a board and its sensor instead of eyeballing them, for
+// qualifying new board lots and sensor vendors. Phases, in order:
+//   gpio    digitalWrite() and register toggle rate on the LED pins, with
+//           every level read back (the buzzer is left alone)
+//   loop    loop() iteration period with nothing else running
+//   button  bounce of each press and release; the operator presses BOOT a
+//           few times when prompted
+//   dht     hundreds of timed reads: latency, failures by cause, bit timing
+//           and the spread of the values
+// Normal monitoring is suspended meanwhile. The result is one line of JSON,
+// prefixed "@report " so it can be picked out of the log:
+//   pio device monitor | sed -n 's/^@report //p' > board-17.json
+
+// Build flags can override any of these
+#ifndef CHAR_DHT_READS
+#define CHAR_DHT_READS 300 // ~10 minutes at the DHT22 interval
+#endif
+#ifndef CHAR_DHT_INTERVAL_MS
+#define CHAR_DHT_INTERVAL_MS 2000 // DHT22 minimum; 1000 is enough for DHT11
+#endif
+#ifndef CHAR_GPIO_TOGGLES
+#define CHAR_GPIO_TOGGLES 20000 // Per pin and method
+#endif
+#ifndef CHAR_LOOP_MS
+#define CHAR_LOOP_MS 5000
+#endif
+#ifndef CHAR_BUTTON_PRESSES
+#define CHAR_BUTTON_PRESSES 5
+#endif
+#ifndef CHAR_BUTTON_WINDOW_MS
+#define CHAR_BUTTON_WINDOW_MS 30000 // Skipped if nobody presses in time
+#endif
+#ifndef CHAR_BOUNCE_GAP_US
+#define CHAR_BOUNCE_GAP_US 20000 // Quiet time that ends a press or release
+#endif
+
+struct CharacterizeConfig {
+  uint8_t dhtPin;
+  uint8_t dhtType; // DHT11 or DHT22
+  uint8_t ledPins[2];
+  uint8_t buttonPin;
+};
+
+void characterizeStart(const CharacterizeConfig &config);
+
+// Runs the current phase; call first thing in loop() and skip everything
+// else while it returns true
+bool characterizeService();
+
+#endif
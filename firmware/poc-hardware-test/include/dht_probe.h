@@ -0,0 +1,39 @@
+#ifndef DHT_PROBE_H
+#define DHT_PROBE_H
+
+#include <stdint.h>
+
+// ============================================================================
+// DHT PROBE
+// ============================================================================
+
+// One DHT11/DHT22 transaction, timed. The DHT library only says whether a
+// read worked; for qualifying sensors we also want why it failed and how
+// close the bit timing came to the decode threshold. Interrupts are off on
+// this core for the ~4 ms of the frame. Keep reads 2 s apart (DHT22) or
+// 1 s (DHT11).
+
+enum DhtProbeStatus {
+  DHT_PROBE_OK,
+  DHT_PROBE_NO_RESPONSE, // line never pulled low after the start signal
+  DHT_PROBE_TIMEOUT,     // a pulse in the frame ran over 200 us
+  DHT_PROBE_CHECKSUM,
+};
+
+struct DhtProbeResult {
+  DhtProbeStatus status;
+  uint32_t readUs;       // start signal to last bit, including the 1.1 ms
+  uint16_t responseUs;   // release of the line to the sensor pulling it low
+  uint16_t lowMinUs;     // bit start pulses (nominal 50 us)
+  uint16_t lowMaxUs;
+  uint16_t zeroHighMaxUs; // longest "0" (nominal 26-28 us)
+  uint16_t oneHighMinUs;  // shortest "1" (nominal 70 us)
+  float temperature;      // valid only when status is DHT_PROBE_OK
+  float humidity;
+};
+
+DhtProbeResult dhtProbeRead(uint8_t pin, uint8_t type);
+
+const char *dhtProbeStatusName(DhtProbeStatus status);
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef TEST_RUNNER_H
+#define TEST_RUNNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// ============================================================================
+// TEST PLAN RUNNER
+// ============================================================================
+
+// Runs a test plan one small step per call, so the loop keeps going
+// between LED blinks and sensor reads. A plan is a line of steps separated
+// by ';', each a test name and key=value parameters:
+//
+//   led pin=status count=3 on=300 off=300; buzzer count=2 on=150;
+//   dht count=5 interval=2000 settle=2000 maxfail=1; button press=1
+//
+//   led     pin (number, or status/alert/buzzer), count, on, off (ms);
+//           every level written is read back
+//   buzzer  as led, on the buzzer pin
+//   dht     count, interval, settle (ms before the first read), maxfail
+//   button  press=0 checks the idle level; press=1 waits up to timeout ms
+//           for a press and release, debounce ms apart
+//   wait    ms
+//
+// Results stream out as lines of JSON behind a tag:
+//   @plan   {"event":"start","steps":2}
+//   @sample {"step":1,"i":0,"ok":true,"temperature":24.1,"humidity":55.2}
+//   @step   {"step":0,"test":"led","result":"pass","pin":2,"iterations":3,
+//            "mismatches":0,"ms":1800}
+//   @plan   {"event":"done","passed":2,"failed":0,"ms":12010}
+// "event" is also "error" (plan rejected, with "error") or "aborted".
+//
+// Nothing here touches Arduino: I/O goes through TestHal, so the same
+// interpreter runs on the host against simulated pins (host/plan_sim.cpp).
+
+#define TEST_PLAN_MAX_STEPS 16
+#define TEST_PLAN_MAX_LENGTH 256
+
+struct TestHal {
+  void (*pinWrite)(uint8_t pin, int level);
+  int (*pinRead)(uint8_t pin); // 0 or 1
+  bool (*readSensor)(float *temperature, float *humidity);
+  void (*emit)(const char *line);
+  void (*stepDone)(const char *test, bool passed); // optional
+  uint8_t statusLedPin;
+  uint8_t alertLedPin;
+  uint8_t buzzerPin;
+  uint8_t buttonPin; // pulled up, low while pressed
+};
+
+void testRunnerBegin(const TestHal &hal);
+
+// Parses the plan and starts it; false (after an error line) if the plan
+// is malformed or another one is running
+bool testRunnerStart(const char *plan, uint32_t nowMs);
+
+// Stops between steps; outputs are left low
+void testRunnerAbort(uint32_t nowMs);
+
+// Does what is due; true while a plan is running
+bool testRunnerService(uint32_t nowMs);
+
+bool testRunnerActive();
+
+#endif
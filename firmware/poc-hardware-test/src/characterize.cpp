@@ -0,0 +1,452 @@
+#include "characterize.h"
+#include "dht_probe.h"
+#include <Arduino.h>
+#include <math.h>
+#include <soc/gpio_struct.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHAR_LOOP_HIST_US 1000 // 1 us bins; longer iterations share the last
+#define CHAR_BUTTON_EDGES 256
+#define CHAR_DHT_PROGRESS_EVERY 50
+#define CHAR_REPORT_VERSION 1
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+// Running min/max/mean/variance (Welford), so nothing is kept per sample
+struct Summary {
+  uint32_t count;
+  double min;
+  double max;
+  double mean;
+  double m2;
+};
+
+static void summaryAdd(Summary &s, double value) {
+  if (s.count == 0 || value < s.min) {
+    s.min = value;
+  }
+  if (s.count == 0 || value > s.max) {
+    s.max = value;
+  }
+  s.count++;
+  double delta = value - s.mean;
+  s.mean += delta / s.count;
+  s.m2 += delta * (value - s.mean);
+}
+
+static double summaryStddev(const Summary &s) {
+  return s.count > 1 ? sqrt(s.m2 / (s.count - 1)) : 0;
+}
+
+// "name":{"min":..,"mean":..,"max":..,"stddev":..}, or null without samples
+static void printSummary(const char *name, const Summary &s, int decimals) {
+  Serial.printf("\"%s\":", name);
+  if (s.count == 0) {
+    Serial.print("null");
+    return;
+  }
+  Serial.printf("{\"min\":%.*f,\"mean\":%.*f,\"max\":%.*f,\"stddev\":%.*f}",
+                decimals, s.min, decimals, s.mean, decimals, s.max, decimals,
+                summaryStddev(s));
+}
+
+static int compareU16(const void *a, const void *b) {
+  return (int)*(const uint16_t *)a - (int)*(const uint16_t *)b;
+}
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+enum CharPhase {
+  CHAR_IDLE,
+  CHAR_GPIO,
+  CHAR_LOOP,
+  CHAR_BUTTON,
+  CHAR_DHT,
+};
+
+struct GpioResult {
+  uint8_t pin;
+  double digitalWriteHz; // full high-low cycles per second
+  double registerHz;
+  uint32_t readbackErrors;
+};
+
+static CharacterizeConfig cfg;
+static CharPhase phase = CHAR_IDLE;
+static uint32_t startMs = 0;
+static uint32_t phaseStartMs = 0;
+
+static GpioResult gpio[2];
+
+static Summary loopUs;
+static uint32_t loopHist[CHAR_LOOP_HIST_US];
+static uint32_t lastLoopUs = 0;
+
+static volatile uint32_t edgeUs[CHAR_BUTTON_EDGES];
+static volatile uint16_t edgeCount = 0;
+static Summary pressBounceUs;
+static Summary releaseBounceUs;
+static Summary burstEdges;
+static uint16_t bursts = 0;
+
+static uint16_t dhtReads = 0;
+static uint32_t dhtFailures[DHT_PROBE_CHECKSUM + 1];
+static uint16_t dhtReadUs[CHAR_DHT_READS];
+static Summary dhtResponseUs;
+static Summary dhtTemperature;
+static Summary dhtHumidity;
+static float dhtTempStepMax = 0;
+static float dhtHumStepMax = 0;
+static float dhtLastTemp = NAN;
+static float dhtLastHum = NAN;
+static uint16_t dhtLowMinUs = UINT16_MAX;
+static uint16_t dhtLowMaxUs = 0;
+static uint16_t dhtZeroHighMaxUs = 0;
+static uint16_t dhtOneHighMinUs = UINT16_MAX;
+static uint32_t lastDhtMs = 0;
+
+static void enterPhase(CharPhase next) {
+  phase = next;
+  phaseStartMs = millis();
+}
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+static void measureGpio(GpioResult &result) {
+  uint8_t pin = result.pin;
+  int level = digitalRead(pin);
+
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < CHAR_GPIO_TOGGLES; i++) {
+    digitalWrite(pin, HIGH);
+    digitalWrite(pin, LOW);
+  }
+  result.digitalWriteHz = CHAR_GPIO_TOGGLES * 1e6 / (micros() - start);
+
+  // Both LED pins are below 32, in the first output register
+  uint32_t mask = 1UL << pin;
+  start = micros();
+  for (uint32_t i = 0; i < CHAR_GPIO_TOGGLES; i++) {
+    GPIO.out_w1ts = mask;
+    GPIO.out_w1tc = mask;
+  }
+  result.registerHz = CHAR_GPIO_TOGGLES * 1e6 / (micros() - start);
+
+  // A weak driver or a short shows up as a level that did not stick
+  result.readbackErrors = 0;
+  for (uint32_t i = 0; i < CHAR_GPIO_TOGGLES; i++) {
+    digitalWrite(pin, HIGH);
+    result.readbackErrors += digitalRead(pin) != HIGH;
+    digitalWrite(pin, LOW);
+    result.readbackErrors += digitalRead(pin) != LOW;
+  }
+  digitalWrite(pin, level);
+}
+
+static void serviceGpio() {
+  for (int i = 0; i < 2; i++) {
+    gpio[i] = GpioResult();
+    gpio[i].pin = cfg.ledPins[i];
+    measureGpio(gpio[i]);
+    Serial.printf("[CHAR] GPIO %d: %.0f Hz digitalWrite, %.0f Hz register, "
+                  "%u read-back errors\n",
+                  gpio[i].pin, gpio[i].digitalWriteHz, gpio[i].registerHz,
+                  (unsigned)gpio[i].readbackErrors);
+  }
+  lastLoopUs = 0;
+  enterPhase(CHAR_LOOP);
+}
+
+// ============================================================================
+// LOOP TIMING
+// ============================================================================
+
+static void startButton();
+
+static void serviceLoop() {
+  uint32_t now = micros();
+  if (lastLoopUs != 0) {
+    uint32_t period = now - lastLoopUs;
+    summaryAdd(loopUs, period);
+    loopHist[min(period, (uint32_t)CHAR_LOOP_HIST_US - 1)]++;
+  }
+  lastLoopUs = now;
+
+  if (millis() - phaseStartMs >= CHAR_LOOP_MS) {
+    Serial.printf("[CHAR] Loop: %u iterations, mean %.1f us, max %.0f us\n",
+                  (unsigned)loopUs.count, loopUs.mean, loopUs.max);
+    startButton();
+  }
+}
+
+static uint32_t loopPercentile(double fraction) {
+  uint32_t target = (uint32_t)ceil(loopUs.count * fraction);
+  uint32_t seen = 0;
+  for (uint32_t us = 0; us < CHAR_LOOP_HIST_US; us++) {
+    seen += loopHist[us];
+    if (seen >= target) {
+      return us;
+    }
+  }
+  return CHAR_LOOP_HIST_US - 1;
+}
+
+// ============================================================================
+// BUTTON BOUNCE
+// ============================================================================
+
+static void IRAM_ATTR onButtonEdge() {
+  if (edgeCount < CHAR_BUTTON_EDGES) {
+    edgeUs[edgeCount] = micros();
+    edgeCount = edgeCount + 1;
+  }
+}
+
+// Edges closer than the gap belong to one press or release. Bursts
+// alternate press, release, ... as the button starts released. Only bursts
+// that have gone quiet are counted.
+static void collectBursts() {
+  uint16_t count = edgeCount;
+  uint32_t now = micros();
+  uint16_t seen = 0;
+  uint16_t i = 0;
+  while (i < count) {
+    uint16_t first = i;
+    while (i + 1 < count && edgeUs[i + 1] - edgeUs[i] < CHAR_BOUNCE_GAP_US) {
+      i++;
+    }
+    uint16_t last = i++;
+    if (last + 1 == count && now - edgeUs[last] < CHAR_BOUNCE_GAP_US) {
+      break; // may still be bouncing
+    }
+    if (seen++ < bursts) {
+      continue;
+    }
+    uint32_t bounce = edgeUs[last] - edgeUs[first];
+    summaryAdd(bursts % 2 == 0 ? pressBounceUs : releaseBounceUs, bounce);
+    summaryAdd(burstEdges, last - first + 1);
+    Serial.printf("[CHAR] %s: %u edges over %u us\n",
+                  bursts % 2 == 0 ? "Press" : "Release",
+                  (unsigned)(last - first + 1), (unsigned)bounce);
+    bursts++;
+  }
+}
+
+static void startButton() {
+  edgeCount = 0;
+  bursts = 0;
+  attachInterrupt(digitalPinToInterrupt(cfg.buttonPin), onButtonEdge, CHANGE);
+  Serial.printf("[CHAR] Press and release BOOT %d times (%u s)\n",
+                CHAR_BUTTON_PRESSES, (unsigned)(CHAR_BUTTON_WINDOW_MS / 1000));
+  enterPhase(CHAR_BUTTON);
+}
+
+static void serviceButton() {
+  collectBursts();
+  bool enough = bursts >= 2 * CHAR_BUTTON_PRESSES;
+  bool expired = millis() - phaseStartMs >= CHAR_BUTTON_WINDOW_MS;
+  if (!enough && !expired && edgeCount < CHAR_BUTTON_EDGES) {
+    return;
+  }
+  detachInterrupt(digitalPinToInterrupt(cfg.buttonPin));
+  Serial.printf("[CHAR] Button: %u presses measured\n",
+                (unsigned)(releaseBounceUs.count));
+  Serial.printf("[CHAR] DHT: %u reads, one every %u ms\n",
+                (unsigned)CHAR_DHT_READS, (unsigned)CHAR_DHT_INTERVAL_MS);
+  lastDhtMs = millis();
+  enterPhase(CHAR_DHT);
+}
+
+// ============================================================================
+// DHT
+// ============================================================================
+
+static void recordDht(const DhtProbeResult &r) {
+  dhtReadUs[dhtReads++] = (uint16_t)min(r.readUs, (uint32_t)UINT16_MAX);
+  if (r.status != DHT_PROBE_NO_RESPONSE) {
+    summaryAdd(dhtResponseUs, r.responseUs);
+  }
+  if (r.status != DHT_PROBE_OK) {
+    dhtFailures[r.status]++;
+    return;
+  }
+  dhtLowMinUs = min(dhtLowMinUs, r.lowMinUs);
+  dhtLowMaxUs = max(dhtLowMaxUs, r.lowMaxUs);
+  dhtZeroHighMaxUs = max(dhtZeroHighMaxUs, r.zeroHighMaxUs);
+  dhtOneHighMinUs = min(dhtOneHighMinUs, r.oneHighMinUs);
+  summaryAdd(dhtTemperature, r.temperature);
+  summaryAdd(dhtHumidity, r.humidity);
+  if (!isnan(dhtLastTemp)) {
+    dhtTempStepMax = max(dhtTempStepMax, fabsf(r.temperature - dhtLastTemp));
+    dhtHumStepMax = max(dhtHumStepMax, fabsf(r.humidity - dhtLastHum));
+  }
+  dhtLastTemp = r.temperature;
+  dhtLastHum = r.humidity;
+}
+
+static void printReport();
+
+static void serviceDht() {
+  if (millis() - lastDhtMs < CHAR_DHT_INTERVAL_MS) {
+    return;
+  }
+  lastDhtMs = millis();
+  DhtProbeResult r = dhtProbeRead(cfg.dhtPin, cfg.dhtType);
+  recordDht(r);
+  if (r.status != DHT_PROBE_OK) {
+    Serial.printf("[CHAR] DHT read %u: %s\n", (unsigned)dhtReads,
+                  dhtProbeStatusName(r.status));
+  }
+  if (dhtReads % CHAR_DHT_PROGRESS_EVERY == 0) {
+    Serial.printf("[CHAR] DHT: %u/%u\n", (unsigned)dhtReads,
+                  (unsigned)CHAR_DHT_READS);
+  }
+  if (dhtReads == CHAR_DHT_READS) {
+    printReport();
+    phase = CHAR_IDLE;
+  }
+}
+
+// ============================================================================
+// REPORT
+// ============================================================================
+
+static void printBoard() {
+  uint64_t mac = ESP.getEfuseMac();
+  Serial.printf("\"board\":{\"chip\":\"%s\",\"rev\":%u,\"mac\":\"%04x%08x\","
+                "\"cpuMHz\":%u,\"sdk\":\"%s\"}",
+                ESP.getChipModel(), (unsigned)ESP.getChipRevision(),
+                (unsigned)(mac >> 32), (unsigned)mac,
+                (unsigned)ESP.getCpuFreqMHz(), ESP.getSdkVersion());
+}
+
+static void printGpio() {
+  Serial.print("\"gpio\":[");
+  for (int i = 0; i < 2; i++) {
+    Serial.printf("%s{\"pin\":%u,\"digitalWriteHz\":%.0f,\"registerHz\":%.0f,"
+                  "\"readbackErrors\":%u}",
+                  i ? "," : "", gpio[i].pin, gpio[i].digitalWriteHz,
+                  gpio[i].registerHz, (unsigned)gpio[i].readbackErrors);
+  }
+  Serial.print("]");
+}
+
+static void printLoop() {
+  Serial.printf("\"loop\":{\"iterations\":%u,", (unsigned)loopUs.count);
+  printSummary("us", loopUs, 1);
+  Serial.printf(",\"p99Us\":%u}", (unsigned)loopPercentile(0.99));
+}
+
+static void printButton() {
+  Serial.printf("\"button\":{\"presses\":%u,", (unsigned)releaseBounceUs.count);
+  printSummary("pressBounceUs", pressBounceUs, 0);
+  Serial.print(",");
+  printSummary("releaseBounceUs", releaseBounceUs, 0);
+  Serial.print(",");
+  printSummary("edges", burstEdges, 1);
+  Serial.print("}");
+}
+
+static void printDht() {
+  uint32_t failed = 0;
+  for (int i = DHT_PROBE_NO_RESPONSE; i <= DHT_PROBE_CHECKSUM; i++) {
+    failed += dhtFailures[i];
+  }
+  qsort(dhtReadUs, dhtReads, sizeof(dhtReadUs[0]), compareU16);
+  Summary readUs = {};
+  for (uint16_t i = 0; i < dhtReads; i++) {
+    summaryAdd(readUs, dhtReadUs[i]);
+  }
+
+  Serial.printf("\"dht\":{\"type\":%u,\"reads\":%u,\"failures\":{", cfg.dhtType,
+                (unsigned)dhtReads);
+  for (int i = DHT_PROBE_NO_RESPONSE; i <= DHT_PROBE_CHECKSUM; i++) {
+    Serial.printf("%s\"%s\":%u", i > DHT_PROBE_NO_RESPONSE ? "," : "",
+                  dhtProbeStatusName((DhtProbeStatus)i),
+                  (unsigned)dhtFailures[i]);
+  }
+  Serial.printf("},\"failureRate\":%.4f,\"checksumRate\":%.4f,",
+                dhtReads ? (double)failed / dhtReads : 0.0,
+                dhtReads ? (double)dhtFailures[DHT_PROBE_CHECKSUM] / dhtReads
+                         : 0.0);
+  printSummary("readUs", readUs, 0);
+  Serial.printf(",\"readP99Us\":%u,",
+                dhtReads ? dhtReadUs[(dhtReads * 99 + 99) / 100 - 1] : 0);
+  printSummary("responseUs", dhtResponseUs, 1);
+  if (dhtTemperature.count > 0) {
+    Serial.printf(",\"bitUs\":{\"lowMin\":%u,\"lowMax\":%u,\"zeroHighMax\":%u,"
+                  "\"oneHighMin\":%u}",
+                  dhtLowMinUs, dhtLowMaxUs, dhtZeroHighMaxUs, dhtOneHighMinUs);
+  }
+  Serial.print(",");
+  printSummary("temperature", dhtTemperature, 2);
+  Serial.printf(",\"temperatureStepMax\":%.1f,", dhtTempStepMax);
+  printSummary("humidity", dhtHumidity, 2);
+  Serial.printf(",\"humidityStepMax\":%.1f}", dhtHumStepMax);
+}
+
+static void printReport() {
+  Serial.printf("@report {\"report\":\"characterization\",\"version\":%d,",
+                CHAR_REPORT_VERSION);
+  printBoard();
+  Serial.print(",");
+  printGpio();
+  Serial.print(",");
+  printLoop();
+  Serial.print(",");
+  printButton();
+  Serial.print(",");
+  printDht();
+  Serial.printf(",\"durationMs\":%u}\n", (unsigned)(millis() - startMs));
+  Serial.println("[CHAR] Characterization complete");
+}
+
+// ============================================================================
+// CONTROL
+// ============================================================================
+
+void characterizeStart(const CharacterizeConfig &config) {
+  cfg = config;
+  gpio[0] = gpio[1] = GpioResult();
+  loopUs = Summary();
+  memset(loopHist, 0, sizeof(loopHist));
+  pressBounceUs = releaseBounceUs = burstEdges = Summary();
+  dhtReads = 0;
+  memset(dhtFailures, 0, sizeof(dhtFailures));
+  dhtResponseUs = dhtTemperature = dhtHumidity = Summary();
+  dhtTempStepMax = dhtHumStepMax = 0;
+  dhtLastTemp = dhtLastHum = NAN;
+  dhtLowMinUs = dhtOneHighMinUs = UINT16_MAX;
+  dhtLowMaxUs = dhtZeroHighMaxUs = 0;
+
+  Serial.println("[CHAR] Starting hardware characterization");
+  startMs = millis();
+  enterPhase(CHAR_GPIO);
+}
+
+bool characterizeService() {
+  switch (phase) {
+  case CHAR_IDLE:
+    return false;
+  case CHAR_GPIO:
+    serviceGpio();
+    break;
+  case CHAR_LOOP:
+    serviceLoop();
+    break;
+  case CHAR_BUTTON:
+    serviceButton();
+    break;
+  case CHAR_DHT:
+    serviceDht();
+    break;
+  }
+  return true;
+}
@@ -0,0 +1,120 @@
+#include "dht_probe.h"
+#include <Arduino.h>
+#include <DHT.h>
+
+#define DHT_PROBE_PULSE_TIMEOUT_US 200
+#define DHT_PROBE_BITS 40
+#define DHT_PROBE_EXPIRED UINT32_MAX
+
+static portMUX_TYPE frameMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Cycles the line stays at level, or DHT_PROBE_EXPIRED if it is still
+// there after the timeout
+static uint32_t pulseCycles(uint8_t pin, int level, uint32_t timeoutCycles) {
+  uint32_t start = ESP.getCycleCount();
+  while (digitalRead(pin) == level) {
+    if (ESP.getCycleCount() - start > timeoutCycles) {
+      return DHT_PROBE_EXPIRED;
+    }
+  }
+  return ESP.getCycleCount() - start;
+}
+
+static uint16_t toUs(uint32_t cycles, uint32_t cyclesPerUs) {
+  return (uint16_t)(cycles / cyclesPerUs);
+}
+
+DhtProbeResult dhtProbeRead(uint8_t pin, uint8_t type) {
+  DhtProbeResult result = {};
+  result.status = DHT_PROBE_OK;
+  result.lowMinUs = UINT16_MAX;
+  result.oneHighMinUs = UINT16_MAX;
+
+  uint32_t cyclesPerUs = ESP.getCpuFreqMHz();
+  uint32_t timeout = DHT_PROBE_PULSE_TIMEOUT_US * cyclesPerUs;
+  uint32_t lows[DHT_PROBE_BITS];
+  uint32_t highs[DHT_PROBE_BITS];
+
+  // Start signal: DHT22 wants at least 1 ms low, DHT11 at least 18 ms
+  uint32_t startUs = micros();
+  pinMode(pin, OUTPUT);
+  digitalWrite(pin, LOW);
+  if (type == DHT11) {
+    delay(20);
+  } else {
+    delayMicroseconds(1100);
+  }
+
+  pinMode(pin, INPUT_PULLUP);
+  portENTER_CRITICAL(&frameMux);
+  uint32_t response = pulseCycles(pin, HIGH, timeout);
+  bool responded = response != DHT_PROBE_EXPIRED;
+  bool ok = responded &&
+            pulseCycles(pin, LOW, timeout) != DHT_PROBE_EXPIRED &&
+            pulseCycles(pin, HIGH, timeout) != DHT_PROBE_EXPIRED;
+  if (!ok) {
+    result.status = responded ? DHT_PROBE_TIMEOUT : DHT_PROBE_NO_RESPONSE;
+  }
+  for (int i = 0; ok && i < DHT_PROBE_BITS; i++) {
+    lows[i] = pulseCycles(pin, LOW, timeout);
+    highs[i] = pulseCycles(pin, HIGH, timeout);
+    if (lows[i] == DHT_PROBE_EXPIRED || highs[i] == DHT_PROBE_EXPIRED) {
+      result.status = DHT_PROBE_TIMEOUT;
+      ok = false;
+    }
+  }
+  portEXIT_CRITICAL(&frameMux);
+  result.readUs = micros() - startUs;
+  if (responded) {
+    result.responseUs = toUs(response, cyclesPerUs);
+  }
+  if (!ok) {
+    return result;
+  }
+
+  // A bit is 1 when its high pulse outlasts the low one before it
+  uint8_t data[5] = {};
+  for (int i = 0; i < DHT_PROBE_BITS; i++) {
+    uint16_t lowUs = toUs(lows[i], cyclesPerUs);
+    uint16_t highUs = toUs(highs[i], cyclesPerUs);
+    result.lowMinUs = min(result.lowMinUs, lowUs);
+    result.lowMaxUs = max(result.lowMaxUs, lowUs);
+    bool one = highs[i] > lows[i];
+    if (one) {
+      result.oneHighMinUs = min(result.oneHighMinUs, highUs);
+      data[i / 8] |= 0x80 >> (i % 8);
+    } else {
+      result.zeroHighMaxUs = max(result.zeroHighMaxUs, highUs);
+    }
+  }
+
+  if ((uint8_t)(data[0] + data[1] + data[2] + data[3]) != data[4]) {
+    result.status = DHT_PROBE_CHECKSUM;
+    return result;
+  }
+  if (type == DHT11) {
+    result.humidity = data[0] + data[1] * 0.1f;
+    result.temperature = (data[2] & 0x7F) + data[3] * 0.1f;
+  } else {
+    result.humidity = ((data[0] << 8) | data[1]) * 0.1f;
+    result.temperature = (((data[2] & 0x7F) << 8) | data[3]) * 0.1f;
+  }
+  if (data[2] & 0x80) {
+    result.temperature = -result.temperature;
+  }
+  return result;
+}
+
+const char *dhtProbeStatusName(DhtProbeStatus status) {
+  switch (status) {
+  case DHT_PROBE_OK:
+    return "ok";
+  case DHT_PROBE_NO_RESPONSE:
+    return "no_response";
+  case DHT_PROBE_TIMEOUT:
+    return "timeout";
+  case DHT_PROBE_CHECKSUM:
+    return "checksum";
+  }
+  return "unknown";
+}
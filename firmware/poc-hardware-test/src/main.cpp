@@ -27,6 +27,8 @@
  * ============================================================================
  */
 
+#include "characterize.h"
+#include "test_runner.h"
 #include <Arduino.h>
 #include <DHT.h>
 
@@ -48,6 +50,17 @@
 #define HEARTBEAT_INTERVAL_MS 5000    // Heartbeat blink every 5 seconds
 #define SENSOR_READ_INTERVAL_MS 2000  // Read sensor every 2 seconds
 #define DEBUG_PRINT_INTERVAL_MS 10000 // Print status every 10 seconds
+#define SERIAL_COMMAND_MAX (TEST_PLAN_MAX_LENGTH + 4) // "run " + plan
+
+// ============================================================================
+// TEST PLANS (see include/test_runner.h for the format)
+// ============================================================================
+#define FULL_TEST_PLAN                                                         \
+  "led pin=status count=3 on=300 off=300; led pin=alert count=3 on=300 "       \
+  "off=300; buzzer count=3 on=200 off=200; dht settle=2000; button"
+#define QUICK_TEST_PLAN                                                        \
+  "led pin=status count=1 on=200 off=0; led pin=alert count=1 on=200 off=0; " \
+  "buzzer count=1 on=200 off=0"
 
 // ============================================================================
 // THRESHOLD CONFIGURATION - Modify for your warehouse requirements
@@ -69,6 +82,8 @@ unsigned long lastDebugPrint = 0;
 bool alertMode = false;
 bool lastButtonState = HIGH;
 unsigned long buttonPressStart = 0;
+char serialCommand[SERIAL_COMMAND_MAX];
+size_t serialCommandLength = 0;
 
 // Last sensor readings
 float lastTemperature = 0;
@@ -78,18 +93,19 @@ bool sensorConnected = false;
 // ============================================================================
 // FUNCTION DECLARATIONS
 // ============================================================================
-void testLED(int pin, const char *name);
-void testBuzzer();
-void testDHTSensor();
-void testButton();
 void heartbeatBlink();
 void alertBlink();
 void alertBeep();
 void runFullTest();
+void runTestPlan(const char *plan);
+void silenceOutputs();
+void printDhtTroubleshooting();
 void printSeparator();
 void printHeader(const char *title);
 void checkSensorAndAlert();
 void handleButtonPress();
+void pollSerialCommand();
+void startCharacterization();
 
 // ============================================================================
 // SETUP
@@ -134,7 +150,32 @@ void setup() {
   Serial.println("[INIT] All pins configured successfully!");
   Serial.println();
 
-  // Run initial full test
+  TestHal hal = {};
+  hal.pinWrite = [](uint8_t pin, int level) { digitalWrite(pin, level); };
+  hal.pinRead = [](uint8_t pin) { return digitalRead(pin); };
+  hal.readSensor = [](float *temperature, float *humidity) {
+    *humidity = dht.readHumidity();
+    *temperature = dht.readTemperature();
+    return !isnan(*humidity) && !isnan(*temperature);
+  };
+  hal.emit = [](const char *line) { Serial.println(line); };
+  hal.stepDone = [](const char *test, bool passed) {
+    if (!passed && strcmp(test, "dht") == 0) {
+      printDhtTroubleshooting();
+    }
+  };
+  hal.statusLedPin = STATUS_LED_PIN;
+  hal.alertLedPin = RED_LED_PIN;
+  hal.buzzerPin = BUZZER_PIN;
+  hal.buttonPin = RESET_BUTTON_PIN;
+  testRunnerBegin(hal);
+
+#ifdef CHARACTERIZE_AT_BOOT
+  startCharacterization();
+  return;
+#endif
+
+  // Initial full test; monitoring starts once it is done
   runFullTest();
 
   Serial.println();
@@ -150,6 +191,8 @@ void setup() {
   Serial.println("  - Alert: Red LED flash + Buzzer if thresholds exceeded");
   Serial.println("  - Short press BOOT button: Quick LED + Buzzer test");
   Serial.println("  - Long press BOOT button (3s): Full hardware test");
+  Serial.println("  - Type 'run <plan>': Run a test plan ('abort' stops it)");
+  Serial.println("  - Type 'characterize': JSON characterization report");
   Serial.println();
   printSeparator();
   Serial.println();
@@ -159,6 +202,17 @@ void setup() {
 // MAIN LOOP
 // ============================================================================
 void loop() {
+  // ---- CHARACTERIZATION (suspends monitoring while it runs) ----
+  if (characterizeService()) {
+    return;
+  }
+  pollSerialCommand();
+
+  // ---- TEST PLAN (suspends monitoring while it runs) ----
+  if (testRunnerService(millis())) {
+    return;
+  }
+
   unsigned long currentMillis = millis();
 
   // ---- HEARTBEAT (every 5 seconds) ----
@@ -300,16 +354,7 @@ void handleButtonPress() {
       Serial.printf("[BUTTON] Short press (%lu ms) - Quick test\n",
                     pressDuration);
 
-      // Quick LED + buzzer test
-      digitalWrite(RED_LED_PIN, HIGH);
-      digitalWrite(STATUS_LED_PIN, HIGH);
-      digitalWrite(BUZZER_PIN, HIGH);
-      delay(200);
-      digitalWrite(RED_LED_PIN, LOW);
-      digitalWrite(STATUS_LED_PIN, LOW);
-      digitalWrite(BUZZER_PIN, LOW);
-
-      Serial.println("[BUTTON] ✓ Quick test complete");
+      runTestPlan(QUICK_TEST_PLAN);
     }
   }
 
@@ -317,129 +362,90 @@ void handleButtonPress() {
 }
 
 // ============================================================================
-// FULL HARDWARE TEST
+// SERIAL COMMANDS
 // ============================================================================
 
-void runFullTest() {
-  printHeader("RUNNING FULL HARDWARE TEST");
-
-  // Test 1: Status LED
-  Serial.println("\n[TEST 1/5] Status LED (GPIO 2 - Built-in Blue)");
-  testLED(STATUS_LED_PIN, "Status LED");
-
-  // Test 2: Red Alert LED
-  Serial.println("\n[TEST 2/5] Red Alert LED (GPIO 5)");
-  testLED(RED_LED_PIN, "Red Alert LED");
-
-  // Test 3: Buzzer
-  Serial.println("\n[TEST 3/5] Buzzer (GPIO 18)");
-  testBuzzer();
-
-  // Test 4: DHT22 Sensor
-  Serial.println("\n[TEST 4/5] DHT22 Sensor (GPIO 4)");
-  testDHTSensor();
-
-  // Test 5: Button
-  Serial.println("\n[TEST 5/5] Reset Button (GPIO 0)");
-  testButton();
-
-  printHeader("HARDWARE TEST COMPLETE");
-}
-
-void testLED(int pin, const char *name) {
-  Serial.printf("  Testing %s on GPIO %d...\n", name, pin);
-
-  for (int i = 0; i < 3; i++) {
-    digitalWrite(pin, HIGH);
-    Serial.printf("    [%d/3] ON  ", i + 1);
-    delay(300);
-    digitalWrite(pin, LOW);
-    Serial.printf("→ OFF\n");
-    delay(300);
+void pollSerialCommand() {
+  while (Serial.available()) {
+    char c = Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (serialCommandLength < SERIAL_COMMAND_MAX - 1) {
+        serialCommand[serialCommandLength++] = c;
+      }
+      continue;
+    }
+    serialCommand[serialCommandLength] = '\0';
+    serialCommandLength = 0;
+    if (strncmp(serialCommand, "run ", 4) == 0) {
+      runTestPlan(serialCommand + 4);
+    } else if (strcmp(serialCommand, "abort") == 0) {
+      testRunnerAbort(millis());
+    } else if (strcmp(serialCommand, "characterize") == 0) {
+      if (testRunnerActive()) {
+        Serial.println("[SERIAL] A test plan is running; 'abort' it first");
+        continue;
+      }
+      startCharacterization();
+      return;
+    } else if (serialCommand[0] != '\0') {
+      Serial.printf("[SERIAL] Unknown command: %s\n", serialCommand);
+    }
   }
-
-  Serial.printf("  ✓ %s test complete - Did you see 3 blinks?\n", name);
 }
 
-void testBuzzer() {
-  Serial.println("  Testing Buzzer on GPIO 18...");
-  Serial.println("  Playing 3 beeps...");
-
-  for (int i = 0; i < 3; i++) {
-    digitalWrite(BUZZER_PIN, HIGH);
-    Serial.printf("    [%d/3] BEEP ", i + 1);
-    delay(200);
-    digitalWrite(BUZZER_PIN, LOW);
-    Serial.printf("→ silence\n");
-    delay(200);
-  }
+void startCharacterization() {
+  CharacterizeConfig config;
+  config.dhtPin = DHT_PIN;
+  config.dhtType = DHT_TYPE;
+  config.ledPins[0] = STATUS_LED_PIN;
+  config.ledPins[1] = RED_LED_PIN;
+  config.buttonPin = RESET_BUTTON_PIN;
 
-  Serial.println("  ✓ Buzzer test complete - Did you hear 3 beeps?");
+  silenceOutputs();
+  characterizeStart(config);
 }
 
-void testDHTSensor() {
-  Serial.println("  Reading from DHT22 sensor on GPIO 4...");
-  Serial.println("  (Waiting 2 seconds for sensor to stabilize)");
-
-  delay(2000);
+// ============================================================================
+// FULL HARDWARE TEST
+// ============================================================================
 
-  float humidity = dht.readHumidity();
-  float temperature = dht.readTemperature();
+void runFullTest() {
+  printHeader("RUNNING FULL HARDWARE TEST");
+  Serial.println("  Watch for 3 blinks on each LED and listen for 3 beeps");
+  runTestPlan(FULL_TEST_PLAN);
+}
 
-  if (isnan(humidity) || isnan(temperature)) {
-    Serial.println("  ❌ FAILED to read from DHT sensor!");
-    Serial.println();
-    Serial.println("  Troubleshooting steps:");
-    Serial.println("  ┌─────────────────────────────────────────────────┐");
-    Serial.println("  │ 1. Check wiring:                                │");
-    Serial.println("  │    - DATA pin → GPIO 4                          │");
-    Serial.println("  │    - VCC      → 3.3V                            │");
-    Serial.println("  │    - GND      → GND                             │");
-    Serial.println("  │                                                 │");
-    Serial.println("  │ 2. Add 4.7kΩ pull-up resistor:                  │");
-    Serial.println("  │    - Between DATA and VCC (3.3V)                │");
-    Serial.println("  │                                                 │");
-    Serial.println("  │ 3. If using DHT11:                              │");
-    Serial.println("  │    - Change DHT_TYPE from DHT22 to DHT11        │");
-    Serial.println("  │                                                 │");
-    Serial.println("  │ 4. Try a different sensor (may be defective)    │");
-    Serial.println("  └─────────────────────────────────────────────────┘");
-  } else {
-    float heatIndex = dht.computeHeatIndex(temperature, humidity, false);
+void runTestPlan(const char *plan) {
+  silenceOutputs();
+  testRunnerStart(plan, millis());
+}
 
-    Serial.println("  ✓ DHT22 sensor working correctly!");
-    Serial.println();
-    Serial.println("  ┌─────────────────────────────────────┐");
-    Serial.printf("  │ Temperature: %6.1f °C (%5.1f °F)   │\n", temperature,
-                  temperature * 9 / 5 + 32);
-    Serial.printf("  │ Humidity:    %6.1f %%               │\n", humidity);
-    Serial.printf("  │ Heat Index:  %6.1f °C              │\n", heatIndex);
-    Serial.println("  └─────────────────────────────────────┘");
-    Serial.println();
-    Serial.println("  Current thresholds:");
-    Serial.printf("    Temperature: %.0f°C - %.0f°C\n", TEMP_LOW_THRESHOLD,
-                  TEMP_HIGH_THRESHOLD);
-    Serial.printf("    Humidity:    %.0f%% - %.0f%%\n", HUMIDITY_LOW_THRESHOLD,
-                  HUMIDITY_HIGH_THRESHOLD);
-
-    sensorConnected = true;
-    lastTemperature = temperature;
-    lastHumidity = humidity;
-  }
+// Tests start from a known state, with the alert cleared
+void silenceOutputs() {
+  alertMode = false;
+  digitalWrite(STATUS_LED_PIN, LOW);
+  digitalWrite(RED_LED_PIN, LOW);
+  digitalWrite(BUZZER_PIN, LOW);
 }
 
-void testButton() {
-  bool currentState = digitalRead(RESET_BUTTON_PIN);
-  Serial.println("  Testing Reset Button on GPIO 0...");
-  Serial.printf("  Current state: %s\n",
-                currentState == LOW ? "PRESSED" : "RELEASED");
+void printDhtTroubleshooting() {
+  Serial.println("  ❌ FAILED to read from DHT sensor!");
   Serial.println();
-  Serial.println("  ┌─────────────────────────────────────────────┐");
-  Serial.println("  │ Button functions:                           │");
-  Serial.println("  │  • Short press (<3s): Quick LED/Buzzer test │");
-  Serial.println("  │  • Long press  (≥3s): Full hardware test    │");
-  Serial.println("  └─────────────────────────────────────────────┘");
-  Serial.println("  ✓ Button test complete");
+  Serial.println("  Troubleshooting steps:");
+  Serial.println("  ┌─────────────────────────────────────────────────┐");
+  Serial.println("  │ 1. Check wiring:                                │");
+  Serial.println("  │    - DATA pin → GPIO 4                          │");
+  Serial.println("  │    - VCC      → 3.3V                            │");
+  Serial.println("  │    - GND      → GND                             │");
+  Serial.println("  │                                                 │");
+  Serial.println("  │ 2. Add 4.7kΩ pull-up resistor:                  │");
+  Serial.println("  │    - Between DATA and VCC (3.3V)                │");
+  Serial.println("  │                                                 │");
+  Serial.println("  │ 3. If using DHT11:                              │");
+  Serial.println("  │    - Change DHT_TYPE from DHT22 to DHT11        │");
+  Serial.println("  │                                                 │");
+  Serial.println("  │ 4. Try a different sensor (may be defective)    │");
+  Serial.println("  └─────────────────────────────────────────────────┘");
 }
 
 // ============================================================================
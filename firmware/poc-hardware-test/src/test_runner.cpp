@@ -0,0 +1,425 @@
+#include "test_runner.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TEST_LINE_MAX 192
+#define TEST_COUNT_MAX 100000
+
+// ============================================================================
+// PLAN
+// ============================================================================
+
+enum TestKind { TEST_LED, TEST_BUZZER, TEST_DHT, TEST_BUTTON, TEST_WAIT };
+
+static const char *const kindNames[] = {"led", "buzzer", "dht", "button",
+                                        "wait"};
+
+// Every parameter is a number, so the table below can fill any of them
+struct TestStep {
+  TestKind kind;
+  uint32_t pin;
+  uint32_t count;
+  uint32_t onMs;
+  uint32_t offMs;
+  uint32_t intervalMs;
+  uint32_t settleMs;
+  uint32_t maxFail;
+  uint32_t press;
+  uint32_t timeoutMs;
+  uint32_t debounceMs;
+  uint32_t waitMs;
+};
+
+#define KIND(k) (1u << (k))
+
+struct ParamSpec {
+  const char *key;
+  uint8_t kinds;
+  size_t offset;
+};
+
+static const ParamSpec paramSpecs[] = {
+    {"pin", KIND(TEST_LED) | KIND(TEST_BUZZER), offsetof(TestStep, pin)},
+    {"count", KIND(TEST_LED) | KIND(TEST_BUZZER) | KIND(TEST_DHT),
+     offsetof(TestStep, count)},
+    {"on", KIND(TEST_LED) | KIND(TEST_BUZZER), offsetof(TestStep, onMs)},
+    {"off", KIND(TEST_LED) | KIND(TEST_BUZZER), offsetof(TestStep, offMs)},
+    {"interval", KIND(TEST_DHT), offsetof(TestStep, intervalMs)},
+    {"settle", KIND(TEST_DHT), offsetof(TestStep, settleMs)},
+    {"maxfail", KIND(TEST_DHT), offsetof(TestStep, maxFail)},
+    {"press", KIND(TEST_BUTTON), offsetof(TestStep, press)},
+    {"timeout", KIND(TEST_BUTTON), offsetof(TestStep, timeoutMs)},
+    {"debounce", KIND(TEST_BUTTON), offsetof(TestStep, debounceMs)},
+    {"ms", KIND(TEST_WAIT), offsetof(TestStep, waitMs)},
+};
+
+static TestHal hal;
+static TestStep steps[TEST_PLAN_MAX_STEPS];
+static uint8_t stepCount = 0;
+
+static void emitf(const char *format, ...) {
+  char line[TEST_LINE_MAX];
+  va_list args;
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+  hal.emit(line);
+}
+
+static void defaults(TestStep &step, TestKind kind) {
+  memset(&step, 0, sizeof(step));
+  step.kind = kind;
+  step.count = 1;
+  switch (kind) {
+  case TEST_LED:
+    step.pin = hal.statusLedPin;
+    step.count = 3;
+    step.onMs = step.offMs = 300;
+    break;
+  case TEST_BUZZER:
+    step.pin = hal.buzzerPin;
+    step.count = 3;
+    step.onMs = step.offMs = 200;
+    break;
+  case TEST_DHT:
+    step.intervalMs = 2000;
+    break;
+  case TEST_BUTTON:
+    step.timeoutMs = 10000;
+    step.debounceMs = 30;
+    break;
+  case TEST_WAIT:
+    step.waitMs = 1000;
+    break;
+  }
+}
+
+static bool parseValue(const char *key, const char *text, uint32_t *value) {
+  if (strcmp(key, "pin") == 0) {
+    if (strcmp(text, "status") == 0) {
+      *value = hal.statusLedPin;
+      return true;
+    } else if (strcmp(text, "alert") == 0) {
+      *value = hal.alertLedPin;
+      return true;
+    } else if (strcmp(text, "buzzer") == 0) {
+      *value = hal.buzzerPin;
+      return true;
+    }
+  }
+  char *end = nullptr;
+  unsigned long parsed = strtoul(text, &end, 10);
+  if (end == text || *end != '\0' || parsed > UINT32_MAX) {
+    return false;
+  }
+  *value = (uint32_t)parsed;
+  return true;
+}
+
+// One "name key=value ..." step; false with error filled in
+static bool parseStep(char *text, TestStep &step, char *error,
+                      size_t errorSize) {
+  char *save = nullptr;
+  char *name = strtok_r(text, " \t", &save);
+  int kind = -1;
+  for (size_t i = 0; name && i < sizeof(kindNames) / sizeof(kindNames[0]);
+       i++) {
+    if (strcmp(name, kindNames[i]) == 0) {
+      kind = (int)i;
+    }
+  }
+  if (kind < 0) {
+    snprintf(error, errorSize, "unknown test '%s'", name ? name : "");
+    return false;
+  }
+  defaults(step, (TestKind)kind);
+
+  for (char *param = strtok_r(nullptr, " \t", &save); param;
+       param = strtok_r(nullptr, " \t", &save)) {
+    char *equals = strchr(param, '=');
+    if (!equals) {
+      snprintf(error, errorSize, "expected key=value, got '%s'", param);
+      return false;
+    }
+    *equals = '\0';
+    const ParamSpec *spec = nullptr;
+    for (const ParamSpec &candidate : paramSpecs) {
+      if (strcmp(param, candidate.key) == 0 &&
+          (candidate.kinds & KIND(kind))) {
+        spec = &candidate;
+      }
+    }
+    uint32_t value = 0;
+    if (!spec) {
+      snprintf(error, errorSize, "%s has no parameter '%s'", name, param);
+      return false;
+    }
+    if (!parseValue(param, equals + 1, &value)) {
+      snprintf(error, errorSize, "bad value for %s", param);
+      return false;
+    }
+    *(uint32_t *)((uint8_t *)&step + spec->offset) = value;
+  }
+
+  if (step.count == 0 || step.count > TEST_COUNT_MAX) {
+    snprintf(error, errorSize, "count must be 1-%u", TEST_COUNT_MAX);
+    return false;
+  }
+  if (step.pin > 39) {
+    snprintf(error, errorSize, "no GPIO %u", (unsigned)step.pin);
+    return false;
+  }
+  return true;
+}
+
+static bool parsePlan(const char *plan, char *error, size_t errorSize) {
+  char copy[TEST_PLAN_MAX_LENGTH];
+  if (strlen(plan) >= sizeof(copy)) {
+    snprintf(error, errorSize, "plan longer than %u characters",
+             TEST_PLAN_MAX_LENGTH - 1);
+    return false;
+  }
+  strcpy(copy, plan);
+
+  stepCount = 0;
+  char *save = nullptr;
+  for (char *text = strtok_r(copy, ";", &save); text;
+       text = strtok_r(nullptr, ";", &save)) {
+    if (strspn(text, " \t") == strlen(text)) {
+      continue; // empty step, e.g. a trailing ';'
+    }
+    if (stepCount == TEST_PLAN_MAX_STEPS) {
+      snprintf(error, errorSize, "more than %u steps", TEST_PLAN_MAX_STEPS);
+      return false;
+    }
+    if (!parseStep(text, steps[stepCount], error, errorSize)) {
+      return false;
+    }
+    stepCount++;
+  }
+  if (stepCount == 0) {
+    snprintf(error, errorSize, "empty plan");
+    return false;
+  }
+  return true;
+}
+
+// ============================================================================
+// STATE
+// ============================================================================
+
+static bool active = false;
+static uint8_t current = 0;
+static bool stepStarted = false;
+static uint32_t stepStartMs = 0;
+static uint32_t planStartMs = 0;
+static uint32_t dueMs = 0;
+static uint32_t iteration = 0;
+static bool outputOn = false;
+static uint32_t mismatches = 0;
+static uint32_t readFailures = 0;
+static bool pressed = false;
+static int lastLevel = 1;
+static uint32_t lastChangeMs = 0;
+static uint32_t pressStartMs = 0;
+static uint8_t passedSteps = 0;
+static uint8_t failedSteps = 0;
+
+static bool due(uint32_t nowMs) { return (int32_t)(nowMs - dueMs) >= 0; }
+
+// fields: the test's own ,"key":value pairs
+static void finishStep(uint32_t nowMs, bool passed, const char *fields) {
+  const TestStep &step = steps[current];
+  emitf("@step {\"step\":%u,\"test\":\"%s\",\"result\":\"%s\"%s,\"ms\":%u}",
+        current, kindNames[step.kind], passed ? "pass" : "fail", fields,
+        (unsigned)(nowMs - stepStartMs));
+  if (hal.stepDone) {
+    hal.stepDone(kindNames[step.kind], passed);
+  }
+  if (passed) {
+    passedSteps++;
+  } else {
+    failedSteps++;
+  }
+  current++;
+  stepStarted = false;
+}
+
+// ============================================================================
+// TESTS
+// ============================================================================
+
+// Toggles the pin, on then off, count times; a level that does not read
+// back is a mismatch
+static void serviceOutput(const TestStep &step, uint32_t nowMs) {
+  if (!due(nowMs)) {
+    return;
+  }
+  outputOn = !outputOn;
+  hal.pinWrite(step.pin, outputOn);
+  if (hal.pinRead(step.pin) != (outputOn ? 1 : 0)) {
+    mismatches++;
+  }
+  dueMs = nowMs + (outputOn ? step.onMs : step.offMs);
+  if (outputOn || ++iteration < step.count) {
+    return;
+  }
+  char fields[80];
+  snprintf(fields, sizeof(fields),
+           ",\"pin\":%u,\"iterations\":%u,\"mismatches\":%u",
+           (unsigned)step.pin, (unsigned)iteration, (unsigned)mismatches);
+  finishStep(nowMs, mismatches == 0, fields);
+}
+
+static void serviceDht(const TestStep &step, uint32_t nowMs) {
+  if (!due(nowMs)) {
+    return;
+  }
+  float temperature = 0;
+  float humidity = 0;
+  bool ok = hal.readSensor(&temperature, &humidity);
+  if (ok) {
+    emitf("@sample {\"step\":%u,\"i\":%u,\"ok\":true,\"temperature\":%.1f,"
+          "\"humidity\":%.1f}",
+          current, (unsigned)iteration, temperature, humidity);
+  } else {
+    readFailures++;
+    emitf("@sample {\"step\":%u,\"i\":%u,\"ok\":false}", current,
+          (unsigned)iteration);
+  }
+  dueMs = nowMs + step.intervalMs;
+  if (++iteration < step.count) {
+    return;
+  }
+  char fields[48];
+  snprintf(fields, sizeof(fields), ",\"reads\":%u,\"failed\":%u",
+           (unsigned)iteration, (unsigned)readFailures);
+  finishStep(nowMs, readFailures <= step.maxFail, fields);
+}
+
+static void serviceButton(const TestStep &step, uint32_t nowMs) {
+  int level = hal.pinRead(hal.buttonPin);
+  char fields[48];
+  if (!step.press) {
+    snprintf(fields, sizeof(fields), ",\"level\":%d", level);
+    finishStep(nowMs, level == 1, fields);
+    return;
+  }
+
+  if (level != lastLevel) {
+    lastLevel = level;
+    lastChangeMs = nowMs;
+  }
+  bool stable = nowMs - lastChangeMs >= step.debounceMs;
+  if (stable && !pressed && level == 0) {
+    pressed = true;
+    pressStartMs = lastChangeMs;
+  } else if (stable && pressed && level == 1) {
+    snprintf(fields, sizeof(fields), ",\"pressMs\":%u",
+             (unsigned)(lastChangeMs - pressStartMs));
+    finishStep(nowMs, true, fields);
+  } else if (nowMs - stepStartMs >= step.timeoutMs) {
+    finishStep(nowMs, false, pressed ? ",\"error\":\"not released\""
+                                     : ",\"error\":\"not pressed\"");
+  }
+}
+
+static void startStep(const TestStep &step, uint32_t nowMs) {
+  stepStarted = true;
+  stepStartMs = nowMs;
+  iteration = 0;
+  outputOn = false;
+  mismatches = 0;
+  readFailures = 0;
+  pressed = false;
+  lastLevel = hal.pinRead(hal.buttonPin);
+  lastChangeMs = nowMs;
+  dueMs = nowMs;
+  if (step.kind == TEST_DHT) {
+    dueMs = nowMs + step.settleMs;
+  } else if (step.kind == TEST_WAIT) {
+    dueMs = nowMs + step.waitMs;
+  }
+}
+
+// ============================================================================
+// CONTROL
+// ============================================================================
+
+void testRunnerBegin(const TestHal &testHal) { hal = testHal; }
+
+bool testRunnerStart(const char *plan, uint32_t nowMs) {
+  char error[80];
+  if (active) {
+    snprintf(error, sizeof(error), "a plan is already running");
+  } else if (!parsePlan(plan, error, sizeof(error))) {
+    stepCount = 0;
+    // The message may quote the plan; keep the line valid JSON
+    for (char *c = error; *c; c++) {
+      if (*c == '"' || *c == '\\') {
+        *c = '\'';
+      }
+    }
+  } else {
+    active = true;
+    current = 0;
+    stepStarted = false;
+    passedSteps = failedSteps = 0;
+    planStartMs = nowMs;
+    emitf("@plan {\"event\":\"start\",\"steps\":%u}", stepCount);
+    return true;
+  }
+  emitf("@plan {\"event\":\"error\",\"error\":\"%s\"}", error);
+  return false;
+}
+
+void testRunnerAbort(uint32_t nowMs) {
+  if (!active) {
+    return;
+  }
+  const TestStep &step = steps[current];
+  if (stepStarted && (step.kind == TEST_LED || step.kind == TEST_BUZZER)) {
+    hal.pinWrite(step.pin, 0);
+  }
+  active = false;
+  emitf("@plan {\"event\":\"aborted\",\"step\":%u,\"ms\":%u}", current,
+        (unsigned)(nowMs - planStartMs));
+}
+
+bool testRunnerService(uint32_t nowMs) {
+  if (!active) {
+    return false;
+  }
+  const TestStep &step = steps[current];
+  if (!stepStarted) {
+    startStep(step, nowMs);
+  }
+  switch (step.kind) {
+  case TEST_LED:
+  case TEST_BUZZER:
+    serviceOutput(step, nowMs);
+    break;
+  case TEST_DHT:
+    serviceDht(step, nowMs);
+    break;
+  case TEST_BUTTON:
+    serviceButton(step, nowMs);
+    break;
+  case TEST_WAIT:
+    if (due(nowMs)) {
+      finishStep(nowMs, true, "");
+    }
+    break;
+  }
+
+  if (current == stepCount) {
+    active = false;
+    emitf("@plan {\"event\":\"done\",\"passed\":%u,\"failed\":%u,\"ms\":%u}",
+          passedSteps, failedSteps, (unsigned)(nowMs - planStartMs));
+  }
+  return active;
+}
+
+bool testRunnerActive() { return active; }
@@ -10,11 +10,20 @@ export const MAX_PAGE_SIZE = 100;
 export const COMMAND_STATUS = {
   PENDING: 'pending',
   SENT: 'sent',
+  RUNNING: 'running', // long-running command accepted, not finished
   ACKED: 'acked',
   FAILED: 'failed',
+  CANCELLED: 'cancelled',
   TIMEOUT: 'timeout',
 } as const;
 
+// Crash report limits: the firmware's CRASH_MAX_CHUNKS, and a chunk must
+// fit its MQTT_FRAME_SIZE
+export const CRASH_REPORT_LIMITS = {
+  MAX_CHUNKS: 128,
+  MAX_CHUNK_SIZE: 1024,
+} as const;
+
 // MQTT Topics
 export const MQTT_TOPICS = {
   // Device publishes to:
@@ -24,21 +33,45 @@ export const MQTT_TOPICS = {
     `iot/${tenantId}/devices/${deviceId}/ack`,
   STATUS: (tenantId: string, deviceId: string) =>
     `iot/${tenantId}/devices/${deviceId}/status`,
+  TIME: (tenantId: string, deviceId: string) =>
+    `iot/${tenantId}/devices/${deviceId}/time`,
+  OTA_REQUEST: (tenantId: string, deviceId: string) =>
+    `iot/${tenantId}/devices/${deviceId}/ota/request`,
+  ROLLUP: (tenantId: string, deviceId: string) =>
+    `iot/${tenantId}/devices/${deviceId}/rollup`,
+  CRASH: (tenantId: string, deviceId: string) =>
+    `iot/${tenantId}/devices/${deviceId}/crash`,
+  CRASH_DATA: (tenantId: string, deviceId: string) =>
+    `iot/${tenantId}/devices/${deviceId}/crash/data`,
 
   // Server publishes to:
   COMMAND: (tenantId: string, deviceId: string) =>
     `iot/${tenantId}/devices/${deviceId}/command`,
+  BROADCAST_COMMAND: (tenantId: string) =>
+    `iot/${tenantId}/broadcast/command`,
+  GROUP_COMMAND: (tenantId: string, group: string) =>
+    `iot/${tenantId}/groups/${group}/command`,
+  OTA_DATA: (tenantId: string, deviceId: string) =>
+    `iot/${tenantId}/devices/${deviceId}/ota/data`,
 
   // Wildcard subscriptions:
   ALL_TELEMETRY: 'iot/+/devices/+/telemetry',
   ALL_ACK: 'iot/+/devices/+/ack',
   ALL_STATUS: 'iot/+/devices/+/status',
+  ALL_TIME: 'iot/+/devices/+/time',
+  ALL_OTA_REQUEST: 'iot/+/devices/+/ota/request',
+  ALL_ROLLUP: 'iot/+/devices/+/rollup',
+  ALL_CRASH: 'iot/+/devices/+/crash',
+  ALL_CRASH_DATA: 'iot/+/devices/+/crash/data',
 } as const;
 
 // Redis Keys
 export const REDIS_KEYS = {
   // Device state shadow
   DEVICE_STATE: (deviceId: string) => `device:${deviceId}:state`,
+
+  // Newest telemetry boot/seq seen, for gap detection
+  TELEMETRY_SEQ: (deviceId: string) => `device:${deviceId}:telemetry-seq`,
   
   // Session and tokens
   SESSION: (sessionId: string) => `session:${sessionId}`,
@@ -53,4 +86,8 @@ export const REDIS_KEYS = {
   
   // Command correlation tracking
   COMMAND_CORRELATION: (correlationId: string) => `cmd:correlation:${correlationId}`,
+
+  // Crash report being received (begin message, then chunk index -> base64)
+  CRASH_REPORT: (deviceId: string, reportId: string) => `crash:${deviceId}:${reportId}`,
+  CRASH_CHUNKS: (deviceId: string, reportId: string) => `crash:${deviceId}:${reportId}:chunks`,
 } as const;
@@ -1,6 +1,14 @@
 import { z } from 'zod';
 
-export const commandStatusSchema = z.enum(['pending', 'sent', 'acked', 'failed', 'timeout']);
+export const commandStatusSchema = z.enum([
+  'pending',
+  'sent',
+  'running',
+  'acked',
+  'failed',
+  'cancelled',
+  'timeout',
+]);
 
 export const commandSchema = z.object({
   id: z.string().uuid(),
@@ -22,6 +30,13 @@ export const createCommandSchema = z.object({
   payload: z.record(z.unknown()).default({}),
 });
 
+// Command for every device of the tenant, or of one device group
+export const createBroadcastCommandSchema = z.object({
+  type: z.string().min(1).max(100),
+  payload: z.record(z.unknown()).default({}),
+  group: z.string().regex(/^[A-Za-z0-9_-]{1,32}$/).optional(),
+});
+
 // MQTT command payload (sent to device)
 export const mqttCommandPayloadSchema = z.object({
   correlationId: z.string().uuid(),
@@ -30,18 +45,25 @@ export const mqttCommandPayloadSchema = z.object({
   timestamp: z.string().datetime(),
 });
 
-// MQTT ack payload (received from device)
+// MQTT ack payload (received from device). Long-running commands send
+// "accepted", then "progress", then one final success/error/cancelled.
 export const mqttAckPayloadSchema = z.object({
   correlationId: z.string().uuid(),
-  status: z.enum(['success', 'error']),
+  action: z.string().optional(),
+  status: z.enum(['accepted', 'progress', 'success', 'error', 'cancelled']),
+  progress: z.number().int().min(0).max(100).optional(),
+  durationMs: z.number().int().nonnegative().optional(),
   error: z.string().optional(),
+  result: z.record(z.unknown()).optional(),
   state: z.record(z.unknown()).optional(),
-  timestamp: z.string().datetime(),
+  // Left out by devices whose clock is not synced yet
+  timestamp: z.string().datetime().optional(),
 });
 
 export type CommandStatus = z.infer<typeof commandStatusSchema>;
 export type Command = z.infer<typeof commandSchema>;
 export type CreateCommand = z.infer<typeof createCommandSchema>;
+export type CreateBroadcastCommand = z.infer<typeof createBroadcastCommandSchema>;
 export type MqttCommandPayload = z.infer<typeof mqttCommandPayloadSchema>;
 export type MqttAckPayload = z.infer<typeof mqttAckPayloadSchema>;
 
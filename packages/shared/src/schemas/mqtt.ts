@@ -1,8 +1,14 @@
 import { z } from 'zod';
+import { CRASH_REPORT_LIMITS } from '../constants';
 
 // Telemetry payload from device
+// boot/seq number samples per boot; resent marks a sample republished by
+// resend_telemetry, stamped with the time it was taken
 export const mqttTelemetryPayloadSchema = z.object({
   timestamp: z.string().datetime().optional(),
+  boot: z.string().regex(/^[0-9a-fA-F]{8}$/).optional(),
+  seq: z.number().int().positive().max(2147483647).optional(),
+  resent: z.boolean().optional(),
   data: z.record(z.unknown()),
 });
 
@@ -12,6 +18,73 @@ export type MqttTelemetryPayload = z.infer<typeof mqttTelemetryPayloadSchema>;
 export const mqttStatusPayloadSchema = z.object({
   status: z.enum(['online', 'offline']),
   timestamp: z.string().datetime().optional(),
+  // Birth message capability negotiation (online only)
+  fw: z.string().optional(),
+  build: z.number().int().optional(),
+  schema: z.number().int().optional(),
+  caps: z.number().int().nonnegative().optional(),
+  profile: z.number().int().nonnegative().optional(),
+  limits: z.record(z.number()).optional(),
 });
 
 export type MqttStatusPayload = z.infer<typeof mqttStatusPayloadSchema>;
+
+// Time sync request from device (t0 = device clock when sent)
+export const mqttTimeSyncRequestSchema = z.object({
+  t0: z.number().int().nonnegative(),
+});
+
+export type MqttTimeSyncRequest = z.infer<typeof mqttTimeSyncRequestSchema>;
+
+// Firmware chunk request from a device running ota_mqtt (id = correlationId)
+export const mqttOtaRequestSchema = z.object({
+  id: z.string(),
+  chunkSize: z.number().int().min(64).max(4096),
+  chunks: z.array(z.number().int().nonnegative()).min(1).max(16),
+});
+
+export type MqttOtaRequest = z.infer<typeof mqttOtaRequestSchema>;
+
+// One closed rollup bucket; values are integers in 1/scale units
+const mqttRollupAccumulatorSchema = z.object({
+  count: z.number().int().positive(),
+  min: z.number().int(),
+  max: z.number().int(),
+  sum: z.number().int(),
+  sumSq: z.number().nonnegative(),
+});
+
+export const mqttRollupPayloadSchema = z.object({
+  periodS: z.number().int().positive(),
+  start: z.string().datetime(),
+  scale: z.number().int().positive(),
+  temperature: mqttRollupAccumulatorSchema,
+  humidity: mqttRollupAccumulatorSchema,
+});
+
+export type MqttRollupPayload = z.infer<typeof mqttRollupPayloadSchema>;
+
+// Crash report from a device after a panic, watchdog or brownout reset
+// (id = boot ID of the reporting boot); the core dump follows on crash/data
+export const mqttCrashReportSchema = z.discriminatedUnion('type', [
+  z.object({
+    type: z.literal('begin'),
+    id: z.string().regex(/^[0-9a-fA-F]{8}$/),
+    reason: z.string(),
+    crashedBoot: z.string().optional(),
+    uptimeMs: z.number().int().nonnegative().optional(),
+    fw: z.string().optional(),
+    dumpSize: z.number().int().nonnegative()
+      .max(CRASH_REPORT_LIMITS.MAX_CHUNKS * CRASH_REPORT_LIMITS.MAX_CHUNK_SIZE),
+    chunkSize: z.number().int().positive().max(CRASH_REPORT_LIMITS.MAX_CHUNK_SIZE),
+    chunks: z.number().int().nonnegative().max(CRASH_REPORT_LIMITS.MAX_CHUNKS),
+    crc32: z.string().regex(/^[0-9a-fA-F]{8}$/),
+  }),
+  z.object({
+    type: z.literal('end'),
+    id: z.string().regex(/^[0-9a-fA-F]{8}$/),
+    chunks: z.number().int().nonnegative().max(CRASH_REPORT_LIMITS.MAX_CHUNKS),
+  }),
+]);
+
+export type MqttCrashReport = z.infer<typeof mqttCrashReportSchema>;